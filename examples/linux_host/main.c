@@ -0,0 +1,74 @@
+/*
+ * @Brief
+ * This example shows how to run the SDK natively on a linux host.
+ * It connects to the broker given in the device config file (or in the BYTEBEAM_BROKER_URI environment variable),
+ * handles the hello_world action and has the SDK publish the device shadow heartbeat every few seconds.
+ */
+
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "bytebeam_sdk.h"
+
+// this macro is used to specify the delay between the device shadow heartbeats
+#define APP_DELAY_FIVE_SEC 5
+
+// this macro is used to specify the delay between the loop count updates
+#define APP_DELAY_ONE_MIN 60
+
+static volatile sig_atomic_t is_running = 1;
+
+static bytebeam_client_t bytebeam_client;
+
+static void handle_signal(int signal)
+{
+    (void)signal;
+    is_running = 0;
+}
+
+static int handle_hello_world(bytebeam_client_t *bytebeam_client, char *args, char *action_id)
+{
+    printf("Hello World action received, args : %s\n", args);
+
+    return bytebeam_publish_action_completed(bytebeam_client, action_id);
+}
+
+int main(void)
+{
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    if (bytebeam_init(&bytebeam_client) != BB_SUCCESS) {
+        printf("Bytebeam init failed, is device_config.json in the working directory?\n");
+        return 1;
+    }
+
+    bytebeam_add_action_handler(&bytebeam_client, handle_hello_world, "hello_world");
+
+    if (bytebeam_start(&bytebeam_client) != BB_SUCCESS) {
+        printf("Bytebeam start failed\n");
+
+        bytebeam_destroy(&bytebeam_client);
+        return 1;
+    }
+
+    bytebeam_shadow_config_t shadow_config = BYTEBEAM_SHADOW_DEFAULT_CONFIG();
+
+    // the sdk publishes the heartbeat, the fields that did not change since the last one are left out
+    shadow_config.heartbeat_interval_ms = APP_DELAY_FIVE_SEC * 1000;
+    bytebeam_shadow_set_config(&bytebeam_client, &shadow_config);
+
+    long long loop_count = 0;
+
+    while (is_running) {
+        bytebeam_shadow_set_int(&bytebeam_client, "Loop_Count", loop_count++);
+
+        sleep(APP_DELAY_ONE_MIN);
+    }
+
+    bytebeam_stop(&bytebeam_client);
+    bytebeam_destroy(&bytebeam_client);
+
+    return 0;
+}
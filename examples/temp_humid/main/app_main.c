@@ -35,8 +35,6 @@
 #include "lwip/dns.h"
 #include "lwip/netdb.h"
 
-#include "cJSON.h"
-
 #include "driver/gpio.h"
 #include "driver/i2c.h"
 
@@ -54,6 +52,20 @@ static float humidity = 90;
 
 static char sht_stream[] = "sht_stream";
 
+// one row of the sht stream, the schema below tells the sdk how to serialize it
+typedef struct {
+    uint64_t timestamp;
+    uint64_t sequence;
+    float temperature;
+    float humidity;
+} sht_record_t;
+
+BYTEBEAM_SCHEMA_DEFINE(sht_schema, sht_record_t,
+    BYTEBEAM_SCHEMA_FIELD(sht_record_t, timestamp,   BYTEBEAM_SCHEMA_UINT64),
+    BYTEBEAM_SCHEMA_FIELD(sht_record_t, sequence,    BYTEBEAM_SCHEMA_UINT64),
+    BYTEBEAM_SCHEMA_FIELD(sht_record_t, temperature, BYTEBEAM_SCHEMA_FLOAT),
+    BYTEBEAM_SCHEMA_FIELD(sht_record_t, humidity,    BYTEBEAM_SCHEMA_FLOAT));
+
 static bytebeam_client_t bytebeam_client;
 
 static const char *TAG = "BYTEBEAM_TEMP_HUMID_EXAMPLE";
@@ -87,108 +99,41 @@ static void sht_init(void)
 static int publish_sht_values(bytebeam_client_t *bytebeam_client)
 {
     struct timeval te;
-    long long milliseconds = 0;
     static uint64_t sequence = 0;
 
-    cJSON *device_shadow_json_list = NULL;
-    cJSON *device_shadow_json = NULL;
-    cJSON *sequence_json = NULL;
-    cJSON *timestamp_json = NULL;
-    cJSON *device_status_json = NULL;
-    cJSON *temperature_json = NULL;
-    cJSON *humidity_json = NULL;
-
-    char *string_json = NULL;
-
-    device_shadow_json_list = cJSON_CreateArray();
-
-    if (device_shadow_json_list == NULL)
-    {
-        ESP_LOGE(TAG, "Json Init failed.");
-        return -1;
-    }
-
-    device_shadow_json = cJSON_CreateObject();
-
-    if (device_shadow_json == NULL)
-    {
-        ESP_LOGE(TAG, "Json add failed.");
-        cJSON_Delete(device_shadow_json_list);
-        return -1;
-    }
+    sht_record_t record = { 0 };
+    char string_json[256] = { 0 };
+    bytebeam_json_writer_t writer;
 
     // get current time
     gettimeofday(&te, NULL);
-    milliseconds = te.tv_sec * 1000LL + te.tv_usec / 1000;
-
-    timestamp_json = cJSON_CreateNumber(milliseconds);
-
-    if (timestamp_json == NULL)
-    {
-        ESP_LOGE(TAG, "Json add time stamp failed.");
-        cJSON_Delete(device_shadow_json_list);
-        return -1;
-    }
-
-    cJSON_AddItemToObject(device_shadow_json, "timestamp", timestamp_json);
+    record.timestamp = te.tv_sec * 1000ULL + te.tv_usec / 1000;
 
     sequence++;
-    sequence_json = cJSON_CreateNumber(sequence);
-
-    if (sequence_json == NULL)
-    {
-        ESP_LOGE(TAG, "Json add sequence id failed.");
-        cJSON_Delete(device_shadow_json_list);
-        return -1;
-    }
-
-    cJSON_AddItemToObject(device_shadow_json, "sequence", sequence_json);
+    record.sequence = sequence;
 
     // get tempearture and humidity samples
     get_sht_values();
 
-    temperature_json = cJSON_CreateNumber(temperature);
+    record.temperature = temperature;
+    record.humidity = humidity;
 
-    if (temperature_json == NULL)
-    {
-        ESP_LOGE(TAG, "Json add temperature failed.");
-        cJSON_Delete(device_shadow_json_list);
-        return -1;
-    }
-    
-    cJSON_AddItemToObject(device_shadow_json, "temperature", temperature_json);
-    
-    humidity_json = cJSON_CreateNumber(humidity);
+    // the schema writes the record struct straight into the buffer, no json objects are built in between
+    bytebeam_json_writer_init(&writer, string_json, sizeof(string_json));
+    bytebeam_json_begin_array(&writer, NULL);
+    bytebeam_schema_write_json(&writer, &sht_schema, &record, 1);
+    bytebeam_json_end_array(&writer);
 
-    if (humidity_json == NULL)
+    if (bytebeam_json_writer_finish(&writer) != BB_SUCCESS)
     {
-        ESP_LOGE(TAG, "Json add humidity failed.");
-        cJSON_Delete(device_shadow_json_list);
-        return -1;
-    }
-    
-    cJSON_AddItemToObject(device_shadow_json, "humidity", humidity_json);
-
-    cJSON_AddItemToArray(device_shadow_json_list, device_shadow_json);
-
-    string_json = cJSON_Print(device_shadow_json_list);
-
-    if(string_json == NULL)
-    {
-        ESP_LOGE(TAG, "Json string print failed.");
-        cJSON_Delete(device_shadow_json_list);
+        ESP_LOGE(TAG, "Json size exceeded buffer size.");
         return -1;
     }
 
     ESP_LOGI(TAG, "\nStatus to send:\n%s\n", string_json);
 
     // publish the json to sht stream
-    int ret_val = bytebeam_publish_to_stream(bytebeam_client, sht_stream, string_json);
-
-    cJSON_Delete(device_shadow_json_list);
-    cJSON_free(string_json);
-
-    return ret_val;
+    return bytebeam_publish_to_stream(bytebeam_client, sht_stream, string_json);
 }
 
 static void app_start(bytebeam_client_t *bytebeam_client)
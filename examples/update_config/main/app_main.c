@@ -281,15 +281,17 @@ static void sync_time_from_ntp(void)
 int handle_update_config(bytebeam_client_t *bytebeam_client, char *args, char *action_id) 
 {
     int ret_val = 0;
-    cJSON *root = NULL;
-    cJSON *name = NULL;
-    cJSON *version = NULL;
-    cJSON *step_value = NULL;
+    int name = -1;
+    int version = -1;
+    int step_value = -1;
+    int token_count = 0;
+    double step_value_val = 0;
+    bytebeam_json_token_t tokens[16];
 
-    // parse the received json
-    root = cJSON_Parse(args);
+    // parse the received json, the tokens just point into the args so no memory is allocated
+    token_count = bytebeam_json_parse(args, strlen(args), tokens, 16);
 
-    if (root == NULL) 
+    if (token_count < 1 || tokens[0].type != BYTEBEAM_JSON_OBJECT) 
     {
         ESP_LOGE(TAG, "ERROR in parsing the JSON\n");
 
@@ -304,9 +306,9 @@ int handle_update_config(bytebeam_client_t *bytebeam_client, char *args, char *a
         return -1;
     }
 
-    name = cJSON_GetObjectItem(root, "name");
+    name = bytebeam_json_find(args, tokens, token_count, 0, "name");
 
-    if (!(cJSON_IsString(name) && (name->valuestring != NULL))) 
+    if (!(name != -1 && bytebeam_json_unescape(args, &tokens[name]) != NULL)) 
     {
         ESP_LOGE(TAG, "Error parsing update config name\n");
 
@@ -318,15 +320,14 @@ int handle_update_config(bytebeam_client_t *bytebeam_client, char *args, char *a
             ESP_LOGE(TAG, "Failed to Publish action failed response for Update Config action");
         }
 
-        cJSON_Delete(root);
         return -1;
     }
 
-    ESP_LOGI(TAG, "Checking update config name \"%s\"\n", name->valuestring);
+    ESP_LOGI(TAG, "Checking update config name \"%s\"\n", args + tokens[name].start);
 
-    version = cJSON_GetObjectItem(root, "version");
+    version = bytebeam_json_find(args, tokens, token_count, 0, "version");
 
-    if (!(cJSON_IsString(version) && (version->valuestring != NULL)))
+    if (!(version != -1 && bytebeam_json_unescape(args, &tokens[version]) != NULL))
     {
         ESP_LOGE(TAG, "Error parsing update config version\n");
 
@@ -338,15 +339,14 @@ int handle_update_config(bytebeam_client_t *bytebeam_client, char *args, char *a
             ESP_LOGE(TAG, "Failed to Publish action failed response for Update Config action");
         }
 
-        cJSON_Delete(root);
         return -1;
     }
 
-    ESP_LOGI(TAG, "Checking update config version \"%s\"\n", version->valuestring);
+    ESP_LOGI(TAG, "Checking update config version \"%s\"\n", args + tokens[version].start);
 
-    step_value = cJSON_GetObjectItem(root, "step_value");
+    step_value = bytebeam_json_find(args, tokens, token_count, 0, "step_value");
 
-    if (!(cJSON_IsNumber(step_value)))
+    if (!(step_value != -1 && bytebeam_json_get_double(args, &tokens[step_value], &step_value_val) == BB_SUCCESS))
     {
         ESP_LOGE(TAG, "Error parsing update config step value\n");
 
@@ -358,15 +358,14 @@ int handle_update_config(bytebeam_client_t *bytebeam_client, char *args, char *a
             ESP_LOGE(TAG, "Failed to Publish action failed response for Update Config action");
         }
 
-        cJSON_Delete(root);
         return -1;
     }
 
-    ESP_LOGI(TAG, "Checking update config step value %d\n", (int)step_value->valuedouble);
+    ESP_LOGI(TAG, "Checking update config step value %d\n", (int)step_value_val);
 
     // Generate the duty cycle for the led
     uint32_t ledc_res = (uint32_t)round(pow(2,LEDC_DUTY_RES)) - 1;
-    led_duty_cycle = ((ledc_res) * (step_value->valuedouble/LEDC_STEP_SIZE));
+    led_duty_cycle = ((ledc_res) * (step_value_val/LEDC_STEP_SIZE));
 
     // set the update config command flag
     update_config_cmd = 1;
@@ -380,9 +379,6 @@ int handle_update_config(bytebeam_client_t *bytebeam_client, char *args, char *a
 		return -1;
     }
 
-    // release the memory occupied by the json object
-    cJSON_Delete(root);
-
     return 0;
 }
 
@@ -9,12 +9,39 @@
 /*This macro is used to specify the maximum length of bytebeam action id string*/
 #define BYTEBEAM_ACTION_ID_STR_LEN 20
 
+/*This macro is used to specify the maximum length of bytebeam action status json string*/
+#define BYTEBEAM_ACTION_STATUS_STR_LEN 512
+
+/*This macro is used to specify the maximum length of bytebeam action name string*/
+#define BYTEBEAM_ACTION_NAME_STR_LEN 64
+
+/*This macro is used to specify the maximum number of json tokens in a received action message*/
+#define BYTEBEAM_ACTION_JSON_TOKEN_COUNT 32
+
+/*This macro is used to specify the size of the payload buffer of each queued action, longer payloads are allocated*/
+#define BYTEBEAM_ACTION_PAYLOAD_STR_LEN 512
+
+/*This macro is used to specify the default number of action worker tasks*/
+#define BYTEBEAM_ACTION_WORKER_COUNT 2
+
+/*This macro is used to specify the default number of received actions waiting for a free action worker*/
+#define BYTEBEAM_ACTION_QUEUE_SIZE 8
+
+/*This macro is used to specify the default stack size of the action worker tasks*/
+#define BYTEBEAM_ACTION_WORKER_STACK_SIZE 8192
+
+/*This macro is used to specify the default priority of the action worker tasks*/
+#define BYTEBEAM_ACTION_WORKER_PRIORITY 5
+
 /**
  * @brief Adds action handler for handling particular action.
  *
- * @note Arguments of the action handler function is generated dynamically inside the SDK and it will be freed after
- *       executing the action handler function. So make sure you are not using it outside the scope of the action
- *       handler function as this may cause memory leaks in your application.
+ * @note Arguments of the action handler function point into the buffers of the SDK i.e. the received message or the
+ *       action queue, which are reused after executing the action handler function. So make sure you are not using
+ *       them outside the scope of the action handler function, copy them if you need them later.
+ *
+ * @note The args is the unescaped payload json of the action, the action handler can parse it with
+ *       bytebeam_json_parse() only if and when it needs it, without any memory allocation.
  *
  * @param[in] bytebeam_client bytebeam client handle
  * @param[in] func_ptr        pointer to action handler function
@@ -67,6 +94,25 @@ bytebeam_err_t bytebeam_update_action_handler(bytebeam_client_t *bytebeam_client
  */
 bytebeam_err_t bytebeam_is_action_handler_there(bytebeam_client_t *bytebeam_client, char *func_name);
 
+/**
+ * @brief Set the scheduling options of particular action.
+ *
+ * @note  The received actions wait in a queue for a free worker task, the ones with higher priority are picked first
+ *        and an action never runs more than max_concurrency times in parallel. By default the actions have priority 0
+ *        and run one at a time.
+ *
+ * @param[in] bytebeam_client bytebeam client handle
+ * @param[in] func_name       action name
+ * @param[in] priority        higher value is picked first
+ * @param[in] max_concurrency maximum number of instances of the action running in parallel, atleast 1
+ *
+ * @return
+ *      BB_SUCCESS: Action options updated successfully
+ *      BB_FAILURE: If the action handler doesn't exist or max_concurrency is invalid
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client or func_name is NULL
+ */
+bytebeam_err_t bytebeam_set_action_handler_options(bytebeam_client_t *bytebeam_client, char *func_name, int priority, int max_concurrency);
+
 /**
  * @brief print action handler array.
  *
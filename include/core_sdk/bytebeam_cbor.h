@@ -0,0 +1,193 @@
+#ifndef BYTEBEAM_CBOR_H
+#define BYTEBEAM_CBOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bytebeam_client.h"
+
+/**
+ * @struct bytebeam_cbor_writer_t
+ * This struct contains the state of a streaming cbor (RFC 8949) writer which emits cbor into a caller provided buffer
+ * @var bytebeam_cbor_writer_t::buffer
+ * Output buffer
+ * @var bytebeam_cbor_writer_t::size
+ * Size of the output buffer in bytes
+ * @var bytebeam_cbor_writer_t::length
+ * Length of the cbor written so far
+ * @var bytebeam_cbor_writer_t::overflow
+ * Set once anything failed to fit in the output buffer, all the further writes are ignored
+ */
+typedef struct bytebeam_cbor_writer {
+    uint8_t *buffer;
+    int size;
+    int length;
+    bool overflow;
+} bytebeam_cbor_writer_t;
+
+/**
+ * @brief Initialize the cbor writer on the caller provided buffer
+ *
+ * @note  The writer never allocates memory, every api below writes directly into the buffer. The apis mirror the ones
+ *        of the json writer, the key argument is the map key when writing inside a map and must be NULL otherwise.
+ *        Maps and arrays are written with indefinite length, so the number of their items need not be known up front.
+ *
+ * @param[in] writer  cbor writer handle
+ * @param[in] buffer  output buffer
+ * @param[in] size    size of the output buffer in bytes
+ *
+ * @return
+ *      void
+ */
+void bytebeam_cbor_writer_init(bytebeam_cbor_writer_t *writer, uint8_t *buffer, int size);
+
+/**
+ * @brief Begin a map, the json object counterpart
+ *
+ * @param[in] writer  cbor writer handle
+ * @param[in] key     map key or NULL
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_cbor_begin_map(bytebeam_cbor_writer_t *writer, const char *key);
+
+/**
+ * @brief End the current map
+ *
+ * @param[in] writer  cbor writer handle
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_cbor_end_map(bytebeam_cbor_writer_t *writer);
+
+/**
+ * @brief Begin an array
+ *
+ * @param[in] writer  cbor writer handle
+ * @param[in] key     map key or NULL
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_cbor_begin_array(bytebeam_cbor_writer_t *writer, const char *key);
+
+/**
+ * @brief End the current array
+ *
+ * @param[in] writer  cbor writer handle
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_cbor_end_array(bytebeam_cbor_writer_t *writer);
+
+/**
+ * @brief Write a text string value
+ *
+ * @param[in] writer  cbor writer handle
+ * @param[in] key     map key or NULL
+ * @param[in] value   NULL terminated UTF-8 string, NULL is written as cbor null
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_cbor_add_string(bytebeam_cbor_writer_t *writer, const char *key, const char *value);
+
+/**
+ * @brief Write a signed integer value in the smallest encoding that holds it
+ *
+ * @param[in] writer  cbor writer handle
+ * @param[in] key     map key or NULL
+ * @param[in] value   integer value
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_cbor_add_int(bytebeam_cbor_writer_t *writer, const char *key, long long value);
+
+/**
+ * @brief Write an unsigned integer value in the smallest encoding that holds it
+ *
+ * @param[in] writer  cbor writer handle
+ * @param[in] key     map key or NULL
+ * @param[in] value   integer value
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_cbor_add_uint(bytebeam_cbor_writer_t *writer, const char *key, unsigned long long value);
+
+/**
+ * @brief Write a floating point value, as single precision if that holds it exactly and as double precision otherwise
+ *
+ * @note  NaN and infinity are written as cbor null, same as the json writer does
+ *
+ * @param[in] writer  cbor writer handle
+ * @param[in] key     map key or NULL
+ * @param[in] value   floating point value
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_cbor_add_double(bytebeam_cbor_writer_t *writer, const char *key, double value);
+
+/**
+ * @brief Write a single precision floating point value, NaN and infinity are written as cbor null
+ *
+ * @param[in] writer  cbor writer handle
+ * @param[in] key     map key or NULL
+ * @param[in] value   floating point value
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_cbor_add_float(bytebeam_cbor_writer_t *writer, const char *key, float value);
+
+/**
+ * @brief Write a boolean value
+ *
+ * @param[in] writer  cbor writer handle
+ * @param[in] key     map key or NULL
+ * @param[in] value   boolean value
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_cbor_add_bool(bytebeam_cbor_writer_t *writer, const char *key, bool value);
+
+/**
+ * @brief Write a null value
+ *
+ * @param[in] writer  cbor writer handle
+ * @param[in] key     map key or NULL
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_cbor_add_null(bytebeam_cbor_writer_t *writer, const char *key);
+
+/**
+ * @brief Check that the whole cbor fitted in the output buffer
+ *
+ * @param[in] writer  cbor writer handle
+ *
+ * @return
+ *      BB_SUCCESS: The output buffer holds the complete cbor, writer->length bytes long
+ *      BB_FAILURE: Output buffer overflowed while writing
+ *      BB_NULL_CHECK_FAILURE: If the writer is NULL
+ */
+bytebeam_err_t bytebeam_cbor_writer_finish(bytebeam_cbor_writer_t *writer);
+
+#endif /* BYTEBEAM_CBOR_H */
@@ -1,7 +1,13 @@
 #ifndef BYTEBEAM_CLIENT_H
 #define BYTEBEAM_CLIENT_H
 
+#ifdef CONFIG_SDK_PLATFORM_LINUX
+#include <stdbool.h>
+#include <stdint.h>
+#include "bytebeam_linux_mqtt.h"
+#else
 #include "mqtt_client.h"
+#endif
 
 /*This macro is used to specify the maximum length of bytebeam broker url string*/
 #define BYTEBEAM_BROKER_URL_STR_LEN 100
@@ -12,12 +18,29 @@
 /*This macro is used to specify the maximum length of bytebeam project id string*/
 #define BYTEBEAM_PROJECT_ID_STR_LEN 100
 
-/*This macro is used to specify the maximum number of actions that need to be handled for particular device*/
-#define BYTEBEAM_NUMBER_OF_ACTIONS 10
+/*This macro is used to specify the initial capacity of the action handler registry, it grows as more actions are added*/
+#define BYTEBEAM_NUMBER_OF_ACTIONS 16
 
-struct bytebeam_client_t;
+/*This macro is used to specify the maximum number of json tokens in the device config file*/
+#define BYTEBEAM_DEVICE_CONFIG_JSON_TOKEN_COUNT 64
+
+/*This macro is used to specify the maximum length of the bytebeam OTA error string*/
+#define BYTEBEAM_OTA_ERROR_STR_LEN 200
+
+struct bytebeam_client;
+struct bytebeam_action_registry;
+struct bytebeam_action_pool;
+struct bytebeam_offline_queue;
+struct bytebeam_delivery;
+struct bytebeam_shadow;
+
+#ifdef CONFIG_SDK_PLATFORM_LINUX
+typedef bytebeam_linux_mqtt_client_handle_t bytebeam_client_handle_t;
+typedef bytebeam_linux_mqtt_config_t bytebeam_client_config_t;
+#else
 typedef esp_mqtt_client_handle_t bytebeam_client_handle_t;
 typedef esp_mqtt_client_config_t bytebeam_client_config_t;
+#endif
 
 /**
  * @struct bytebeam_device_config_t
@@ -54,9 +77,46 @@ typedef struct bytebeam_device_config {
  */
 typedef struct bytebeam_action_functions_map {
     const char *name;
-    int (*func)(struct bytebeam_client_t *bytebeam_client, char *args, char *action_id);
+    int (*func)(struct bytebeam_client *bytebeam_client, char *args, char *action_id);
 } bytebeam_action_functions_map_t;
 
+/**
+ * @struct bytebeam_action_pool_config_t
+ * This struct contains the configuration of the worker tasks executing the action handlers, zero means default
+ * @var bytebeam_action_pool_config_t::worker_count
+ * Number of worker tasks, i.e. the number of action handlers that can run in parallel
+ * @var bytebeam_action_pool_config_t::queue_size
+ * Number of received actions that can wait for a free worker, the actions received beyond it are failed
+ * @var bytebeam_action_pool_config_t::worker_stack_size
+ * Stack size of each worker task, keep it big enough for the heaviest action handler (e.g. OTA)
+ * @var bytebeam_action_pool_config_t::worker_priority
+ * Priority of the worker tasks
+ */
+typedef struct bytebeam_action_pool_config {
+    int worker_count;
+    int queue_size;
+    int worker_stack_size;
+    int worker_priority;
+} bytebeam_action_pool_config_t;
+
+/**
+ * @struct bytebeam_sleep_cycle_config_t
+ * This struct contains the settings of the sleep cycle mode, for the devices waking up from deep sleep just to publish
+ * and going back to sleep. The mode keeps an mqtt persistent session, so the broker holds on to the action
+ * subscription and queues the actions while the device sleeps. Zero means default.
+ * @var bytebeam_sleep_cycle_config_t::is_enabled
+ * Turns the sleep cycle mode on
+ * @var bytebeam_sleep_cycle_config_t::subscribe_every
+ * The actions are subscribed on every nth wake up only, or whenever the broker lost the session
+ * @var bytebeam_sleep_cycle_config_t::heartbeat_every
+ * The device heartbeat is published on start of every nth wake up only
+ */
+typedef struct bytebeam_sleep_cycle_config {
+    bool is_enabled;
+    int subscribe_every;
+    int heartbeat_every;
+} bytebeam_sleep_cycle_config_t;
+
 typedef struct bytebeam_device_info {
     const char *status;
     const char *software_type;
@@ -71,22 +131,61 @@ typedef struct bytebeam_device_info {
  * @var bytebeam_client_t::device_cfg
  * structure for all the tls authentication related configs
  * @var bytebeam_client_t::client
- * ESP MQTT client handle 
+ * MQTT client handle of the platform i.e. ESP MQTT or the linux mqtt client
  * @var bytebeam_client_t::mqtt_cfg
- * ESP MQTT client configuration structure
- * @var bytebeam_client_t::action_funcs
- * Array containing action handler structure for all the configured actions on Bytebeam platform
+ * MQTT client configuration structure of the platform
+ * @var bytebeam_client_t::action_registry
+ * Hash table of the action handlers for all the configured actions on Bytebeam platform, NULL until one is added
+ * @var bytebeam_client_t::action_pool_cfg
+ * Configuration of the action worker tasks, must be set before initializing the client
+ * @var bytebeam_client_t::action_pool
+ * Action worker tasks state, created by bytebeam_init
+ * @var bytebeam_client_t::sleep_cycle_cfg
+ * Configuration of the sleep cycle mode, must be set before initializing the client
  * @var bytebeam_client_t::connection_status
  * Connection status of MQTT client instance.
+ * @var bytebeam_client_t::offline_queue
+ * Offline queue state, NULL unless the offline queue is enabled
+ * @var bytebeam_client_t::stream_topics
+ * Cache of the publish topics of the opened streams, created by bytebeam_init
+ * @var bytebeam_client_t::delivery
+ * In-flight table of the stream publishes waiting for their acknowledgement, created by bytebeam_init
+ * @var bytebeam_client_t::shadow
+ * Last sent state of the device shadow, created by bytebeam_init
+ * @var bytebeam_client_t::log
+ * Cloud logging state i.e log level, log stream and sequence, created by bytebeam_init
+ * @var bytebeam_client_t::device_config_data
+ * Device config read by bytebeam_init which the certificates point into, NULL if the device config is provided
+ * @var bytebeam_client_t::last_action_id
+ * Id of the last handled action, the actions with an id upto this one are ignored if triggered again
+ * @var bytebeam_client_t::action_status_sequence
+ * Sequence number of the last action status published
+ * @var bytebeam_client_t::ota_action_id
+ * Id of the OTA action in progress, NULL if there is none
+ * @var bytebeam_client_t::ota_error_str
+ * Reason of the last OTA failure, reported with the failed action status
  */
 typedef struct bytebeam_client {
     bytebeam_device_info_t device_info;
     bytebeam_device_config_t device_cfg;
     bytebeam_client_handle_t client;
     bytebeam_client_config_t mqtt_cfg;
-    bytebeam_action_functions_map_t action_funcs[BYTEBEAM_NUMBER_OF_ACTIONS];
+    struct bytebeam_action_registry *action_registry;
+    bytebeam_action_pool_config_t action_pool_cfg;
+    struct bytebeam_action_pool *action_pool;
+    bytebeam_sleep_cycle_config_t sleep_cycle_cfg;
     int connection_status;
     bool use_device_config_data;
+    struct bytebeam_offline_queue *offline_queue;
+    struct bytebeam_stream_topics *stream_topics;
+    struct bytebeam_delivery *delivery;
+    struct bytebeam_shadow *shadow;
+    struct bytebeam_log *log;
+    char *device_config_data;
+    int last_action_id;
+    uint64_t action_status_sequence;
+    char *ota_action_id;
+    char ota_error_str[BYTEBEAM_OTA_ERROR_STR_LEN];
 } bytebeam_client_t;
 
 /*Status codes propogated via functions*/
@@ -94,7 +193,8 @@ typedef enum bytebeam_err {
     BB_SUCCESS = 0,
     BB_FAILURE = -1,
     BB_NULL_CHECK_FAILURE = -2,
-    BB_PROGRESS_OUT_OF_RANGE = -3
+    BB_PROGRESS_OUT_OF_RANGE = -3,
+    BB_RATE_LIMITED = -4
 } bytebeam_err_t;
 
 /**
@@ -149,4 +249,17 @@ bytebeam_err_t bytebeam_stop(bytebeam_client_t *bytebeam_client);
  */
 bytebeam_err_t bytebeam_destroy(bytebeam_client_t *bytebeam_client);
 
+/**
+ * @brief Clears the provisioning cache, so that the next bytebeam_init reads the device config file again
+ *
+ * @note  With CONFIG_BYTEBEAM_PROVISIONING_CACHE the device config is cached after the first successful parse and
+ *        the later boots never look at the device config file, so call this api after re-provisioning the device.
+ *        The running client keeps its device config.
+ *
+ * @return
+ *      BB_SUCCESS: Provisioning cache cleared, or there was none
+ *      BB_FAILURE: Provisioning cache could not be cleared
+ */
+bytebeam_err_t bytebeam_clear_provisioning_cache(void);
+
 #endif /* BYTEBEAM_CLIENT_H */
\ No newline at end of file
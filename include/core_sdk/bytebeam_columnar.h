@@ -0,0 +1,200 @@
+#ifndef BYTEBEAM_COLUMNAR_H
+#define BYTEBEAM_COLUMNAR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bytebeam_client.h"
+#include "bytebeam_stream.h"
+
+/*This macro is used to specify the maximum number of value columns of a columnar batch*/
+#define BYTEBEAM_COLUMNAR_MAX_COLUMNS 8
+
+/*This macro is used to specify the maximum length of a columnar batch column name*/
+#define BYTEBEAM_COLUMNAR_COLUMN_NAME_LEN 255
+
+/*This macro is used to specify the version of the columnar batch format, the first byte of every batch*/
+#define BYTEBEAM_COLUMNAR_FORMAT_VERSION 1
+
+/*
+ * Columnar batch format, published on the /columnar topic of a stream. A batch is a header followed by a bit stream.
+ *
+ * Header, multi byte integers are little endian:
+ *   u8  version, BYTEBEAM_COLUMNAR_FORMAT_VERSION
+ *   u8  flags, bit 0 set if the samples are period_ms apart and the bit stream holds no timestamps
+ *   u8  column count
+ *   per column: u8 name length, the name bytes, u8 type (0 float, 1 int)
+ *   u32 sample count
+ *   u64 timestamp of the first sample in milliseconds
+ *   u32 period_ms, 0 if the timestamps are in the bit stream
+ *
+ * Bit stream, most significant bit first, padded with zero bits to a whole byte. Per sample:
+ *   timestamp, unless the period is fixed and except for the first sample whose timestamp is in the header:
+ *     the delta of delta against the previous sample, the delta before the second sample being 0, as a dod code
+ *   then per column, in the header order:
+ *     first sample: the 64 bits of the value, the IEEE 754 double for the float columns and int64 for the int ones
+ *     int column: the delta of delta against the previous two values (previous delta 0 at first) as a dod code
+ *     float column: the xor of the value's double bits with the previous value's ones (Gorilla encoding)
+ *       '0'                   the xor is zero, same value as before
+ *       '10' bits             the meaningful bits of the xor, within the leading and trailing zero window of the
+ *                             last '11' of the column
+ *       '11' 5b 6b bits       a new window of 5 bits of leading zeros (upto 31), 6 bits of meaningful bits length
+ *                             (0 meaning 64) followed by the meaningful bits
+ *
+ * Dod code, the delta of delta as two's complement of the given width:
+ *   '0' for 0, '10' 7 bits, '110' 9 bits, '1110' 12 bits, '1111' 64 bits
+ *
+ * The deltas are taken modulo 2^64, so the decoder adds them back with wrapping arithmetic.
+ */
+
+/* This enum represents the type of a columnar batch column */
+typedef enum {
+    BYTEBEAM_COLUMNAR_FLOAT,
+    BYTEBEAM_COLUMNAR_INT,
+} bytebeam_columnar_type_t;
+
+/**
+ * @struct bytebeam_columnar_column_t
+ * This struct describes a value column of a columnar batch
+ * @var bytebeam_columnar_column_t::name
+ * Name of the column, the field name of the decoded records
+ * @var bytebeam_columnar_column_t::type
+ * Type of the column values
+ */
+typedef struct bytebeam_columnar_column {
+    const char *name;
+    bytebeam_columnar_type_t type;
+} bytebeam_columnar_column_t;
+
+/**
+ * @struct bytebeam_columnar_state_t
+ * This struct contains the encoding state of a value column
+ * @var bytebeam_columnar_state_t::previous
+ * Bits of the previous value
+ * @var bytebeam_columnar_state_t::previous_delta
+ * Delta between the previous two values of the int columns
+ * @var bytebeam_columnar_state_t::leading
+ * Leading zeros of the current xor window of the float columns, 0xFF until the first window
+ * @var bytebeam_columnar_state_t::trailing
+ * Trailing zeros of the current xor window of the float columns
+ */
+typedef struct bytebeam_columnar_state {
+    uint64_t previous;
+    uint64_t previous_delta;
+    uint8_t leading;
+    uint8_t trailing;
+} bytebeam_columnar_state_t;
+
+/**
+ * @struct bytebeam_columnar_encoder_t
+ * This struct contains the state of a columnar batch encoder which packs samples into a caller provided buffer
+ * @var bytebeam_columnar_encoder_t::buffer
+ * Output buffer
+ * @var bytebeam_columnar_encoder_t::size
+ * Size of the output buffer in bytes
+ * @var bytebeam_columnar_encoder_t::header_length
+ * Length of the header at the start of the output buffer
+ * @var bytebeam_columnar_encoder_t::bit_length
+ * Length of the batch written so far in bits, header included
+ * @var bytebeam_columnar_encoder_t::column_count
+ * Number of value columns
+ * @var bytebeam_columnar_encoder_t::types
+ * Types of the value columns
+ * @var bytebeam_columnar_encoder_t::period_ms
+ * Fixed sample period in milliseconds, 0 if the timestamps are encoded
+ * @var bytebeam_columnar_encoder_t::sample_count
+ * Number of samples in the batch
+ * @var bytebeam_columnar_encoder_t::timestamp
+ * Encoding state of the timestamps
+ * @var bytebeam_columnar_encoder_t::columns
+ * Encoding state of the value columns
+ */
+typedef struct bytebeam_columnar_encoder {
+    uint8_t *buffer;
+    int size;
+    int header_length;
+    int bit_length;
+    int column_count;
+    bytebeam_columnar_type_t types[BYTEBEAM_COLUMNAR_MAX_COLUMNS];
+    uint32_t period_ms;
+    int sample_count;
+    bytebeam_columnar_state_t timestamp;
+    bytebeam_columnar_state_t columns[BYTEBEAM_COLUMNAR_MAX_COLUMNS];
+} bytebeam_columnar_encoder_t;
+
+/**
+ * @brief Initialize the columnar encoder on the caller provided buffer and write the batch header
+ *
+ * @note  The encoder never allocates memory, the samples are encoded straight into the buffer. The column names are
+ *        copied into the header, so they need not outlive this call.
+ *
+ * @param[in] encoder       columnar encoder handle
+ * @param[in] buffer        output buffer
+ * @param[in] size          size of the output buffer in bytes
+ * @param[in] columns       value columns of the batch
+ * @param[in] column_count  number of value columns, upto BYTEBEAM_COLUMNAR_MAX_COLUMNS
+ * @param[in] period_ms     fixed sample period in milliseconds, 0 to encode the timestamp of every sample
+ *
+ * @return
+ *      BB_SUCCESS: Encoder initialized successfully
+ *      BB_FAILURE: Invalid columns or the header does not fit in the buffer
+ *      BB_NULL_CHECK_FAILURE: If the encoder, buffer, or columns is NULL
+ */
+bytebeam_err_t bytebeam_columnar_init(bytebeam_columnar_encoder_t *encoder, uint8_t *buffer, int size, const bytebeam_columnar_column_t *columns, int column_count, uint32_t period_ms);
+
+/**
+ * @brief Append a sample to the batch
+ *
+ * @note  If the sample does not fit, the batch is left as it was before the call, so publish it, reset the encoder
+ *        and append the sample again. The int column values are converted to int64.
+ *
+ * @param[in] encoder       columnar encoder handle
+ * @param[in] timestamp     timestamp of the sample in milliseconds, only the first one is used if the period is fixed
+ * @param[in] values        one value per column
+ *
+ * @return
+ *      BB_SUCCESS: Sample appended successfully
+ *      BB_FAILURE: Sample does not fit in the buffer
+ *      BB_NULL_CHECK_FAILURE: If the encoder or values is NULL
+ */
+bytebeam_err_t bytebeam_columnar_append(bytebeam_columnar_encoder_t *encoder, unsigned long long timestamp, const double *values);
+
+/**
+ * @brief Complete the batch, filling in the sample count
+ *
+ * @param[in] encoder       columnar encoder handle
+ *
+ * @return
+ *      Length of the batch in bytes
+ *      -1 : If the encoder is NULL
+ */
+int bytebeam_columnar_finish(bytebeam_columnar_encoder_t *encoder);
+
+/**
+ * @brief Drop the samples of the batch, keeping the header for the next batch
+ *
+ * @param[in] encoder       columnar encoder handle
+ *
+ * @return
+ *      void
+ */
+void bytebeam_columnar_reset(bytebeam_columnar_encoder_t *encoder);
+
+/**
+ * @brief Publish the batch to the opened stream, on the columnar topic of the stream
+ *
+ * @note  The batch is completed with bytebeam_columnar_finish before the publish, the samples are kept so reset the
+ *        encoder after a successful publish. The columnar publishes are never stored in the offline queue or
+ *        compressed.
+ *
+ * @param[in] stream              stream handle
+ * @param[in] encoder             columnar encoder handle
+ *
+ * @return
+ *      BB_SUCCESS: Batch publish successful or nothing to publish
+ *      BB_FAILURE: Batch publish failed
+ *      BB_NULL_CHECK_FAILURE: If the stream or encoder is NULL
+ *      BB_RATE_LIMITED: If the rate limit or the outbox watermarks refused the publish
+ */
+bytebeam_err_t bytebeam_stream_publish_columnar(bytebeam_stream_handle_t stream, bytebeam_columnar_encoder_t *encoder);
+
+#endif /* BYTEBEAM_COLUMNAR_H */
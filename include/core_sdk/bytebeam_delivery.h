@@ -0,0 +1,123 @@
+#ifndef BYTEBEAM_DELIVERY_H
+#define BYTEBEAM_DELIVERY_H
+
+#include "bytebeam_client.h"
+#include "bytebeam_stream.h"
+
+/*This macro is used to specify the maximum number of stream publishes waiting for their acknowledgement that are tracked*/
+#define BYTEBEAM_DELIVERY_MAX_INFLIGHT 64
+
+/*This macro is used to specify the time in milliseconds after which an unacknowledged publish is reported as timed out*/
+#define BYTEBEAM_DELIVERY_TIMEOUT_MS 60000
+
+/*This macro is used to specify the number of buckets of the publish to acknowledgement latency histogram*/
+#define BYTEBEAM_DELIVERY_LATENCY_BUCKETS 12
+
+/* This enum represents the outcome of a tracked publish */
+typedef enum {
+    BYTEBEAM_DELIVERY_ACKED,
+    BYTEBEAM_DELIVERY_TIMEOUT,
+} bytebeam_delivery_status_t;
+
+/* Delivery callback, called once per tracked publish from the mqtt task on the acknowledgement, or from whichever task
+ * notices the timeout. The latency is the time from the publish to the acknowledgement or the timeout.
+ */
+typedef void (*bytebeam_delivery_cb_t)(bytebeam_client_t *bytebeam_client, int msg_id, bytebeam_delivery_status_t status, long long latency_ms, void *arg);
+
+/**
+ * @struct bytebeam_delivery_stats_t
+ * This struct contains the delivery statistics of the stream publishes of a client
+ * @var bytebeam_delivery_stats_t::tracked
+ * Number of publishes added to the in-flight table
+ * @var bytebeam_delivery_stats_t::acked
+ * Number of tracked publishes acknowledged by the broker
+ * @var bytebeam_delivery_stats_t::timed_out
+ * Number of tracked publishes that were never acknowledged
+ * @var bytebeam_delivery_stats_t::untracked
+ * Number of publishes sent while the in-flight table was full, their acknowledgements are not accounted
+ * @var bytebeam_delivery_stats_t::inflight
+ * Number of tracked publishes waiting for their acknowledgement right now
+ * @var bytebeam_delivery_stats_t::latency_min_ms
+ * Lowest publish to acknowledgement latency
+ * @var bytebeam_delivery_stats_t::latency_max_ms
+ * Highest publish to acknowledgement latency
+ * @var bytebeam_delivery_stats_t::latency_sum_ms
+ * Sum of the latencies of the acknowledged publishes, for the average
+ * @var bytebeam_delivery_stats_t::latency_bucket_ms
+ * Upper bound in milliseconds of each histogram bucket, -1 for the last one which has none
+ * @var bytebeam_delivery_stats_t::latency_histogram
+ * Number of acknowledged publishes per latency bucket
+ */
+typedef struct bytebeam_delivery_stats {
+    unsigned int tracked;
+    unsigned int acked;
+    unsigned int timed_out;
+    unsigned int untracked;
+    unsigned int inflight;
+    long long latency_min_ms;
+    long long latency_max_ms;
+    long long latency_sum_ms;
+    int latency_bucket_ms[BYTEBEAM_DELIVERY_LATENCY_BUCKETS];
+    unsigned int latency_histogram[BYTEBEAM_DELIVERY_LATENCY_BUCKETS];
+} bytebeam_delivery_stats_t;
+
+/**
+ * @brief Publish message to the opened stream and get called back once the broker acknowledges it
+ *
+ * @note  Use this api to keep a buffer around until its records are delivered. Unlike bytebeam_stream_publish the
+ *        message is never stored in the offline queue, and the publish fails if the in-flight table is full, so that
+ *        a successful publish always ends with exactly one callback.
+ *
+ * @param[in] stream              stream handle
+ * @param[in] payload             message to publish
+ * @param[in] callback            delivery callback
+ * @param[in] callback_arg        argument passed to the callback
+ *
+ * @return
+ *      BB_SUCCESS: Message publish successful, the callback will follow
+ *      BB_FAILURE: Message publish failed or the in-flight table is full
+ *      BB_NULL_CHECK_FAILURE: If the stream, payload, or callback is NULL
+ *      BB_RATE_LIMITED: If the rate limit or the outbox watermarks refused the publish
+ */
+bytebeam_err_t bytebeam_stream_publish_with_callback(bytebeam_stream_handle_t stream, char *payload, bytebeam_delivery_cb_t callback, void *callback_arg);
+
+/**
+ * @brief Report the publishes that have waited longer than BYTEBEAM_DELIVERY_TIMEOUT_MS as timed out
+ *
+ * @note  This happens on every publish and acknowledgement anyway, call this api periodically if the client can go
+ *        quiet for long.
+ *
+ * @param[in] bytebeam_client     bytebeam client handle
+ *
+ * @return
+ *      BB_SUCCESS: Timed out publishes reported
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ */
+bytebeam_err_t bytebeam_poll_deliveries(bytebeam_client_t *bytebeam_client);
+
+/**
+ * @brief Get the delivery statistics of the stream publishes
+ *
+ * @param[in]  bytebeam_client    bytebeam client handle
+ * @param[out] stats              delivery statistics
+ *
+ * @return
+ *      BB_SUCCESS: Statistics copied successfully
+ *      BB_FAILURE: The client is not initialized
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client or stats is NULL
+ */
+bytebeam_err_t bytebeam_get_delivery_stats(bytebeam_client_t *bytebeam_client, bytebeam_delivery_stats_t *stats);
+
+/**
+ * @brief Reset the delivery statistics, the in-flight publishes stay tracked
+ *
+ * @param[in] bytebeam_client     bytebeam client handle
+ *
+ * @return
+ *      BB_SUCCESS: Statistics reset successfully
+ *      BB_FAILURE: The client is not initialized
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ */
+bytebeam_err_t bytebeam_reset_delivery_stats(bytebeam_client_t *bytebeam_client);
+
+#endif /* BYTEBEAM_DELIVERY_H */
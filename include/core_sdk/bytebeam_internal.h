@@ -0,0 +1,66 @@
+#ifndef BYTEBEAM_INTERNAL_H
+#define BYTEBEAM_INTERNAL_H
+
+#include "bytebeam_client.h"
+#include "bytebeam_delivery.h"
+#include "bytebeam_metrics.h"
+
+/*
+ * The functions the core sdk modules and the hals call into each other with. They are no part of the public api, the
+ * applications go through bytebeam_sdk.h and the platform layer through bytebeam_hal.h.
+ */
+
+int bytebeam_subscribe_to_actions(bytebeam_device_config_t device_cfg, bytebeam_client_handle_t client);
+int bytebeam_unsubscribe_to_actions(bytebeam_device_config_t device_cfg, bytebeam_client_handle_t client);
+int bytebeam_handle_actions(char *action_received, int action_len, bytebeam_client_handle_t client, bytebeam_client_t *bytebeam_client);
+int bytebeam_find_action_handler(bytebeam_client_t *bytebeam_client, const char *func_name, bytebeam_action_functions_map_t *handler, int *priority, int *max_concurrency);
+int bytebeam_action_pool_start(bytebeam_client_t *bytebeam_client);
+void bytebeam_action_pool_stop(bytebeam_client_t *bytebeam_client);
+int bytebeam_action_pool_submit(bytebeam_client_t *bytebeam_client, bytebeam_action_functions_map_t *handler, char *payload, char *action_id, int priority, int max_concurrency);
+int bytebeam_publish_device_heartbeat(bytebeam_client_t *bytebeam_client);
+int bytebeam_stream_array_append(char *buffer, int buffer_size, int length, const char *record);
+int bytebeam_log_start(bytebeam_client_t *bytebeam_client);
+void bytebeam_log_free(bytebeam_client_t *bytebeam_client);
+bool bytebeam_log_client_claim(bytebeam_client_t *bytebeam_client);
+void bytebeam_log_client_clear(bytebeam_client_t *bytebeam_client);
+int bytebeam_log_flusher_start(bytebeam_client_t *bytebeam_client);
+void bytebeam_log_flusher_stop(bytebeam_client_t *bytebeam_client);
+bool bytebeam_log_flush_ring(void);
+int bytebeam_stream_publish_raw(bytebeam_client_t *bytebeam_client, char *stream_name, char *payload, int length);
+int bytebeam_stream_publish_unlimited(bytebeam_client_t *bytebeam_client, char *stream_name, char *payload);
+const char *bytebeam_stream_get_action_status_topic(bytebeam_client_t *bytebeam_client);
+int bytebeam_stream_topics_start(bytebeam_client_t *bytebeam_client);
+void bytebeam_stream_topics_free(bytebeam_client_t *bytebeam_client);
+void bytebeam_stream_check_outbox(bytebeam_client_t *bytebeam_client);
+
+int bytebeam_delivery_start(bytebeam_client_t *bytebeam_client);
+void bytebeam_delivery_free(bytebeam_client_t *bytebeam_client);
+int bytebeam_delivery_reserve(bytebeam_client_t *bytebeam_client, bytebeam_delivery_cb_t callback, void *callback_arg);
+void bytebeam_delivery_commit(bytebeam_client_t *bytebeam_client, int slot_index, int msg_id);
+void bytebeam_delivery_on_published(bytebeam_client_t *bytebeam_client, int msg_id);
+void bytebeam_delivery_on_disconnected(bytebeam_client_t *bytebeam_client);
+
+void bytebeam_metrics_count(bytebeam_metric_counter_t counter, uint32_t value);
+void bytebeam_metrics_gauge(bytebeam_metric_gauge_t gauge, int32_t value);
+void bytebeam_metrics_observe(bytebeam_metric_histogram_t histogram, long long value);
+void bytebeam_metrics_poll(void);
+void bytebeam_metrics_client_clear(bytebeam_client_t *bytebeam_client);
+
+int bytebeam_shadow_start(bytebeam_client_t *bytebeam_client);
+void bytebeam_shadow_stop(bytebeam_client_t *bytebeam_client);
+void bytebeam_shadow_free(bytebeam_client_t *bytebeam_client);
+void bytebeam_shadow_on_connected(bytebeam_client_t *bytebeam_client);
+void bytebeam_shadow_on_stream_flush(bytebeam_client_t *bytebeam_client);
+int bytebeam_shadow_poll(void);
+
+void bytebeam_sleep_cycle_on_init(bytebeam_client_t *bytebeam_client);
+bool bytebeam_sleep_cycle_should_subscribe(bytebeam_client_t *bytebeam_client, bool session_present);
+bool bytebeam_sleep_cycle_should_publish_heartbeat(bytebeam_client_t *bytebeam_client);
+
+bool bytebeam_offline_queue_is_active(bytebeam_client_t *bytebeam_client);
+bytebeam_err_t bytebeam_offline_queue_store(bytebeam_client_t *bytebeam_client, char *stream_name, char *payload, int length);
+void bytebeam_offline_queue_on_connected(bytebeam_client_t *bytebeam_client);
+void bytebeam_offline_queue_on_disconnected(bytebeam_client_t *bytebeam_client);
+void bytebeam_offline_queue_on_published(bytebeam_client_t *bytebeam_client, int msg_id);
+
+#endif /* BYTEBEAM_INTERNAL_H */
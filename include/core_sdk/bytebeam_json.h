@@ -0,0 +1,350 @@
+#ifndef BYTEBEAM_JSON_H
+#define BYTEBEAM_JSON_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include "bytebeam_client.h"
+
+/*This macro is used to specify the marker ending a string value that was cut short to fit in the output buffer*/
+#define BYTEBEAM_JSON_TRUNCATION_MARKER "..."
+
+/**
+ * @struct bytebeam_json_writer_t
+ * This struct contains the state of a streaming json writer which emits compact json into a caller provided buffer
+ * @var bytebeam_json_writer_t::buffer
+ * Output buffer, always kept NULL terminated
+ * @var bytebeam_json_writer_t::size
+ * Size of the output buffer in bytes
+ * @var bytebeam_json_writer_t::length
+ * Length of the json written so far
+ * @var bytebeam_json_writer_t::need_comma
+ * Whether the next value needs to be separated from the previous one
+ * @var bytebeam_json_writer_t::overflow
+ * Set once anything failed to fit in the output buffer, all the further writes are ignored
+ */
+typedef struct bytebeam_json_writer {
+    char *buffer;
+    int size;
+    int length;
+    bool need_comma;
+    bool overflow;
+} bytebeam_json_writer_t;
+
+/* This enum represents the type of a json token */
+typedef enum {
+    BYTEBEAM_JSON_UNDEFINED,
+    BYTEBEAM_JSON_OBJECT,
+    BYTEBEAM_JSON_ARRAY,
+    BYTEBEAM_JSON_STRING,
+    BYTEBEAM_JSON_PRIMITIVE,
+} bytebeam_json_type_t;
+
+/**
+ * @struct bytebeam_json_token_t
+ * This struct describes a single json value found by the json parser, as a view into the parsed json text
+ * @var bytebeam_json_token_t::type
+ * Type of the value, numbers, booleans and null are primitives
+ * @var bytebeam_json_token_t::start
+ * Offset of the first character of the value, for strings the one after the opening quote
+ * @var bytebeam_json_token_t::end
+ * Offset just past the last character of the value, for strings the one of the closing quote
+ * @var bytebeam_json_token_t::size
+ * Number of members of an object, elements of an array, 1 for the object member names and 0 otherwise
+ * @var bytebeam_json_token_t::parent
+ * Index of the enclosing object or array token, -1 for the root value
+ */
+typedef struct bytebeam_json_token {
+    bytebeam_json_type_t type;
+    int start;
+    int end;
+    int size;
+    int parent;
+} bytebeam_json_token_t;
+
+/**
+ * @brief Initialize the json writer on the caller provided buffer
+ *
+ * @note  The writer never allocates memory, every api below writes directly into the buffer. The key argument of
+ *        the apis below is the member name when writing inside an object and must be NULL otherwise.
+ *
+ * @param[in] writer  json writer handle
+ * @param[in] buffer  output buffer
+ * @param[in] size    size of the output buffer in bytes
+ *
+ * @return
+ *      void
+ */
+void bytebeam_json_writer_init(bytebeam_json_writer_t *writer, char *buffer, int size);
+
+/**
+ * @brief Begin a json object
+ *
+ * @param[in] writer  json writer handle
+ * @param[in] key     member name or NULL
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_json_begin_object(bytebeam_json_writer_t *writer, const char *key);
+
+/**
+ * @brief End the current json object
+ *
+ * @param[in] writer  json writer handle
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_json_end_object(bytebeam_json_writer_t *writer);
+
+/**
+ * @brief Begin a json array
+ *
+ * @param[in] writer  json writer handle
+ * @param[in] key     member name or NULL
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_json_begin_array(bytebeam_json_writer_t *writer, const char *key);
+
+/**
+ * @brief End the current json array
+ *
+ * @param[in] writer  json writer handle
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_json_end_array(bytebeam_json_writer_t *writer);
+
+/**
+ * @brief Write a string value, escaping it as needed
+ *
+ * @param[in] writer  json writer handle
+ * @param[in] key     member name or NULL
+ * @param[in] value   NULL terminated string, NULL is written as json null
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_json_add_string(bytebeam_json_writer_t *writer, const char *key, const char *value);
+
+/**
+ * @brief Write a string value formatted as per printf format string, escaping it as needed
+ *
+ * @param[in] writer  json writer handle
+ * @param[in] key     member name or NULL
+ * @param[in] fmt     printf format string
+ * @param[in] args    format arguments
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_json_add_vformat(bytebeam_json_writer_t *writer, const char *key, const char *fmt, va_list args);
+
+/**
+ * @brief Write a string value formatted as per printf format string, cutting it short if it does not fit
+ *
+ * @note  The string is cut at a character boundary and ended with BYTEBEAM_JSON_TRUNCATION_MARKER so that it fits
+ *        along with reserve more bytes, i.e. the ones needed to close the containers it is in.
+ *
+ * @param[in] writer  json writer handle
+ * @param[in] key     member name or NULL
+ * @param[in] reserve number of bytes to leave free after the string
+ * @param[in] fmt     printf format string
+ * @param[in] args    format arguments
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully, possibly cut short
+ *      BB_FAILURE: Output buffer overflow, not even the marker fits
+ */
+bytebeam_err_t bytebeam_json_add_vformat_truncated(bytebeam_json_writer_t *writer, const char *key, int reserve, const char *fmt, va_list args);
+
+/**
+ * @brief Write a signed integer value
+ *
+ * @param[in] writer  json writer handle
+ * @param[in] key     member name or NULL
+ * @param[in] value   integer value
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_json_add_int(bytebeam_json_writer_t *writer, const char *key, long long value);
+
+/**
+ * @brief Write an unsigned integer value
+ *
+ * @param[in] writer  json writer handle
+ * @param[in] key     member name or NULL
+ * @param[in] value   integer value
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_json_add_uint(bytebeam_json_writer_t *writer, const char *key, unsigned long long value);
+
+/**
+ * @brief Write a floating point value, NaN and infinity are written as json null
+ *
+ * @param[in] writer  json writer handle
+ * @param[in] key     member name or NULL
+ * @param[in] value   floating point value
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_json_add_double(bytebeam_json_writer_t *writer, const char *key, double value);
+
+/**
+ * @brief Write a boolean value
+ *
+ * @param[in] writer  json writer handle
+ * @param[in] key     member name or NULL
+ * @param[in] value   boolean value
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_json_add_bool(bytebeam_json_writer_t *writer, const char *key, bool value);
+
+/**
+ * @brief Write a null value
+ *
+ * @param[in] writer  json writer handle
+ * @param[in] key     member name or NULL
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_json_add_null(bytebeam_json_writer_t *writer, const char *key);
+
+/**
+ * @brief Write an already serialized json value as is
+ *
+ * @param[in] writer  json writer handle
+ * @param[in] key     member name or NULL
+ * @param[in] json    serialized json value
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow
+ */
+bytebeam_err_t bytebeam_json_add_raw(bytebeam_json_writer_t *writer, const char *key, const char *json);
+
+/**
+ * @brief Check that the whole json fitted in the output buffer
+ *
+ * @param[in] writer  json writer handle
+ *
+ * @return
+ *      BB_SUCCESS: The output buffer holds the complete json
+ *      BB_FAILURE: Output buffer overflowed while writing
+ *      BB_NULL_CHECK_FAILURE: If the writer is NULL
+ */
+bytebeam_err_t bytebeam_json_writer_finish(bytebeam_json_writer_t *writer);
+
+/**
+ * @brief Parse the json text into an array of tokens
+ *
+ * @note  The parser never allocates memory and never modifies the json text, the tokens just point into it. Every
+ *        object member takes two tokens, the member name immediately followed by its value, and the tokens of a
+ *        nested value immediately follow the token of the value itself.
+ *
+ * @param[in]  json        json text, need not be NULL terminated
+ * @param[in]  length      length of the json text, parsing stops early at a NULL character
+ * @param[out] tokens      token array
+ * @param[in]  max_tokens  number of tokens in the token array
+ *
+ * @return
+ *      Number of tokens used on success, the root value is the token 0
+ *      -1 : If the json is invalid or needs more tokens than available
+ */
+int bytebeam_json_parse(const char *json, int length, bytebeam_json_token_t *tokens, int max_tokens);
+
+/**
+ * @brief Find the value of an object member
+ *
+ * @note  The member names are compared as is, i.e. without unescaping them.
+ *
+ * @param[in] json         parsed json text
+ * @param[in] tokens       token array filled by the parser
+ * @param[in] token_count  number of tokens used by the parser
+ * @param[in] object       index of the object token
+ * @param[in] key          member name
+ *
+ * @return
+ *      Index of the member value token
+ *      -1 : If the object has no such member
+ */
+int bytebeam_json_find(const char *json, const bytebeam_json_token_t *tokens, int token_count, int object, const char *key);
+
+/**
+ * @brief Unescape a string value in place and NULL terminate it
+ *
+ * @note  The unescaped string is written over the escaped one and the NULL character takes the place of the closing
+ *        quote, so the string can be used without copying it. The token is updated to the unescaped length, calling
+ *        this api again on the same token just returns the string.
+ *
+ * @param[in] json   parsed json text, the same buffer given to the parser
+ * @param[in] token  string token
+ *
+ * @return
+ *      Pointer to the NULL terminated string inside the json text
+ *      NULL : If the token is not a string or has an invalid escape sequence
+ */
+char *bytebeam_json_unescape(char *json, bytebeam_json_token_t *token);
+
+/**
+ * @brief Copy the unescaped string value into the caller provided buffer
+ *
+ * @param[in]  json      parsed json text
+ * @param[in]  token     string token
+ * @param[out] out       output buffer, NULL terminated on success
+ * @param[in]  out_size  size of the output buffer in bytes
+ *
+ * @return
+ *      BB_SUCCESS: String copied successfully
+ *      BB_FAILURE: If the token is not a string, has an invalid escape sequence or does not fit in the buffer
+ */
+bytebeam_err_t bytebeam_json_get_string(const char *json, const bytebeam_json_token_t *token, char *out, int out_size);
+
+/**
+ * @brief Get the value of a number
+ *
+ * @param[in]  json   parsed json text
+ * @param[in]  token  primitive token
+ * @param[out] value  number value
+ *
+ * @return
+ *      BB_SUCCESS: Number fetched successfully
+ *      BB_FAILURE: If the token is not a number
+ */
+bytebeam_err_t bytebeam_json_get_double(const char *json, const bytebeam_json_token_t *token, double *value);
+
+/**
+ * @brief Get the value of a boolean
+ *
+ * @param[in]  json   parsed json text
+ * @param[in]  token  primitive token
+ * @param[out] value  boolean value
+ *
+ * @return
+ *      BB_SUCCESS: Boolean fetched successfully
+ *      BB_FAILURE: If the token is not a boolean
+ */
+bytebeam_err_t bytebeam_json_get_bool(const char *json, const bytebeam_json_token_t *token, bool *value);
+
+#endif /* BYTEBEAM_JSON_H */
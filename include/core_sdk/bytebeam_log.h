@@ -6,6 +6,33 @@
 /*This macro is used to specify the maximum length of bytebeam log stream string*/
 #define BYTEBEAM_LOG_STREAM_STR_LEN 20
 
+/*This macro is used to specify the log stream a client publishes its logs on unless set otherwise*/
+#define BYTEBEAM_LOG_DEFAULT_STREAM "logs"
+
+/*This macro is used to specify the maximum length of bytebeam log json string including the log message*/
+#define BYTEBEAM_LOG_PAYLOAD_STR_LEN 512
+
+/*This macro is used to specify the maximum length of bytebeam log tag string*/
+#define BYTEBEAM_LOG_TAG_STR_LEN 24
+
+/*This macro is used to specify the maximum length of bytebeam log message string, longer messages are truncated*/
+#define BYTEBEAM_LOG_MESSAGE_STR_LEN 256
+
+/*This macro is used to specify the number of log records the log ring buffer can hold, must be a power of two*/
+#define BYTEBEAM_LOG_RING_SIZE 32
+
+/*This macro is used to specify the maximum length of the jsonarray published by the log flusher*/
+#define BYTEBEAM_LOG_BATCH_STR_LEN 2048
+
+/*This macro is used to specify the interval at which the log flusher publishes the buffered log records*/
+#define BYTEBEAM_LOG_FLUSH_INTERVAL_MS 1000
+
+/*This macro is used to specify the stack size of the log flusher task*/
+#define BYTEBEAM_LOG_FLUSHER_STACK_SIZE 4096
+
+/*This macro is used to specify the priority of the log flusher task*/
+#define BYTEBEAM_LOG_FLUSHER_PRIORITY 3
+
 #define BYTEBEAM_LOGX(BB_LOGX, level, tag, fmt, ...)                                          \
      do {                                                                                     \
         const char* levelStr = bytebeam_log_level_str[level];                                 \
@@ -24,6 +51,24 @@
 #define BYTEBEAM_LOGD(tag, fmt, ...)  BYTEBEAM_LOGX(BB_LOGD, BYTEBEAM_LOG_LEVEL_DEBUG, tag, fmt, ##__VA_ARGS__)
 #define BYTEBEAM_LOGV(tag, fmt, ...)  BYTEBEAM_LOGX(BB_LOGV, BYTEBEAM_LOG_LEVEL_VERBOSE, tag, fmt, ##__VA_ARGS__)
 
+#define BYTEBEAM_CLIENT_LOGX(bytebeam_client, BB_LOGX, level, tag, fmt, ...)                                    \
+     do {                                                                                                       \
+        const char* levelStr = bytebeam_log_level_str[level];                                                   \
+        if(level <= bytebeam_client_log_level_get(bytebeam_client)) {                                           \
+            if (bytebeam_client_log_publish(bytebeam_client, levelStr, tag, fmt, ##__VA_ARGS__) == BB_FAILURE) {  \
+                BB_LOGE(tag, "Failed To Publish Bytebeam Log !");                                               \
+            } else {                                                                                            \
+                BB_LOGX(tag, fmt, ##__VA_ARGS__);                                                               \
+            }                                                                                                   \
+        }                                                                                                       \
+    } while (0)
+
+#define BYTEBEAM_CLIENT_LOGE(bytebeam_client, tag, fmt, ...)  BYTEBEAM_CLIENT_LOGX(bytebeam_client, BB_LOGE, BYTEBEAM_LOG_LEVEL_ERROR, tag, fmt, ##__VA_ARGS__)
+#define BYTEBEAM_CLIENT_LOGW(bytebeam_client, tag, fmt, ...)  BYTEBEAM_CLIENT_LOGX(bytebeam_client, BB_LOGW, BYTEBEAM_LOG_LEVEL_WARN, tag, fmt, ##__VA_ARGS__)
+#define BYTEBEAM_CLIENT_LOGI(bytebeam_client, tag, fmt, ...)  BYTEBEAM_CLIENT_LOGX(bytebeam_client, BB_LOGI, BYTEBEAM_LOG_LEVEL_INFO, tag, fmt, ##__VA_ARGS__)
+#define BYTEBEAM_CLIENT_LOGD(bytebeam_client, tag, fmt, ...)  BYTEBEAM_CLIENT_LOGX(bytebeam_client, BB_LOGD, BYTEBEAM_LOG_LEVEL_DEBUG, tag, fmt, ##__VA_ARGS__)
+#define BYTEBEAM_CLIENT_LOGV(bytebeam_client, tag, fmt, ...)  BYTEBEAM_CLIENT_LOGX(bytebeam_client, BB_LOGV, BYTEBEAM_LOG_LEVEL_VERBOSE, tag, fmt, ##__VA_ARGS__)
+
 /* This enum represents Bytebeam Log Levels */
 typedef enum {
     BYTEBEAM_LOG_LEVEL_NONE,
@@ -43,9 +88,33 @@ static const char* bytebeam_log_level_str[6] = {
     [BYTEBEAM_LOG_LEVEL_VERBOSE] = "Verbose"
 };
 
+/**
+ * @struct bytebeam_log_stats_t
+ * This struct contains the statistics of the asynchronous cloud logging
+ * @var bytebeam_log_stats_t::queued_records
+ * Number of log records written into the log ring buffer
+ * @var bytebeam_log_stats_t::dropped_records
+ * Number of log records dropped because the log ring buffer was full
+ * @var bytebeam_log_stats_t::published_records
+ * Number of log records published by the log flusher
+ * @var bytebeam_log_stats_t::failed_records
+ * Number of log records lost because the publish failed
+ */
+typedef struct bytebeam_log_stats {
+    unsigned int queued_records;
+    unsigned int dropped_records;
+    unsigned int published_records;
+    unsigned int failed_records;
+} bytebeam_log_stats_t;
+
 /**
  * @brief Set the bytebeam log client handle
  *
+ * @note  The bytebeam_log_* apis and the BYTEBEAM_LOG* macros go through the first client initialized, a gateway
+ *        running several clients can hand them over to another one with this api. Destroying the log client stops
+ *        them until another is set. Every client keeps its own log level, log stream and cloud logging status, the
+ *        bytebeam_client_log_* apis and the BYTEBEAM_CLIENT_LOG* macros log through a given client.
+ *
  * @param[in] bytebeam_client bytebeam client handle
  * 
  * @return
@@ -54,7 +123,9 @@ static const char* bytebeam_log_level_str[6] = {
 void bytebeam_log_client_set(bytebeam_client_t *bytebeam_client);
 
 /**
- * @brief Enable the cloud logging
+ * @brief Enable the cloud logging of the log client
+ *
+ * @note  The cloud logging is enabled by default, the status is kept per client and set once it is initialized
  *
  * @param
  *      void
@@ -65,7 +136,7 @@ void bytebeam_log_client_set(bytebeam_client_t *bytebeam_client);
 void bytebeam_enable_cloud_logging();
 
 /**
- * @brief Return the cloud logging status i.e Enabled or Disabled
+ * @brief Return the cloud logging status of the log client i.e Enabled or Disabled
  *
  * @param
  *      void
@@ -77,7 +148,7 @@ void bytebeam_enable_cloud_logging();
 bool bytebeam_is_cloud_logging_enabled();
 
 /**
- * @brief Disable the cloud logging
+ * @brief Disable the cloud logging of the log client
  *
  * @param
  *      void
@@ -88,7 +159,7 @@ bool bytebeam_is_cloud_logging_enabled();
 void bytebeam_disable_cloud_logging();
 
 /**
- * @brief Set the bytebeam log level
+ * @brief Set the bytebeam log level of the log client
  *
  * @param[in] level log level
  * 
@@ -98,36 +169,36 @@ void bytebeam_disable_cloud_logging();
 void bytebeam_log_level_set(bytebeam_log_level_t level);
 
 /**
- * @brief Get the bytebeam log level
+ * @brief Get the bytebeam log level of the log client
  *
  * @param
  *      void
  * 
  * @return
- *      bytebeam log level
+ *      bytebeam log level, BYTEBEAM_LOG_LEVEL_INFO if there is no log client
  */
 bytebeam_log_level_t bytebeam_log_level_get(void);
 
 /**
- * @brief Set the bytebeam log stream name
+ * @brief Set the bytebeam log stream name of the log client
  *
  * @param[in] stream_name name of the log stream
  * 
  * @return
  *      BB_SUCCESS: If the log stream was successfully set
- *      BB_FAILURE: If the log stream size exceeded buffer size
- *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ *      BB_FAILURE: If the log stream size exceeded buffer size or there is no log client
+ *      BB_NULL_CHECK_FAILURE: If the stream_name is NULL
  */
 bytebeam_err_t bytebeam_log_stream_set(char* stream_name);
 
 /**
- * @brief Get the bytebeam log stream name
+ * @brief Get the bytebeam log stream name of the log client
  *
  * @param
  *      void
  * 
  * @return
- *      bytebeam log stream name
+ *      bytebeam log stream name, BYTEBEAM_LOG_DEFAULT_STREAM if there is no log client
  */
 char* bytebeam_log_stream_get();
 
@@ -136,6 +207,10 @@ char* bytebeam_log_stream_get();
  *
  * @note  This api works on bytebeam log client handle so make sure to set the bytebeam log handle
  *        before calling this api, If called without setting it will return BB_BB_FAILURE
+ *
+ * @note  Once the bytebeam client is initialized the log record is only written into the log ring buffer and the
+ *        log flusher task publishes the buffered records in batches, so this api never blocks on the network. If
+ *        the ring buffer is full the record is dropped and counted in the log statistics.
  * 
  * @param[in] level     indicates log level
  * @param[in] tag       indicates log level
@@ -144,7 +219,108 @@ char* bytebeam_log_stream_get();
  * @return
  *      BB_SUCCESS : Log publish successful
  *      BB_FAILURE : Log publish failed
+ *      BB_RATE_LIMITED : The ring buffer is full and the record is dropped
  */
 bytebeam_err_t bytebeam_log_publish(const char *level, const char *tag, const char *fmt, ...);
 
+/**
+ * @brief Enable or disable the cloud logging of the client
+ *
+ * @param[in] bytebeam_client bytebeam client handle
+ * @param[in] is_enabled      true to enable the cloud logging, false to disable it
+ *
+ * @return
+ *      BB_SUCCESS: Cloud logging status set successfully
+ *      BB_FAILURE: If the client is not initialized
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ */
+bytebeam_err_t bytebeam_client_set_cloud_logging(bytebeam_client_t *bytebeam_client, bool is_enabled);
+
+/**
+ * @brief Return the cloud logging status of the client i.e Enabled or Disabled
+ *
+ * @param[in] bytebeam_client bytebeam client handle
+ *
+ * @return
+ *      True  : If cloud logging is enabled
+ *      False : Cloud logging is disabled, or the client is not initialized
+ */
+bool bytebeam_client_is_cloud_logging_enabled(bytebeam_client_t *bytebeam_client);
+
+/**
+ * @brief Set the bytebeam log level of the client
+ *
+ * @param[in] bytebeam_client bytebeam client handle
+ * @param[in] level           log level
+ *
+ * @return
+ *      BB_SUCCESS: Log level set successfully
+ *      BB_FAILURE: If the client is not initialized
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ */
+bytebeam_err_t bytebeam_client_log_level_set(bytebeam_client_t *bytebeam_client, bytebeam_log_level_t level);
+
+/**
+ * @brief Get the bytebeam log level of the client
+ *
+ * @param[in] bytebeam_client bytebeam client handle
+ *
+ * @return
+ *      bytebeam log level, BYTEBEAM_LOG_LEVEL_INFO if the client is not initialized
+ */
+bytebeam_log_level_t bytebeam_client_log_level_get(bytebeam_client_t *bytebeam_client);
+
+/**
+ * @brief Set the bytebeam log stream name of the client
+ *
+ * @param[in] bytebeam_client bytebeam client handle
+ * @param[in] stream_name     name of the log stream
+ *
+ * @return
+ *      BB_SUCCESS: If the log stream was successfully set
+ *      BB_FAILURE: If the log stream size exceeded buffer size or the client is not initialized
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client or the stream_name is NULL
+ */
+bytebeam_err_t bytebeam_client_log_stream_set(bytebeam_client_t *bytebeam_client, const char *stream_name);
+
+/**
+ * @brief Get the bytebeam log stream name of the client
+ *
+ * @param[in] bytebeam_client bytebeam client handle
+ *
+ * @return
+ *      bytebeam log stream name, BYTEBEAM_LOG_DEFAULT_STREAM if the client is not initialized
+ */
+const char *bytebeam_client_log_stream_get(bytebeam_client_t *bytebeam_client);
+
+/**
+ * @brief Publish Log to Bytebeam through the given client
+ *
+ * @note  The log goes out on the log stream of the client under its device id, so that every downstream device of a
+ *        gateway gets its own logs. Like bytebeam_log_publish it only buffers the record once the client is
+ *        initialized.
+ *
+ * @param[in] bytebeam_client bytebeam client handle
+ * @param[in] level           indicates log level
+ * @param[in] tag             indicates log tag
+ * @param[in] fmt             variable arguments
+ *
+ * @return
+ *      BB_SUCCESS : Log publish successful
+ *      BB_FAILURE : Log publish failed, or the client is not initialized
+ *      BB_RATE_LIMITED : The ring buffer is full and the record is dropped
+ */
+bytebeam_err_t bytebeam_client_log_publish(bytebeam_client_t *bytebeam_client, const char *level, const char *tag, const char *fmt, ...);
+
+/**
+ * @brief Get the asynchronous cloud logging statistics
+ *
+ * @param[out] stats log statistics
+ *
+ * @return
+ *      BB_SUCCESS: Statistics fetched successfully
+ *      BB_NULL_CHECK_FAILURE: If the stats is NULL
+ */
+bytebeam_err_t bytebeam_log_get_stats(bytebeam_log_stats_t *stats);
+
 #endif /* BYTEBEAM_LOG_H */
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef BYTEBEAM_LZ4_H
+#define BYTEBEAM_LZ4_H
+
+#include <stdint.h>
+
+/*This macro is used to specify the log2 of the number of entries of the lz4 match finder hash table*/
+#define BYTEBEAM_LZ4_HASH_LOG 10
+
+/*This macro is used to specify the number of entries of the lz4 match finder hash table*/
+#define BYTEBEAM_LZ4_HASH_TABLE_SIZE (1 << BYTEBEAM_LZ4_HASH_LOG)
+
+/*This macro is used to specify the maximum size of the input of a single lz4 compression*/
+#define BYTEBEAM_LZ4_MAX_INPUT_SIZE 65535
+
+/*This macro is used to specify the output buffer size that always holds the compressed input of the given size*/
+#define BYTEBEAM_LZ4_COMPRESS_BOUND(size) ((size) + ((size) / 255) + 16)
+
+/**
+ * @brief Compress the input into a single lz4 block (the raw block format, without the lz4 frame around it)
+ *
+ * @note  The compressor never allocates memory, the hash table is the only state and it is reset on every call. The
+ *        match window is the whole input, which is why the input is limited to 64KB.
+ *
+ * @param[in] src         input buffer
+ * @param[in] src_len     length of the input, upto BYTEBEAM_LZ4_MAX_INPUT_SIZE bytes
+ * @param[in] dst         output buffer
+ * @param[in] dst_size    size of the output buffer, BYTEBEAM_LZ4_COMPRESS_BOUND(src_len) bytes always suffice
+ * @param[in] hash_table  scratch hash table of BYTEBEAM_LZ4_HASH_TABLE_SIZE entries
+ *
+ * @return
+ *      Length of the compressed block
+ *      -1 : If the input is too big or the compressed block does not fit in the output buffer
+ */
+int bytebeam_lz4_compress(const uint8_t *src, int src_len, uint8_t *dst, int dst_size, uint16_t *hash_table);
+
+#endif /* BYTEBEAM_LZ4_H */
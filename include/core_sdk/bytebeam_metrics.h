@@ -0,0 +1,164 @@
+#ifndef BYTEBEAM_METRICS_H
+#define BYTEBEAM_METRICS_H
+
+#include <stdint.h>
+#include "bytebeam_client.h"
+
+/*This macro is used to specify the name of the stream the sdk metrics are published on*/
+#define BYTEBEAM_METRICS_STREAM "sdk_metrics"
+
+/*This macro is used to specify the maximum length of the json published on the sdk metrics stream*/
+#define BYTEBEAM_METRICS_PAYLOAD_STR_LEN 2048
+
+/*This macro is used to specify the number of buckets of the sdk metrics histograms*/
+#define BYTEBEAM_METRICS_HISTOGRAM_BUCKETS 9
+
+/*
+ * The histogram buckets are powers of 4, bucket i counts the values upto 4^i and the last bucket everything above
+ * 4^7 i.e. the upper bounds are 1, 4, 16, 64, 256, 1024, 4096, 16384 and none. The unit is given by the metric name.
+ */
+
+/* This enum represents the sdk counters, they count up from the boot and wrap around at 2^32 */
+typedef enum {
+    BYTEBEAM_METRIC_STREAM_PUBLISHES,
+    BYTEBEAM_METRIC_STREAM_PUBLISH_FAILURES,
+    BYTEBEAM_METRIC_STREAM_PUBLISH_BYTES,
+    BYTEBEAM_METRIC_STREAM_RATE_LIMITED,
+    BYTEBEAM_METRIC_STREAM_COMPRESSED,
+    BYTEBEAM_METRIC_MQTT_CONNECTS,
+    BYTEBEAM_METRIC_MQTT_DISCONNECTS,
+    BYTEBEAM_METRIC_ACTIONS_RECEIVED,
+    BYTEBEAM_METRIC_ACTIONS_REJECTED,
+    BYTEBEAM_METRIC_COUNTER_COUNT,
+} bytebeam_metric_counter_t;
+
+/* This enum represents the sdk gauges, they hold the last value set */
+typedef enum {
+    BYTEBEAM_METRIC_OUTBOX_BYTES,
+    BYTEBEAM_METRIC_PUBLISHES_INFLIGHT,
+    BYTEBEAM_METRIC_ACTION_QUEUE_DEPTH,
+    BYTEBEAM_METRIC_GAUGE_COUNT,
+} bytebeam_metric_gauge_t;
+
+/* This enum represents the sdk histograms, they cover the time since the last sdk metrics publish */
+typedef enum {
+    BYTEBEAM_METRIC_PUBLISH_US,
+    BYTEBEAM_METRIC_COMPRESS_US,
+    BYTEBEAM_METRIC_LOG_FLUSH_US,
+    BYTEBEAM_METRIC_ACTION_DISPATCH_MS,
+    BYTEBEAM_METRIC_ACTION_RUN_MS,
+    BYTEBEAM_METRIC_HISTOGRAM_COUNT,
+} bytebeam_metric_histogram_t;
+
+/**
+ * @struct bytebeam_metric_histogram_value_t
+ * This struct contains the values of an sdk histogram
+ * @var bytebeam_metric_histogram_value_t::count
+ * Number of values recorded
+ * @var bytebeam_metric_histogram_value_t::sum
+ * Sum of the values recorded, for the average
+ * @var bytebeam_metric_histogram_value_t::max
+ * Highest value recorded
+ * @var bytebeam_metric_histogram_value_t::buckets
+ * Number of values recorded per bucket
+ */
+typedef struct bytebeam_metric_histogram_value {
+    uint32_t count;
+    uint32_t sum;
+    uint32_t max;
+    uint32_t buckets[BYTEBEAM_METRICS_HISTOGRAM_BUCKETS];
+} bytebeam_metric_histogram_value_t;
+
+/**
+ * @struct bytebeam_sdk_metrics_t
+ * This struct contains a snapshot of the sdk metrics
+ * @var bytebeam_sdk_metrics_t::counters
+ * Counter values indexed by bytebeam_metric_counter_t
+ * @var bytebeam_sdk_metrics_t::gauges
+ * Gauge values indexed by bytebeam_metric_gauge_t
+ * @var bytebeam_sdk_metrics_t::histograms
+ * Histogram values indexed by bytebeam_metric_histogram_t
+ */
+typedef struct bytebeam_sdk_metrics {
+    uint32_t counters[BYTEBEAM_METRIC_COUNTER_COUNT];
+    int32_t gauges[BYTEBEAM_METRIC_GAUGE_COUNT];
+    bytebeam_metric_histogram_value_t histograms[BYTEBEAM_METRIC_HISTOGRAM_COUNT];
+} bytebeam_sdk_metrics_t;
+
+/**
+ * @brief Get the name of an sdk counter, as used on the sdk metrics stream
+ *
+ * @param[in] counter sdk counter
+ *
+ * @return
+ *      Name of the counter, NULL if there is no such counter
+ */
+const char *bytebeam_metrics_counter_name(bytebeam_metric_counter_t counter);
+
+/**
+ * @brief Get the name of an sdk gauge, as used on the sdk metrics stream
+ *
+ * @param[in] gauge sdk gauge
+ *
+ * @return
+ *      Name of the gauge, NULL if there is no such gauge
+ */
+const char *bytebeam_metrics_gauge_name(bytebeam_metric_gauge_t gauge);
+
+/**
+ * @brief Get the name of an sdk histogram, as used on the sdk metrics stream
+ *
+ * @param[in] histogram sdk histogram
+ *
+ * @return
+ *      Name of the histogram, NULL if there is no such histogram
+ */
+const char *bytebeam_metrics_histogram_name(bytebeam_metric_histogram_t histogram);
+
+/**
+ * @brief Get a snapshot of the sdk metrics
+ *
+ * @note  The metrics are updated without a lock, so the values of the snapshot are each consistent on their own but
+ *        not necessarily with one another.
+ *
+ * @param[out] metrics sdk metrics
+ *
+ * @return
+ *      BB_SUCCESS: Metrics copied successfully
+ *      BB_NULL_CHECK_FAILURE: If the metrics is NULL
+ */
+bytebeam_err_t bytebeam_get_sdk_metrics(bytebeam_sdk_metrics_t *metrics);
+
+/**
+ * @brief Publish the sdk metrics to the sdk metrics stream and start the histograms over
+ *
+ * @note  Every metric is a column of the record, every histogram adds the <name>_count, <name>_sum, <name>_max
+ *        columns and the <name>_buckets column with the comma separated bucket counts. The log statistics and the
+ *        delivery statistics are included as well.
+ *
+ * @param[in] bytebeam_client bytebeam client handle
+ *
+ * @return
+ *      BB_SUCCESS: Metrics publish successful
+ *      BB_FAILURE: Metrics publish failed
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ */
+bytebeam_err_t bytebeam_publish_sdk_metrics(bytebeam_client_t *bytebeam_client);
+
+/**
+ * @brief Publish the sdk metrics periodically
+ *
+ * @note  The metrics are published from the log flusher task, so the interval is rounded up to the log flush
+ *        interval. The metrics are not published while the client is disconnected.
+ *
+ * @param[in] bytebeam_client bytebeam client handle
+ * @param[in] interval_ms     publish interval in milliseconds, 0 to stop publishing
+ *
+ * @return
+ *      BB_SUCCESS: Interval set successfully
+ *      BB_FAILURE: If the interval is negative
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ */
+bytebeam_err_t bytebeam_set_sdk_metrics_interval(bytebeam_client_t *bytebeam_client, int interval_ms);
+
+#endif /* BYTEBEAM_METRICS_H */
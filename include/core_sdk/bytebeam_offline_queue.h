@@ -0,0 +1,125 @@
+#ifndef BYTEBEAM_OFFLINE_QUEUE_H
+#define BYTEBEAM_OFFLINE_QUEUE_H
+
+#include "bytebeam_client.h"
+
+/*This macro is used to specify the maximum length of bytebeam offline queue file path string*/
+#define BYTEBEAM_OFFLINE_QUEUE_PATH_STR_LEN 64
+
+/*This macro is used to specify the default size of a single offline queue segment file in bytes*/
+#define BYTEBEAM_OFFLINE_QUEUE_SEGMENT_SIZE (16 * 1024)
+
+/*This macro is used to specify the default maximum size of the offline queue in bytes*/
+#define BYTEBEAM_OFFLINE_QUEUE_MAX_SIZE (128 * 1024)
+
+/*This macro is used to specify the default size of the payload buffer used for draining the offline queue*/
+#define BYTEBEAM_OFFLINE_QUEUE_DRAIN_SIZE 4096
+
+/* This enum represents what happens to the records when the offline queue is full */
+typedef enum {
+    BYTEBEAM_OFFLINE_DROP_OLDEST,
+    BYTEBEAM_OFFLINE_DROP_NEWEST,
+} bytebeam_offline_drop_policy_t;
+
+/**
+ * @struct bytebeam_offline_queue_config_t
+ * This struct contains the configuration of the offline queue
+ * @var bytebeam_offline_queue_config_t::base_path
+ * Directory in which the segment files are kept, the file names carry the device id so clients can share it
+ * @var bytebeam_offline_queue_config_t::mount_spiffs
+ * Mount SPIFFS for the lifetime of the queue, set it if the base path is on SPIFFS
+ * @var bytebeam_offline_queue_config_t::segment_size
+ * Size of a single segment file in bytes
+ * @var bytebeam_offline_queue_config_t::max_size
+ * Maximum size of all the segment files together in bytes, must be atleast twice the segment size
+ * @var bytebeam_offline_queue_config_t::drain_size
+ * Size of the payload buffer used for draining, it bounds the size of a single drained publish
+ * @var bytebeam_offline_queue_config_t::drop_policy
+ * Which records to drop once the queue is full
+ */
+typedef struct bytebeam_offline_queue_config {
+    const char *base_path;
+    bool mount_spiffs;
+    int segment_size;
+    int max_size;
+    int drain_size;
+    bytebeam_offline_drop_policy_t drop_policy;
+} bytebeam_offline_queue_config_t;
+
+#define BYTEBEAM_OFFLINE_QUEUE_DEFAULT_CONFIG() {              \
+    .base_path    = "/spiffs",                                 \
+    .mount_spiffs = true,                                      \
+    .segment_size = BYTEBEAM_OFFLINE_QUEUE_SEGMENT_SIZE,       \
+    .max_size     = BYTEBEAM_OFFLINE_QUEUE_MAX_SIZE,           \
+    .drain_size   = BYTEBEAM_OFFLINE_QUEUE_DRAIN_SIZE,         \
+    .drop_policy  = BYTEBEAM_OFFLINE_DROP_OLDEST               \
+}
+
+/**
+ * @struct bytebeam_offline_queue_stats_t
+ * This struct contains the statistics of the offline queue
+ * @var bytebeam_offline_queue_stats_t::used_size
+ * Size of all the segment files together in bytes
+ * @var bytebeam_offline_queue_stats_t::stored_records
+ * Number of records stored since the queue was enabled
+ * @var bytebeam_offline_queue_stats_t::drained_records
+ * Number of records drained since the queue was enabled
+ * @var bytebeam_offline_queue_stats_t::dropped_records
+ * Number of records dropped because the queue was full
+ */
+typedef struct bytebeam_offline_queue_stats {
+    int used_size;
+    unsigned int stored_records;
+    unsigned int drained_records;
+    unsigned int dropped_records;
+} bytebeam_offline_queue_stats_t;
+
+/**
+ * @brief Enable the offline queue for the bytebeam client
+ *
+ * @note  Once enabled, the stream publishes made while the client is disconnected (or while older records are still
+ *        queued) are appended to the segment files and drained in order, batched, after the client connects. The
+ *        records are removed only after the broker acknowledges them, so a record may be delivered more than once
+ *        across reboots. The records left over from the previous boot are drained as well.
+ *
+ * @note  The segment files are named after the device id, so the client must be initialized first. Enabling fails if
+ *        another client already queues the records of the same device id in the same directory.
+ *
+ * @param[in] bytebeam_client bytebeam client handle
+ * @param[in] config          offline queue configuration, NULL to use the default configuration
+ *
+ * @return
+ *      BB_SUCCESS: Offline queue enabled successfully
+ *      BB_FAILURE: Offline queue enable failed
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ */
+bytebeam_err_t bytebeam_offline_queue_enable(bytebeam_client_t *bytebeam_client, const bytebeam_offline_queue_config_t *config);
+
+/**
+ * @brief Disable the offline queue for the bytebeam client, the queued records stay on the file system
+ *
+ * @note  Other tasks may keep publishing while the queue is disabled, a publish or drain already in progress finishes
+ *        and the queue is freed by whichever task lets go of it last.
+ *
+ * @param[in] bytebeam_client bytebeam client handle
+ *
+ * @return
+ *      BB_SUCCESS: Offline queue disabled successfully
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ */
+bytebeam_err_t bytebeam_offline_queue_disable(bytebeam_client_t *bytebeam_client);
+
+/**
+ * @brief Get the offline queue statistics
+ *
+ * @param[in]  bytebeam_client bytebeam client handle
+ * @param[out] stats           offline queue statistics
+ *
+ * @return
+ *      BB_SUCCESS: Statistics fetched successfully
+ *      BB_FAILURE: Offline queue is not enabled
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client or stats is NULL
+ */
+bytebeam_err_t bytebeam_offline_queue_get_stats(bytebeam_client_t *bytebeam_client, bytebeam_offline_queue_stats_t *stats);
+
+#endif /* BYTEBEAM_OFFLINE_QUEUE_H */
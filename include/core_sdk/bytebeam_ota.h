@@ -6,12 +6,30 @@
 /*This macro is used to specify the maximum length of bytebeam OTA url string*/
 #define BYTEBAM_OTA_URL_STR_LEN 200
 
-/*This macro is used to specify the maximum length of the bytebeam OTA error string*/
-#define BYTEBEAM_OTA_ERROR_STR_LEN 200
+/*This macro is used to specify the maximum length of the bytebeam OTA image etag string*/
+#define BYTEBEAM_OTA_ETAG_STR_LEN 64
+
+/*This macro is used to specify the number of times the OTA download is resumed after a connection loss*/
+#define BYTEBEAM_OTA_MAX_RETRIES 5
+
+/*This macro is used to specify the delay before resuming the OTA download after a connection loss*/
+#define BYTEBEAM_OTA_RETRY_DELAY_MS 5000
+
+/*This macro is used to specify the maximum number of HTTP redirects followed by the OTA download*/
+#define BYTEBEAM_OTA_MAX_REDIRECTS 5
+
+/*This macro is used to specify how often (in downloaded bytes) the OTA download progress is saved in NVS*/
+#define BYTEBEAM_OTA_RESUME_SAVE_INTERVAL (64 * 1024)
+
+/*This macro is used to specify the maximum number of json tokens in the OTA action payload*/
+#define BYTEBEAM_OTA_JSON_TOKEN_COUNT 16
 
 /**
  * @brief Download and update Firmware image 
  *
+ * @note  The download progress is saved in NVS, so if the connection drops the download is resumed with a range
+ *        request from the last saved offset. This works across reboots too, as long as the same url is received.
+ *
  * @param[in] bytebeam_client bytebeam client handle
  * @param[in] payload_string  buffer which stores payload received with OTA update init request
  * @param[in] action_id       action id for OTA update which is received with OTA update init request 
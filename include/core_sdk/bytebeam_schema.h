@@ -0,0 +1,147 @@
+#ifndef BYTEBEAM_SCHEMA_H
+#define BYTEBEAM_SCHEMA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "bytebeam_json.h"
+#include "bytebeam_cbor.h"
+#include "bytebeam_stream.h"
+
+/* This enum represents the C type of a schema field */
+typedef enum {
+    BYTEBEAM_SCHEMA_INT8,
+    BYTEBEAM_SCHEMA_INT16,
+    BYTEBEAM_SCHEMA_INT32,
+    BYTEBEAM_SCHEMA_INT64,
+    BYTEBEAM_SCHEMA_UINT8,
+    BYTEBEAM_SCHEMA_UINT16,
+    BYTEBEAM_SCHEMA_UINT32,
+    BYTEBEAM_SCHEMA_UINT64,
+    BYTEBEAM_SCHEMA_FLOAT,
+    BYTEBEAM_SCHEMA_DOUBLE,
+    BYTEBEAM_SCHEMA_BOOL,
+    BYTEBEAM_SCHEMA_STRING,
+    BYTEBEAM_SCHEMA_STRING_PTR,
+} bytebeam_schema_type_t;
+
+/**
+ * @struct bytebeam_schema_field_t
+ * This struct describes a single field of a schema i.e. a member of the record struct
+ * @var bytebeam_schema_field_t::name
+ * Name of the field in the published record, the name of the struct member
+ * @var bytebeam_schema_field_t::type
+ * C type of the struct member
+ * @var bytebeam_schema_field_t::offset
+ * Offset of the struct member in the record struct
+ * @var bytebeam_schema_field_t::size
+ * Size of the struct member, the array size for the char array strings
+ */
+typedef struct bytebeam_schema_field {
+    const char *name;
+    bytebeam_schema_type_t type;
+    uint16_t offset;
+    uint16_t size;
+} bytebeam_schema_field_t;
+
+/**
+ * @struct bytebeam_schema_t
+ * This struct describes the layout of a record struct, as defined by BYTEBEAM_SCHEMA_DEFINE
+ * @var bytebeam_schema_t::fields
+ * Fields of the record, in the order they are written
+ * @var bytebeam_schema_t::field_count
+ * Number of fields of the record
+ * @var bytebeam_schema_t::record_size
+ * Size of the record struct, the stride of the record arrays
+ */
+typedef struct bytebeam_schema {
+    const bytebeam_schema_field_t *fields;
+    int field_count;
+    int record_size;
+} bytebeam_schema_t;
+
+/* Size of the struct member for the field type, 0 for the char array strings which can be of any size */
+#define BYTEBEAM_SCHEMA_TYPE_SIZE(field_type)                                                \
+    (((field_type) == BYTEBEAM_SCHEMA_INT8   || (field_type) == BYTEBEAM_SCHEMA_UINT8)  ? 1 : \
+     ((field_type) == BYTEBEAM_SCHEMA_INT16  || (field_type) == BYTEBEAM_SCHEMA_UINT16) ? 2 : \
+     ((field_type) == BYTEBEAM_SCHEMA_INT32  || (field_type) == BYTEBEAM_SCHEMA_UINT32) ? 4 : \
+     ((field_type) == BYTEBEAM_SCHEMA_INT64  || (field_type) == BYTEBEAM_SCHEMA_UINT64) ? 8 : \
+     ((field_type) == BYTEBEAM_SCHEMA_FLOAT)      ? sizeof(float)       :                    \
+     ((field_type) == BYTEBEAM_SCHEMA_DOUBLE)     ? sizeof(double)      :                    \
+     ((field_type) == BYTEBEAM_SCHEMA_BOOL)       ? sizeof(bool)        :                    \
+     ((field_type) == BYTEBEAM_SCHEMA_STRING_PTR) ? sizeof(const char *) : 0)
+
+/* Describes the member of the record struct as a field of the given type. A member whose size does not match the type
+ * fails the compilation, as the size of the negative array in the offset expression.
+ */
+#define BYTEBEAM_SCHEMA_FIELD(struct_type, member, field_type) {                                          \
+    .name   = #member,                                                                                    \
+    .type   = (field_type),                                                                               \
+    .offset = offsetof(struct_type, member) + 0 * sizeof(char[(BYTEBEAM_SCHEMA_TYPE_SIZE(field_type) == 0 || \
+              BYTEBEAM_SCHEMA_TYPE_SIZE(field_type) == sizeof(((struct_type *)0)->member)) ? 1 : -1]),   \
+    .size   = sizeof(((struct_type *)0)->member)                                                          \
+}
+
+/* Defines a schema named schema_name for the record struct from the list of BYTEBEAM_SCHEMA_FIELD entries */
+#define BYTEBEAM_SCHEMA_DEFINE(schema_name, struct_type, ...)                                  \
+    static const bytebeam_schema_field_t schema_name##_fields[] = { __VA_ARGS__ };            \
+    static const bytebeam_schema_t schema_name = {                                              \
+        .fields      = schema_name##_fields,                                                    \
+        .field_count = sizeof(schema_name##_fields) / sizeof(schema_name##_fields[0]),         \
+        .record_size = sizeof(struct_type)                                                      \
+    }
+
+/**
+ * @brief Write the records as json objects, appending them to the current json array or object of the writer
+ *
+ * @note  The fields are read straight from the structs and written into the output buffer of the writer, nothing is
+ *        allocated. Floats are written with just enough digits to read back the same float. The char array strings
+ *        must be NULL terminated within their array.
+ *
+ * @param[in] writer      json writer handle
+ * @param[in] schema      schema of the records
+ * @param[in] records     array of record structs
+ * @param[in] count       number of records
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow or a char array string is not NULL terminated
+ *      BB_NULL_CHECK_FAILURE: If the writer, schema, or records is NULL
+ */
+bytebeam_err_t bytebeam_schema_write_json(bytebeam_json_writer_t *writer, const bytebeam_schema_t *schema, const void *records, int count);
+
+/**
+ * @brief Write the records as cbor maps, appending them to the current cbor array or map of the writer
+ *
+ * @note  Same as bytebeam_schema_write_json but for the cbor writer, floats are written as cbor floats.
+ *
+ * @param[in] writer      cbor writer handle
+ * @param[in] schema      schema of the records
+ * @param[in] records     array of record structs
+ * @param[in] count       number of records
+ *
+ * @return
+ *      BB_SUCCESS: Written successfully
+ *      BB_FAILURE: Output buffer overflow or a char array string is not NULL terminated
+ *      BB_NULL_CHECK_FAILURE: If the writer, schema, or records is NULL
+ */
+bytebeam_err_t bytebeam_schema_write_cbor(bytebeam_cbor_writer_t *writer, const bytebeam_schema_t *schema, const void *records, int count);
+
+/**
+ * @brief Append the record struct to the batch, serializing it straight into the batch buffer
+ *
+ * @note  Works like bytebeam_stream_batch_append, including the flush thresholds, without building the json text of
+ *        the record first.
+ *
+ * @param[in] batch       batch handle
+ * @param[in] schema      schema of the record
+ * @param[in] record      record struct to append
+ *
+ * @return
+ *      BB_SUCCESS: Record appended successfully
+ *      BB_FAILURE: Record does not fit in the batch or the batch flush failed
+ *      BB_NULL_CHECK_FAILURE: If the batch, schema, or record is NULL
+ */
+bytebeam_err_t bytebeam_stream_batch_append_record(bytebeam_stream_batch_t *batch, const bytebeam_schema_t *schema, const void *record);
+
+#endif /* BYTEBEAM_SCHEMA_H */
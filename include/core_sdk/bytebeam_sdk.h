@@ -11,5 +11,14 @@
 #include "bytebeam_stream.h"
 #include "bytebeam_ota.h"
 #include "bytebeam_log.h"
+#include "bytebeam_json.h"
+#include "bytebeam_cbor.h"
+#include "bytebeam_schema.h"
+#include "bytebeam_columnar.h"
+#include "bytebeam_delivery.h"
+#include "bytebeam_metrics.h"
+#include "bytebeam_shadow.h"
+#include "bytebeam_sleep_cycle.h"
+#include "bytebeam_offline_queue.h"
 
 #endif /* BYTEBEAM_SDK_H */
\ No newline at end of file
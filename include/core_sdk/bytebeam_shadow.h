@@ -0,0 +1,154 @@
+#ifndef BYTEBEAM_SHADOW_H
+#define BYTEBEAM_SHADOW_H
+
+#include <stdbool.h>
+#include "bytebeam_client.h"
+
+/*This macro is used to specify the name of the stream the device shadow is published on*/
+#define BYTEBEAM_SHADOW_STREAM "device_shadow"
+
+/*This macro is used to specify the maximum length of bytebeam device heartbeat json string*/
+#define BYTEBEAM_DEVICE_HEARTBEAT_STR_LEN 2048
+
+/*This macro is used to specify the maximum number of device shadow fields, the device info fields included*/
+#define BYTEBEAM_SHADOW_MAX_FIELDS 16
+
+/*This macro is used to specify the maximum length of a device shadow field name*/
+#define BYTEBEAM_SHADOW_FIELD_NAME_LEN 32
+
+/*This macro is used to specify the maximum length of a device shadow string value*/
+#define BYTEBEAM_SHADOW_STRING_LEN 64
+
+/*This macro is used to specify the default number of delta heartbeats between two full device shadow snapshots*/
+#define BYTEBEAM_SHADOW_FULL_SNAPSHOT_EVERY 10
+
+/*This macro is used to specify the default heartbeat jitter, as a percentage of the heartbeat interval*/
+#define BYTEBEAM_SHADOW_JITTER_PERCENT 10
+
+/*This macro is used to specify the default window in which a heartbeat rides along with a stream batch flush, as a percentage of the heartbeat interval*/
+#define BYTEBEAM_SHADOW_COALESCE_PERCENT 25
+
+/**
+ * @struct bytebeam_shadow_config_t
+ * This struct contains the device shadow heartbeat settings
+ * @var bytebeam_shadow_config_t::heartbeat_interval_ms
+ * Interval at which the sdk publishes the device shadow heartbeat, 0 to publish it only on connect
+ * @var bytebeam_shadow_config_t::full_snapshot_every
+ * Number of delta heartbeats after which a full snapshot is published, 0 to publish a full snapshot every time
+ * @var bytebeam_shadow_config_t::jitter_percent
+ * Random spread of every heartbeat deadline and of the first heartbeat after a connect, as a percentage of the interval
+ * upto 50
+ * @var bytebeam_shadow_config_t::coalesce_percent
+ * A heartbeat due within this percentage of the interval is published right after a stream batch flush, 0 to disable
+ */
+typedef struct bytebeam_shadow_config {
+    int heartbeat_interval_ms;
+    int full_snapshot_every;
+    int jitter_percent;
+    int coalesce_percent;
+} bytebeam_shadow_config_t;
+
+#define BYTEBEAM_SHADOW_DEFAULT_CONFIG() {                       \
+    .heartbeat_interval_ms = 0,                                  \
+    .full_snapshot_every   = BYTEBEAM_SHADOW_FULL_SNAPSHOT_EVERY, \
+    .jitter_percent        = BYTEBEAM_SHADOW_JITTER_PERCENT,      \
+    .coalesce_percent      = BYTEBEAM_SHADOW_COALESCE_PERCENT     \
+}
+
+/**
+ * @brief Configure the device shadow heartbeat
+ *
+ * @note  The heartbeat is published from the log flusher task, which sleeps until the next heartbeat is due, so the
+ *        application needs no task of its own for it. Every deadline is moved by a random jitter and the first heartbeat
+ *        after a connect is spread over the jitter window, so that a fleet reconnecting to a restarted broker does not
+ *        send its heartbeats all at once. A heartbeat close to due is published right after a stream batch flush, so
+ *        that the radio wakes up once for both. Every client gets its own heartbeat, a gateway running a client per
+ *        downstream device needs no timer per device. Call this api after bytebeam_init.
+ *
+ * @param[in] bytebeam_client     bytebeam client handle
+ * @param[in] config              heartbeat settings
+ *
+ * @return
+ *      BB_SUCCESS: Device shadow configured successfully
+ *      BB_FAILURE: Invalid settings or the client is not initialized
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client or config is NULL
+ */
+bytebeam_err_t bytebeam_shadow_set_config(bytebeam_client_t *bytebeam_client, const bytebeam_shadow_config_t *config);
+
+/**
+ * @brief Set a string field of the device shadow
+ *
+ * @note  The field goes out with the next heartbeat only if its value changed since the last one. The value is
+ *        copied, so it need not outlive this call.
+ *
+ * @param[in] bytebeam_client     bytebeam client handle
+ * @param[in] name                field name
+ * @param[in] value               field value
+ *
+ * @return
+ *      BB_SUCCESS: Field set successfully
+ *      BB_FAILURE: The name or value is too long, there is no room for another field or the client is not initialized
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client, name, or value is NULL
+ */
+bytebeam_err_t bytebeam_shadow_set_string(bytebeam_client_t *bytebeam_client, const char *name, const char *value);
+
+/**
+ * @brief Set an integer field of the device shadow
+ *
+ * @param[in] bytebeam_client     bytebeam client handle
+ * @param[in] name                field name
+ * @param[in] value               field value
+ *
+ * @return
+ *      BB_SUCCESS: Field set successfully
+ *      BB_FAILURE: The name is too long, there is no room for another field or the client is not initialized
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client or name is NULL
+ */
+bytebeam_err_t bytebeam_shadow_set_int(bytebeam_client_t *bytebeam_client, const char *name, long long value);
+
+/**
+ * @brief Set a floating point field of the device shadow
+ *
+ * @param[in] bytebeam_client     bytebeam client handle
+ * @param[in] name                field name
+ * @param[in] value               field value
+ *
+ * @return
+ *      BB_SUCCESS: Field set successfully
+ *      BB_FAILURE: The name is too long, there is no room for another field or the client is not initialized
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client or name is NULL
+ */
+bytebeam_err_t bytebeam_shadow_set_double(bytebeam_client_t *bytebeam_client, const char *name, double value);
+
+/**
+ * @brief Set a boolean field of the device shadow
+ *
+ * @param[in] bytebeam_client     bytebeam client handle
+ * @param[in] name                field name
+ * @param[in] value               field value
+ *
+ * @return
+ *      BB_SUCCESS: Field set successfully
+ *      BB_FAILURE: The name is too long, there is no room for another field or the client is not initialized
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client or name is NULL
+ */
+bytebeam_err_t bytebeam_shadow_set_bool(bytebeam_client_t *bytebeam_client, const char *name, bool value);
+
+/**
+ * @brief Publish the device shadow heartbeat now
+ *
+ * @note  Every heartbeat carries the timestamp, sequence and Uptime. A delta heartbeat adds only the fields changed
+ *        since the last heartbeat, a full snapshot adds all of them. The first heartbeat after every connect is a full
+ *        snapshot.
+ *
+ * @param[in] bytebeam_client     bytebeam client handle
+ * @param[in] full                publish a full snapshot even if a delta is due
+ *
+ * @return
+ *      BB_SUCCESS: Device shadow publish successful
+ *      BB_FAILURE: Device shadow publish failed, the changed fields go out with the next heartbeat
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ */
+bytebeam_err_t bytebeam_shadow_publish(bytebeam_client_t *bytebeam_client, bool full);
+
+#endif /* BYTEBEAM_SHADOW_H */
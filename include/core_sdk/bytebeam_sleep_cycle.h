@@ -0,0 +1,45 @@
+#ifndef BYTEBEAM_SLEEP_CYCLE_H
+#define BYTEBEAM_SLEEP_CYCLE_H
+
+#include <stdint.h>
+#include "bytebeam_client.h"
+
+/*This macro is used to specify the default number of wake ups between two action subscribes in sleep cycle mode*/
+#define BYTEBEAM_SLEEP_CYCLE_SUBSCRIBE_EVERY 10
+
+/*This macro is used to specify the default number of wake ups between two start heartbeats in sleep cycle mode*/
+#define BYTEBEAM_SLEEP_CYCLE_HEARTBEAT_EVERY 10
+
+/*This macro is used to specify how often bytebeam_flush checks whether the publishes made it out*/
+#define BYTEBEAM_FLUSH_POLL_INTERVAL_MS 20
+
+/**
+ * @brief Wait for the publishes to make it to the broker, i.e. before going to deep sleep
+ *
+ * @note  Returns once the client is connected, the log ring buffer and the offline queue are drained and all the
+ *        qos 1 publishes are acknowledged by the broker. The publishes made while waiting count as well.
+ *
+ * @note  The stream batches and the columnar encoders are buffered by the application, flush them first via
+ *        bytebeam_stream_batch_flush and bytebeam_stream_publish_columnar, their records are not waited for.
+ *
+ * @param[in] bytebeam_client bytebeam client handle
+ * @param[in] timeout_ms      time to wait at most
+ *
+ * @return
+ *      BB_SUCCESS: All the publishes were acknowledged
+ *      BB_FAILURE: Timed out with publishes still pending, or the client is not initialized
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ */
+bytebeam_err_t bytebeam_flush(bytebeam_client_t *bytebeam_client, int timeout_ms);
+
+/**
+ * @brief Get the number of wake ups counted in sleep cycle mode
+ *
+ * @note  The count is kept in the memory retained across deep sleep, it starts over on power on.
+ *
+ * @return
+ *      Number of times a client was initialized in sleep cycle mode since power on
+ */
+uint32_t bytebeam_get_wake_count(void);
+
+#endif /* BYTEBEAM_SLEEP_CYCLE_H */
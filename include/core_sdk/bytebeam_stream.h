@@ -1,8 +1,135 @@
 #ifndef BYTEBEAM_STREAM_H
 #define BYTEBEAM_STREAM_H
 
+#include <stdint.h>
+#include <stdbool.h>
 #include "bytebeam_client.h"
 
+/*This macro is used to specify the maximum length of bytebeam stream name string*/
+#define BYTEBEAM_STREAM_NAME_STR_LEN 50
+
+/*This macro is used to specify the initial number of streams the per client topic cache has room for*/
+#define BYTEBEAM_STREAM_TOPIC_CACHE_SIZE 8
+
+/*This macro is used to specify the default number of records after which the stream batch is flushed*/
+#define BYTEBEAM_STREAM_BATCH_MAX_RECORDS 50
+
+/*This macro is used to specify the default size of the stream batch payload buffer in bytes*/
+#define BYTEBEAM_STREAM_BATCH_MAX_SIZE 4096
+
+/*This macro is used to specify the default age in milliseconds after which the stream batch is flushed*/
+#define BYTEBEAM_STREAM_BATCH_MAX_AGE_MS 1000
+
+/*This macro is used to specify the default payload size in bytes below which the stream publishes are not compressed*/
+#define BYTEBEAM_STREAM_COMPRESSION_MIN_SIZE 512
+
+/* Handle of an opened stream, it holds the stream's publish topic so the publishes through it skip building the topic */
+typedef struct bytebeam_stream *bytebeam_stream_handle_t;
+
+/**
+ * @struct bytebeam_stream_batch_config_t
+ * This struct contains the flush thresholds for a stream batch
+ * @var bytebeam_stream_batch_config_t::max_records
+ * Flush the batch once it holds this many records (0 disables the count threshold)
+ * @var bytebeam_stream_batch_config_t::max_size
+ * Size of the payload buffer in bytes, the batch is flushed when the next record does not fit
+ * @var bytebeam_stream_batch_config_t::max_age_ms
+ * Flush the batch once the oldest record is this old (0 disables the age threshold)
+ */
+typedef struct bytebeam_stream_batch_config {
+    int max_records;
+    int max_size;
+    int max_age_ms;
+} bytebeam_stream_batch_config_t;
+
+#define BYTEBEAM_STREAM_BATCH_DEFAULT_CONFIG() {               \
+    .max_records = BYTEBEAM_STREAM_BATCH_MAX_RECORDS,          \
+    .max_size    = BYTEBEAM_STREAM_BATCH_MAX_SIZE,             \
+    .max_age_ms  = BYTEBEAM_STREAM_BATCH_MAX_AGE_MS            \
+}
+
+/**
+ * @struct bytebeam_stream_compression_config_t
+ * This struct contains the compression settings of a stream
+ * @var bytebeam_stream_compression_config_t::min_size
+ * Payloads smaller than this many bytes are published as is, as the small ones hardly compress
+ */
+typedef struct bytebeam_stream_compression_config {
+    int min_size;
+} bytebeam_stream_compression_config_t;
+
+#define BYTEBEAM_STREAM_COMPRESSION_DEFAULT_CONFIG() {         \
+    .min_size = BYTEBEAM_STREAM_COMPRESSION_MIN_SIZE           \
+}
+
+/**
+ * @struct bytebeam_stream_rate_limit_config_t
+ * This struct contains the token bucket settings of a stream
+ * @var bytebeam_stream_rate_limit_config_t::rate_bytes_per_sec
+ * Average payload bytes per second the stream may publish
+ * @var bytebeam_stream_rate_limit_config_t::burst_bytes
+ * Payload bytes the stream may publish at once after being idle, also the biggest payload that can ever be published
+ */
+typedef struct bytebeam_stream_rate_limit_config {
+    int rate_bytes_per_sec;
+    int burst_bytes;
+} bytebeam_stream_rate_limit_config_t;
+
+/* Outbox watermark callback, above_high is true when the outbox crossed the high watermark and false when it drained
+ * back to the low watermark. It is called from the publishing task or the mqtt task, so keep it short.
+ */
+typedef void (*bytebeam_outbox_watermark_cb_t)(bytebeam_client_t *bytebeam_client, bool above_high, int outbox_size, void *arg);
+
+/**
+ * @struct bytebeam_outbox_watermark_config_t
+ * This struct contains the outbox watermarks of a client
+ * @var bytebeam_outbox_watermark_config_t::high_watermark
+ * Outbox size in bytes at which the stream publishes start being refused
+ * @var bytebeam_outbox_watermark_config_t::low_watermark
+ * Outbox size in bytes at which the stream publishes are accepted again
+ * @var bytebeam_outbox_watermark_config_t::callback
+ * Called on every crossing of the watermarks, can be NULL
+ * @var bytebeam_outbox_watermark_config_t::callback_arg
+ * Argument passed to the callback
+ */
+typedef struct bytebeam_outbox_watermark_config {
+    int high_watermark;
+    int low_watermark;
+    bytebeam_outbox_watermark_cb_t callback;
+    void *callback_arg;
+} bytebeam_outbox_watermark_config_t;
+
+/**
+ * @struct bytebeam_stream_batch_t
+ * This struct contains the state of a batch of records waiting to be published to particular stream
+ * @var bytebeam_stream_batch_t::bytebeam_client
+ * bytebeam client handle used for publishing the batch
+ * @var bytebeam_stream_batch_t::stream_name
+ * Name of the target stream
+ * @var bytebeam_stream_batch_t::stream
+ * Handle of the target stream
+ * @var bytebeam_stream_batch_t::config
+ * Flush thresholds of the batch
+ * @var bytebeam_stream_batch_t::buffer
+ * Payload buffer holding the json array of the batched records
+ * @var bytebeam_stream_batch_t::length
+ * Length of the json array in the payload buffer (excluding the closing bracket)
+ * @var bytebeam_stream_batch_t::record_count
+ * Number of records in the batch
+ * @var bytebeam_stream_batch_t::first_record_ms
+ * Uptime in milliseconds at which the oldest record of the batch was appended
+ */
+typedef struct bytebeam_stream_batch {
+    bytebeam_client_t *bytebeam_client;
+    char stream_name[BYTEBEAM_STREAM_NAME_STR_LEN];
+    bytebeam_stream_handle_t stream;
+    bytebeam_stream_batch_config_t config;
+    char *buffer;
+    int length;
+    int record_count;
+    long long first_record_ms;
+} bytebeam_stream_batch_t;
+
 /**
  * @brief Publish message to particualar stream
  *
@@ -14,7 +141,196 @@
  *      BB_SUCCESS: Message publish successful
  *      BB_FAILURE: Message publish failed
  *      BB_NULL_CHECK_FAILURE: If the bytebeam_client, stream_name, or payload is NULL
+ *      BB_RATE_LIMITED: If the rate limit or the outbox watermarks refused the publish
  */
 bytebeam_err_t bytebeam_publish_to_stream(bytebeam_client_t *bytebeam_client, char *stream_name, char *payload);
 
+/**
+ * @brief Open particular stream for publishing, opening the same stream again returns the same handle
+ *
+ * @note  The handle stays valid until the client is destroyed, it needs no closing. The topic of the stream is built on
+ *        the first publish and rebuilt only if bytebeam_init is called again, so keep the handle around for the
+ *        frequently published streams. Call this api after bytebeam_init.
+ *
+ * @param[in] bytebeam_client     bytebeam client handle
+ * @param[in] stream_name         name of the target stream
+ *
+ * @return
+ *      Stream handle
+ *      NULL : If the bytebeam_client or stream_name is NULL, the client is not initialized, the stream name is too long
+ *             or the memory allocation failed
+ */
+bytebeam_stream_handle_t bytebeam_stream_open(bytebeam_client_t *bytebeam_client, char *stream_name);
+
+/**
+ * @brief Publish message to the opened stream
+ *
+ * @param[in] stream              stream handle
+ * @param[in] payload             message to publish
+ *
+ * @return
+ *      BB_SUCCESS: Message publish successful
+ *      BB_FAILURE: Message publish failed
+ *      BB_NULL_CHECK_FAILURE: If the stream or payload is NULL
+ *      BB_RATE_LIMITED: If the rate limit or the outbox watermarks refused the publish
+ */
+bytebeam_err_t bytebeam_stream_publish(bytebeam_stream_handle_t stream, char *payload);
+
+/**
+ * @brief Publish cbor encoded message to the opened stream, on the cbor topic of the stream instead of the jsonarray one
+ *
+ * @note  The payload is the cbor counterpart of the json array payload i.e. an array of maps, one per record, as
+ *        written by the cbor writer. The cbor publishes are never stored in the offline queue, they fail while the
+ *        client is disconnected.
+ *
+ * @param[in] stream              stream handle
+ * @param[in] payload             cbor encoded message to publish
+ * @param[in] length              length of the message in bytes
+ *
+ * @return
+ *      BB_SUCCESS: Message publish successful
+ *      BB_FAILURE: Message publish failed
+ *      BB_NULL_CHECK_FAILURE: If the stream or payload is NULL
+ *      BB_RATE_LIMITED: If the rate limit or the outbox watermarks refused the publish
+ */
+bytebeam_err_t bytebeam_stream_publish_cbor(bytebeam_stream_handle_t stream, const uint8_t *payload, int length);
+
+/**
+ * @brief Enable or disable the lz4 compression of the publishes to the opened stream
+ *
+ * @note  A compressed payload is published on the lz4 topic of its format i.e. /jsonarray/lz4 or /cbor/lz4 instead of
+ *        /jsonarray or /cbor. It holds the uncompressed length as 4 bytes little endian followed by a single lz4 block.
+ *        Payloads below the size threshold, over 64KB or that do not get smaller are published uncompressed. This
+ *        covers the batch flushes and the offline queue drains of the stream too, and the cloud logs if it is set on
+ *        the log stream.
+ *
+ * @param[in] stream              stream handle
+ * @param[in] config              compression settings, NULL to disable the compression
+ *
+ * @return
+ *      BB_SUCCESS: Compression settings applied successfully
+ *      BB_FAILURE: Invalid settings or the memory allocation failed
+ *      BB_NULL_CHECK_FAILURE: If the stream is NULL
+ */
+bytebeam_err_t bytebeam_stream_set_compression(bytebeam_stream_handle_t stream, const bytebeam_stream_compression_config_t *config);
+
+/**
+ * @brief Limit the publish rate of the opened stream with a token bucket
+ *
+ * @note  A publish over the limit is refused with BB_RATE_LIMITED, it is neither sent nor stored in the offline queue.
+ *        The limit counts the payload bytes before any compression and only the records sent live, the records
+ *        stored in the offline queue while the client is disconnected are never refused. The bucket starts full.
+ *
+ * @param[in] stream              stream handle
+ * @param[in] config              token bucket settings, NULL to remove the limit
+ *
+ * @return
+ *      BB_SUCCESS: Rate limit applied successfully
+ *      BB_FAILURE: Invalid settings
+ *      BB_NULL_CHECK_FAILURE: If the stream is NULL
+ */
+bytebeam_err_t bytebeam_stream_set_rate_limit(bytebeam_stream_handle_t stream, const bytebeam_stream_rate_limit_config_t *config);
+
+/**
+ * @brief Set the outbox watermarks of the client, the stream publishes are refused while the outbox is above them
+ *
+ * @note  The outbox holds the publishes the mqtt client has not got rid of yet, on a slow broker it grows until the
+ *        heap runs out. Between crossing the high watermark and draining to the low one the stream publishes are
+ *        refused with BB_RATE_LIMITED, so that the producers can downsample or aggregate meanwhile. The action
+ *        status publishes, the device heartbeats, the offline queue drains and the records stored in the offline
+ *        queue are never refused.
+ *
+ * @param[in] bytebeam_client     bytebeam client handle
+ * @param[in] config              outbox watermarks, NULL to remove them
+ *
+ * @return
+ *      BB_SUCCESS: Watermarks applied successfully
+ *      BB_FAILURE: Invalid watermarks or the memory allocation failed
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ */
+bytebeam_err_t bytebeam_set_outbox_watermarks(bytebeam_client_t *bytebeam_client, const bytebeam_outbox_watermark_config_t *config);
+
+/**
+ * @brief Check whether a publish of the given size to the opened stream would be accepted right now
+ *
+ * @note  Nothing is consumed, the actual publish can still be refused if other tasks publish in between.
+ *
+ * @param[in] stream              stream handle
+ * @param[in] length              payload length in bytes
+ *
+ * @return
+ *      true : The rate limit and the outbox watermarks allow the publish
+ *      false: The publish would be refused, or the stream is NULL
+ */
+bool bytebeam_stream_can_publish(bytebeam_stream_handle_t stream, int length);
+
+/**
+ * @brief Initialize a batch for packing multiple records into a single publish to particular stream
+ *
+ * @note  The batch is not thread safe, so make sure a batch is used from one task at a time.
+ *
+ * @param[in] batch               batch handle
+ * @param[in] bytebeam_client     bytebeam client handle
+ * @param[in] stream_name         name of the target stream
+ * @param[in] config              flush thresholds of the batch, NULL to use the default thresholds
+ *
+ * @return
+ *      BB_SUCCESS: Batch initialized successfully
+ *      BB_FAILURE: Batch initialization failed
+ *      BB_NULL_CHECK_FAILURE: If the batch, bytebeam_client, or stream_name is NULL
+ */
+bytebeam_err_t bytebeam_stream_batch_init(bytebeam_stream_batch_t *batch, bytebeam_client_t *bytebeam_client, char *stream_name, const bytebeam_stream_batch_config_t *config);
+
+/**
+ * @brief Append record to the batch, flushing the batch if any of the thresholds is hit
+ *
+ * @param[in] batch               batch handle
+ * @param[in] record              json object or json array of objects to append
+ *
+ * @return
+ *      BB_SUCCESS: Record appended successfully
+ *      BB_FAILURE: Record is malformed, does not fit in the batch or the batch flush failed
+ *      BB_NULL_CHECK_FAILURE: If the batch or record is NULL
+ */
+bytebeam_err_t bytebeam_stream_batch_append(bytebeam_stream_batch_t *batch, char *record);
+
+/**
+ * @brief Flush the batch if the oldest record has crossed the age threshold
+ *
+ * @note  Call this api periodically if the records are appended at irregular intervals
+ *
+ * @param[in] batch               batch handle
+ *
+ * @return
+ *      BB_SUCCESS: Batch flushed or nothing to flush
+ *      BB_FAILURE: Batch flush failed
+ *      BB_NULL_CHECK_FAILURE: If the batch is NULL
+ */
+bytebeam_err_t bytebeam_stream_batch_poll(bytebeam_stream_batch_t *batch);
+
+/**
+ * @brief Publish all the records of the batch as a single message
+ *
+ * @note  On failure the records are retained in the batch so that the flush can be retried
+ *
+ * @param[in] batch               batch handle
+ *
+ * @return
+ *      BB_SUCCESS: Batch flushed or nothing to flush
+ *      BB_FAILURE: Batch flush failed
+ *      BB_NULL_CHECK_FAILURE: If the batch is NULL
+ */
+bytebeam_err_t bytebeam_stream_batch_flush(bytebeam_stream_batch_t *batch);
+
+/**
+ * @brief De-initialize the batch, the pending records are dropped so flush the batch before if needed
+ *
+ * @param[in] batch               batch handle
+ *
+ * @return
+ *      BB_SUCCESS: Batch de-initialized successfully
+ *      BB_NULL_CHECK_FAILURE: If the batch is NULL
+ */
+bytebeam_err_t bytebeam_stream_batch_deinit(bytebeam_stream_batch_t *batch);
+
 #endif /* BYTEBEAM_STREAM_H */
\ No newline at end of file
@@ -1,11 +1,80 @@
 #ifndef BYTEBEAM_HAL_H
 #define BYTEBEAM_HAL_H
 
-// define the sdk platform here
+// the sdk platform is picked by the build, esp-idf unless the host build asks for linux
+#ifndef CONFIG_SDK_PLATFORM_LINUX
 #define CONFIG_SDK_PLATFORM_ESP
+#endif
 
 #ifdef CONFIG_SDK_PLATFORM_ESP
 #include "bytebeam_esp_hal.h"
 #endif
 
+#ifdef CONFIG_SDK_PLATFORM_LINUX
+#include "bytebeam_linux_hal.h"
+#endif
+
+#include "bytebeam_client.h"
+
+typedef enum bytebeam_reset_reason {
+    BB_RST_UNKNOWN,    //!< Reset reason can not be determined
+    BB_RST_POWERON,    //!< Reset due to power-on event
+    BB_RST_EXT,        //!< Reset by external pin (not applicable for ESP32)
+    BB_RST_SW,         //!< Software reset via esp_restart
+    BB_RST_PANIC,      //!< Software reset due to exception/panic
+    BB_RST_INT_WDT,    //!< Reset (software or hardware) due to interrupt watchdog
+    BB_RST_TASK_WDT,   //!< Reset due to task watchdog
+    BB_RST_WDT,        //!< Reset due to other watchdogs
+    BB_RST_DEEPSLEEP,  //!< Reset after exiting deep sleep mode
+    BB_RST_BROWNOUT,   //!< Brownout reset (software or hardware)
+    BB_RST_SDIO,       //!< Reset over SDIO
+} bytebeam_reset_reason_t;
+
+typedef void *bytebeam_hal_mutex_t;
+typedef void *bytebeam_hal_task_t;
+typedef void *bytebeam_hal_semaphore_t;
+
+int bytebeam_hal_mqtt_subscribe(bytebeam_client_handle_t client, char *topic, int qos);
+int bytebeam_hal_mqtt_unsubscribe(bytebeam_client_handle_t client, char *topic);
+int bytebeam_hal_mqtt_publish(bytebeam_client_handle_t client, char *topic, char *message, int length, int qos);
+int bytebeam_hal_mqtt_get_outbox_size(bytebeam_client_handle_t client);
+int bytebeam_hal_restart(void);
+int bytebeam_hal_ota(bytebeam_client_t *bytebeam_client, char *ota_url);
+int bytebeam_hal_ota_mark_updated(bytebeam_client_t *bytebeam_client, int action_id_val);
+int bytebeam_hal_init(bytebeam_client_t *bytebeam_client);
+int bytebeam_hal_destroy(bytebeam_client_t *bytebeam_client);
+int bytebeam_hal_start_mqtt(bytebeam_client_t *bytebeam_client);
+int bytebeam_hal_stop_mqtt(bytebeam_client_t *bytebeam_client);
+
+int bytebeam_hal_spiffs_mount();
+int bytebeam_hal_spiffs_unmount();
+int bytebeam_hal_fatfs_mount();
+int bytebeam_hal_fatfs_unmount();
+char *bytebeam_hal_provisioning_cache_load(int *length);
+int bytebeam_hal_provisioning_cache_save(const char *data, int length);
+int bytebeam_hal_provisioning_cache_erase(void);
+const char *bytebeam_hal_provisioning_partition_map(int *length);
+void bytebeam_hal_provisioning_partition_unmap(void);
+unsigned long long bytebeam_hal_get_epoch_millis();
+bytebeam_reset_reason_t bytebeam_hal_get_reset_reason();
+long long bytebeam_hal_get_uptime_ms();
+long long bytebeam_hal_get_uptime_us();
+uint32_t bytebeam_hal_random(void);
+
+bytebeam_hal_mutex_t bytebeam_hal_mutex_create(void);
+void bytebeam_hal_mutex_lock(bytebeam_hal_mutex_t mutex);
+void bytebeam_hal_mutex_unlock(bytebeam_hal_mutex_t mutex);
+void bytebeam_hal_mutex_delete(bytebeam_hal_mutex_t mutex);
+
+bytebeam_hal_task_t bytebeam_hal_task_create(const char *name, void (*task_func)(void *), void *arg, int stack_size, int priority);
+void bytebeam_hal_task_delete(bytebeam_hal_task_t task);
+void bytebeam_hal_task_notify(bytebeam_hal_task_t task);
+bool bytebeam_hal_task_wait_notify(int timeout_ms);
+void bytebeam_hal_delay_ms(int milliseconds);
+
+bytebeam_hal_semaphore_t bytebeam_hal_semaphore_create(int max_count, int initial_count);
+bool bytebeam_hal_semaphore_take(bytebeam_hal_semaphore_t semaphore, int timeout_ms);
+void bytebeam_hal_semaphore_give(bytebeam_hal_semaphore_t semaphore);
+void bytebeam_hal_semaphore_delete(bytebeam_hal_semaphore_t semaphore);
+
 #endif /* BYTEBEAM_HAL_H */
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef BYTEBEAM_LINUX_HAL_H
+#define BYTEBEAM_LINUX_HAL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*This macro is used to specify the log level of the linux hal, 1 (error) to 5 (verbose), as per esp log levels*/
+#ifndef BYTEBEAM_LINUX_LOG_LEVEL
+#define BYTEBEAM_LINUX_LOG_LEVEL 3
+#endif
+
+/*This macro is used to specify the device provisioning file, looked up relative to the working directory*/
+#ifndef CONFIG_BYTEBEAM_PROVISIONING_FILENAME
+#define CONFIG_BYTEBEAM_PROVISIONING_FILENAME "device_config.json"
+#endif
+
+/*This macro is used to specify the file the OTA image is downloaded into*/
+#ifndef BYTEBEAM_LINUX_OTA_IMAGE_FILENAME
+#define BYTEBEAM_LINUX_OTA_IMAGE_FILENAME "bytebeam_ota.bin"
+#endif
+
+/*This macro is used to specify the file keeping the id of the completed OTA action across the restart*/
+#ifndef BYTEBEAM_LINUX_OTA_STATE_FILENAME
+#define BYTEBEAM_LINUX_OTA_STATE_FILENAME "bytebeam_ota_state"
+#endif
+
+/*This macro is used to specify the file keeping the provisioning cache, see CONFIG_BYTEBEAM_PROVISIONING_CACHE*/
+#ifndef BYTEBEAM_LINUX_PROVISIONING_CACHE_FILENAME
+#define BYTEBEAM_LINUX_PROVISIONING_CACHE_FILENAME "bytebeam_provisioning_cache"
+#endif
+
+/*This macro is used to specify the provisioning image mapped in place of the flash partition, see BYTEBEAM_LINUX_PROVISION_FROM_IMAGE*/
+#ifndef BYTEBEAM_LINUX_PROVISIONING_IMAGE_FILENAME
+#define BYTEBEAM_LINUX_PROVISIONING_IMAGE_FILENAME "device_config.bin"
+#endif
+
+/*This macro is used to specify the environment variable overriding the broker uri, i.e. mqtt://localhost:1883 for a local broker*/
+#define BYTEBEAM_LINUX_BROKER_URI_ENV "BYTEBEAM_BROKER_URI"
+
+// the device is provisioned from a plain file, there is no file system to mount on the host
+#ifndef CONFIG_BYTEBEAM_PROVISION_DEVICE_FROM_PARTITION
+#define CONFIG_BYTEBEAM_PROVISION_DEVICE_FROM_FILE 1
+#endif
+
+unsigned long long bytebeam_linux_log_timestamp(void);
+
+#define BYTEBEAM_LINUX_LOG(level, letter, tag, fmt, ...)                                                  \
+    do {                                                                                                  \
+        if (level <= BYTEBEAM_LINUX_LOG_LEVEL) {                                                          \
+            printf(letter " (%llu) %s: " fmt "\n", bytebeam_linux_log_timestamp(), tag, ##__VA_ARGS__);   \
+        }                                                                                                 \
+    } while (0)
+
+#define BB_LOGE(tag, fmt, ...)  BYTEBEAM_LINUX_LOG(1, "E", tag, fmt, ##__VA_ARGS__)
+#define BB_LOGW(tag, fmt, ...)  BYTEBEAM_LINUX_LOG(2, "W", tag, fmt, ##__VA_ARGS__)
+#define BB_LOGI(tag, fmt, ...)  BYTEBEAM_LINUX_LOG(3, "I", tag, fmt, ##__VA_ARGS__)
+#define BB_LOGD(tag, fmt, ...)  BYTEBEAM_LINUX_LOG(4, "D", tag, fmt, ##__VA_ARGS__)
+#define BB_LOGV(tag, fmt, ...)  BYTEBEAM_LINUX_LOG(5, "V", tag, fmt, ##__VA_ARGS__)
+
+/*This macro is used to specify the variables kept across the deep sleep, there is no deep sleep on the host*/
+#define BB_RETAINED
+
+#endif /* BYTEBEAM_LINUX_HAL_H */
@@ -0,0 +1,182 @@
+#ifndef BYTEBEAM_LINUX_MQTT_H
+#define BYTEBEAM_LINUX_MQTT_H
+
+#include <stdbool.h>
+
+/*This macro is used to specify the maximum size of a received mqtt packet, bigger packets drop the connection*/
+#define BYTEBEAM_LINUX_MQTT_MAX_PACKET_SIZE (64 * 1024)
+
+/*This macro is used to specify the default keep alive interval of the mqtt connection*/
+#define BYTEBEAM_LINUX_MQTT_KEEPALIVE_SEC 60
+
+/*This macro is used to specify the delay before reconnecting after the mqtt connection is lost*/
+#define BYTEBEAM_LINUX_MQTT_RECONNECT_DELAY_MS 5000
+
+/*This macro is used to specify the timeout of the blocking socket operations of the mqtt client*/
+#define BYTEBEAM_LINUX_MQTT_NETWORK_TIMEOUT_MS 10000
+
+/*This macro is used to specify the number of unacknowledged qos 1 publishes counted towards the outbox size*/
+#define BYTEBEAM_LINUX_MQTT_MAX_INFLIGHT 64
+
+struct bytebeam_linux_mqtt_client;
+typedef struct bytebeam_linux_mqtt_client *bytebeam_linux_mqtt_client_handle_t;
+
+/* This enum represents the events reported by the linux mqtt client, as per the esp mqtt events */
+typedef enum {
+    BYTEBEAM_LINUX_MQTT_EVENT_CONNECTED,
+    BYTEBEAM_LINUX_MQTT_EVENT_DISCONNECTED,
+    BYTEBEAM_LINUX_MQTT_EVENT_SUBSCRIBED,
+    BYTEBEAM_LINUX_MQTT_EVENT_PUBLISHED,
+    BYTEBEAM_LINUX_MQTT_EVENT_DATA,
+} bytebeam_linux_mqtt_event_id_t;
+
+/**
+ * @struct bytebeam_linux_mqtt_event_t
+ * This struct contains a single event reported by the linux mqtt client
+ * @var bytebeam_linux_mqtt_event_t::event_id
+ * Type of the event
+ * @var bytebeam_linux_mqtt_event_t::msg_id
+ * Message id of the acknowledged publish or subscribe, of the received publish for data
+ * @var bytebeam_linux_mqtt_event_t::topic
+ * Topic of the received publish, not NULL terminated
+ * @var bytebeam_linux_mqtt_event_t::topic_len
+ * Length of the topic
+ * @var bytebeam_linux_mqtt_event_t::data
+ * Payload of the received publish, not NULL terminated, can be modified until the event handler returns
+ * @var bytebeam_linux_mqtt_event_t::data_len
+ * Length of the payload
+ * @var bytebeam_linux_mqtt_event_t::session_present
+ * The broker resumed the session of the client, connected event only
+ */
+typedef struct bytebeam_linux_mqtt_event {
+    bytebeam_linux_mqtt_event_id_t event_id;
+    int msg_id;
+    const char *topic;
+    int topic_len;
+    char *data;
+    int data_len;
+    bool session_present;
+} bytebeam_linux_mqtt_event_t;
+
+typedef void (*bytebeam_linux_mqtt_event_handler_t)(void *handler_args, bytebeam_linux_mqtt_event_t *event);
+
+/**
+ * @struct bytebeam_linux_mqtt_config_t
+ * This struct contains the configuration of the linux mqtt client, the strings must outlive the client
+ * @var bytebeam_linux_mqtt_config_t::uri
+ * Broker uri i.e. mqtt://host:port, or mqtts://host:port for tls
+ * @var bytebeam_linux_mqtt_config_t::cert_pem
+ * CA certificate verifying the broker, tls only
+ * @var bytebeam_linux_mqtt_config_t::client_cert_pem
+ * Client certificate, tls only
+ * @var bytebeam_linux_mqtt_config_t::client_key_pem
+ * Client private key, tls only
+ * @var bytebeam_linux_mqtt_config_t::client_id
+ * Mqtt client id, NULL to generate one
+ * @var bytebeam_linux_mqtt_config_t::keepalive_sec
+ * Keep alive interval, zero means default
+ * @var bytebeam_linux_mqtt_config_t::disable_clean_session
+ * Ask the broker to keep the session of the client, i.e. its subscriptions, across the connections
+ */
+typedef struct bytebeam_linux_mqtt_config {
+    const char *uri;
+    const char *cert_pem;
+    const char *client_cert_pem;
+    const char *client_key_pem;
+    const char *client_id;
+    int keepalive_sec;
+    bool disable_clean_session;
+} bytebeam_linux_mqtt_config_t;
+
+/**
+ * @brief Create a linux mqtt client
+ *
+ * @note  The client is a minimal mqtt 3.1.1 client with a single network thread which delivers all the events. The
+ *        qos 1 publishes are not retransmitted after a reconnect. A tls reconnect resumes the last session of the
+ *        client, the session is kept in memory only.
+ *
+ * @param[in] config        client configuration
+ * @param[in] handler       event handler
+ * @param[in] handler_args  argument passed to the event handler
+ *
+ * @return
+ *      Client handle
+ *      NULL : If the configuration is invalid or the memory allocation failed
+ */
+bytebeam_linux_mqtt_client_handle_t bytebeam_linux_mqtt_init(const bytebeam_linux_mqtt_config_t *config, bytebeam_linux_mqtt_event_handler_t handler, void *handler_args);
+
+/**
+ * @brief Start the network thread, it keeps the client connected until stopped
+ *
+ * @param[in] client  client handle
+ *
+ * @return
+ *      0 : Client started successfully
+ *     -1 : Client start failed
+ */
+int bytebeam_linux_mqtt_start(bytebeam_linux_mqtt_client_handle_t client);
+
+/**
+ * @brief Disconnect and stop the network thread, cannot be called from the event handler
+ *
+ * @param[in] client  client handle
+ *
+ * @return
+ *      0 : Client stopped successfully
+ *     -1 : Client was not started
+ */
+int bytebeam_linux_mqtt_stop(bytebeam_linux_mqtt_client_handle_t client);
+
+/**
+ * @brief Stop and free the client
+ *
+ * @param[in] client  client handle
+ *
+ * @return
+ *      void
+ */
+void bytebeam_linux_mqtt_destroy(bytebeam_linux_mqtt_client_handle_t client);
+
+/**
+ * @brief Publish a message
+ *
+ * @param[in] client  client handle
+ * @param[in] topic   topic name
+ * @param[in] data    payload
+ * @param[in] len     payload length
+ * @param[in] qos     0 or 1
+ *
+ * @return
+ *      Message id of the publish, 0 for qos 0
+ *      -1 : If the client is not connected or the send failed
+ */
+int bytebeam_linux_mqtt_publish(bytebeam_linux_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos);
+
+/**
+ * @brief Get the size of the outbox i.e. the bytes of the qos 1 publishes waiting for their acknowledgement
+ *
+ * @note  The client sends every publish straight away, so the outbox only holds the unacknowledged ones. Upto
+ *        BYTEBEAM_LINUX_MQTT_MAX_INFLIGHT of them are counted, the oldest ones are forgotten after that. The outbox is
+ *        emptied on a disconnect, as the publishes are not retransmitted.
+ *
+ * @param[in] client  client handle
+ *
+ * @return
+ *      Outbox size in bytes
+ */
+int bytebeam_linux_mqtt_get_outbox_size(bytebeam_linux_mqtt_client_handle_t client);
+
+/**
+ * @brief Subscribe to a topic
+ *
+ * @param[in] client  client handle
+ * @param[in] topic   topic filter
+ * @param[in] qos     0 or 1
+ *
+ * @return
+ *      Message id of the subscribe
+ *      -1 : If the client is not connected or the send failed
+ */
+int bytebeam_linux_mqtt_subscribe(bytebeam_linux_mqtt_client_handle_t client, const char *topic, int qos);
+
+#endif /* BYTEBEAM_LINUX_MQTT_H */
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+#
+# Converts the device config json into the provisioning image the sdk maps from the provisioning partition (or, on
+# the linux host, from the device_config.bin file). The image is a 16 byte header (magic, version, string count,
+# length and crc32 of the strings, little endian) followed by the project id, broker uri, device id, ca certificate,
+# device certificate and device private key, each of them nul terminated.
+#
+
+import argparse
+import json
+import struct
+import sys
+import zlib
+
+PROVISIONING_IMAGE_MAGIC = 0x43504242
+PROVISIONING_IMAGE_VERSION = 1
+
+
+def make_provisioning_image(device_config):
+    authentication = device_config["authentication"]
+
+    strings = [
+        device_config["project_id"],
+        "mqtts://%s:%d" % (device_config["broker"], int(device_config["port"])),
+        device_config["device_id"],
+        authentication["ca_certificate"],
+        authentication["device_certificate"],
+        authentication["device_private_key"],
+    ]
+
+    data = b"".join(string.encode("utf-8") + b"\0" for string in strings)
+    header = struct.pack("<IHHII", PROVISIONING_IMAGE_MAGIC, PROVISIONING_IMAGE_VERSION, len(strings), len(data),
+                         zlib.crc32(data) & 0xFFFFFFFF)
+
+    return header + data
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate the bytebeam provisioning image")
+    parser.add_argument("input", help="device config json, as downloaded from the bytebeam cloud")
+    parser.add_argument("output", help="provisioning image to write")
+    args = parser.parse_args()
+
+    with open(args.input, "r") as config_file:
+        device_config = json.load(config_file)
+
+    try:
+        image = make_provisioning_image(device_config)
+    except KeyError as err:
+        sys.exit("Device config has no %s" % err)
+
+    with open(args.output, "wb") as image_file:
+        image_file.write(image)
+
+    print("Wrote %d bytes provisioning image to %s" % (len(image), args.output))
+
+
+if __name__ == "__main__":
+    main()
@@ -1,10 +1,28 @@
-#include "cJSON.h"
+#include <stdint.h>
 #include "sys/time.h"
 #include "bytebeam_hal.h"
+#include "bytebeam_internal.h"
+#include "bytebeam_json.h"
 #include "bytebeam_action.h"
 
-static int function_handler_index = 0;
-static char bytebeam_last_known_action_id[BYTEBEAM_ACTION_ID_STR_LEN] = { 0 };
+/* Open addressing hash table with linear probing, the name hash is computed once when the handler is added */
+typedef struct bytebeam_action_entry {
+    uint32_t hash;
+    const char *name;
+    int (*func)(bytebeam_client_t *bytebeam_client, char *args, char *action_id);
+    int priority;
+    int max_concurrency;
+} bytebeam_action_entry_t;
+
+typedef struct bytebeam_action_registry {
+    int capacity;
+    int count;
+    bytebeam_hal_mutex_t lock;
+    bytebeam_action_entry_t *entries;
+} bytebeam_action_registry_t;
+
+// the action status sequence of the sleep cycle mode carries on across deep sleep, so the statuses stay in order
+static BB_RETAINED uint64_t bytebeam_action_status_sequence = 0;
 
 static const char *TAG = "BYTEBEAM_ACTION";
 
@@ -57,106 +75,254 @@ int bytebeam_unsubscribe_to_actions(bytebeam_device_config_t device_cfg, bytebea
     return msg_id;
 }
 
-int bytebeam_handle_actions(char *action_received, bytebeam_client_handle_t client, bytebeam_client_t *bytebeam_client)
+int bytebeam_handle_actions(char *action_received, int action_len, bytebeam_client_handle_t client, bytebeam_client_t *bytebeam_client)
 {
-    cJSON *root = NULL;
-    cJSON *name = NULL;
-    cJSON *payload = NULL;
-    cJSON *action_id_obj = NULL;
+    char *name = NULL;
+    char *payload = NULL;
+    char *action_id = NULL;
+    int token_count = 0;
+    int name_index = -1;
+    int payload_index = -1;
+    int action_id_index = -1;
+    bytebeam_json_token_t tokens[BYTEBEAM_ACTION_JSON_TOKEN_COUNT];
+
+    // the received data is not NULL terminated, the tokens just point into it
+    token_count = bytebeam_json_parse(action_received, action_len, tokens, BYTEBEAM_ACTION_JSON_TOKEN_COUNT);
+
+    if (token_count < 1 || tokens[0].type != BYTEBEAM_JSON_OBJECT) {
+        BB_LOGE(TAG, "ERROR in parsing the JSON\n");
 
-    int action_iterator = 0;
-    char action_id[BYTEBEAM_ACTION_ID_STR_LEN] = { 0 };
+        return -1;
+    }
 
-    root = cJSON_Parse(action_received);
+    name_index = bytebeam_json_find(action_received, tokens, token_count, 0, "name");
+    action_id_index = bytebeam_json_find(action_received, tokens, token_count, 0, "id");
+    payload_index = bytebeam_json_find(action_received, tokens, token_count, 0, "payload");
 
-    if (root == NULL) {
-        BB_LOGE(TAG, "ERROR in parsing the JSON\n");
+    /* The strings are unescaped and terminated in place of their closing quotes, so the handler gets them straight
+     * from the received data without any copy. This must happen only after all the lookups are done.
+     */
+    if (name_index != -1) {
+        name = bytebeam_json_unescape(action_received, &tokens[name_index]);
+    }
 
-        return -1;
+    if (action_id_index != -1) {
+        action_id = bytebeam_json_unescape(action_received, &tokens[action_id_index]);
     }
 
-    name = cJSON_GetObjectItem(root, "name");
+    if (payload_index != -1) {
+        payload = bytebeam_json_unescape(action_received, &tokens[payload_index]);
+    }
 
-    if (!(cJSON_IsString(name) && (name->valuestring != NULL))) {
+    if (name == NULL) {
         BB_LOGE(TAG, "Error parsing action name\n");
 
-        cJSON_Delete(root);
         return -1;
     }
 
-    BB_LOGI(TAG, "Checking name \"%s\"\n", name->valuestring);
+    BB_LOGI(TAG, "Checking name \"%s\"\n", name);
 
-    action_id_obj = cJSON_GetObjectItem(root, "id");
+    bytebeam_metrics_count(BYTEBEAM_METRIC_ACTIONS_RECEIVED, 1);
 
-    if (cJSON_IsString(action_id_obj) && (action_id_obj->valuestring != NULL)) {
-        BB_LOGI(TAG, "Checking version \"%s\"\n", action_id_obj->valuestring);
+    if (action_id != NULL) {
+        BB_LOGI(TAG, "Checking version \"%s\"\n", action_id);
     } else {
         BB_LOGE(TAG, "Error parsing action id");
 
-        cJSON_Delete(root);
         return -1;
     }
 
-    int max_len = BYTEBEAM_ACTION_ID_STR_LEN;
-    int temp_var = snprintf(action_id, max_len, "%s", action_id_obj->valuestring);
-
-    if(temp_var >= max_len)
+    if(strlen(action_id) >= BYTEBEAM_ACTION_ID_STR_LEN)
     {
         BB_LOGE(TAG, "Action Id length exceeded buffer size");
 
-        cJSON_Delete(root);
         return -1;
     }
 
     int action_id_val = atoi(action_id);
-    int last_known_action_id_val = atoi(bytebeam_last_known_action_id);
+    int last_known_action_id_val = bytebeam_client->last_action_id;
 
     BB_LOGD(TAG, "action_id_val : %d, last_known_action_id_val : %d\n",action_id_val, last_known_action_id_val);
 
     // just ignore the previous actions if triggered again
     if (action_id_val <= last_known_action_id_val) {
-        BB_LOGE(TAG, "Ignoring %s Action\n", name->valuestring);
+        BB_LOGE(TAG, "Ignoring %s Action\n", name);
+
         return 0;
     }
 
-    payload = cJSON_GetObjectItem(root, "payload");
-
-    if (cJSON_IsString(payload) && (payload->valuestring != NULL)) {
-        BB_LOGI(TAG, "Checking payload \"%s\"\n", payload->valuestring);
+    if (payload != NULL) {
+        BB_LOGI(TAG, "Checking payload \"%s\"\n", payload);
 
-        while (bytebeam_client->action_funcs[action_iterator].name) {
-            if (!strcmp(bytebeam_client->action_funcs[action_iterator].name, name->valuestring)) {
-                bytebeam_client->action_funcs[action_iterator].func(bytebeam_client, payload->valuestring, action_id);
-                break;
-            }
+        int priority = 0;
+        int max_concurrency = 0;
+        bytebeam_action_functions_map_t handler;
 
-            action_iterator++;
-        }
+        if (bytebeam_find_action_handler(bytebeam_client, name, &handler, &priority, &max_concurrency) != 0) {
+            BB_LOGI(TAG, "Invalid action:%s\n", name);
 
-        if (bytebeam_client->action_funcs[action_iterator].name == NULL) {
-            BB_LOGI(TAG, "Invalid action:%s\n", name->valuestring);
+            bytebeam_metrics_count(BYTEBEAM_METRIC_ACTIONS_REJECTED, 1);
 
             // publish action failed response indicating unregistered action
             bytebeam_publish_action_status(bytebeam_client, action_id, 0, "Failed", "Unregistered Action");
+        } else if (bytebeam_client->action_pool != NULL) {
+            // leave the execution to the action workers, the mqtt task must not block on the handler
+            if (bytebeam_action_pool_submit(bytebeam_client, &handler, payload, action_id, priority, max_concurrency) != 0) {
+                BB_LOGE(TAG, "Action queue full, failing %s action\n", name);
+                bytebeam_metrics_count(BYTEBEAM_METRIC_ACTIONS_REJECTED, 1);
+
+                bytebeam_publish_action_status(bytebeam_client, action_id, 0, "Failed", "Action queue full");
+            }
+        } else {
+            long long start_ms = bytebeam_hal_get_uptime_ms();
+
+            handler.func(bytebeam_client, payload, action_id);
+
+            // run inline, so the dispatch takes no time at all
+            bytebeam_metrics_observe(BYTEBEAM_METRIC_ACTION_DISPATCH_MS, 0);
+            bytebeam_metrics_observe(BYTEBEAM_METRIC_ACTION_RUN_MS, bytebeam_hal_get_uptime_ms() - start_ms);
         }
 
         // update the last known action id
-        strcpy(bytebeam_last_known_action_id, action_id);
+        bytebeam_client->last_action_id = action_id_val;
     } else {
         BB_LOGE(TAG, "Error fetching payload");
 
-        cJSON_Delete(root);
         return -1;
     }
 
-    /*  Deleting json object from memory after calling the respective action handlder so make sure that they will not
-     *  gonna use the json object beyond the scope of the handler as this pointer we will be dangling.
-     */
-    cJSON_Delete(root);
+    return 0;
+}
+
+/* FNV-1a, good enough spread for action names and cheap to compute */
+static uint32_t action_name_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*name != '\0') {
+        hash = (hash ^ (uint8_t)*name) * 16777619u;
+        name++;
+    }
+
+    return hash;
+}
+
+/* Returns the slot holding the action, or the empty slot where it would go if it is not there */
+static int find_action_slot(bytebeam_action_registry_t *registry, const char *name, uint32_t hash)
+{
+    int mask = registry->capacity - 1;
+    int index = (int)(hash & mask);
+
+    while (registry->entries[index].name != NULL) {
+        if (registry->entries[index].hash == hash && !strcmp(registry->entries[index].name, name)) {
+            break;
+        }
+
+        index = (index + 1) & mask;
+    }
+
+    return index;
+}
+
+static int grow_action_registry(bytebeam_action_registry_t *registry)
+{
+    int new_capacity = registry->capacity * 2;
+    bytebeam_action_entry_t *new_entries = calloc(new_capacity, sizeof(bytebeam_action_entry_t));
+
+    if (new_entries == NULL) {
+        return -1;
+    }
+
+    int index = 0;
+    int mask = new_capacity - 1;
+
+    for (index = 0; index < registry->capacity; index++) {
+        bytebeam_action_entry_t *entry = &registry->entries[index];
+
+        if (entry->name == NULL) {
+            continue;
+        }
+
+        int new_index = (int)(entry->hash & mask);
+
+        while (new_entries[new_index].name != NULL) {
+            new_index = (new_index + 1) & mask;
+        }
+
+        new_entries[new_index] = *entry;
+    }
+
+    free(registry->entries);
+    registry->entries = new_entries;
+    registry->capacity = new_capacity;
 
     return 0;
 }
 
+static bytebeam_action_registry_t *get_action_registry(bytebeam_client_t *bytebeam_client)
+{
+    if (bytebeam_client->action_registry != NULL) {
+        return bytebeam_client->action_registry;
+    }
+
+    bytebeam_action_registry_t *registry = calloc(1, sizeof(bytebeam_action_registry_t));
+
+    if (registry == NULL) {
+        return NULL;
+    }
+
+    // the capacity must stay a power of two for the index masking
+    registry->capacity = 1;
+
+    while (registry->capacity < BYTEBEAM_NUMBER_OF_ACTIONS) {
+        registry->capacity = registry->capacity * 2;
+    }
+
+    registry->entries = calloc(registry->capacity, sizeof(bytebeam_action_entry_t));
+    registry->lock = bytebeam_hal_mutex_create();
+
+    if (registry->entries == NULL || registry->lock == NULL) {
+        if (registry->lock != NULL) {
+            bytebeam_hal_mutex_delete(registry->lock);
+        }
+
+        free(registry->entries);
+        free(registry);
+        return NULL;
+    }
+
+    bytebeam_client->action_registry = registry;
+
+    return registry;
+}
+
+int bytebeam_find_action_handler(bytebeam_client_t *bytebeam_client, const char *func_name, bytebeam_action_functions_map_t *handler, int *priority, int *max_concurrency)
+{
+    bytebeam_action_registry_t *registry = bytebeam_client->action_registry;
+
+    if (registry == NULL) {
+        return -1;
+    }
+
+    uint32_t hash = action_name_hash(func_name);
+
+    bytebeam_hal_mutex_lock(registry->lock);
+
+    bytebeam_action_entry_t *entry = &registry->entries[find_action_slot(registry, func_name, hash)];
+
+    // copy out the entry, it may move as soon as the lock is released
+    if (entry->name != NULL) {
+        handler->name = func_name;
+        handler->func = entry->func;
+        *priority = entry->priority;
+        *max_concurrency = entry->max_concurrency;
+    }
+
+    bytebeam_hal_mutex_unlock(registry->lock);
+
+    return (entry->name != NULL) ? 0 : -1;
+}
+
 bytebeam_err_t bytebeam_add_action_handler(bytebeam_client_t *bytebeam_client, int (*func_ptr)(bytebeam_client_t *, char *, char *), char *func_name)
 {
     if (bytebeam_client == NULL || func_ptr == NULL || func_name == NULL)
@@ -164,25 +330,47 @@ bytebeam_err_t bytebeam_add_action_handler(bytebeam_client_t *bytebeam_client, i
         return BB_NULL_CHECK_FAILURE;
     }
 
-    if (function_handler_index >= BYTEBEAM_NUMBER_OF_ACTIONS) {
+    bytebeam_action_registry_t *registry = get_action_registry(bytebeam_client);
+
+    if (registry == NULL) {
         BB_LOGE(TAG, "Creation of new action handler failed");
         return BB_FAILURE;
     }
 
-    int action_iterator = 0;
+    uint32_t hash = action_name_hash(func_name);
+
+    bytebeam_hal_mutex_lock(registry->lock);
+
+    int index = find_action_slot(registry, func_name, hash);
+
+    // checking for duplicates in the registry, if there log the info about it and return
+    if (registry->entries[index].name != NULL) {
+        bytebeam_hal_mutex_unlock(registry->lock);
+
+        BB_LOGE(TAG, "action : %s is already there, update the action instead\n", func_name);
+        return BB_FAILURE;
+    }
 
-    // checking for duplicates in the array, if there log the info about it and return 
-    for (action_iterator = 0; action_iterator < function_handler_index; action_iterator++) {
-        if (!strcmp(bytebeam_client->action_funcs[action_iterator].name, func_name)) {
-            BB_LOGE(TAG, "action : %s is already there, update the action instead\n", func_name);
+    // keep the load factor under 3/4 so that the probe sequences stay short
+    if ((registry->count + 1) * 4 > registry->capacity * 3) {
+        if (grow_action_registry(registry) != 0) {
+            bytebeam_hal_mutex_unlock(registry->lock);
+
+            BB_LOGE(TAG, "Creation of new action handler failed");
             return BB_FAILURE;
         }
+
+        index = find_action_slot(registry, func_name, hash);
     }
 
-    bytebeam_client->action_funcs[function_handler_index].func = func_ptr;
-    bytebeam_client->action_funcs[function_handler_index].name = func_name;
+    registry->entries[index].hash = hash;
+    registry->entries[index].name = func_name;
+    registry->entries[index].func = func_ptr;
+    registry->entries[index].priority = 0;
+    registry->entries[index].max_concurrency = 1;
+    registry->count = registry->count + 1;
 
-    function_handler_index = function_handler_index + 1;
+    bytebeam_hal_mutex_unlock(registry->lock);
 
     return BB_SUCCESS;
 }
@@ -195,29 +383,48 @@ bytebeam_err_t bytebeam_remove_action_handler(bytebeam_client_t *bytebeam_client
         return BB_NULL_CHECK_FAILURE;
     }
 
-    int action_iterator = 0;
-    int target_action_index = -1;
+    bytebeam_action_registry_t *registry = bytebeam_client->action_registry;
 
-    for (action_iterator = 0; action_iterator < function_handler_index; action_iterator++) {
-        if (!strcmp(bytebeam_client->action_funcs[action_iterator].name, func_name)) {
-            target_action_index = action_iterator;
-        }
+    if (registry == NULL) {
+        BB_LOGE(TAG, "action : %s not found \n", func_name);
+        return BB_FAILURE;
     }
 
-    if (target_action_index == -1) {
+    bytebeam_hal_mutex_lock(registry->lock);
+
+    int mask = registry->capacity - 1;
+    int index = find_action_slot(registry, func_name, action_name_hash(func_name));
+
+    if (registry->entries[index].name == NULL) {
+        bytebeam_hal_mutex_unlock(registry->lock);
+
         BB_LOGE(TAG, "action : %s not found \n", func_name);
         return BB_FAILURE;
-    } else {
-        for(action_iterator = target_action_index; action_iterator < function_handler_index - 1; action_iterator++) {
-            bytebeam_client->action_funcs[action_iterator].func = bytebeam_client->action_funcs[action_iterator+1].func;
-            bytebeam_client->action_funcs[action_iterator].name = bytebeam_client->action_funcs[action_iterator+1].name;
+    }
+
+    /* Shift the following entries of the probe sequence back into the hole, so that the lookups never need
+     * tombstones. An entry moves only if the hole lies between its home slot and its current slot.
+     */
+    int hole = index;
+    int next = (hole + 1) & mask;
+
+    while (registry->entries[next].name != NULL) {
+        int home = (int)(registry->entries[next].hash & mask);
+
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            registry->entries[hole] = registry->entries[next];
+            hole = next;
         }
 
-        function_handler_index = function_handler_index - 1;
-        bytebeam_client->action_funcs[function_handler_index].func = NULL;
-        bytebeam_client->action_funcs[function_handler_index].name = NULL;
-        return BB_SUCCESS;
+        next = (next + 1) & mask;
     }
+
+    memset(&registry->entries[hole], 0x00, sizeof(bytebeam_action_entry_t));
+    registry->count = registry->count - 1;
+
+    bytebeam_hal_mutex_unlock(registry->lock);
+
+    return BB_SUCCESS;
 }
 
 bytebeam_err_t bytebeam_update_action_handler(bytebeam_client_t *bytebeam_client, int (*new_func_ptr)(bytebeam_client_t *, char *, char *), char *func_name)
@@ -228,25 +435,32 @@ bytebeam_err_t bytebeam_update_action_handler(bytebeam_client_t *bytebeam_client
         return BB_NULL_CHECK_FAILURE;
     }
 
-    int action_iterator = 0;
-    int target_action_index = -1;
+    bytebeam_action_registry_t *registry = bytebeam_client->action_registry;
 
-    for (action_iterator = 0; action_iterator < function_handler_index; action_iterator++) {
-        if (!strcmp(bytebeam_client->action_funcs[action_iterator].name, func_name)) {
-            target_action_index = action_iterator;
-        }
+    if (registry == NULL) {
+        BB_LOGE(TAG, "action : %s not found \n", func_name);
+        return BB_FAILURE;
     }
 
-    if (target_action_index == -1) {
+    bytebeam_hal_mutex_lock(registry->lock);
+
+    int index = find_action_slot(registry, func_name, action_name_hash(func_name));
+
+    if (registry->entries[index].name == NULL) {
+        bytebeam_hal_mutex_unlock(registry->lock);
+
         BB_LOGE(TAG, "action : %s not found \n", func_name);
         return BB_FAILURE;
-    } else {
-        bytebeam_client->action_funcs[target_action_index].func = new_func_ptr;
-        return BB_SUCCESS;
     }
+
+    registry->entries[index].func = new_func_ptr;
+
+    bytebeam_hal_mutex_unlock(registry->lock);
+
+    return BB_SUCCESS;
 }
 
-bytebeam_err_t bytebeam_is_action_handler_there(bytebeam_client_t *bytebeam_client, char *func_name)
+bytebeam_err_t bytebeam_set_action_handler_options(bytebeam_client_t *bytebeam_client, char *func_name, int priority, int max_concurrency)
 {
 
     if (bytebeam_client == NULL || func_name == NULL)
@@ -254,20 +468,49 @@ bytebeam_err_t bytebeam_is_action_handler_there(bytebeam_client_t *bytebeam_clie
         return BB_NULL_CHECK_FAILURE;
     }
 
-    int action_iterator = 0;
-    int target_action_index = -1;
+    bytebeam_action_registry_t *registry = bytebeam_client->action_registry;
 
-    for (action_iterator = 0; action_iterator < function_handler_index; action_iterator++) {
-        if (!strcmp(bytebeam_client->action_funcs[action_iterator].name, func_name)) {
-            target_action_index = action_iterator;
-        }
+    if (registry == NULL || max_concurrency < 1) {
+        BB_LOGE(TAG, "Failed to set the options of action : %s\n", func_name);
+        return BB_FAILURE;
     }
 
-    if (target_action_index == -1) {
+    bytebeam_hal_mutex_lock(registry->lock);
+
+    int index = find_action_slot(registry, func_name, action_name_hash(func_name));
+
+    if (registry->entries[index].name == NULL) {
+        bytebeam_hal_mutex_unlock(registry->lock);
+
+        BB_LOGE(TAG, "action : %s not found \n", func_name);
+        return BB_FAILURE;
+    }
+
+    registry->entries[index].priority = priority;
+    registry->entries[index].max_concurrency = max_concurrency;
+
+    bytebeam_hal_mutex_unlock(registry->lock);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_is_action_handler_there(bytebeam_client_t *bytebeam_client, char *func_name)
+{
+
+    if (bytebeam_client == NULL || func_name == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    int priority = 0;
+    int max_concurrency = 0;
+    bytebeam_action_functions_map_t handler;
+
+    if (bytebeam_find_action_handler(bytebeam_client, func_name, &handler, &priority, &max_concurrency) != 0) {
         BB_LOGE(TAG, "action : %s not found \n", func_name);
         return BB_FAILURE;
     } else {
-        BB_LOGI(TAG, "action : %s found at index %d\n", func_name, target_action_index);
+        BB_LOGI(TAG, "action : %s found\n", func_name);
         return BB_SUCCESS;
     }
 }
@@ -281,15 +524,22 @@ bytebeam_err_t bytebeam_print_action_handler_array(bytebeam_client_t *bytebeam_c
     }
 
     int action_iterator = 0;
+    bytebeam_action_registry_t *registry = bytebeam_client->action_registry;
 
     BB_LOGI(TAG, "[");
-    for (action_iterator = 0; action_iterator < BYTEBEAM_NUMBER_OF_ACTIONS; action_iterator++) {
-        if (bytebeam_client->action_funcs[action_iterator].name != NULL) {
-            BB_LOGI(TAG, "       {%s : %s}       \n", bytebeam_client->action_funcs[action_iterator].name, "*******");
-        } else {
-            BB_LOGI(TAG, "       {%s : %s}       \n", "NULL", "NULL");
+
+    if (registry != NULL) {
+        bytebeam_hal_mutex_lock(registry->lock);
+
+        for (action_iterator = 0; action_iterator < registry->capacity; action_iterator++) {
+            if (registry->entries[action_iterator].name != NULL) {
+                BB_LOGI(TAG, "       {%s : %s}       \n", registry->entries[action_iterator].name, "*******");
+            }
         }
+
+        bytebeam_hal_mutex_unlock(registry->lock);
     }
+
     BB_LOGI(TAG, "]");
 
     return BB_SUCCESS;
@@ -303,14 +553,18 @@ bytebeam_err_t bytebeam_reset_action_handler_array(bytebeam_client_t *bytebeam_c
         return BB_NULL_CHECK_FAILURE;
     }
 
-    int action_iterator = 0;
+    bytebeam_action_registry_t *registry = bytebeam_client->action_registry;
 
-    for (action_iterator = 0; action_iterator < BYTEBEAM_NUMBER_OF_ACTIONS; action_iterator++) {
-        bytebeam_client->action_funcs[action_iterator].func = NULL;
-        bytebeam_client->action_funcs[action_iterator].name = NULL;
+    if (registry == NULL) {
+        return BB_SUCCESS;
     }
 
-    function_handler_index = 0;
+    // release the registry altogether, it is created again when the next action is added
+    bytebeam_client->action_registry = NULL;
+
+    bytebeam_hal_mutex_delete(registry->lock);
+    free(registry->entries);
+    free(registry);
 
     return BB_SUCCESS;
 }
@@ -374,164 +628,86 @@ bytebeam_err_t bytebeam_publish_action_progress(bytebeam_client_t *bytebeam_clie
     }
 }
 
-
-bytebeam_err_t bytebeam_publish_action_status(bytebeam_client_t *bytebeam_client, char *action_id, int percentage, char *status, char *error_message)
+static uint64_t next_action_status_sequence(bytebeam_client_t *bytebeam_client)
 {
-    static uint64_t sequence = 0;
-    unsigned long long milliseconds = 0;
-
-    cJSON *action_status_json_list = NULL;
-    cJSON *action_status_json = NULL;
-    cJSON *percentage_json = NULL;
-    cJSON *timestamp_json = NULL;
-    cJSON *device_status_json = NULL;
-    cJSON *action_id_json = NULL;
-    cJSON *action_errors_json = NULL;
-    cJSON *seq_json = NULL;
-    char *string_json = NULL;
-    const char *ota_states[1] = { "" };
-
-    int qos = 1;
-    int msg_id = 0;
-    char topic[BYTEBEAM_MQTT_TOPIC_STR_LEN] = {0};
+    if (!bytebeam_client->sleep_cycle_cfg.is_enabled) {
+        return __atomic_add_fetch(&bytebeam_client->action_status_sequence, 1, __ATOMIC_RELAXED);
+    }
 
-    action_status_json_list = cJSON_CreateArray();
+    // the first status of this wake up carries on from the last one before the deep sleep
+    uint64_t expected = 0;
+    __atomic_compare_exchange_n(&bytebeam_client->action_status_sequence, &expected, bytebeam_action_status_sequence, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
 
-    if (action_status_json_list == NULL) {
-        BB_LOGE(TAG, "Json Init failed.");
+    uint64_t sequence = __atomic_add_fetch(&bytebeam_client->action_status_sequence, 1, __ATOMIC_RELAXED);
+    uint64_t retained = __atomic_load_n(&bytebeam_action_status_sequence, __ATOMIC_RELAXED);
 
-        return BB_FAILURE;
+    // the workers may get here out of order, the retained sequence only ever moves forward
+    while (retained < sequence &&
+           !__atomic_compare_exchange_n(&bytebeam_action_status_sequence, &retained, sequence, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
     }
 
-    action_status_json = cJSON_CreateObject();
+    return sequence;
+}
 
-    if (action_status_json == NULL) {
-        BB_LOGE(TAG, "Json add failed.");
+bytebeam_err_t bytebeam_publish_action_status(bytebeam_client_t *bytebeam_client, char *action_id, int percentage, char *status, char *error_message)
+{
+    uint64_t sequence = 0;
+    unsigned long long milliseconds = 0;
 
-        cJSON_Delete(action_status_json_list);
-        return BB_FAILURE;
-    }
+    char string_json[BYTEBEAM_ACTION_STATUS_STR_LEN] = { 0 };
+    bytebeam_json_writer_t writer;
+
+    int qos = 1;
+    int msg_id = 0;
 
     milliseconds = bytebeam_hal_get_epoch_millis();
 
     if(milliseconds == 0)
     {
         BB_LOGE(TAG, "failed to get epoch millis.");
-
-        cJSON_Delete(action_status_json_list);
-        return BB_FAILURE;
-    }
-
-    timestamp_json = cJSON_CreateNumber(milliseconds);
-
-    if (timestamp_json == NULL) {
-        BB_LOGE(TAG, "Json add time stamp failed.");
-
-        cJSON_Delete(action_status_json_list);
-        return BB_FAILURE;
-    }
-
-    cJSON_AddItemToObject(action_status_json, "timestamp", timestamp_json);
-
-    sequence++;
-    seq_json = cJSON_CreateNumber(sequence);
-
-    if (seq_json == NULL) {
-        BB_LOGE(TAG, "Json add seq id failed.");
-     
-        cJSON_Delete(action_status_json_list);
         return BB_FAILURE;
     }
 
-    cJSON_AddItemToObject(action_status_json, "sequence", seq_json);
+    // the action workers of the client may report their status at the same time
+    sequence = next_action_status_sequence(bytebeam_client);
 
-    device_status_json = cJSON_CreateString(status);
+    bytebeam_json_writer_init(&writer, string_json, sizeof(string_json));
 
-    if (device_status_json == NULL) {
-        BB_LOGE(TAG, "Json add device status failed.");
+    bytebeam_json_begin_array(&writer, NULL);
+    bytebeam_json_begin_object(&writer, NULL);
+    bytebeam_json_add_uint(&writer, "timestamp", milliseconds);
+    bytebeam_json_add_uint(&writer, "sequence", sequence);
+    bytebeam_json_add_string(&writer, "state", status);
+    bytebeam_json_begin_array(&writer, "errors");
+    bytebeam_json_add_string(&writer, NULL, error_message);
+    bytebeam_json_end_array(&writer);
+    bytebeam_json_add_string(&writer, "id", action_id);
+    bytebeam_json_add_int(&writer, "progress", percentage);
+    bytebeam_json_end_object(&writer);
+    bytebeam_json_end_array(&writer);
 
-        cJSON_Delete(action_status_json_list);
-        return BB_FAILURE;
-    }
-
-    cJSON_AddItemToObject(action_status_json, "state", device_status_json);
-
-    ota_states[0] = error_message;
-    action_errors_json = cJSON_CreateStringArray(ota_states, 1);
-
-    if (action_errors_json == NULL) {
-        BB_LOGE(TAG, "Json add action errors failed.");
-
-        cJSON_Delete(action_status_json_list);
-        return BB_FAILURE;
-    }
-
-    cJSON_AddItemToObject(action_status_json, "errors", action_errors_json);
-
-    action_id_json = cJSON_CreateString(action_id);
-
-    if (action_id_json == NULL) {
-        BB_LOGE(TAG, "Json add action_id failed.");
-
-        cJSON_Delete(action_status_json_list);
-        return BB_FAILURE;
-    }
-
-    cJSON_AddItemToObject(action_status_json, "id", action_id_json);
-
-    percentage_json = cJSON_CreateNumber(percentage);
-
-    if (percentage_json == NULL) {
-        BB_LOGE(TAG, "Json add progress percentage failed.");
-
-        cJSON_Delete(action_status_json_list);
-        return BB_FAILURE;
-    }
-
-    cJSON_AddItemToObject(action_status_json, "progress", percentage_json);
-
-    cJSON_AddItemToArray(action_status_json_list, action_status_json);
-
-    string_json = cJSON_Print(action_status_json_list);
-
-    if(string_json == NULL)
+    if(bytebeam_json_writer_finish(&writer) != BB_SUCCESS)
     {
-        BB_LOGE(TAG, "Json string print failed.");
-
-        cJSON_Delete(action_status_json_list);
+        BB_LOGE(TAG, "Action status size exceeded buffer size");
         return BB_FAILURE;
-    } 
+    }
 
     BB_LOGD(TAG, "\nTrying to print:\n%s\n", string_json);
 
-    int max_len = BYTEBEAM_MQTT_TOPIC_STR_LEN;
-    int temp_var = snprintf(topic, max_len, "/tenants/%s/devices/%s/action/status", bytebeam_client->device_cfg.project_id, bytebeam_client->device_cfg.device_id);
+    const char *topic = bytebeam_stream_get_action_status_topic(bytebeam_client);
 
-    if(temp_var >= max_len)
-    {
-        BB_LOGE(TAG, "action status topic size exceeded topic buffer size");
-
-        cJSON_Delete(action_status_json_list);
-        cJSON_free(string_json);
+    if (topic == NULL) {
         return BB_FAILURE;
     }
 
-    BB_LOGI(TAG, "\nTopic is %s\n", topic);
-
-    msg_id = bytebeam_hal_mqtt_publish(bytebeam_client->client, topic, string_json, strlen(string_json), qos);
+    msg_id = bytebeam_hal_mqtt_publish(bytebeam_client->client, (char *)topic, string_json, strlen(string_json), qos);
 
     if (msg_id != -1) {
-        BB_LOGI(TAG, "sent publish successful, msg_id=%d, message:%s", msg_id, string_json);
+        BB_LOGD(TAG, "sent publish successful, msg_id=%d, message:%s", msg_id, string_json);
     } else {
         BB_LOGE(TAG, "Publish Failed.");
-
-        cJSON_Delete(action_status_json_list);
-        cJSON_free(string_json);
         return BB_FAILURE;
     }
 
-    cJSON_Delete(action_status_json_list);
-    cJSON_free(string_json);
-
     return BB_SUCCESS;
-}
\ No newline at end of file
+}
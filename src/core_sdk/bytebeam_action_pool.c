@@ -0,0 +1,333 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytebeam_hal.h"
+#include "bytebeam_internal.h"
+#include "bytebeam_action.h"
+
+typedef struct bytebeam_action_job {
+    bytebeam_action_functions_map_t handler;
+    char name[BYTEBEAM_ACTION_NAME_STR_LEN];
+    char action_id[BYTEBEAM_ACTION_ID_STR_LEN];
+    char payload_buffer[BYTEBEAM_ACTION_PAYLOAD_STR_LEN];
+    char *payload;
+    int priority;
+    int max_concurrency;
+    uint32_t order;
+    long long submit_ms;
+    bool is_queued;
+    bool is_running;
+} bytebeam_action_job_t;
+
+/* All the workers wait on the jobs_available semaphore. It is given once for every queued job, and again whenever a
+ * job finishes while others are still queued, since those might have been held back by the concurrency limit.
+ *
+ * A job keeps its slot until its handler returns, as the handler works on the payload in the slot. So there is a slot
+ * for every queued job plus one for every worker, and the queue is full once queue_size jobs are waiting.
+ */
+typedef struct bytebeam_action_pool {
+    bytebeam_client_t *bytebeam_client;
+    bytebeam_action_pool_config_t config;
+    bytebeam_hal_mutex_t lock;
+    bytebeam_hal_semaphore_t jobs_available;
+    bytebeam_action_job_t *jobs;
+    int job_slots;
+    int queued_jobs;
+    int alive_workers;
+    uint32_t next_order;
+    bool is_stopping;
+} bytebeam_action_pool_t;
+
+static const char *TAG = "BYTEBEAM_ACTION_POOL";
+
+static int count_running_instances(bytebeam_action_pool_t *pool, const char *name)
+{
+    int count = 0;
+    int index = 0;
+
+    for (index = 0; index < pool->job_slots; index++) {
+        if (pool->jobs[index].is_running && !strcmp(pool->jobs[index].name, name)) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/* Pick the highest priority job that is not held back by its concurrency limit, the oldest one among equals */
+static bytebeam_action_job_t *pick_next_job(bytebeam_action_pool_t *pool)
+{
+    int index = 0;
+    bytebeam_action_job_t *next_job = NULL;
+
+    for (index = 0; index < pool->job_slots; index++) {
+        bytebeam_action_job_t *job = &pool->jobs[index];
+
+        if (!job->is_queued) {
+            continue;
+        }
+
+        if (next_job != NULL && (job->priority < next_job->priority ||
+            (job->priority == next_job->priority && (int32_t)(job->order - next_job->order) > 0))) {
+            continue;
+        }
+
+        if (count_running_instances(pool, job->name) >= job->max_concurrency) {
+            continue;
+        }
+
+        next_job = job;
+    }
+
+    return next_job;
+}
+
+static void action_worker_task(void *arg)
+{
+    bytebeam_action_pool_t *pool = arg;
+
+    while (true) {
+        bytebeam_hal_semaphore_take(pool->jobs_available, -1);
+
+        bytebeam_hal_mutex_lock(pool->lock);
+
+        if (pool->is_stopping) {
+            bytebeam_hal_mutex_unlock(pool->lock);
+            break;
+        }
+
+        bytebeam_action_job_t *job = pick_next_job(pool);
+
+        if (job == NULL) {
+            // the queued jobs are held back by their concurrency limit, a finishing job wakes us up again
+            bytebeam_hal_mutex_unlock(pool->lock);
+            continue;
+        }
+
+        job->is_queued = false;
+        job->is_running = true;
+        pool->queued_jobs--;
+
+        bytebeam_metrics_gauge(BYTEBEAM_METRIC_ACTION_QUEUE_DEPTH, pool->queued_jobs);
+
+        bytebeam_hal_mutex_unlock(pool->lock);
+
+        BB_LOGD(TAG, "Running %s action, id %s", job->name, job->action_id);
+
+        long long start_ms = bytebeam_hal_get_uptime_ms();
+
+        bytebeam_metrics_observe(BYTEBEAM_METRIC_ACTION_DISPATCH_MS, start_ms - job->submit_ms);
+
+        job->handler.func(pool->bytebeam_client, job->payload, job->action_id);
+
+        bytebeam_metrics_observe(BYTEBEAM_METRIC_ACTION_RUN_MS, bytebeam_hal_get_uptime_ms() - start_ms);
+
+        if (job->payload != job->payload_buffer) {
+            free(job->payload);
+        }
+
+        bytebeam_hal_mutex_lock(pool->lock);
+
+        job->payload = NULL;
+        job->is_running = false;
+
+        if (pool->queued_jobs > 0) {
+            bytebeam_hal_semaphore_give(pool->jobs_available);
+        }
+
+        bytebeam_hal_mutex_unlock(pool->lock);
+    }
+
+    bytebeam_hal_mutex_lock(pool->lock);
+    pool->alive_workers--;
+    bytebeam_hal_mutex_unlock(pool->lock);
+
+    bytebeam_hal_task_delete(NULL);
+}
+
+int bytebeam_action_pool_submit(bytebeam_client_t *bytebeam_client, bytebeam_action_functions_map_t *handler, char *payload, char *action_id, int priority, int max_concurrency)
+{
+    int index = 0;
+    bytebeam_action_pool_t *pool = bytebeam_client->action_pool;
+
+    if (strlen(handler->name) >= BYTEBEAM_ACTION_NAME_STR_LEN) {
+        BB_LOGE(TAG, "Action name size exceeded buffer size");
+        return -1;
+    }
+
+    /* The received data goes away once the mqtt event is handled, so the job keeps its own copy. It goes into the
+     * payload buffer of the slot, only the payloads too long for it are allocated.
+     */
+    int payload_len = (int)strlen(payload);
+    char *payload_copy = NULL;
+
+    if (payload_len >= BYTEBEAM_ACTION_PAYLOAD_STR_LEN) {
+        payload_copy = strdup(payload);
+
+        if (payload_copy == NULL) {
+            BB_LOGE(TAG, "Failed to allocate the memory for action payload");
+            return -1;
+        }
+    }
+
+    bytebeam_hal_mutex_lock(pool->lock);
+
+    if (pool->is_stopping || pool->queued_jobs >= pool->config.queue_size) {
+        bytebeam_hal_mutex_unlock(pool->lock);
+
+        free(payload_copy);
+        return -1;
+    }
+
+    // there is always a free slot while the queue is not full
+    for (index = 0; index < pool->job_slots; index++) {
+        if (!pool->jobs[index].is_queued && !pool->jobs[index].is_running) {
+            break;
+        }
+    }
+
+    bytebeam_action_job_t *job = &pool->jobs[index];
+
+    if (payload_copy == NULL) {
+        memcpy(job->payload_buffer, payload, payload_len + 1);
+        payload_copy = job->payload_buffer;
+    }
+
+    job->handler = *handler;
+    strcpy(job->name, handler->name);
+    job->handler.name = job->name;
+    snprintf(job->action_id, sizeof(job->action_id), "%s", action_id);
+    job->payload = payload_copy;
+    job->priority = priority;
+    job->max_concurrency = max_concurrency;
+    job->order = pool->next_order++;
+    job->submit_ms = bytebeam_hal_get_uptime_ms();
+    job->is_queued = true;
+    pool->queued_jobs++;
+
+    bytebeam_metrics_gauge(BYTEBEAM_METRIC_ACTION_QUEUE_DEPTH, pool->queued_jobs);
+
+    bytebeam_hal_mutex_unlock(pool->lock);
+
+    bytebeam_hal_semaphore_give(pool->jobs_available);
+
+    return 0;
+}
+
+static void free_action_pool(bytebeam_action_pool_t *pool)
+{
+    int index = 0;
+
+    if (pool->jobs != NULL) {
+        for (index = 0; index < pool->job_slots; index++) {
+            if (pool->jobs[index].payload != pool->jobs[index].payload_buffer) {
+                free(pool->jobs[index].payload);
+            }
+        }
+    }
+
+    if (pool->jobs_available != NULL) {
+        bytebeam_hal_semaphore_delete(pool->jobs_available);
+    }
+
+    if (pool->lock != NULL) {
+        bytebeam_hal_mutex_delete(pool->lock);
+    }
+
+    free(pool->jobs);
+    free(pool);
+}
+
+int bytebeam_action_pool_start(bytebeam_client_t *bytebeam_client)
+{
+    int index = 0;
+    bytebeam_action_pool_config_t config = bytebeam_client->action_pool_cfg;
+
+    if (bytebeam_client->action_pool != NULL) {
+        return 0;
+    }
+
+    config.worker_count = (config.worker_count > 0) ? config.worker_count : BYTEBEAM_ACTION_WORKER_COUNT;
+    config.queue_size = (config.queue_size > 0) ? config.queue_size : BYTEBEAM_ACTION_QUEUE_SIZE;
+    config.worker_stack_size = (config.worker_stack_size > 0) ? config.worker_stack_size : BYTEBEAM_ACTION_WORKER_STACK_SIZE;
+    config.worker_priority = (config.worker_priority > 0) ? config.worker_priority : BYTEBEAM_ACTION_WORKER_PRIORITY;
+
+    bytebeam_action_pool_t *pool = calloc(1, sizeof(bytebeam_action_pool_t));
+
+    if (pool == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for action pool");
+        return -1;
+    }
+
+    pool->bytebeam_client = bytebeam_client;
+    pool->config = config;
+    pool->job_slots = config.queue_size + config.worker_count;
+    pool->jobs = calloc(pool->job_slots, sizeof(bytebeam_action_job_t));
+    pool->lock = bytebeam_hal_mutex_create();
+
+    // room for every queued job plus the wake ups of the finishing jobs
+    pool->jobs_available = bytebeam_hal_semaphore_create(config.queue_size + config.worker_count, 0);
+
+    if (pool->jobs == NULL || pool->lock == NULL || pool->jobs_available == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for action pool");
+
+        free_action_pool(pool);
+        return -1;
+    }
+
+    for (index = 0; index < config.worker_count; index++) {
+        if (bytebeam_hal_task_create("bytebeam_action", action_worker_task, pool, config.worker_stack_size, config.worker_priority) == NULL) {
+            BB_LOGE(TAG, "Failed to create action worker task");
+            break;
+        }
+
+        bytebeam_hal_mutex_lock(pool->lock);
+        pool->alive_workers++;
+        bytebeam_hal_mutex_unlock(pool->lock);
+    }
+
+    bytebeam_client->action_pool = pool;
+
+    if (index < config.worker_count) {
+        bytebeam_action_pool_stop(bytebeam_client);
+        return -1;
+    }
+
+    BB_LOGI(TAG, "Started %d action workers", config.worker_count);
+
+    return 0;
+}
+
+void bytebeam_action_pool_stop(bytebeam_client_t *bytebeam_client)
+{
+    int index = 0;
+    bytebeam_action_pool_t *pool = bytebeam_client->action_pool;
+
+    if (pool == NULL) {
+        return;
+    }
+
+    bytebeam_hal_mutex_lock(pool->lock);
+    pool->is_stopping = true;
+    bytebeam_hal_mutex_unlock(pool->lock);
+
+    for (index = 0; index < pool->config.worker_count; index++) {
+        bytebeam_hal_semaphore_give(pool->jobs_available);
+    }
+
+    // the running actions are let to finish, the queued ones are dropped
+    while (true) {
+        bytebeam_hal_mutex_lock(pool->lock);
+        int alive_workers = pool->alive_workers;
+        bytebeam_hal_mutex_unlock(pool->lock);
+
+        if (alive_workers == 0) {
+            break;
+        }
+
+        bytebeam_hal_delay_ms(10);
+    }
+
+    bytebeam_client->action_pool = NULL;
+    free_action_pool(pool);
+}
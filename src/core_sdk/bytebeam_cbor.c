@@ -0,0 +1,253 @@
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include "bytebeam_cbor.h"
+
+/* Cbor major types, already shifted into the upper 3 bits of the initial byte */
+#define CBOR_MAJOR_UINT         0x00
+#define CBOR_MAJOR_NEGATIVE     0x20
+#define CBOR_MAJOR_TEXT         0x60
+
+#define CBOR_INDEFINITE_ARRAY   0x9F
+#define CBOR_INDEFINITE_MAP     0xBF
+#define CBOR_BREAK              0xFF
+#define CBOR_FALSE              0xF4
+#define CBOR_TRUE               0xF5
+#define CBOR_NULL               0xF6
+#define CBOR_FLOAT32            0xFA
+#define CBOR_FLOAT64            0xFB
+
+static void write_bytes(bytebeam_cbor_writer_t *writer, const void *data, int len)
+{
+    if (writer->overflow) {
+        return;
+    }
+
+    if (writer->length + len > writer->size) {
+        writer->overflow = true;
+        return;
+    }
+
+    memcpy(writer->buffer + writer->length, data, len);
+    writer->length = writer->length + len;
+}
+
+static void write_byte(bytebeam_cbor_writer_t *writer, uint8_t byte)
+{
+    write_bytes(writer, &byte, 1);
+}
+
+/* Writes the initial byte of the major type with the argument in the shortest form, as per the preferred serialization */
+static void write_head(bytebeam_cbor_writer_t *writer, uint8_t major, uint64_t value)
+{
+    uint8_t head[9];
+    int len = 0;
+
+    if (value < 24) {
+        head[0] = major | (uint8_t)value;
+        len = 1;
+    } else if (value <= 0xFF) {
+        head[0] = major | 24;
+        head[1] = (uint8_t)value;
+        len = 2;
+    } else if (value <= 0xFFFF) {
+        head[0] = major | 25;
+        len = 3;
+    } else if (value <= 0xFFFFFFFF) {
+        head[0] = major | 26;
+        len = 5;
+    } else {
+        head[0] = major | 27;
+        len = 9;
+    }
+
+    // the multi byte arguments are big endian
+    if (len > 2) {
+        int index = 0;
+
+        for (index = len - 1; index > 0; index--) {
+            head[index] = (uint8_t)value;
+            value = value >> 8;
+        }
+    }
+
+    write_bytes(writer, head, len);
+}
+
+static void write_text(bytebeam_cbor_writer_t *writer, const char *text)
+{
+    int len = (int)strlen(text);
+
+    write_head(writer, CBOR_MAJOR_TEXT, (uint64_t)len);
+    write_bytes(writer, text, len);
+}
+
+static void write_key(bytebeam_cbor_writer_t *writer, const char *key)
+{
+    if (key != NULL) {
+        write_text(writer, key);
+    }
+}
+
+static bytebeam_err_t writer_status(bytebeam_cbor_writer_t *writer)
+{
+    return writer->overflow ? BB_FAILURE : BB_SUCCESS;
+}
+
+void bytebeam_cbor_writer_init(bytebeam_cbor_writer_t *writer, uint8_t *buffer, int size)
+{
+    writer->buffer = buffer;
+    writer->size = size;
+    writer->length = 0;
+    writer->overflow = (size <= 0);
+}
+
+bytebeam_err_t bytebeam_cbor_begin_map(bytebeam_cbor_writer_t *writer, const char *key)
+{
+    write_key(writer, key);
+    write_byte(writer, CBOR_INDEFINITE_MAP);
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_cbor_end_map(bytebeam_cbor_writer_t *writer)
+{
+    write_byte(writer, CBOR_BREAK);
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_cbor_begin_array(bytebeam_cbor_writer_t *writer, const char *key)
+{
+    write_key(writer, key);
+    write_byte(writer, CBOR_INDEFINITE_ARRAY);
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_cbor_end_array(bytebeam_cbor_writer_t *writer)
+{
+    write_byte(writer, CBOR_BREAK);
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_cbor_add_string(bytebeam_cbor_writer_t *writer, const char *key, const char *value)
+{
+    if (value == NULL) {
+        return bytebeam_cbor_add_null(writer, key);
+    }
+
+    write_key(writer, key);
+    write_text(writer, value);
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_cbor_add_int(bytebeam_cbor_writer_t *writer, const char *key, long long value)
+{
+    write_key(writer, key);
+
+    // a negative integer n is encoded as -1 - n, which also covers the smallest long long without overflow
+    if (value < 0) {
+        write_head(writer, CBOR_MAJOR_NEGATIVE, (uint64_t)(-(value + 1)));
+    } else {
+        write_head(writer, CBOR_MAJOR_UINT, (uint64_t)value);
+    }
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_cbor_add_uint(bytebeam_cbor_writer_t *writer, const char *key, unsigned long long value)
+{
+    write_key(writer, key);
+    write_head(writer, CBOR_MAJOR_UINT, (uint64_t)value);
+
+    return writer_status(writer);
+}
+
+static void write_float32(bytebeam_cbor_writer_t *writer, float value)
+{
+    uint32_t bits = 0;
+    uint8_t out[5];
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    out[0] = CBOR_FLOAT32;
+    out[1] = (uint8_t)(bits >> 24);
+    out[2] = (uint8_t)(bits >> 16);
+    out[3] = (uint8_t)(bits >> 8);
+    out[4] = (uint8_t)bits;
+
+    write_bytes(writer, out, sizeof(out));
+}
+
+bytebeam_err_t bytebeam_cbor_add_double(bytebeam_cbor_writer_t *writer, const char *key, double value)
+{
+    uint64_t bits = 0;
+    uint8_t out[9];
+    int index = 0;
+
+    if (isnan(value) || isinf(value)) {
+        return bytebeam_cbor_add_null(writer, key);
+    }
+
+    write_key(writer, key);
+
+    // most of the sensor values come from floats, those take half the space and lose nothing
+    if (fabs(value) <= FLT_MAX && (double)(float)value == value) {
+        write_float32(writer, (float)value);
+        return writer_status(writer);
+    }
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    out[0] = CBOR_FLOAT64;
+
+    for (index = 8; index > 0; index--) {
+        out[index] = (uint8_t)bits;
+        bits = bits >> 8;
+    }
+
+    write_bytes(writer, out, sizeof(out));
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_cbor_add_float(bytebeam_cbor_writer_t *writer, const char *key, float value)
+{
+    if (isnan(value) || isinf(value)) {
+        return bytebeam_cbor_add_null(writer, key);
+    }
+
+    write_key(writer, key);
+    write_float32(writer, value);
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_cbor_add_bool(bytebeam_cbor_writer_t *writer, const char *key, bool value)
+{
+    write_key(writer, key);
+    write_byte(writer, value ? CBOR_TRUE : CBOR_FALSE);
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_cbor_add_null(bytebeam_cbor_writer_t *writer, const char *key)
+{
+    write_key(writer, key);
+    write_byte(writer, CBOR_NULL);
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_cbor_writer_finish(bytebeam_cbor_writer_t *writer)
+{
+    if (writer == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    return writer_status(writer);
+}
@@ -1,23 +1,22 @@
-#include "cJSON.h"
 #include "bytebeam_hal.h"
+#include "bytebeam_internal.h"
 #include "bytebeam_log.h"
+#include "bytebeam_json.h"
 #include "bytebeam_action.h"
 #include "bytebeam_client.h"
-
-static cJSON *bytebeam_cert_json = NULL;
-static char *bytebeam_device_config_data = NULL;
+#include "bytebeam_offline_queue.h"
 
 static const char *TAG = "BYTEBEAM_CLIENT";
 
-static int read_device_config_file()
+#if !CONFIG_BYTEBEAM_PROVISION_DEVICE_FROM_PARTITION
+static int read_device_config_file(bytebeam_client_t *bytebeam_client)
 {
-    int ret_code = 0;
     char config_fname[100] = "";
 
 #if CONFIG_BYTEBEAM_PROVISION_DEVICE_FROM_SPIFFS
     BB_LOGI(TAG, "SPIFFS file system detected !");
 
-    ret_code = bytebeam_hal_spiffs_mount();
+    int ret_code = bytebeam_hal_spiffs_mount();
 
     if (ret_code != 0)
     {
@@ -31,7 +30,7 @@ static int read_device_config_file()
 #if CONFIG_BYTEBEAM_PROVISION_DEVICE_FROM_FATFS
     BB_LOGI(TAG, "FATFS file system detected !");
 
-    ret_code = bytebeam_hal_fatfs_mount();
+    int ret_code = bytebeam_hal_fatfs_mount();
 
     if(ret_code != 0)
     {
@@ -43,6 +42,12 @@ static int read_device_config_file()
     strcat(config_fname, CONFIG_BYTEBEAM_PROVISIONING_FILENAME);
 #endif
 
+#if CONFIG_BYTEBEAM_PROVISION_DEVICE_FROM_FILE
+    BB_LOGI(TAG, "Provisioning from file !");
+
+    strcat(config_fname, CONFIG_BYTEBEAM_PROVISIONING_FILENAME);
+#endif
+
 #if CONFIG_BYTEBEAM_PROVISION_DEVICE_FROM_LITTLEFS
     BB_LOGI(TAG, "LITTLEFS file system detected !");
 
@@ -69,32 +74,32 @@ static int read_device_config_file()
     if(file_length <= 0)
     {
         BB_LOGE(TAG, "Failed to get device config file size");
+
+        fclose(file);
         return -1;
     }
 
     // dynamically allocate a char array to store the file contents
-    bytebeam_device_config_data = malloc(sizeof(char) * (file_length + 1));
+    char *device_config_data = malloc(sizeof(char) * (file_length + 1));
 
     // if memory allocation fails just log the failure to serial and return :)
-    if(bytebeam_device_config_data == NULL)
+    if(device_config_data == NULL)
     {
         BB_LOGE(TAG, "Failed to allocate the memory for device config file");
+
+        fclose(file);
         return -1;
     }
 
-    int temp_c;
-    int loop_var = 0;
-
-    while ((temp_c = fgetc(file)) != EOF)
-    {
-        bytebeam_device_config_data[loop_var] = temp_c;
-        loop_var++;
-    }
+    // read the whole file in one go, the text mode may still hand back fewer bytes than its size
+    size_t read_length = fread(device_config_data, sizeof(char), file_length, file);
 
-    bytebeam_device_config_data[loop_var] = '\0';
+    device_config_data[read_length] = '\0';
 
     fclose(file);
 
+    bytebeam_client->device_config_data = device_config_data;
+
 #if CONFIG_BYTEBEAM_PROVISION_DEVICE_FROM_SPIFFS
     ret_code =  bytebeam_hal_spiffs_unmount();
 
@@ -111,7 +116,7 @@ static int read_device_config_file()
 #endif
 
 #if CONFIG_BYTEBEAM_PROVISION_DEVICE_FROM_FATFS
-    ret_code =  bytebeam_hal_spiffs_unmount();
+    ret_code =  bytebeam_hal_fatfs_unmount();
 
     if(ret_code != 0)
     {
@@ -124,154 +129,401 @@ static int read_device_config_file()
     return 0;
 }
 
-static int parse_device_config_file(bytebeam_device_config_t *device_cfg)
+/* Returns the unescaped string value of the member, it lives in the device config data */
+static char *get_device_config_string(char *device_config_data, bytebeam_json_token_t *tokens, int token_count, int object, const char *key)
 {
+    int index = bytebeam_json_find(device_config_data, tokens, token_count, object, key);
+
+    if (index == -1) {
+        return NULL;
+    }
+
+    return bytebeam_json_unescape(device_config_data, &tokens[index]);
+}
+
+static int parse_device_config_file(bytebeam_client_t *bytebeam_client)
+{
+    char *device_config_data = bytebeam_client->device_config_data;
+    bytebeam_device_config_t *device_cfg = &(bytebeam_client->device_cfg);
+
     // before going ahead make sure you are parsing something
-    if (bytebeam_device_config_data == NULL) {
+    if (device_config_data == NULL) {
         BB_LOGE(TAG, "device config file is empty");
 
-        free(bytebeam_device_config_data);
         return -1;
     }
 
-    // refer to json file to the device config data
-    const char *json_file = (const char *)bytebeam_device_config_data;
-
-    /*  Do not delete the bytebeam cert json object from memory because we are giving the reference of the certificates to the mqtt
-     *  library (see below), so it needs to be there in the memory. Ofcourse we will delete the json object to release the
-     *  memory and that is handled properly in bytebeam sdk cleanup.
+    /*  Do not free the device config data after parsing because the strings are unescaped in place and we are giving
+     *  the reference of the certificates to the mqtt library (see below), so it needs to be there in the memory.
+     *  Ofcourse we will free it to release the memory and that is handled properly in bytebeam sdk cleanup.
      */
 
-    bytebeam_cert_json = cJSON_Parse(json_file);
+    int token_count = 0;
+    bytebeam_json_token_t *tokens = malloc(BYTEBEAM_DEVICE_CONFIG_JSON_TOKEN_COUNT * sizeof(bytebeam_json_token_t));
+
+    if (tokens == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for parsing device config file");
 
-    if (bytebeam_cert_json == NULL) {
+        return -1;
+    }
+
+    token_count = bytebeam_json_parse(device_config_data, strlen(device_config_data), tokens, BYTEBEAM_DEVICE_CONFIG_JSON_TOKEN_COUNT);
+
+    if (token_count < 1 || tokens[0].type != BYTEBEAM_JSON_OBJECT) {
         BB_LOGE(TAG, "ERROR in parsing the JSON\n");
 
-        free(bytebeam_device_config_data);
+        free(tokens);
         return -1;
     }
 
-    cJSON *prj_id_obj = cJSON_GetObjectItem(bytebeam_cert_json, "project_id");
+    char *prj_id = get_device_config_string(device_config_data, tokens, token_count, 0, "project_id");
 
-    if (!(cJSON_IsString(prj_id_obj) && (prj_id_obj->valuestring != NULL))) {
+    if (prj_id == NULL) {
         BB_LOGE(TAG, "ERROR in getting the project id\n");
 
-        free(bytebeam_device_config_data);
+        free(tokens);
         return -1;
     }
 
     int max_len = BYTEBEAM_PROJECT_ID_STR_LEN;
-    int temp_var = snprintf(device_cfg->project_id, max_len, "%s", prj_id_obj->valuestring);
+    int temp_var = snprintf(device_cfg->project_id, max_len, "%s", prj_id);
 
     if(temp_var >= max_len)
     {   
         BB_LOGE(TAG, "Project Id length exceeded buffer size");
 
-        free(bytebeam_device_config_data);
+        free(tokens);
         return -1;
     }
 
-    cJSON *broker_name_obj = cJSON_GetObjectItem(bytebeam_cert_json, "broker");
+    char *broker_name = get_device_config_string(device_config_data, tokens, token_count, 0, "broker");
 
-    if (!(cJSON_IsString(broker_name_obj) && (broker_name_obj->valuestring != NULL))) {
+    if (broker_name == NULL) {
         BB_LOGE(TAG, "ERROR parsing broker name");
 
-        free(bytebeam_device_config_data);
+        free(tokens);
         return -1;
     }
 
-    cJSON *port_num_obj = cJSON_GetObjectItem(bytebeam_cert_json, "port");
+    double port_num = 0;
+    int port_index = bytebeam_json_find(device_config_data, tokens, token_count, 0, "port");
 
-    if (!(cJSON_IsNumber(port_num_obj))) {
+    if (port_index == -1 || bytebeam_json_get_double(device_config_data, &tokens[port_index], &port_num) != BB_SUCCESS) {
         BB_LOGE(TAG, "ERROR parsing port number.");
 
-        free(bytebeam_device_config_data);
+        free(tokens);
         return -1;
     }
 
-    int port_int = port_num_obj->valuedouble;
+    int port_int = port_num;
 
     max_len = BYTEBEAM_BROKER_URL_STR_LEN;
-    temp_var = snprintf(device_cfg->broker_uri, max_len, "mqtts://%s:%d", broker_name_obj->valuestring, port_int);
+    temp_var = snprintf(device_cfg->broker_uri, max_len, "mqtts://%s:%d", broker_name, port_int);
 
     if(temp_var >= max_len)
     {
         BB_LOGE(TAG, "Broker URL length exceeded buffer size");
 
-        free(bytebeam_device_config_data);
+        free(tokens);
         return -1;
     }
 
-    cJSON *device_id_obj = cJSON_GetObjectItem(bytebeam_cert_json, "device_id");
+    char *device_id = get_device_config_string(device_config_data, tokens, token_count, 0, "device_id");
 
-    if (!(cJSON_IsString(device_id_obj) && (device_id_obj->valuestring != NULL))) {
+    if (device_id == NULL) {
         BB_LOGE(TAG, "ERROR parsing device id\n");
 
-        free(bytebeam_device_config_data);
+        free(tokens);
         return -1;
     }
     
     max_len = BYTEBEAM_DEVICE_ID_STR_LEN;
-    temp_var = snprintf(device_cfg->device_id, max_len, "%s", device_id_obj->valuestring);
+    temp_var = snprintf(device_cfg->device_id, max_len, "%s", device_id);
     
     if(temp_var >= max_len)
     {
         BB_LOGE(TAG, "Device Id length exceeded buffer size");
 
-        free(bytebeam_device_config_data);
+        free(tokens);
         return -1;
     }
 
-    cJSON *auth_obj = cJSON_GetObjectItem(bytebeam_cert_json, "authentication");
+    int auth_index = bytebeam_json_find(device_config_data, tokens, token_count, 0, "authentication");
 
-    if (bytebeam_cert_json == NULL || !(cJSON_IsObject(auth_obj))) {
+    if (auth_index == -1 || tokens[auth_index].type != BYTEBEAM_JSON_OBJECT) {
         BB_LOGE(TAG, "ERROR in parsing the auth JSON\n");
 
-        free(bytebeam_device_config_data);
+        free(tokens);
         return -1;
     }
 
-    cJSON *ca_cert_obj = cJSON_GetObjectItem(auth_obj, "ca_certificate");
+    device_cfg->ca_cert_pem = get_device_config_string(device_config_data, tokens, token_count, auth_index, "ca_certificate");
 
-    if (!(cJSON_IsString(ca_cert_obj) && (ca_cert_obj->valuestring != NULL))) {
+    if (device_cfg->ca_cert_pem == NULL) {
         BB_LOGE(TAG, "ERROR parsing ca certificate\n");
 
-        free(bytebeam_device_config_data);
+        free(tokens);
         return -1;
     }
 
-    device_cfg->ca_cert_pem = (char *)ca_cert_obj->valuestring;
-
-    cJSON *device_cert_obj = cJSON_GetObjectItem(auth_obj, "device_certificate");
+    device_cfg->client_cert_pem = get_device_config_string(device_config_data, tokens, token_count, auth_index, "device_certificate");
 
-    if (!(cJSON_IsString(device_cert_obj) && (device_cert_obj->valuestring != NULL))) {
+    if (device_cfg->client_cert_pem == NULL) {
         BB_LOGE(TAG, "ERROR parsing device certifate\n");
 
-        free(bytebeam_device_config_data);
+        free(tokens);
         return -1;
     }
 
-    device_cfg->client_cert_pem = (char *)device_cert_obj->valuestring;
+    device_cfg->client_key_pem = get_device_config_string(device_config_data, tokens, token_count, auth_index, "device_private_key");
 
-    cJSON *device_private_key_obj = cJSON_GetObjectItem(auth_obj, "device_private_key");
-
-    if (!(cJSON_IsString(device_private_key_obj) && (device_private_key_obj->valuestring != NULL))) {
+    if (device_cfg->client_key_pem == NULL) {
         BB_LOGE(TAG, "ERROR parsing device private key\n");
 
-        free(bytebeam_device_config_data);
+        free(tokens);
+        return -1;
+    }
+
+    free(tokens);
+
+    return 0;
+}
+
+#endif
+
+#if CONFIG_BYTEBEAM_PROVISIONING_CACHE || CONFIG_BYTEBEAM_PROVISION_DEVICE_FROM_PARTITION
+/* A provisioning image is the parsed device config as a header followed by the project id, broker uri, device id,
+ * ca certificate, device certificate and device private key, each of them nul terminated. The provisioning cache and
+ * the provisioning partition both hold one, and the certificates are used right where they are in the image, so
+ * loading it takes no mount, no parse and no copy of the certificates.
+ */
+#define PROVISIONING_IMAGE_MAGIC 0x43504242u
+#define PROVISIONING_IMAGE_VERSION 1
+#define PROVISIONING_IMAGE_STRING_COUNT 6
+
+typedef struct provisioning_image_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t string_count;
+    uint32_t length;
+    uint32_t checksum;
+} provisioning_image_header_t;
+
+static uint32_t get_provisioning_image_checksum(const char *data, uint32_t length)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    uint32_t index = 0;
+    int bit = 0;
+
+    // plain crc32, the image is only checked once per boot so a lookup table is not worth its flash
+    for (index = 0; index < length; index++) {
+        crc ^= (uint8_t)data[index];
+
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+
+    return ~crc;
+}
+
+/* Points the device config into the image, which has to stay around for as long as the client uses it */
+static int parse_provisioning_image(const char *image, int length, bytebeam_device_config_t *device_cfg)
+{
+    int index = 0;
+    provisioning_image_header_t header;
+    const char *strings[PROVISIONING_IMAGE_STRING_COUNT];
+
+    if (length < (int)sizeof(header)) {
+        BB_LOGW(TAG, "Provisioning image is truncated");
+        return -1;
+    }
+
+    memcpy(&header, image, sizeof(header));
+
+    const char *data = image + sizeof(header);
+    const char *data_end = image + length;
+
+    // the image may be followed by the erased flash of its partition, so it only has to fit
+    if (header.magic != PROVISIONING_IMAGE_MAGIC || header.version != PROVISIONING_IMAGE_VERSION ||
+        header.string_count != PROVISIONING_IMAGE_STRING_COUNT || header.length > (uint32_t)(length - sizeof(header)) ||
+        header.checksum != get_provisioning_image_checksum(data, header.length)) {
+        BB_LOGW(TAG, "Provisioning image is invalid");
+        return -1;
+    }
+
+    data_end = data + header.length;
+
+    for (index = 0; index < PROVISIONING_IMAGE_STRING_COUNT; index++) {
+        const char *string_end = memchr(data, '\0', data_end - data);
+
+        if (string_end == NULL) {
+            BB_LOGW(TAG, "Provisioning image is invalid");
+            return -1;
+        }
+
+        strings[index] = data;
+        data = string_end + 1;
+    }
+
+    // the ids went in from these very buffers, but an image from a build with other buffer sizes may not fit
+    if (snprintf(device_cfg->project_id, sizeof(device_cfg->project_id), "%s", strings[0]) >= (int)sizeof(device_cfg->project_id) ||
+        snprintf(device_cfg->broker_uri, sizeof(device_cfg->broker_uri), "%s", strings[1]) >= (int)sizeof(device_cfg->broker_uri) ||
+        snprintf(device_cfg->device_id, sizeof(device_cfg->device_id), "%s", strings[2]) >= (int)sizeof(device_cfg->device_id)) {
+        BB_LOGW(TAG, "Provisioning image exceeded buffer size");
+        return -1;
+    }
+
+    // the mqtt client takes the certificates as const, so they may as well live in read only flash
+    device_cfg->ca_cert_pem = (char *)strings[3];
+    device_cfg->client_cert_pem = (char *)strings[4];
+    device_cfg->client_key_pem = (char *)strings[5];
+
+    return 0;
+}
+#endif
+
+#if CONFIG_BYTEBEAM_PROVISION_DEVICE_FROM_PARTITION
+static int map_provisioning_partition(bytebeam_device_config_t *device_cfg)
+{
+    int length = 0;
+    const char *image = bytebeam_hal_provisioning_partition_map(&length);
+
+    if (image == NULL) {
+        BB_LOGE(TAG, "Failed to map provisioning partition");
+        return -1;
+    }
+
+    if (parse_provisioning_image(image, length, device_cfg) != 0) {
+        bytebeam_hal_provisioning_partition_unmap();
+        return -1;
+    }
+
+    BB_LOGI(TAG, "Using provisioning partition !");
+
+    return 0;
+}
+#endif
+
+#if CONFIG_BYTEBEAM_PROVISIONING_CACHE
+static int load_provisioning_cache(bytebeam_client_t *bytebeam_client)
+{
+    int length = 0;
+    char *blob = bytebeam_hal_provisioning_cache_load(&length);
+
+    if (blob == NULL) {
+        BB_LOGI(TAG, "No provisioning cache found");
+        return -1;
+    }
+
+    if (parse_provisioning_image(blob, length, &(bytebeam_client->device_cfg)) != 0) {
+        free(blob);
+        return -1;
+    }
+
+    // the certificates point into the cache, so it takes the place of the device config data
+    bytebeam_client->device_config_data = blob;
+
+    BB_LOGI(TAG, "Using provisioning cache !");
+
+    return 0;
+}
+
+static void save_provisioning_cache(const bytebeam_device_config_t *device_cfg)
+{
+    int index = 0;
+    uint32_t length = 0;
+    provisioning_image_header_t header;
+    const char *strings[PROVISIONING_IMAGE_STRING_COUNT] = {
+        device_cfg->project_id,
+        device_cfg->broker_uri,
+        device_cfg->device_id,
+        device_cfg->ca_cert_pem,
+        device_cfg->client_cert_pem,
+        device_cfg->client_key_pem,
+    };
+
+    for (index = 0; index < PROVISIONING_IMAGE_STRING_COUNT; index++) {
+        length += strlen(strings[index]) + 1;
+    }
+
+    char *blob = malloc(sizeof(header) + length);
+
+    if (blob == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for provisioning cache");
+        return;
+    }
+
+    char *data = blob + sizeof(header);
+
+    for (index = 0; index < PROVISIONING_IMAGE_STRING_COUNT; index++) {
+        int string_len = strlen(strings[index]) + 1;
+
+        memcpy(data, strings[index], string_len);
+        data += string_len;
+    }
+
+    header.magic = PROVISIONING_IMAGE_MAGIC;
+    header.version = PROVISIONING_IMAGE_VERSION;
+    header.string_count = PROVISIONING_IMAGE_STRING_COUNT;
+    header.length = length;
+    header.checksum = get_provisioning_image_checksum(blob + sizeof(header), length);
+
+    memcpy(blob, &header, sizeof(header));
+
+    // the next boot just parses the file again if this fails, so there is nothing more to do about it
+    if (bytebeam_hal_provisioning_cache_save(blob, sizeof(header) + length) == 0) {
+        BB_LOGI(TAG, "Provisioning cache saved");
+    }
+
+    free(blob);
+}
+#endif
+
+static int load_device_config(bytebeam_client_t *bytebeam_client)
+{
+#if CONFIG_BYTEBEAM_PROVISION_DEVICE_FROM_PARTITION
+    // the device config is used straight from the flash, there is nothing to read, parse or cache
+    return map_provisioning_partition(&(bytebeam_client->device_cfg));
+#else
+#if CONFIG_BYTEBEAM_PROVISIONING_CACHE
+    // a warm boot takes the device config parsed on an earlier boot and skips the file system altogether
+    if (load_provisioning_cache(bytebeam_client) == 0) {
+        return 0;
+    }
+#endif
+
+    // read the device config json stored in file system
+    if (read_device_config_file(bytebeam_client) != 0) {
+        BB_LOGE(TAG, "Error in reading device config JSON");
         return -1;
     }
 
-    device_cfg->client_key_pem = (char *)device_private_key_obj->valuestring;
+    // parse the device config json readed from the file system
+    if (parse_device_config_file(bytebeam_client) != 0) {
+        BB_LOGE(TAG, "Error in parsing device config JSON");
+        return -1;
+    }
 
-    free(bytebeam_device_config_data);
-    bytebeam_device_config_data = NULL;
+#if CONFIG_BYTEBEAM_PROVISIONING_CACHE
+    save_provisioning_cache(&(bytebeam_client->device_cfg));
+#endif
 
     return 0;
+#endif
 }
 
 static void set_mqtt_conf(bytebeam_device_config_t *device_cfg, bytebeam_client_config_t *mqtt_cfg)
 {
+#ifdef CONFIG_SDK_PLATFORM_LINUX
+    // the linux mqtt client takes the same settings, just in its own flat config
+    mqtt_cfg->uri = device_cfg->broker_uri;
+    mqtt_cfg->cert_pem = (const char *)device_cfg->ca_cert_pem;
+    mqtt_cfg->client_cert_pem = (const char *)device_cfg->client_cert_pem;
+    mqtt_cfg->client_key_pem = (const char *)device_cfg->client_key_pem;
+    mqtt_cfg->client_id = device_cfg->device_id;
+    BB_LOGI(TAG, "The uri  is: %s\n", mqtt_cfg->uri);
+#else
     // set the broker uri
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
     mqtt_cfg->broker.address.uri = device_cfg->broker_uri;
@@ -301,6 +553,18 @@ static void set_mqtt_conf(bytebeam_device_config_t *device_cfg, bytebeam_client_
 #else
     mqtt_cfg->client_key_pem = (const char *)device_cfg->client_key_pem;
 #endif
+#endif
+}
+
+static void set_mqtt_session_conf(bool is_persistent, bytebeam_client_config_t *mqtt_cfg)
+{
+#ifdef CONFIG_SDK_PLATFORM_LINUX
+    mqtt_cfg->disable_clean_session = is_persistent;
+#elif ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    mqtt_cfg->session.disable_clean_session = is_persistent;
+#else
+    mqtt_cfg->disable_clean_session = is_persistent;
+#endif
 }
 
 static void bytebeam_sdk_cleanup(bytebeam_client_t *bytebeam_client)
@@ -311,6 +575,11 @@ static void bytebeam_sdk_cleanup(bytebeam_client_t *bytebeam_client)
 
     BB_LOGD(TAG, "Cleaning Up Bytebeam SDK");
 
+#if CONFIG_BYTEBEAM_PROVISION_DEVICE_FROM_PARTITION
+    // only the clients which loaded their device config hold a mapping of the provisioning partition
+    bool is_partition_mapped = !bytebeam_client->use_device_config_data && bytebeam_client->device_cfg.ca_cert_pem != NULL;
+#endif
+
     // clearing bytebeam device configuration
     bytebeam_client->device_cfg.ca_cert_pem = NULL;
     bytebeam_client->device_cfg.client_cert_pem = NULL;
@@ -328,24 +597,41 @@ static void bytebeam_sdk_cleanup(bytebeam_client_t *bytebeam_client)
     // clearing bytebeam action functions array
     bytebeam_reset_action_handler_array(bytebeam_client);
 
+    // clearing the sdk metrics client, the metrics themselves count on across the clients
+    bytebeam_metrics_client_clear(bytebeam_client);
+
+    // clearing the device shadow, this stops its heartbeat
+    bytebeam_shadow_free(bytebeam_client);
+
+    // clearing the delivery tracking, the publishes still in flight are reported as timed out
+    bytebeam_delivery_free(bytebeam_client);
+
+    // clearing the cached stream topics, this invalidates the stream handles
+    bytebeam_stream_topics_free(bytebeam_client);
+
     // clearing bytebeam connection status
     bytebeam_client->connection_status = 0;
 
     // clearing OTA action id
-    ota_action_id = NULL;
+    bytebeam_client->ota_action_id = NULL;
 
-    // clearing bytebeam log client
-    bytebeam_log_client_set(NULL);
+    // clearing bytebeam log client, if the logs went out through this client, and the cloud logging state
+    bytebeam_log_client_clear(bytebeam_client);
+    bytebeam_log_free(bytebeam_client);
 
-    // clearing bytebeam log level
-    bytebeam_log_level_set(BYTEBEAM_LOG_LEVEL_INFO);
+    // clearing device config data holding the certificates
+    if(bytebeam_client->device_config_data != NULL) {
+        free(bytebeam_client->device_config_data);
+        bytebeam_client->device_config_data = NULL;
+        BB_LOGD(TAG, "Device config data freed");
+    }
 
-    // clearing certifciate json object
-    if(bytebeam_cert_json != NULL) {
-        cJSON_Delete(bytebeam_cert_json);
-        bytebeam_cert_json = NULL;
-        BB_LOGD(TAG, "Certificate JSON object deleted");
+#if CONFIG_BYTEBEAM_PROVISION_DEVICE_FROM_PARTITION
+    // unmapping the provisioning partition holding the certificates
+    if (is_partition_mapped) {
+        bytebeam_hal_provisioning_partition_unmap();
     }
+#endif
     
     BB_LOGD(TAG, "Bytebeam SDK Cleanup done !!");
 }
@@ -361,22 +647,10 @@ bytebeam_err_t bytebeam_init(bytebeam_client_t *bytebeam_client)
 
     // check-in the device config data from file system if in case not provided 
     if (bytebeam_client->use_device_config_data == false) {
-        // read the device config json stored in file system
-        ret_val = read_device_config_file();
-
-        if(ret_val != 0) {
-            BB_LOGE(TAG, "Error in reading device config JSON");
-
-            /* This call will clear all the bytebeam sdk variables so to avoid any memory leaks further */
-            bytebeam_sdk_cleanup(bytebeam_client);
-            return BB_FAILURE;
-        }
-
-        // parse the device config json readed from the file system
-        ret_val = parse_device_config_file(&(bytebeam_client->device_cfg));
+        ret_val = load_device_config(bytebeam_client);
 
         if (ret_val != 0) {
-            BB_LOGE(TAG, "Error in parsing device config JSON");
+            BB_LOGE(TAG, "Error in loading device config");
 
             /* This call will clear all the bytebeam sdk variables so to avoid any memory leaks further */
             bytebeam_sdk_cleanup(bytebeam_client);
@@ -389,6 +663,18 @@ bytebeam_err_t bytebeam_init(bytebeam_client_t *bytebeam_client)
     // set the mqtt configurations
     set_mqtt_conf(&(bytebeam_client->device_cfg), &(bytebeam_client->mqtt_cfg));
 
+    // in sleep cycle mode the broker keeps the session, so the action subscription outlives the deep sleep
+    set_mqtt_session_conf(bytebeam_client->sleep_cycle_cfg.is_enabled, &(bytebeam_client->mqtt_cfg));
+    bytebeam_sleep_cycle_on_init(bytebeam_client);
+
+    // every publish needs a topic, so there is no client without the topic cache
+    if (bytebeam_stream_topics_start(bytebeam_client) != 0) {
+        BB_LOGE(TAG, "Error in starting bytebeam stream topic cache");
+
+        bytebeam_sdk_cleanup(bytebeam_client);
+        return BB_FAILURE;
+    }
+
     // initialize the bytebeam hal layer
     ret_val = bytebeam_hal_init(bytebeam_client);
 
@@ -400,8 +686,33 @@ bytebeam_err_t bytebeam_init(bytebeam_client_t *bytebeam_client)
         return BB_FAILURE;
     }
 
-    bytebeam_log_client_set(bytebeam_client);
-    bytebeam_log_level_set(BYTEBEAM_LOG_LEVEL_INFO);
+    // the client still connects without the cloud logging, it just never publishes any logs
+    if (bytebeam_log_start(bytebeam_client) != 0) {
+        BB_LOGE(TAG, "Error in starting bytebeam cloud logging");
+    }
+
+    // the bytebeam_log_* apis go through the first client, the other clients of a gateway log through their own handle
+    bytebeam_log_client_claim(bytebeam_client);
+
+    // actions are still handled without the workers, just inline from the mqtt task
+    if (bytebeam_action_pool_start(bytebeam_client) != 0) {
+        BB_LOGE(TAG, "Error in starting bytebeam action workers");
+    }
+
+    // the client still connects without the shadow, it just never publishes the device heartbeat
+    if (bytebeam_shadow_start(bytebeam_client) != 0) {
+        BB_LOGE(TAG, "Error in starting bytebeam device shadow");
+    }
+
+    // stream publishes still work without the delivery tracking, just without the callbacks and the statistics
+    if (bytebeam_delivery_start(bytebeam_client) != 0) {
+        BB_LOGE(TAG, "Error in starting bytebeam delivery tracking");
+    }
+
+    // cloud logs still work without the flusher, just synchronously from the caller's task
+    if (bytebeam_log_flusher_start(bytebeam_client) != 0) {
+        BB_LOGE(TAG, "Error in starting bytebeam log flusher");
+    }
 
     BB_LOGI(TAG, "Bytebeam Client Initialized !!");
 
@@ -457,6 +768,16 @@ bytebeam_err_t bytebeam_destroy(bytebeam_client_t *bytebeam_client)
         return BB_NULL_CHECK_FAILURE;
     }
 
+    // let the running actions finish while the mqtt client is still around
+    bytebeam_action_pool_stop(bytebeam_client);
+
+    // the flusher carries on for the other clients, so this one leaves it before its mqtt client goes away
+    bytebeam_shadow_stop(bytebeam_client);
+    bytebeam_metrics_client_clear(bytebeam_client);
+
+    // publish the buffered logs while the mqtt client is still around
+    bytebeam_log_flusher_stop(bytebeam_client);
+
     ret_val = bytebeam_hal_destroy(bytebeam_client);
 
     if (ret_val != 0) {
@@ -464,10 +785,27 @@ bytebeam_err_t bytebeam_destroy(bytebeam_client_t *bytebeam_client)
         return BB_FAILURE;
     }
 
+    // release the offline queue, the queued records stay on the file system for the next time
+    bytebeam_offline_queue_disable(bytebeam_client);
+
     /* This call will clearing all the bytebeam sdk variables so to avoid any memory leaks further */
     bytebeam_sdk_cleanup(bytebeam_client);
 
     BB_LOGI(TAG, "Bytebeam Client destroyed !!");
 
     return BB_SUCCESS;
-}
\ No newline at end of file
+}
+
+bytebeam_err_t bytebeam_clear_provisioning_cache(void)
+{
+    int ret_val = bytebeam_hal_provisioning_cache_erase();
+
+    if (ret_val != 0) {
+        BB_LOGE(TAG, "Failed to clear provisioning cache");
+        return BB_FAILURE;
+    }
+
+    BB_LOGI(TAG, "Provisioning cache cleared");
+
+    return BB_SUCCESS;
+}
@@ -0,0 +1,295 @@
+#include <string.h>
+#include "bytebeam_hal.h"
+#include "bytebeam_columnar.h"
+
+/* Flag of the header telling the timestamps are implied by the fixed sample period */
+#define COLUMNAR_FLAG_FIXED_PERIOD 0x01
+
+/* Length of the sample count, base timestamp and period fields at the end of the header */
+#define COLUMNAR_HEADER_TAIL_LEN (4 + 8 + 4)
+
+/* Marks the xor window of a float column as not yet set */
+#define COLUMNAR_NO_WINDOW 0xFF
+
+static const char *TAG = "BYTEBEAM_COLUMNAR";
+
+static void put_le(uint8_t *out, uint64_t value, int len)
+{
+    int index = 0;
+
+    for (index = 0; index < len; index++) {
+        out[index] = (uint8_t)(value >> (8 * index));
+    }
+}
+
+/* Writes the low count bits of the value most significant bit first, returns -1 if they do not fit in the buffer */
+static int write_bits(bytebeam_columnar_encoder_t *encoder, uint64_t value, int count)
+{
+    if (encoder->bit_length + count > encoder->size * 8) {
+        return -1;
+    }
+
+    while (count > 0) {
+        int byte = encoder->bit_length >> 3;
+        int free_bits = 8 - (encoder->bit_length & 7);
+        int len = (count < free_bits) ? count : free_bits;
+        uint8_t chunk = (uint8_t)((value >> (count - len)) & ((1u << len) - 1));
+
+        // the bytes are cleared as the bit stream reaches them, so a rolled back append leaves no stale bits behind
+        if (free_bits == 8) {
+            encoder->buffer[byte] = 0;
+        }
+
+        encoder->buffer[byte] = encoder->buffer[byte] | (uint8_t)(chunk << (free_bits - len));
+        encoder->bit_length = encoder->bit_length + len;
+        count = count - len;
+    }
+
+    return 0;
+}
+
+/* Writes the delta of delta code of the value, the deltas are taken modulo 2^64 */
+static int write_dod(bytebeam_columnar_encoder_t *encoder, bytebeam_columnar_state_t *state, uint64_t value)
+{
+    uint64_t delta = value - state->previous;
+    int64_t dod = (int64_t)(delta - state->previous_delta);
+    int ret_val = 0;
+
+    if (dod == 0) {
+        ret_val = write_bits(encoder, 0x0, 1);
+    } else if (dod >= -64 && dod <= 63) {
+        ret_val = write_bits(encoder, 0x2, 2) | write_bits(encoder, (uint64_t)dod, 7);
+    } else if (dod >= -256 && dod <= 255) {
+        ret_val = write_bits(encoder, 0x6, 3) | write_bits(encoder, (uint64_t)dod, 9);
+    } else if (dod >= -2048 && dod <= 2047) {
+        ret_val = write_bits(encoder, 0xE, 4) | write_bits(encoder, (uint64_t)dod, 12);
+    } else {
+        ret_val = write_bits(encoder, 0xF, 4) | write_bits(encoder, (uint64_t)dod, 64);
+    }
+
+    state->previous = value;
+    state->previous_delta = delta;
+
+    return ret_val;
+}
+
+static int count_leading_zeros(uint64_t value)
+{
+    return __builtin_clzll(value);
+}
+
+static int count_trailing_zeros(uint64_t value)
+{
+    return __builtin_ctzll(value);
+}
+
+/* Writes the xor of the value with the previous one, reusing the previous window of meaningful bits when it fits */
+static int write_xor(bytebeam_columnar_encoder_t *encoder, bytebeam_columnar_state_t *state, uint64_t value)
+{
+    uint64_t xor = value ^ state->previous;
+
+    state->previous = value;
+
+    if (xor == 0) {
+        return write_bits(encoder, 0x0, 1);
+    }
+
+    int leading = count_leading_zeros(xor);
+    int trailing = count_trailing_zeros(xor);
+
+    // the leading zeros get 5 bits, the rest of them go into the meaningful bits
+    if (leading > 31) {
+        leading = 31;
+    }
+
+    if (state->leading != COLUMNAR_NO_WINDOW && leading >= state->leading && trailing >= state->trailing) {
+        int meaningful = 64 - state->leading - state->trailing;
+
+        return write_bits(encoder, 0x2, 2) | write_bits(encoder, xor >> state->trailing, meaningful);
+    }
+
+    int meaningful = 64 - leading - trailing;
+
+    state->leading = (uint8_t)leading;
+    state->trailing = (uint8_t)trailing;
+
+    return write_bits(encoder, 0x3, 2) |
+           write_bits(encoder, (uint64_t)leading, 5) |
+           write_bits(encoder, (uint64_t)(meaningful & 0x3F), 6) |
+           write_bits(encoder, xor >> trailing, meaningful);
+}
+
+static uint64_t value_bits(bytebeam_columnar_type_t type, double value)
+{
+    uint64_t bits = 0;
+
+    if (type == BYTEBEAM_COLUMNAR_FLOAT) {
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    // saturate the out of range values, NaN included, as converting them to an integer is undefined
+    if (!(value > -9223372036854775808.0)) {
+        return (uint64_t)INT64_MIN;
+    }
+
+    if (value >= 9223372036854775808.0) {
+        return (uint64_t)INT64_MAX;
+    }
+
+    return (uint64_t)(int64_t)value;
+}
+
+bytebeam_err_t bytebeam_columnar_init(bytebeam_columnar_encoder_t *encoder, uint8_t *buffer, int size, const bytebeam_columnar_column_t *columns, int column_count, uint32_t period_ms)
+{
+    if (encoder == NULL || buffer == NULL || columns == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (column_count < 1 || column_count > BYTEBEAM_COLUMNAR_MAX_COLUMNS) {
+        BB_LOGE(TAG, "Invalid columnar batch column count %d", column_count);
+        return BB_FAILURE;
+    }
+
+    int index = 0;
+    int length = 3 + COLUMNAR_HEADER_TAIL_LEN;
+
+    for (index = 0; index < column_count; index++) {
+        int name_len = (columns[index].name != NULL) ? (int)strlen(columns[index].name) : 0;
+
+        if (name_len == 0 || name_len > BYTEBEAM_COLUMNAR_COLUMN_NAME_LEN ||
+            (columns[index].type != BYTEBEAM_COLUMNAR_FLOAT && columns[index].type != BYTEBEAM_COLUMNAR_INT)) {
+            BB_LOGE(TAG, "Invalid columnar batch column %d", index);
+            return BB_FAILURE;
+        }
+
+        length = length + 1 + name_len + 1;
+    }
+
+    if (length > size) {
+        BB_LOGE(TAG, "Columnar batch header size exceeded buffer size");
+        return BB_FAILURE;
+    }
+
+    memset(encoder, 0x00, sizeof(bytebeam_columnar_encoder_t));
+
+    encoder->buffer = buffer;
+    encoder->size = size;
+    encoder->column_count = column_count;
+    encoder->period_ms = period_ms;
+
+    length = 0;
+    buffer[length++] = BYTEBEAM_COLUMNAR_FORMAT_VERSION;
+    buffer[length++] = (period_ms != 0) ? COLUMNAR_FLAG_FIXED_PERIOD : 0;
+    buffer[length++] = (uint8_t)column_count;
+
+    for (index = 0; index < column_count; index++) {
+        int name_len = (int)strlen(columns[index].name);
+
+        buffer[length++] = (uint8_t)name_len;
+        memcpy(buffer + length, columns[index].name, name_len);
+        length = length + name_len;
+        buffer[length++] = (uint8_t)columns[index].type;
+
+        encoder->types[index] = columns[index].type;
+    }
+
+    // the sample count and the base timestamp are filled in later
+    memset(buffer + length, 0x00, COLUMNAR_HEADER_TAIL_LEN);
+    put_le(buffer + length + 12, period_ms, 4);
+
+    encoder->header_length = length + COLUMNAR_HEADER_TAIL_LEN;
+
+    bytebeam_columnar_reset(encoder);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_columnar_append(bytebeam_columnar_encoder_t *encoder, unsigned long long timestamp, const double *values)
+{
+    if (encoder == NULL || values == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    int index = 0;
+    int ret_val = 0;
+    int bit_length = encoder->bit_length;
+    bytebeam_columnar_state_t timestamp_state = encoder->timestamp;
+    bytebeam_columnar_state_t column_states[BYTEBEAM_COLUMNAR_MAX_COLUMNS];
+
+    memcpy(column_states, encoder->columns, encoder->column_count * sizeof(bytebeam_columnar_state_t));
+
+    if (encoder->sample_count == 0) {
+        put_le(encoder->buffer + encoder->header_length - 12, timestamp, 8);
+
+        encoder->timestamp.previous = timestamp;
+
+        for (index = 0; index < encoder->column_count; index++) {
+            uint64_t bits = value_bits(encoder->types[index], values[index]);
+
+            encoder->columns[index].previous = bits;
+            ret_val = ret_val | write_bits(encoder, bits, 64);
+        }
+    } else {
+        if (encoder->period_ms == 0) {
+            ret_val = write_dod(encoder, &encoder->timestamp, timestamp);
+        }
+
+        for (index = 0; index < encoder->column_count && ret_val == 0; index++) {
+            uint64_t bits = value_bits(encoder->types[index], values[index]);
+
+            if (encoder->types[index] == BYTEBEAM_COLUMNAR_FLOAT) {
+                ret_val = write_xor(encoder, &encoder->columns[index], bits);
+            } else {
+                ret_val = write_dod(encoder, &encoder->columns[index], bits);
+            }
+        }
+    }
+
+    if (ret_val != 0) {
+        // roll back to the state before the sample, clearing the bits it left in the last byte
+        encoder->bit_length = bit_length;
+        encoder->timestamp = timestamp_state;
+        memcpy(encoder->columns, column_states, encoder->column_count * sizeof(bytebeam_columnar_state_t));
+
+        if (bit_length & 7) {
+            encoder->buffer[bit_length >> 3] &= (uint8_t)(0xFF << (8 - (bit_length & 7)));
+        }
+
+        return BB_FAILURE;
+    }
+
+    encoder->sample_count++;
+
+    return BB_SUCCESS;
+}
+
+int bytebeam_columnar_finish(bytebeam_columnar_encoder_t *encoder)
+{
+    if (encoder == NULL)
+    {
+        return -1;
+    }
+
+    put_le(encoder->buffer + encoder->header_length - COLUMNAR_HEADER_TAIL_LEN, (uint64_t)encoder->sample_count, 4);
+
+    // the unused bits of the last byte are always zero, so the padding is already in place
+    return (encoder->bit_length + 7) / 8;
+}
+
+void bytebeam_columnar_reset(bytebeam_columnar_encoder_t *encoder)
+{
+    int index = 0;
+
+    encoder->bit_length = encoder->header_length * 8;
+    encoder->sample_count = 0;
+
+    memset(&encoder->timestamp, 0x00, sizeof(bytebeam_columnar_state_t));
+    memset(encoder->columns, 0x00, sizeof(encoder->columns));
+
+    for (index = 0; index < encoder->column_count; index++) {
+        encoder->columns[index].leading = COLUMNAR_NO_WINDOW;
+    }
+}
@@ -0,0 +1,391 @@
+#include <stdlib.h>
+#include <string.h>
+#include "bytebeam_hal.h"
+#include "bytebeam_internal.h"
+#include "bytebeam_delivery.h"
+
+/*This macro is used to specify the number of acknowledgements remembered while their publish is not yet in the table*/
+#define DELIVERY_MAX_EARLY_ACKS 8
+
+typedef enum {
+    DELIVERY_SLOT_FREE,
+    DELIVERY_SLOT_PENDING,
+    DELIVERY_SLOT_INFLIGHT,
+} delivery_slot_state_t;
+
+typedef struct bytebeam_delivery_slot {
+    delivery_slot_state_t state;
+    int msg_id;
+    long long publish_ms;
+    bytebeam_delivery_cb_t callback;
+    void *callback_arg;
+} bytebeam_delivery_slot_t;
+
+typedef struct bytebeam_delivery_ack {
+    int msg_id;
+    long long ack_ms;
+} bytebeam_delivery_ack_t;
+
+/* In-flight table of the stream publishes. A slot is reserved before the publish and gets its msg_id after it, the
+ * lock is not held across the publish as the mqtt client takes its own lock there. The broker can acknowledge the
+ * publish before its msg_id makes it into the table, such acknowledgements wait in the early acks ring. The table is
+ * small, so the lookups by msg_id just scan it.
+ */
+typedef struct bytebeam_delivery {
+    bytebeam_hal_mutex_t lock;
+    bytebeam_delivery_slot_t slots[BYTEBEAM_DELIVERY_MAX_INFLIGHT];
+    bytebeam_delivery_ack_t early_acks[DELIVERY_MAX_EARLY_ACKS];
+    int next_early_ack;
+    bytebeam_delivery_stats_t stats;
+} bytebeam_delivery_t;
+
+static const int latency_bucket_ms[BYTEBEAM_DELIVERY_LATENCY_BUCKETS] = {
+    10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 30000, -1
+};
+
+static const char *TAG = "BYTEBEAM_DELIVERY";
+
+static void reset_stats(bytebeam_delivery_t *delivery)
+{
+    unsigned int inflight = delivery->stats.inflight;
+
+    memset(&delivery->stats, 0x00, sizeof(bytebeam_delivery_stats_t));
+    memcpy(delivery->stats.latency_bucket_ms, latency_bucket_ms, sizeof(latency_bucket_ms));
+
+    delivery->stats.inflight = inflight;
+}
+
+static void record_latency(bytebeam_delivery_stats_t *stats, long long latency_ms)
+{
+    int bucket = 0;
+
+    if (stats->acked == 0 || latency_ms < stats->latency_min_ms) {
+        stats->latency_min_ms = latency_ms;
+    }
+
+    if (latency_ms > stats->latency_max_ms) {
+        stats->latency_max_ms = latency_ms;
+    }
+
+    stats->acked++;
+    stats->latency_sum_ms = stats->latency_sum_ms + latency_ms;
+
+    while (latency_bucket_ms[bucket] != -1 && latency_ms > latency_bucket_ms[bucket]) {
+        bucket++;
+    }
+
+    stats->latency_histogram[bucket]++;
+}
+
+/* Frees the slot and accounts its outcome, the caller holds the lock and calls the callback after releasing it */
+static void complete_slot(bytebeam_delivery_t *delivery, bytebeam_delivery_slot_t *slot, bytebeam_delivery_status_t status, long long now, bytebeam_delivery_slot_t *completed)
+{
+    long long latency_ms = now - slot->publish_ms;
+
+    if (status == BYTEBEAM_DELIVERY_ACKED) {
+        record_latency(&delivery->stats, latency_ms);
+    } else {
+        delivery->stats.timed_out++;
+    }
+
+    delivery->stats.inflight--;
+
+    *completed = *slot;
+    completed->publish_ms = latency_ms;
+
+    slot->state = DELIVERY_SLOT_FREE;
+    slot->callback = NULL;
+    slot->callback_arg = NULL;
+}
+
+static void notify_completed(bytebeam_client_t *bytebeam_client, bytebeam_delivery_slot_t *completed, bytebeam_delivery_status_t status)
+{
+    if (status == BYTEBEAM_DELIVERY_TIMEOUT) {
+        BB_LOGW(TAG, "Publish msg_id=%d was not acknowledged in %lld ms", completed->msg_id, completed->publish_ms);
+    }
+
+    if (completed->callback != NULL) {
+        completed->callback(bytebeam_client, completed->msg_id, status, completed->publish_ms, completed->callback_arg);
+    }
+}
+
+/* Reports the timed out publishes one at a time, so that no callback is called with the lock held */
+static void expire_slots(bytebeam_client_t *bytebeam_client, bool expire_all)
+{
+    bytebeam_delivery_t *delivery = bytebeam_client->delivery;
+    bytebeam_delivery_slot_t completed;
+
+    while (true) {
+        int index = 0;
+        bool found = false;
+        long long now = bytebeam_hal_get_uptime_ms();
+
+        bytebeam_hal_mutex_lock(delivery->lock);
+
+        for (index = 0; index < BYTEBEAM_DELIVERY_MAX_INFLIGHT; index++) {
+            bytebeam_delivery_slot_t *slot = &delivery->slots[index];
+
+            if (slot->state != DELIVERY_SLOT_INFLIGHT) {
+                continue;
+            }
+
+            if (expire_all || now - slot->publish_ms >= BYTEBEAM_DELIVERY_TIMEOUT_MS) {
+                complete_slot(delivery, slot, BYTEBEAM_DELIVERY_TIMEOUT, now, &completed);
+                found = true;
+                break;
+            }
+        }
+
+        bytebeam_hal_mutex_unlock(delivery->lock);
+
+        if (!found) {
+            break;
+        }
+
+        notify_completed(bytebeam_client, &completed, BYTEBEAM_DELIVERY_TIMEOUT);
+    }
+}
+
+int bytebeam_delivery_start(bytebeam_client_t *bytebeam_client)
+{
+    if (bytebeam_client->delivery != NULL) {
+        return 0;
+    }
+
+    bytebeam_delivery_t *delivery = calloc(1, sizeof(bytebeam_delivery_t));
+
+    if (delivery == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for delivery tracking");
+        return -1;
+    }
+
+    delivery->lock = bytebeam_hal_mutex_create();
+
+    if (delivery->lock == NULL) {
+        BB_LOGE(TAG, "Failed to create the delivery tracking lock");
+
+        free(delivery);
+        return -1;
+    }
+
+    reset_stats(delivery);
+
+    bytebeam_client->delivery = delivery;
+
+    return 0;
+}
+
+void bytebeam_delivery_free(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_delivery_t *delivery = bytebeam_client->delivery;
+
+    if (delivery == NULL) {
+        return;
+    }
+
+    // the callers may be holding buffers for the publishes, so let them know these are never going to be acknowledged
+    expire_slots(bytebeam_client, true);
+
+    bytebeam_hal_mutex_delete(delivery->lock);
+    free(delivery);
+
+    bytebeam_client->delivery = NULL;
+}
+
+int bytebeam_delivery_reserve(bytebeam_client_t *bytebeam_client, bytebeam_delivery_cb_t callback, void *callback_arg)
+{
+    int index = 0;
+    int reserved = -1;
+    bytebeam_delivery_t *delivery = bytebeam_client->delivery;
+
+    if (delivery == NULL) {
+        return -1;
+    }
+
+    expire_slots(bytebeam_client, false);
+
+    bytebeam_hal_mutex_lock(delivery->lock);
+
+    for (index = 0; index < BYTEBEAM_DELIVERY_MAX_INFLIGHT; index++) {
+        bytebeam_delivery_slot_t *slot = &delivery->slots[index];
+
+        if (slot->state == DELIVERY_SLOT_FREE) {
+            slot->state = DELIVERY_SLOT_PENDING;
+            slot->msg_id = -1;
+            slot->publish_ms = bytebeam_hal_get_uptime_ms();
+            slot->callback = callback;
+            slot->callback_arg = callback_arg;
+
+            delivery->stats.inflight++;
+            reserved = index;
+            break;
+        }
+    }
+
+    if (reserved == -1 && callback == NULL) {
+        delivery->stats.untracked++;
+    }
+
+    bytebeam_hal_mutex_unlock(delivery->lock);
+
+    return reserved;
+}
+
+void bytebeam_delivery_commit(bytebeam_client_t *bytebeam_client, int slot_index, int msg_id)
+{
+    int index = 0;
+    bool has_completed = false;
+    bytebeam_delivery_slot_t completed;
+    bytebeam_delivery_t *delivery = bytebeam_client->delivery;
+
+    if (delivery == NULL || slot_index < 0) {
+        return;
+    }
+
+    long long now = bytebeam_hal_get_uptime_ms();
+    bytebeam_delivery_slot_t *slot = &delivery->slots[slot_index];
+
+    bytebeam_hal_mutex_lock(delivery->lock);
+
+    if (msg_id == -1) {
+        // the publish never left, so there is nothing to report
+        slot->state = DELIVERY_SLOT_FREE;
+        slot->callback = NULL;
+        slot->callback_arg = NULL;
+        delivery->stats.inflight--;
+
+        bytebeam_hal_mutex_unlock(delivery->lock);
+        return;
+    }
+
+    slot->state = DELIVERY_SLOT_INFLIGHT;
+    slot->msg_id = msg_id;
+    delivery->stats.tracked++;
+
+    // a qos 0 publish is as delivered as it gets once it is sent
+    if (msg_id == 0) {
+        complete_slot(delivery, slot, BYTEBEAM_DELIVERY_ACKED, now, &completed);
+        has_completed = true;
+    }
+
+    for (index = 0; index < DELIVERY_MAX_EARLY_ACKS && !has_completed; index++) {
+        bytebeam_delivery_ack_t *ack = &delivery->early_acks[index];
+
+        // the msg_ids wrap around, so an acknowledgement from before the publish belongs to an older one
+        if (ack->msg_id == msg_id && ack->ack_ms >= slot->publish_ms) {
+            complete_slot(delivery, slot, BYTEBEAM_DELIVERY_ACKED, ack->ack_ms, &completed);
+            ack->msg_id = 0;
+            has_completed = true;
+        }
+    }
+
+    bytebeam_hal_mutex_unlock(delivery->lock);
+
+    if (has_completed) {
+        notify_completed(bytebeam_client, &completed, BYTEBEAM_DELIVERY_ACKED);
+    }
+}
+
+void bytebeam_delivery_on_published(bytebeam_client_t *bytebeam_client, int msg_id)
+{
+    int index = 0;
+    bool has_completed = false;
+    bytebeam_delivery_slot_t completed;
+    bytebeam_delivery_t *delivery = bytebeam_client->delivery;
+
+    if (delivery == NULL) {
+        return;
+    }
+
+    long long now = bytebeam_hal_get_uptime_ms();
+
+    bytebeam_hal_mutex_lock(delivery->lock);
+
+    for (index = 0; index < BYTEBEAM_DELIVERY_MAX_INFLIGHT; index++) {
+        bytebeam_delivery_slot_t *slot = &delivery->slots[index];
+
+        if (slot->state == DELIVERY_SLOT_INFLIGHT && slot->msg_id == msg_id) {
+            complete_slot(delivery, slot, BYTEBEAM_DELIVERY_ACKED, now, &completed);
+            has_completed = true;
+            break;
+        }
+    }
+
+    // the publish may still be on its way into the table, remember the acknowledgement for it
+    if (!has_completed) {
+        delivery->early_acks[delivery->next_early_ack].msg_id = msg_id;
+        delivery->early_acks[delivery->next_early_ack].ack_ms = now;
+        delivery->next_early_ack = (delivery->next_early_ack + 1) % DELIVERY_MAX_EARLY_ACKS;
+    }
+
+    bytebeam_hal_mutex_unlock(delivery->lock);
+
+    if (has_completed) {
+        notify_completed(bytebeam_client, &completed, BYTEBEAM_DELIVERY_ACKED);
+    }
+
+    expire_slots(bytebeam_client, false);
+}
+
+void bytebeam_delivery_on_disconnected(bytebeam_client_t *bytebeam_client)
+{
+    if (bytebeam_client->delivery == NULL) {
+        return;
+    }
+
+    expire_slots(bytebeam_client, true);
+}
+
+bytebeam_err_t bytebeam_poll_deliveries(bytebeam_client_t *bytebeam_client)
+{
+    if (bytebeam_client == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (bytebeam_client->delivery != NULL) {
+        expire_slots(bytebeam_client, false);
+    }
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_get_delivery_stats(bytebeam_client_t *bytebeam_client, bytebeam_delivery_stats_t *stats)
+{
+    if (bytebeam_client == NULL || stats == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    bytebeam_delivery_t *delivery = bytebeam_client->delivery;
+
+    if (delivery == NULL) {
+        return BB_FAILURE;
+    }
+
+    bytebeam_hal_mutex_lock(delivery->lock);
+    *stats = delivery->stats;
+    bytebeam_hal_mutex_unlock(delivery->lock);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_reset_delivery_stats(bytebeam_client_t *bytebeam_client)
+{
+    if (bytebeam_client == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    bytebeam_delivery_t *delivery = bytebeam_client->delivery;
+
+    if (delivery == NULL) {
+        return BB_FAILURE;
+    }
+
+    bytebeam_hal_mutex_lock(delivery->lock);
+    reset_stats(delivery);
+    bytebeam_hal_mutex_unlock(delivery->lock);
+
+    return BB_SUCCESS;
+}
@@ -0,0 +1,786 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytebeam_json.h"
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static void write_bytes(bytebeam_json_writer_t *writer, const char *data, int len)
+{
+    if (writer->overflow) {
+        return;
+    }
+
+    // keep the space for the NULL character
+    if (writer->length + len + 1 > writer->size) {
+        writer->overflow = true;
+        return;
+    }
+
+    memcpy(writer->buffer + writer->length, data, len);
+    writer->length = writer->length + len;
+    writer->buffer[writer->length] = '\0';
+}
+
+static void write_char(bytebeam_json_writer_t *writer, char c)
+{
+    write_bytes(writer, &c, 1);
+}
+
+/* Returns the escape sequence length of the character, writing the sequence into out if it is not NULL */
+static int escape_char(char c, char *out)
+{
+    char escape = 0;
+
+    switch (c) {
+        case '"'  : escape = '"';  break;
+        case '\\' : escape = '\\'; break;
+        case '\b' : escape = 'b';  break;
+        case '\f' : escape = 'f';  break;
+        case '\n' : escape = 'n';  break;
+        case '\r' : escape = 'r';  break;
+        case '\t' : escape = 't';  break;
+
+        default:
+            if ((unsigned char)c >= 0x20) {
+                if (out != NULL) {
+                    out[0] = c;
+                }
+
+                return 1;
+            }
+
+            if (out != NULL) {
+                memcpy(out, "\\u00", 4);
+                out[4] = hex_digits[((unsigned char)c >> 4) & 0x0F];
+                out[5] = hex_digits[(unsigned char)c & 0x0F];
+            }
+
+            return 6;
+    }
+
+    if (out != NULL) {
+        out[0] = '\\';
+        out[1] = escape;
+    }
+
+    return 2;
+}
+
+static void write_escaped(bytebeam_json_writer_t *writer, const char *value)
+{
+    char escaped[6];
+
+    write_char(writer, '"');
+
+    while (*value != '\0' && !writer->overflow) {
+        // copy the runs of plain characters in one go
+        const char *run = value;
+
+        while (*value != '\0' && escape_char(*value, NULL) == 1) {
+            value++;
+        }
+
+        if (value != run) {
+            write_bytes(writer, run, (int)(value - run));
+        }
+
+        if (*value != '\0') {
+            int len = escape_char(*value, escaped);
+            write_bytes(writer, escaped, len);
+            value++;
+        }
+    }
+
+    write_char(writer, '"');
+}
+
+static void write_key(bytebeam_json_writer_t *writer, const char *key)
+{
+    if (writer->need_comma) {
+        write_char(writer, ',');
+    }
+
+    if (key != NULL) {
+        write_escaped(writer, key);
+        write_char(writer, ':');
+    }
+
+    writer->need_comma = true;
+}
+
+static bytebeam_err_t writer_status(bytebeam_json_writer_t *writer)
+{
+    return writer->overflow ? BB_FAILURE : BB_SUCCESS;
+}
+
+void bytebeam_json_writer_init(bytebeam_json_writer_t *writer, char *buffer, int size)
+{
+    writer->buffer = buffer;
+    writer->size = size;
+    writer->length = 0;
+    writer->need_comma = false;
+    writer->overflow = (size <= 0);
+
+    if (size > 0) {
+        buffer[0] = '\0';
+    }
+}
+
+bytebeam_err_t bytebeam_json_begin_object(bytebeam_json_writer_t *writer, const char *key)
+{
+    write_key(writer, key);
+    write_char(writer, '{');
+    writer->need_comma = false;
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_json_end_object(bytebeam_json_writer_t *writer)
+{
+    write_char(writer, '}');
+    writer->need_comma = true;
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_json_begin_array(bytebeam_json_writer_t *writer, const char *key)
+{
+    write_key(writer, key);
+    write_char(writer, '[');
+    writer->need_comma = false;
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_json_end_array(bytebeam_json_writer_t *writer)
+{
+    write_char(writer, ']');
+    writer->need_comma = true;
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_json_add_string(bytebeam_json_writer_t *writer, const char *key, const char *value)
+{
+    if (value == NULL) {
+        return bytebeam_json_add_null(writer, key);
+    }
+
+    write_key(writer, key);
+    write_escaped(writer, value);
+
+    return writer_status(writer);
+}
+
+/* Formats the string straight into the output buffer, keeping reserve bytes free after the closing quote. A string that
+ * does not fit is either an overflow or, if truncating, cut at a character boundary and ended with the marker.
+ */
+static bytebeam_err_t write_vformat(bytebeam_json_writer_t *writer, int reserve, bool is_truncating, const char *fmt, va_list args)
+{
+    int marker_len = is_truncating ? (int)strlen(BYTEBEAM_JSON_TRUNCATION_MARKER) : 0;
+
+    // the space for the string along with the closing quote and the NULL character
+    char *start = writer->buffer + writer->length;
+    int available = writer->size - writer->length - reserve;
+
+    if (available < marker_len + 2) {
+        writer->overflow = true;
+        return BB_FAILURE;
+    }
+
+    int len = vsnprintf(start, available, fmt, args);
+
+    if (len < 0 || (len >= available && !is_truncating)) {
+        writer->buffer[writer->length] = '\0';
+        writer->overflow = true;
+        return BB_FAILURE;
+    }
+
+    bool is_truncated = (len >= available);
+
+    if (is_truncated) {
+        len = available - 1;
+    }
+
+    int escaped_len = 0;
+    int index = 0;
+
+    for (index = 0; index < len; index++) {
+        escaped_len = escaped_len + escape_char(start[index], NULL);
+    }
+
+    if (escaped_len + 2 > available) {
+        if (!is_truncating) {
+            writer->buffer[writer->length] = '\0';
+            writer->overflow = true;
+            return BB_FAILURE;
+        }
+
+        is_truncated = true;
+    }
+
+    if (is_truncated) {
+        escaped_len = 0;
+
+        // keep the leading characters whose escape sequences fit along with the marker
+        for (index = 0; index < len; index++) {
+            int seq_len = escape_char(start[index], NULL);
+
+            if (escaped_len + seq_len + marker_len + 2 > available) {
+                break;
+            }
+
+            escaped_len = escaped_len + seq_len;
+        }
+
+        // never split a multi byte utf-8 character
+        while (index > 0 && ((unsigned char)start[index] & 0xC0) == 0x80) {
+            index--;
+            escaped_len = escaped_len - escape_char(start[index], NULL);
+        }
+
+        len = index;
+    }
+
+    // walk backwards so that the escape sequences never overwrite the characters yet to be escaped
+    if (escaped_len != len) {
+        int out = escaped_len;
+
+        for (index = len - 1; index >= 0; index--) {
+            char escaped[6];
+            int seq_len = escape_char(start[index], escaped);
+
+            out = out - seq_len;
+            memcpy(start + out, escaped, seq_len);
+        }
+    }
+
+    if (is_truncated) {
+        memcpy(start + escaped_len, BYTEBEAM_JSON_TRUNCATION_MARKER, marker_len);
+        escaped_len = escaped_len + marker_len;
+    }
+
+    writer->length = writer->length + escaped_len;
+    writer->buffer[writer->length] = '\0';
+    write_char(writer, '"');
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_json_add_vformat(bytebeam_json_writer_t *writer, const char *key, const char *fmt, va_list args)
+{
+    write_key(writer, key);
+    write_char(writer, '"');
+
+    if (writer->overflow) {
+        return BB_FAILURE;
+    }
+
+    return write_vformat(writer, 0, false, fmt, args);
+}
+
+bytebeam_err_t bytebeam_json_add_vformat_truncated(bytebeam_json_writer_t *writer, const char *key, int reserve, const char *fmt, va_list args)
+{
+    write_key(writer, key);
+    write_char(writer, '"');
+
+    if (writer->overflow) {
+        return BB_FAILURE;
+    }
+
+    return write_vformat(writer, reserve, true, fmt, args);
+}
+
+bytebeam_err_t bytebeam_json_add_int(bytebeam_json_writer_t *writer, const char *key, long long value)
+{
+    char number[24];
+    int len = snprintf(number, sizeof(number), "%lld", value);
+
+    write_key(writer, key);
+    write_bytes(writer, number, len);
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_json_add_uint(bytebeam_json_writer_t *writer, const char *key, unsigned long long value)
+{
+    char number[24];
+    int len = snprintf(number, sizeof(number), "%llu", value);
+
+    write_key(writer, key);
+    write_bytes(writer, number, len);
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_json_add_double(bytebeam_json_writer_t *writer, const char *key, double value)
+{
+    char number[32];
+
+    if (isnan(value) || isinf(value)) {
+        return bytebeam_json_add_null(writer, key);
+    }
+
+    // use the shortest representation that survives the round trip, same as cJSON does
+    int len = snprintf(number, sizeof(number), "%1.15g", value);
+
+    if (strtod(number, NULL) != value) {
+        len = snprintf(number, sizeof(number), "%1.17g", value);
+    }
+
+    write_key(writer, key);
+    write_bytes(writer, number, len);
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_json_add_bool(bytebeam_json_writer_t *writer, const char *key, bool value)
+{
+    write_key(writer, key);
+
+    if (value) {
+        write_bytes(writer, "true", 4);
+    } else {
+        write_bytes(writer, "false", 5);
+    }
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_json_add_null(bytebeam_json_writer_t *writer, const char *key)
+{
+    write_key(writer, key);
+    write_bytes(writer, "null", 4);
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_json_add_raw(bytebeam_json_writer_t *writer, const char *key, const char *json)
+{
+    write_key(writer, key);
+    write_bytes(writer, json, (int)strlen(json));
+
+    return writer_status(writer);
+}
+
+bytebeam_err_t bytebeam_json_writer_finish(bytebeam_json_writer_t *writer)
+{
+    if (writer == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    return writer_status(writer);
+}
+
+/* What the parser expects next, the whitespace is skipped in every state */
+typedef enum {
+    JSON_EXPECT_VALUE,
+    JSON_EXPECT_KEY,
+    JSON_EXPECT_COLON,
+    JSON_EXPECT_COMMA,
+    JSON_EXPECT_END,
+} json_expect_t;
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+static long read_hex4(const char *in)
+{
+    long value = 0;
+    int index = 0;
+
+    for (index = 0; index < 4; index++) {
+        int digit = hex_value(in[index]);
+
+        if (digit < 0) {
+            return -1;
+        }
+
+        value = (value << 4) | digit;
+    }
+
+    return value;
+}
+
+/* Returns the offset of the closing quote of the string starting at pos, or -1 if the string is invalid */
+static int scan_string(const char *json, int length, int pos)
+{
+    while (pos < length && json[pos] != '\0') {
+        char c = json[pos];
+
+        if (c == '"') {
+            return pos;
+        }
+
+        if ((unsigned char)c < 0x20) {
+            return -1;
+        }
+
+        if (c == '\\') {
+            if (pos + 1 >= length) {
+                return -1;
+            }
+
+            if (json[pos + 1] == 'u') {
+                if (pos + 5 >= length || read_hex4(json + pos + 2) < 0) {
+                    return -1;
+                }
+
+                pos = pos + 4;
+            } else if (strchr("\"\\/bfnrt", json[pos + 1]) == NULL || json[pos + 1] == '\0') {
+                return -1;
+            }
+
+            pos++;
+        }
+
+        pos++;
+    }
+
+    return -1;
+}
+
+/* Returns the offset just past the primitive starting at pos, or -1 if the primitive is invalid */
+static int scan_primitive(const char *json, int length, int pos)
+{
+    int start = pos;
+
+    while (pos < length && json[pos] != '\0' && strchr(" \t\r\n,]}:", json[pos]) == NULL) {
+        if (strchr("0123456789+-.eEtruefalsn", json[pos]) == NULL) {
+            return -1;
+        }
+
+        pos++;
+    }
+
+    int len = pos - start;
+
+    if (json[start] == 't' && (len != 4 || strncmp(json + start, "true", 4))) {
+        return -1;
+    }
+
+    if (json[start] == 'f' && (len != 5 || strncmp(json + start, "false", 5))) {
+        return -1;
+    }
+
+    if (json[start] == 'n' && (len != 4 || strncmp(json + start, "null", 4))) {
+        return -1;
+    }
+
+    return pos;
+}
+
+int bytebeam_json_parse(const char *json, int length, bytebeam_json_token_t *tokens, int max_tokens)
+{
+    int pos = 0;
+    int count = 0;
+    int parent = -1;
+    json_expect_t expect = JSON_EXPECT_VALUE;
+
+    if (json == NULL || tokens == NULL) {
+        return -1;
+    }
+
+    for (pos = 0; pos < length && json[pos] != '\0'; pos++) {
+        char c = json[pos];
+
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            continue;
+        }
+
+        if (expect == JSON_EXPECT_END) {
+            return -1;
+        }
+
+        if (expect == JSON_EXPECT_COLON) {
+            if (c != ':') {
+                return -1;
+            }
+
+            expect = JSON_EXPECT_VALUE;
+            continue;
+        }
+
+        if (c == '}' || c == ']') {
+            bytebeam_json_type_t type = (c == '}') ? BYTEBEAM_JSON_OBJECT : BYTEBEAM_JSON_ARRAY;
+
+            // an empty container can be closed right away, but never after a trailing comma
+            if (parent == -1 || tokens[parent].type != type ||
+                (expect != JSON_EXPECT_COMMA && tokens[parent].size != 0)) {
+                return -1;
+            }
+
+            tokens[parent].end = pos + 1;
+            parent = tokens[parent].parent;
+            expect = (parent == -1) ? JSON_EXPECT_END : JSON_EXPECT_COMMA;
+            continue;
+        }
+
+        if (expect == JSON_EXPECT_COMMA) {
+            if (c != ',') {
+                return -1;
+            }
+
+            expect = (tokens[parent].type == BYTEBEAM_JSON_OBJECT) ? JSON_EXPECT_KEY : JSON_EXPECT_VALUE;
+            continue;
+        }
+
+        if (count == max_tokens || (expect == JSON_EXPECT_KEY && c != '"')) {
+            return -1;
+        }
+
+        bytebeam_json_token_t *token = &tokens[count];
+
+        token->size = 0;
+        token->parent = parent;
+
+        if (expect == JSON_EXPECT_KEY) {
+            tokens[parent].size++;
+        } else if (parent != -1 && tokens[parent].type == BYTEBEAM_JSON_OBJECT) {
+            // the member name is always the token just before its value
+            tokens[count - 1].size = 1;
+        } else if (parent != -1) {
+            tokens[parent].size++;
+        }
+
+        if (c == '{' || c == '[') {
+            token->type = (c == '{') ? BYTEBEAM_JSON_OBJECT : BYTEBEAM_JSON_ARRAY;
+            token->start = pos;
+            token->end = -1;
+
+            parent = count++;
+            expect = (c == '{') ? JSON_EXPECT_KEY : JSON_EXPECT_VALUE;
+            continue;
+        }
+
+        if (c == '"') {
+            int end = scan_string(json, length, pos + 1);
+
+            if (end < 0) {
+                return -1;
+            }
+
+            token->type = BYTEBEAM_JSON_STRING;
+            token->start = pos + 1;
+            token->end = end;
+            pos = end;
+        } else {
+            int end = scan_primitive(json, length, pos);
+
+            if (end <= pos) {
+                return -1;
+            }
+
+            token->type = BYTEBEAM_JSON_PRIMITIVE;
+            token->start = pos;
+            token->end = end;
+            pos = end - 1;
+        }
+
+        if (expect == JSON_EXPECT_KEY) {
+            expect = JSON_EXPECT_COLON;
+        } else {
+            expect = (parent == -1) ? JSON_EXPECT_END : JSON_EXPECT_COMMA;
+        }
+
+        count++;
+    }
+
+    return (expect == JSON_EXPECT_END) ? count : -1;
+}
+
+int bytebeam_json_find(const char *json, const bytebeam_json_token_t *tokens, int token_count, int object, const char *key)
+{
+    int member = 0;
+    int index = object + 1;
+    int key_len = (int)strlen(key);
+
+    if (object < 0 || object >= token_count || tokens[object].type != BYTEBEAM_JSON_OBJECT) {
+        return -1;
+    }
+
+    for (member = 0; member < tokens[object].size && index + 1 < token_count; member++) {
+        const bytebeam_json_token_t *name = &tokens[index];
+        int value = index + 1;
+
+        if (name->end - name->start == key_len && !strncmp(json + name->start, key, key_len)) {
+            return value;
+        }
+
+        // skip the nested tokens of the value, they all start before the value ends
+        index = value + 1;
+
+        while (index < token_count && tokens[index].start < tokens[value].end) {
+            index++;
+        }
+    }
+
+    return -1;
+}
+
+/* Unescapes in_len characters of a string into out, which may be the same as in. Returns the unescaped length */
+static int unescape_string(const char *in, int in_len, char *out, int out_size)
+{
+    int in_pos = 0;
+    int out_len = 0;
+
+    while (in_pos < in_len) {
+        char utf8[4];
+        int utf8_len = 1;
+
+        if (in[in_pos] != '\\') {
+            utf8[0] = in[in_pos];
+            in_pos++;
+        } else if (in[in_pos + 1] != 'u') {
+            switch (in[in_pos + 1]) {
+                case 'b' : utf8[0] = '\b'; break;
+                case 'f' : utf8[0] = '\f'; break;
+                case 'n' : utf8[0] = '\n'; break;
+                case 'r' : utf8[0] = '\r'; break;
+                case 't' : utf8[0] = '\t'; break;
+                default  : utf8[0] = in[in_pos + 1]; break;
+            }
+
+            in_pos = in_pos + 2;
+        } else {
+            long code = read_hex4(in + in_pos + 2);
+
+            in_pos = in_pos + 6;
+
+            // combine the surrogate pair into a single code point
+            if (code >= 0xD800 && code <= 0xDBFF) {
+                long low = (in_pos + 6 <= in_len && in[in_pos] == '\\' && in[in_pos + 1] == 'u') ? read_hex4(in + in_pos + 2) : -1;
+
+                if (low < 0xDC00 || low > 0xDFFF) {
+                    return -1;
+                }
+
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                in_pos = in_pos + 6;
+            } else if (code >= 0xDC00 && code <= 0xDFFF) {
+                return -1;
+            }
+
+            if (code < 0x80) {
+                utf8[0] = (char)code;
+            } else if (code < 0x800) {
+                utf8[0] = (char)(0xC0 | (code >> 6));
+                utf8[1] = (char)(0x80 | (code & 0x3F));
+                utf8_len = 2;
+            } else if (code < 0x10000) {
+                utf8[0] = (char)(0xE0 | (code >> 12));
+                utf8[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+                utf8[2] = (char)(0x80 | (code & 0x3F));
+                utf8_len = 3;
+            } else {
+                utf8[0] = (char)(0xF0 | (code >> 18));
+                utf8[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+                utf8[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+                utf8[3] = (char)(0x80 | (code & 0x3F));
+                utf8_len = 4;
+            }
+        }
+
+        // keep the space for the NULL character
+        if (out_len + utf8_len + 1 > out_size) {
+            return -1;
+        }
+
+        // the utf-8 sequence is never longer than its escape sequence, so writing in place never overtakes reading
+        memcpy(out + out_len, utf8, utf8_len);
+        out_len = out_len + utf8_len;
+    }
+
+    out[out_len] = '\0';
+
+    return out_len;
+}
+
+char *bytebeam_json_unescape(char *json, bytebeam_json_token_t *token)
+{
+    if (json == NULL || token == NULL || token->type != BYTEBEAM_JSON_STRING) {
+        return NULL;
+    }
+
+    // the closing quote was replaced by the NULL character if the string is already unescaped
+    if (json[token->end] == '\0') {
+        return json + token->start;
+    }
+
+    int len = unescape_string(json + token->start, token->end - token->start, json + token->start, token->end - token->start + 1);
+
+    if (len < 0) {
+        return NULL;
+    }
+
+    token->end = token->start + len;
+
+    return json + token->start;
+}
+
+bytebeam_err_t bytebeam_json_get_string(const char *json, const bytebeam_json_token_t *token, char *out, int out_size)
+{
+    int len = token->end - token->start;
+
+    if (token->type != BYTEBEAM_JSON_STRING || out_size <= 0) {
+        return BB_FAILURE;
+    }
+
+    if (json[token->end] == '\0') {
+        if (len + 1 > out_size) {
+            return BB_FAILURE;
+        }
+
+        memcpy(out, json + token->start, len + 1);
+        return BB_SUCCESS;
+    }
+
+    return (unescape_string(json + token->start, len, out, out_size) < 0) ? BB_FAILURE : BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_json_get_double(const char *json, const bytebeam_json_token_t *token, double *value)
+{
+    char number[32];
+    char *number_end = NULL;
+    int len = token->end - token->start;
+
+    if (token->type != BYTEBEAM_JSON_PRIMITIVE || len >= (int)sizeof(number) || strchr("-0123456789", json[token->start]) == NULL) {
+        return BB_FAILURE;
+    }
+
+    // the json text need not be NULL terminated, so convert a terminated copy
+    memcpy(number, json + token->start, len);
+    number[len] = '\0';
+
+    *value = strtod(number, &number_end);
+
+    return (*number_end == '\0') ? BB_SUCCESS : BB_FAILURE;
+}
+
+bytebeam_err_t bytebeam_json_get_bool(const char *json, const bytebeam_json_token_t *token, bool *value)
+{
+    if (token->type != BYTEBEAM_JSON_PRIMITIVE || (json[token->start] != 't' && json[token->start] != 'f')) {
+        return BB_FAILURE;
+    }
+
+    *value = (json[token->start] == 't');
+
+    return BB_SUCCESS;
+}
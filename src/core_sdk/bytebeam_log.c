@@ -1,44 +1,227 @@
-#include "cJSON.h"
+#include <stdarg.h>
+#include <stdint.h>
 #include "bytebeam_hal.h"
+#include "bytebeam_internal.h"
+#include "bytebeam_json.h"
 #include "bytebeam_stream.h"
 #include "bytebeam_log.h"
 
-// bytebeam log module variables
-static bool is_cloud_logging_enable = true;
+/*This macro is used to specify the maximum length of bytebeam log level string*/
+#define BYTEBEAM_LOG_LEVEL_STR_LEN 10
+
+#define BYTEBEAM_LOG_RING_MASK (BYTEBEAM_LOG_RING_SIZE - 1)
+
+#if (BYTEBEAM_LOG_RING_SIZE & BYTEBEAM_LOG_RING_MASK) != 0
+#error "BYTEBEAM_LOG_RING_SIZE must be a power of two"
+#endif
+
+/* A slot is free for the writer at position p when its sequence is p, and holds a record for the reader at
+ * position p when its sequence is p + 1 (bounded queue by Dmitry Vyukov). Writers claim a position with a single
+ * compare and swap, so any number of tasks can log without a lock while the flusher task is the only reader.
+ */
+typedef struct bytebeam_log_record {
+    uint32_t sequence;
+    bytebeam_client_t *bytebeam_client;
+    unsigned long long timestamp;
+    char level[BYTEBEAM_LOG_LEVEL_STR_LEN];
+    char tag[BYTEBEAM_LOG_TAG_STR_LEN];
+    char message[BYTEBEAM_LOG_MESSAGE_STR_LEN];
+} bytebeam_log_record_t;
+
+typedef struct bytebeam_log_ring {
+    uint32_t write_pos;
+    uint32_t read_pos;
+    bytebeam_log_record_t records[BYTEBEAM_LOG_RING_SIZE];
+} bytebeam_log_ring_t;
+
+/* Cloud logging state of a client, every client publishes its logs on its own log stream under its own device id.
+ * The clients using the log flusher are kept in a list, the flusher publishes the buffered records of a client only
+ * while it is on the list.
+ */
+typedef struct bytebeam_log {
+    bytebeam_client_t *bytebeam_client;
+    bool is_cloud_logging_enabled;
+    bytebeam_log_level_t level;
+    char stream[BYTEBEAM_LOG_STREAM_STR_LEN];
+    uint64_t sequence;
+    bool is_attached;
+    struct bytebeam_log *next;
+} bytebeam_log_t;
+
+// client the bytebeam_log_* apis and the BYTEBEAM_LOG* macros go through
 static bytebeam_client_t *bytebeam_log_client = NULL;
-static char bytebeam_log_stream[BYTEBEAM_LOG_STREAM_STR_LEN] = "logs";
-static bytebeam_log_level_t bytebeam_log_level = BYTEBEAM_LOG_LEVEL_INFO;
+
+// the log sequence of the sleep cycle mode carries on across deep sleep, so the logs stay in order
+static BB_RETAINED uint64_t bytebeam_log_sequence = 0;
+
+/* The flusher lock guards the list of the attached clients, the client whose batch the flusher is publishing and
+ * the starting and stopping of the flusher task. It is created along with the first client and kept for the
+ * lifetime of the application, so the flusher can take it at any time.
+ */
+static bytebeam_hal_mutex_t bytebeam_log_flusher_lock = NULL;
+static bytebeam_log_t *bytebeam_log_flusher_users = NULL;
+static bytebeam_client_t *bytebeam_log_flushing_client = NULL;
+
+// bytebeam log flusher variables
+static bytebeam_log_ring_t *bytebeam_log_ring = NULL;
+static bytebeam_hal_task_t bytebeam_log_flusher = NULL;
+static bool is_log_flusher_running = false;
+static bool is_log_flusher_stopped = true;
+static bytebeam_log_stats_t bytebeam_log_stats = { 0 };
 
 static const char *TAG = "BYTEBEAM_LOG";
 
+static bytebeam_hal_mutex_t get_log_flusher_lock(void)
+{
+    bytebeam_hal_mutex_t expected = NULL;
+    bytebeam_hal_mutex_t lock = __atomic_load_n(&bytebeam_log_flusher_lock, __ATOMIC_ACQUIRE);
+
+    if (lock != NULL) {
+        return lock;
+    }
+
+    lock = bytebeam_hal_mutex_create();
+
+    if (lock == NULL) {
+        return NULL;
+    }
+
+    // two clients may be initialized at the same time, the lock of the one coming second is thrown away
+    if (!__atomic_compare_exchange_n(&bytebeam_log_flusher_lock, &expected, lock, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        bytebeam_hal_mutex_delete(lock);
+        return expected;
+    }
+
+    return lock;
+}
+
+static bytebeam_log_t *get_default_log(void)
+{
+    bytebeam_client_t *bytebeam_client = __atomic_load_n(&bytebeam_log_client, __ATOMIC_ACQUIRE);
+
+    return (bytebeam_client != NULL) ? bytebeam_client->log : NULL;
+}
+
+int bytebeam_log_start(bytebeam_client_t *bytebeam_client)
+{
+    if (bytebeam_client->log != NULL) {
+        return 0;
+    }
+
+    bytebeam_log_t *log = calloc(1, sizeof(bytebeam_log_t));
+
+    if (log == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for cloud logging");
+        return -1;
+    }
+
+    if (get_log_flusher_lock() == NULL) {
+        BB_LOGE(TAG, "Failed to create the log flusher lock");
+
+        free(log);
+        return -1;
+    }
+
+    log->bytebeam_client = bytebeam_client;
+    log->is_cloud_logging_enabled = true;
+    log->level = BYTEBEAM_LOG_LEVEL_INFO;
+    snprintf(log->stream, sizeof(log->stream), "%s", BYTEBEAM_LOG_DEFAULT_STREAM);
+
+    if (bytebeam_client->sleep_cycle_cfg.is_enabled) {
+        log->sequence = bytebeam_log_sequence;
+    }
+
+    bytebeam_client->log = log;
+
+    return 0;
+}
+
+void bytebeam_log_free(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_log_t *log = bytebeam_client->log;
+
+    if (log == NULL) {
+        return;
+    }
+
+    bytebeam_log_flusher_stop(bytebeam_client);
+    free(log);
+
+    bytebeam_client->log = NULL;
+}
+
 void bytebeam_log_client_set(bytebeam_client_t *bytebeam_client)
 {
-    bytebeam_log_client = bytebeam_client;
+    __atomic_store_n(&bytebeam_log_client, bytebeam_client, __ATOMIC_RELEASE);
+}
+
+bool bytebeam_log_client_claim(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_client_t *expected = NULL;
+
+    return __atomic_compare_exchange_n(&bytebeam_log_client, &expected, bytebeam_client, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+void bytebeam_log_client_clear(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_client_t *expected = bytebeam_client;
+
+    // left alone if the logs go out through another client
+    __atomic_compare_exchange_n(&bytebeam_log_client, &expected, NULL, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static bytebeam_err_t set_log_stream(bytebeam_log_t *log, const char *stream_name)
+{
+    if (strlen(stream_name) >= sizeof(log->stream))
+    {
+        BB_LOGE(TAG, "log stream size exceeded buffer size");
+        return BB_FAILURE;
+    }
+
+    snprintf(log->stream, sizeof(log->stream), "%s", stream_name);
+
+    return BB_SUCCESS;
 }
 
 void bytebeam_enable_cloud_logging()
 {
-    is_cloud_logging_enable = true;
+    bytebeam_log_t *log = get_default_log();
+
+    if (log != NULL) {
+        log->is_cloud_logging_enabled = true;
+    }
 }
 
 bool bytebeam_is_cloud_logging_enabled()
 {
-    return is_cloud_logging_enable;
+    bytebeam_log_t *log = get_default_log();
+
+    return (log != NULL) ? log->is_cloud_logging_enabled : true;
 }
 
 void bytebeam_disable_cloud_logging()
 {
-    is_cloud_logging_enable = false;
+    bytebeam_log_t *log = get_default_log();
+
+    if (log != NULL) {
+        log->is_cloud_logging_enabled = false;
+    }
 }
 
 void bytebeam_log_level_set(bytebeam_log_level_t level)
 {
-    bytebeam_log_level = level;
+    bytebeam_log_t *log = get_default_log();
+
+    if (log != NULL) {
+        log->level = level;
+    }
 }
 
 bytebeam_log_level_t bytebeam_log_level_get(void)
 {
-    return bytebeam_log_level;
+    bytebeam_log_t *log = get_default_log();
+
+    return (log != NULL) ? log->level : BYTEBEAM_LOG_LEVEL_INFO;
 }
 
 bytebeam_err_t bytebeam_log_stream_set(char* stream_name)
@@ -49,196 +232,634 @@ bytebeam_err_t bytebeam_log_stream_set(char* stream_name)
         return BB_NULL_CHECK_FAILURE;
     }
 
-    int max_len = BYTEBEAM_LOG_STREAM_STR_LEN;
-    int temp_var = snprintf(bytebeam_log_stream, max_len, "%s", stream_name);
+    bytebeam_log_t *log = get_default_log();
 
-    if (temp_var >= max_len)
+    if (log == NULL)
     {
-        BB_LOGE(TAG, "log stream size exceeded buffer size");
+        BB_LOGE(TAG, "Bytebeam log client handle is not set");
         return BB_FAILURE;
     }
 
-    return BB_SUCCESS;
+    return set_log_stream(log, stream_name);
 }
 
 char* bytebeam_log_stream_get()
 {
-    return bytebeam_log_stream;
+    bytebeam_log_t *log = get_default_log();
+
+    return (log != NULL) ? log->stream : (char *)BYTEBEAM_LOG_DEFAULT_STREAM;
 }
 
-bytebeam_err_t bytebeam_log_publish(const char *level, const char *tag, const char *fmt, ...)
+bytebeam_err_t bytebeam_client_set_cloud_logging(bytebeam_client_t *bytebeam_client, bool is_enabled)
 {
-    static uint64_t sequence = 0;
-    unsigned long long milliseconds = 0;
+    if (bytebeam_client == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (bytebeam_client->log == NULL) {
+        BB_LOGE(TAG, "Bytebeam client is not initialized");
+        return BB_FAILURE;
+    }
+
+    bytebeam_client->log->is_cloud_logging_enabled = is_enabled;
+
+    return BB_SUCCESS;
+}
 
-    cJSON *device_log_json_list = NULL;
-    cJSON *device_log_json = NULL;
-    cJSON *sequence_json = NULL;
-    cJSON *timestamp_json = NULL;
-    cJSON *log_level_json = NULL;
-    cJSON *log_tag_json = NULL;
-    cJSON *log_message_json = NULL;
+bool bytebeam_client_is_cloud_logging_enabled(bytebeam_client_t *bytebeam_client)
+{
+    if (bytebeam_client == NULL || bytebeam_client->log == NULL) {
+        return false;
+    }
 
-    char *log_string_json = NULL;
+    return bytebeam_client->log->is_cloud_logging_enabled;
+}
 
-    if(bytebeam_log_client == NULL)
+bytebeam_err_t bytebeam_client_log_level_set(bytebeam_client_t *bytebeam_client, bytebeam_log_level_t level)
+{
+    if (bytebeam_client == NULL)
     {
-        BB_LOGE(TAG, "Bytebeam log client handle is not set");
-        return BB_FAILURE;
+        return BB_NULL_CHECK_FAILURE;
     }
 
-    // if cloud logging is disabled, we don't need to push just return :)
-    if(!is_cloud_logging_enable) {
-      return BB_SUCCESS;
+    if (bytebeam_client->log == NULL) {
+        BB_LOGE(TAG, "Bytebeam client is not initialized");
+        return BB_FAILURE;
     }
 
-    va_list args;
+    bytebeam_client->log->level = level;
 
-    // get the buffer size (+1 for NULL Character)
-    va_start(args, fmt);
-    int buffer_size = vsnprintf(NULL, 0, fmt, args) + 1; 
-    va_end(args);
+    return BB_SUCCESS;
+}
 
-    // Check the buffer size
-    if(buffer_size <= 0) 
-    {
-        BB_LOGE(TAG, "Failed to Get the buffer size for Bytebeam Log.");
-        return BB_FAILURE;
+bytebeam_log_level_t bytebeam_client_log_level_get(bytebeam_client_t *bytebeam_client)
+{
+    if (bytebeam_client == NULL || bytebeam_client->log == NULL) {
+        return BYTEBEAM_LOG_LEVEL_INFO;
     }
 
-    // allocate the memory for the buffer to store the message
-    char *message_buffer = (char*) malloc(buffer_size);
-    if (message_buffer == NULL) 
+    return bytebeam_client->log->level;
+}
+
+bytebeam_err_t bytebeam_client_log_stream_set(bytebeam_client_t *bytebeam_client, const char *stream_name)
+{
+    if (bytebeam_client == NULL || stream_name == NULL)
     {
-        BB_LOGE(TAG, "Failed to ALlocate the memory for Bytebeam Log.");
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (bytebeam_client->log == NULL) {
+        BB_LOGE(TAG, "Bytebeam client is not initialized");
         return BB_FAILURE;
     }
 
-    // get the message in the buffer
-    va_start(args, fmt);
-    int temp_var = vsnprintf(message_buffer, buffer_size, fmt, args);
-    va_end(args);
+    return set_log_stream(bytebeam_client->log, stream_name);
+}
 
-    // Check for argument loss
-    if (temp_var >= buffer_size) 
-    {
-        BB_LOGE(TAG, "Failed to Get the message for Bytebeam Log.");
+const char *bytebeam_client_log_stream_get(bytebeam_client_t *bytebeam_client)
+{
+    if (bytebeam_client == NULL || bytebeam_client->log == NULL) {
+        return BYTEBEAM_LOG_DEFAULT_STREAM;
+    }
 
-        free(message_buffer);
-        return BB_FAILURE;
+    return bytebeam_client->log->stream;
+}
+
+static bytebeam_err_t log_ring_write(bytebeam_client_t *bytebeam_client, const char *level, const char *tag, const char *fmt, va_list args)
+{
+    bytebeam_log_ring_t *ring = bytebeam_log_ring;
+    bytebeam_log_record_t *record = NULL;
+    uint32_t pos = __atomic_load_n(&ring->write_pos, __ATOMIC_RELAXED);
+
+    while (true) {
+        record = &ring->records[pos & BYTEBEAM_LOG_RING_MASK];
+
+        uint32_t sequence = __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t)(sequence - pos);
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->write_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // the flusher has not caught up yet, so the ring is full. The drop is counted, the caller need not report it
+            __atomic_fetch_add(&bytebeam_log_stats.dropped_records, 1, __ATOMIC_RELAXED);
+            return BB_RATE_LIMITED;
+        } else {
+            pos = __atomic_load_n(&ring->write_pos, __ATOMIC_RELAXED);
+        }
     }
 
-    device_log_json_list = cJSON_CreateArray();
+    record->bytebeam_client = bytebeam_client;
+    record->timestamp = bytebeam_hal_get_epoch_millis();
+    snprintf(record->level, sizeof(record->level), "%s", level);
+    snprintf(record->tag, sizeof(record->tag), "%s", tag);
+    int message_len = vsnprintf(record->message, sizeof(record->message), fmt, args);
 
-    if (device_log_json_list == NULL) {
-        BB_LOGE(TAG, "Log Json Init failed.");
+    // mark the message cut short to fit in the record
+    if (message_len >= (int)sizeof(record->message)) {
+        int marker_len = strlen(BYTEBEAM_JSON_TRUNCATION_MARKER);
+        int len = sizeof(record->message) - 1 - marker_len;
 
-        free(message_buffer);
-        return BB_FAILURE;
+        // never split a multi byte utf-8 character
+        while (len > 0 && ((unsigned char)record->message[len] & 0xC0) == 0x80) {
+            len--;
+        }
+
+        memcpy(record->message + len, BYTEBEAM_JSON_TRUNCATION_MARKER, marker_len + 1);
     }
 
-    device_log_json = cJSON_CreateObject();
+    __atomic_store_n(&record->sequence, pos + 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&bytebeam_log_stats.queued_records, 1, __ATOMIC_RELAXED);
 
-    if (device_log_json == NULL) {
-        BB_LOGE(TAG, "Log Json add failed.");
+    // wake up the flusher early once the ring is half full, rest of the time it just flushes periodically
+    if (((pos - __atomic_load_n(&ring->read_pos, __ATOMIC_RELAXED)) + 1) == (BYTEBEAM_LOG_RING_SIZE / 2)) {
+        // the handle is set and cleared under the flusher lock, the task may be just starting or on its way out
+        bytebeam_hal_mutex_lock(bytebeam_log_flusher_lock);
 
-        cJSON_Delete(device_log_json_list);
-        free(message_buffer);
-        return BB_FAILURE;
+        if (bytebeam_log_flusher != NULL) {
+            bytebeam_hal_task_notify(bytebeam_log_flusher);
+        }
+
+        bytebeam_hal_mutex_unlock(bytebeam_log_flusher_lock);
     }
-    
-    milliseconds = bytebeam_hal_get_epoch_millis();
 
-    if(milliseconds == 0)
-    {
-        BB_LOGE(TAG, "failed to get epoch millis.");
+    return BB_SUCCESS;
+}
 
-        cJSON_Delete(device_log_json_list);
-        free(message_buffer);
-        return BB_FAILURE;
+static bytebeam_log_record_t *log_ring_peek(bytebeam_log_ring_t *ring)
+{
+    bytebeam_log_record_t *record = &ring->records[ring->read_pos & BYTEBEAM_LOG_RING_MASK];
+
+    if (__atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE) != ring->read_pos + 1) {
+        return NULL;
     }
 
-    timestamp_json = cJSON_CreateNumber(milliseconds);
+    return record;
+}
 
-    if (timestamp_json == NULL) {
-        BB_LOGE(TAG, "Log Json add time stamp failed.");
+static void log_ring_pop(bytebeam_log_ring_t *ring, bytebeam_log_record_t *record)
+{
+    // hand the slot back to the writers one full lap ahead
+    __atomic_store_n(&record->sequence, ring->read_pos + BYTEBEAM_LOG_RING_SIZE, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->read_pos, ring->read_pos + 1, __ATOMIC_RELAXED);
+}
 
-        cJSON_Delete(device_log_json_list);
-        free(message_buffer);
+static bytebeam_err_t log_batch_add(bytebeam_log_t *log, bytebeam_json_writer_t *writer, unsigned long long timestamp, const char *level, const char *tag, const char *message)
+{
+    // roll back the partially written record if it does not fit
+    bytebeam_json_writer_t saved_writer = *writer;
+
+    bytebeam_json_begin_object(writer, NULL);
+    bytebeam_json_add_uint(writer, "timestamp", timestamp);
+    bytebeam_json_add_uint(writer, "sequence", log->sequence + 1);
+    bytebeam_json_add_string(writer, "level", level);
+    bytebeam_json_add_string(writer, "tag", tag);
+    bytebeam_json_add_string(writer, "message", message);
+    bytebeam_json_end_object(writer);
+
+    // keep the space for closing the array
+    if (writer->overflow || writer->length + 2 > writer->size) {
+        *writer = saved_writer;
+        writer->buffer[writer->length] = '\0';
         return BB_FAILURE;
     }
 
-    cJSON_AddItemToObject(device_log_json, "timestamp", timestamp_json);
+    log->sequence++;
 
-    sequence++;
-    sequence_json = cJSON_CreateNumber(sequence);
+    if (log->bytebeam_client->sleep_cycle_cfg.is_enabled) {
+        bytebeam_log_sequence = log->sequence;
+    }
 
-    if (sequence_json == NULL) {
-        BB_LOGE(TAG, "Log Json add sequence id failed.");
+    return BB_SUCCESS;
+}
 
-        cJSON_Delete(device_log_json_list);
-        free(message_buffer);
-        return BB_FAILURE;
+static void log_batch_begin(bytebeam_json_writer_t *writer)
+{
+    bytebeam_json_writer_init(writer, writer->buffer, writer->size);
+    bytebeam_json_begin_array(writer, NULL);
+}
+
+static void log_batch_publish(bytebeam_log_t *log, bytebeam_json_writer_t *writer, unsigned int records)
+{
+    long long start_us = bytebeam_hal_get_uptime_us();
+
+    bytebeam_json_end_array(writer);
+
+    int ret_val = bytebeam_publish_to_stream(log->bytebeam_client, log->stream, writer->buffer);
+
+    bytebeam_metrics_observe(BYTEBEAM_METRIC_LOG_FLUSH_US, bytebeam_hal_get_uptime_us() - start_us);
+
+    if (ret_val == BB_SUCCESS) {
+        __atomic_fetch_add(&bytebeam_log_stats.published_records, records, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&bytebeam_log_stats.failed_records, records, __ATOMIC_RELAXED);
     }
 
-    cJSON_AddItemToObject(device_log_json, "sequence", sequence_json);
+    log_batch_begin(writer);
+}
 
-    log_level_json = cJSON_CreateString(level);
+/* Pins the client for the batch being built, so that it is not detached before the batch is out. Returns NULL if the
+ * client is detached already, its records can not be published anymore.
+ */
+static bytebeam_log_t *pin_log_client(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_log_t *log = NULL;
 
-    if (log_level_json == NULL) {
-        BB_LOGE(TAG, "Log Json add level failed.");
+    bytebeam_hal_mutex_lock(bytebeam_log_flusher_lock);
 
-        cJSON_Delete(device_log_json_list);
-        free(message_buffer);
-        return BB_FAILURE;
+    // the client is looked up by its address, a detached one may be gone already
+    for (log = bytebeam_log_flusher_users; log != NULL; log = log->next) {
+        if (log->bytebeam_client == bytebeam_client) {
+            bytebeam_log_flushing_client = bytebeam_client;
+            break;
+        }
     }
 
-    cJSON_AddItemToObject(device_log_json, "level", log_level_json);
+    bytebeam_hal_mutex_unlock(bytebeam_log_flusher_lock);
+
+    return log;
+}
+
+static void unpin_log_client(void)
+{
+    bytebeam_hal_mutex_lock(bytebeam_log_flusher_lock);
+    bytebeam_log_flushing_client = NULL;
+    bytebeam_hal_mutex_unlock(bytebeam_log_flusher_lock);
+}
 
-    log_tag_json = cJSON_CreateString(tag);
+static void log_ring_flush(bytebeam_log_ring_t *ring, bytebeam_json_writer_t *writer, unsigned int *reported_drops)
+{
+    char drop_message[64];
+    unsigned int records = 0;
+    bytebeam_log_t *log = NULL;
+    bytebeam_log_record_t *record = NULL;
+
+    while ((record = log_ring_peek(ring)) != NULL) {
+        // a batch goes out through a single client, so a record of another client closes it
+        if (log == NULL || record->bytebeam_client != log->bytebeam_client) {
+            if (log != NULL) {
+                if (records > 0) {
+                    log_batch_publish(log, writer, records);
+                }
+
+                unpin_log_client();
+            }
+
+            records = 0;
+            log = pin_log_client(record->bytebeam_client);
+
+            if (log == NULL) {
+                log_ring_pop(ring, record);
+                __atomic_fetch_add(&bytebeam_log_stats.failed_records, 1, __ATOMIC_RELAXED);
+                continue;
+            }
+
+            log_batch_begin(writer);
+
+            // let the cloud know about the records lost since the last flush
+            unsigned int dropped_records = __atomic_load_n(&bytebeam_log_stats.dropped_records, __ATOMIC_RELAXED);
+
+            if (dropped_records != *reported_drops) {
+                snprintf(drop_message, sizeof(drop_message), "%u log records dropped, log ring buffer full", dropped_records - *reported_drops);
+
+                if (log_batch_add(log, writer, bytebeam_hal_get_epoch_millis(), bytebeam_log_level_str[BYTEBEAM_LOG_LEVEL_WARN], TAG, drop_message) == BB_SUCCESS) {
+                    *reported_drops = dropped_records;
+                    records++;
+                }
+            }
+        }
+
+        if (log_batch_add(log, writer, record->timestamp, record->level, record->tag, record->message) != BB_SUCCESS) {
+            // a record that does not fit even in an empty batch can never be published
+            if (records == 0) {
+                log_ring_pop(ring, record);
+                __atomic_fetch_add(&bytebeam_log_stats.failed_records, 1, __ATOMIC_RELAXED);
+                continue;
+            }
+
+            log_batch_publish(log, writer, records);
+            records = 0;
+            continue;
+        }
+
+        log_ring_pop(ring, record);
+        records++;
+    }
 
-    if (log_tag_json == NULL) {
-        BB_LOGE(TAG, "Log Json add tag failed.");
+    if (log != NULL) {
+        if (records > 0) {
+            log_batch_publish(log, writer, records);
+        }
 
-        cJSON_Delete(device_log_json_list);
-        free(message_buffer);
-        return BB_FAILURE;
+        unpin_log_client();
+    }
+}
+
+static void log_flusher_task(void *arg)
+{
+    unsigned int reported_drops = __atomic_load_n(&bytebeam_log_stats.dropped_records, __ATOMIC_RELAXED);
+    int wait_ms = BYTEBEAM_LOG_FLUSH_INTERVAL_MS;
+    int heartbeat_due_ms = 0;
+    bytebeam_json_writer_t writer;
+    char *batch = malloc(BYTEBEAM_LOG_BATCH_STR_LEN);
+
+    if (batch == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for log batch");
+    }
+
+    bytebeam_json_writer_init(&writer, batch, (batch != NULL) ? BYTEBEAM_LOG_BATCH_STR_LEN : 0);
+
+    while (batch != NULL && __atomic_load_n(&is_log_flusher_running, __ATOMIC_ACQUIRE)) {
+        bytebeam_hal_task_wait_notify(wait_ms);
+        log_ring_flush(bytebeam_log_ring, &writer, &reported_drops);
+
+        // the flusher wakes up periodically anyway, so it publishes the device heartbeat and the sdk metrics as well
+        heartbeat_due_ms = bytebeam_shadow_poll();
+        bytebeam_metrics_poll();
+
+        // sleep no longer than upto the next heartbeat, so that its jitter is not rounded to the flush interval
+        wait_ms = (heartbeat_due_ms > 0 && heartbeat_due_ms < BYTEBEAM_LOG_FLUSH_INTERVAL_MS) ? heartbeat_due_ms : BYTEBEAM_LOG_FLUSH_INTERVAL_MS;
+    }
+
+    // the records logged while stopping belong to the clients detached already, so they are just counted as failed
+    if (batch != NULL) {
+        log_ring_flush(bytebeam_log_ring, &writer, &reported_drops);
+        free(batch);
+    }
+
+    // the handle goes along with the task, nobody may notify it anymore
+    bytebeam_hal_mutex_lock(bytebeam_log_flusher_lock);
+    bytebeam_log_flusher = NULL;
+    __atomic_store_n(&is_log_flusher_running, false, __ATOMIC_RELEASE);
+    __atomic_store_n(&is_log_flusher_stopped, true, __ATOMIC_RELEASE);
+    bytebeam_hal_mutex_unlock(bytebeam_log_flusher_lock);
+
+    bytebeam_hal_task_delete(NULL);
+}
+
+/* Starts the flusher task unless it is running already, the caller holds the flusher lock */
+static int start_log_flusher_task(void)
+{
+    // the task of the last client gone may still be on its way out, a new one has to wait for it
+    while (!is_log_flusher_stopped && !__atomic_load_n(&is_log_flusher_running, __ATOMIC_ACQUIRE)) {
+        bytebeam_hal_mutex_unlock(bytebeam_log_flusher_lock);
+        bytebeam_hal_delay_ms(10);
+        bytebeam_hal_mutex_lock(bytebeam_log_flusher_lock);
     }
 
-    cJSON_AddItemToObject(device_log_json, "tag", log_tag_json);
+    if (!is_log_flusher_stopped) {
+        return 0;
+    }
+
+    /* The ring is allocated once and kept for the lifetime of the application, a task might still be writing into
+     * it while the flusher is being stopped.
+     */
+    if (bytebeam_log_ring == NULL) {
+        bytebeam_log_ring_t *ring = calloc(1, sizeof(bytebeam_log_ring_t));
 
-    log_message_json = cJSON_CreateString(message_buffer);
+        if (ring == NULL) {
+            BB_LOGE(TAG, "Failed to allocate the memory for log ring buffer");
+            return -1;
+        }
 
-    if (log_message_json == NULL) {
-        BB_LOGE(TAG, "Log Json add message failed.");
+        for (uint32_t index = 0; index < BYTEBEAM_LOG_RING_SIZE; index++) {
+            ring->records[index].sequence = index;
+        }
+
+        bytebeam_log_ring = ring;
+    }
 
-        cJSON_Delete(device_log_json_list);
-        free(message_buffer);
+    is_log_flusher_stopped = false;
+    __atomic_store_n(&is_log_flusher_running, true, __ATOMIC_RELEASE);
+
+    bytebeam_log_flusher = bytebeam_hal_task_create("bytebeam_log", log_flusher_task, NULL, BYTEBEAM_LOG_FLUSHER_STACK_SIZE, BYTEBEAM_LOG_FLUSHER_PRIORITY);
+
+    if (bytebeam_log_flusher == NULL) {
+        BB_LOGE(TAG, "Failed to create log flusher task");
+
+        __atomic_store_n(&is_log_flusher_running, false, __ATOMIC_RELEASE);
+        is_log_flusher_stopped = true;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Publishes the records buffered so far, the caller holds the flusher lock which is let go meanwhile */
+static void wait_log_ring_flushed(void)
+{
+    uint32_t write_pos = __atomic_load_n(&bytebeam_log_ring->write_pos, __ATOMIC_RELAXED);
+
+    bytebeam_hal_task_notify(bytebeam_log_flusher);
+
+    while (__atomic_load_n(&is_log_flusher_running, __ATOMIC_ACQUIRE) &&
+           (int32_t)(__atomic_load_n(&bytebeam_log_ring->read_pos, __ATOMIC_RELAXED) - write_pos) < 0) {
+        bytebeam_hal_mutex_unlock(bytebeam_log_flusher_lock);
+        bytebeam_hal_delay_ms(10);
+        bytebeam_hal_mutex_lock(bytebeam_log_flusher_lock);
+    }
+}
+
+/* Tells whether every record logged so far is handed over to mqtt and wakes up the flusher if not. The records are
+ * taken off the ring before their batch is published, so the batch of a pinned client is still on its way.
+ */
+bool bytebeam_log_flush_ring(void)
+{
+    bytebeam_hal_mutex_t lock = __atomic_load_n(&bytebeam_log_flusher_lock, __ATOMIC_ACQUIRE);
+
+    if (lock == NULL) {
+        return true;
+    }
+
+    bytebeam_hal_mutex_lock(lock);
+
+    bool is_flushed = !__atomic_load_n(&is_log_flusher_running, __ATOMIC_ACQUIRE) || bytebeam_log_ring == NULL ||
+                      (__atomic_load_n(&bytebeam_log_ring->read_pos, __ATOMIC_RELAXED) == __atomic_load_n(&bytebeam_log_ring->write_pos, __ATOMIC_RELAXED) &&
+                       bytebeam_log_flushing_client == NULL);
+
+    if (!is_flushed && bytebeam_log_flusher != NULL) {
+        bytebeam_hal_task_notify(bytebeam_log_flusher);
+    }
+
+    bytebeam_hal_mutex_unlock(lock);
+
+    return is_flushed;
+}
+
+/* The flusher is shared by all the clients, it keeps running for as long as any of them is initialized */
+int bytebeam_log_flusher_start(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_log_t *log = bytebeam_client->log;
+    int ret_val = 0;
+
+    if (log == NULL) {
+        return -1;
+    }
+
+    bytebeam_hal_mutex_lock(bytebeam_log_flusher_lock);
+
+    ret_val = start_log_flusher_task();
+
+    // a client is attached even without the task, the records it logs meanwhile are published synchronously
+    if (!log->is_attached) {
+        log->next = bytebeam_log_flusher_users;
+        bytebeam_log_flusher_users = log;
+        log->is_attached = true;
+    }
+
+    bytebeam_hal_mutex_unlock(bytebeam_log_flusher_lock);
+
+    return ret_val;
+}
+
+void bytebeam_log_flusher_stop(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_log_t *log = bytebeam_client->log;
+    bytebeam_log_t **link = &bytebeam_log_flusher_users;
+
+    // the bytebeam_log_* apis stop going through this client
+    bytebeam_log_client_clear(bytebeam_client);
+
+    if (log == NULL) {
+        return;
+    }
+
+    bytebeam_hal_mutex_lock(bytebeam_log_flusher_lock);
+
+    if (!log->is_attached) {
+        bytebeam_hal_mutex_unlock(bytebeam_log_flusher_lock);
+        return;
+    }
+
+    // publish the buffered logs while the mqtt client of this one is still around
+    if (__atomic_load_n(&is_log_flusher_running, __ATOMIC_ACQUIRE)) {
+        wait_log_ring_flushed();
+    }
+
+    while (*link != log) {
+        link = &(*link)->next;
+    }
+
+    *link = log->next;
+    log->next = NULL;
+    log->is_attached = false;
+
+    // the flusher may still be publishing a batch of this client it pinned before
+    while (bytebeam_log_flushing_client == bytebeam_client) {
+        bytebeam_hal_mutex_unlock(bytebeam_log_flusher_lock);
+        bytebeam_hal_delay_ms(10);
+        bytebeam_hal_mutex_lock(bytebeam_log_flusher_lock);
+    }
+
+    // the other clients still need their logs and heartbeats published, so only the last one stops the task
+    if (bytebeam_log_flusher_users == NULL && !is_log_flusher_stopped) {
+        __atomic_store_n(&is_log_flusher_running, false, __ATOMIC_RELEASE);
+        bytebeam_hal_task_notify(bytebeam_log_flusher);
+    }
+
+    bytebeam_hal_mutex_unlock(bytebeam_log_flusher_lock);
+}
+
+static bytebeam_err_t log_publish(bytebeam_client_t *bytebeam_client, const char *level, const char *tag, const char *fmt, va_list args)
+{
+    unsigned long long milliseconds = 0;
+
+    char log_string_json[BYTEBEAM_LOG_PAYLOAD_STR_LEN] = { 0 };
+    bytebeam_json_writer_t writer;
+    bytebeam_log_t *log = (bytebeam_client != NULL) ? bytebeam_client->log : NULL;
+
+    if(log == NULL)
+    {
+        BB_LOGE(TAG, "Bytebeam log client handle is not set");
         return BB_FAILURE;
     }
 
-    cJSON_AddItemToObject(device_log_json, "message", log_message_json);
+    // if cloud logging is disabled, we don't need to push just return :)
+    if(!log->is_cloud_logging_enabled) {
+      return BB_SUCCESS;
+    }
 
-    cJSON_AddItemToArray(device_log_json_list, device_log_json);
+    // hand the record over to the log flusher if it is running, no json or network work in the caller's task
+    if (__atomic_load_n(&is_log_flusher_running, __ATOMIC_ACQUIRE)) {
+        return log_ring_write(bytebeam_client, level, tag, fmt, args);
+    }
 
-    log_string_json = cJSON_Print(device_log_json_list);
+    milliseconds = bytebeam_hal_get_epoch_millis();
 
-    if(log_string_json == NULL)
+    if(milliseconds == 0)
     {
-        BB_LOGE(TAG, "Json string print failed.");
+        BB_LOGE(TAG, "failed to get epoch millis.");
+        return BB_FAILURE;
+    }
 
-        cJSON_Delete(device_log_json_list);
-        free(message_buffer);
+    log->sequence++;
+
+    if (bytebeam_client->sleep_cycle_cfg.is_enabled) {
+        bytebeam_log_sequence = log->sequence;
+    }
+
+    bytebeam_json_writer_init(&writer, log_string_json, sizeof(log_string_json));
+
+    bytebeam_json_begin_array(&writer, NULL);
+    bytebeam_json_begin_object(&writer, NULL);
+    bytebeam_json_add_uint(&writer, "timestamp", milliseconds);
+    bytebeam_json_add_uint(&writer, "sequence", log->sequence);
+    bytebeam_json_add_string(&writer, "level", level);
+    bytebeam_json_add_string(&writer, "tag", tag);
+
+    // format the message straight into the json, no intermediate message buffer needed. A message too long for the
+    // payload is cut short, leaving the space for closing the object and the array
+    bytebeam_json_add_vformat_truncated(&writer, "message", 2, fmt, args);
+
+    bytebeam_json_end_object(&writer);
+    bytebeam_json_end_array(&writer);
+
+    if(bytebeam_json_writer_finish(&writer) != BB_SUCCESS)
+    {
+        BB_LOGE(TAG, "Bytebeam Log size exceeded buffer size");
         return BB_FAILURE;
-    } 
+    }
 
     BB_LOGD(TAG, "\n Log to Send :\n%s\n", log_string_json);
 
-    int ret_val = bytebeam_publish_to_stream(bytebeam_log_client, bytebeam_log_stream, log_string_json);
+    int ret_val = bytebeam_publish_to_stream(bytebeam_client, log->stream, log_string_json);
 
-    cJSON_Delete(device_log_json_list);
-    cJSON_free(log_string_json);
-    free(message_buffer);
+    return ret_val;
+}
+
+bytebeam_err_t bytebeam_log_publish(const char *level, const char *tag, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    bytebeam_err_t ret_val = log_publish(__atomic_load_n(&bytebeam_log_client, __ATOMIC_ACQUIRE), level, tag, fmt, args);
+    va_end(args);
 
     return ret_val;
-}
\ No newline at end of file
+}
+
+bytebeam_err_t bytebeam_client_log_publish(bytebeam_client_t *bytebeam_client, const char *level, const char *tag, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    bytebeam_err_t ret_val = log_publish(bytebeam_client, level, tag, fmt, args);
+    va_end(args);
+
+    return ret_val;
+}
+
+bytebeam_err_t bytebeam_log_get_stats(bytebeam_log_stats_t *stats)
+{
+    if (stats == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    stats->queued_records = __atomic_load_n(&bytebeam_log_stats.queued_records, __ATOMIC_RELAXED);
+    stats->dropped_records = __atomic_load_n(&bytebeam_log_stats.dropped_records, __ATOMIC_RELAXED);
+    stats->published_records = __atomic_load_n(&bytebeam_log_stats.published_records, __ATOMIC_RELAXED);
+    stats->failed_records = __atomic_load_n(&bytebeam_log_stats.failed_records, __ATOMIC_RELAXED);
+
+    return BB_SUCCESS;
+}
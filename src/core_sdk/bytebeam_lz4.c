@@ -0,0 +1,142 @@
+#include <string.h>
+#include "bytebeam_lz4.h"
+
+/* Lz4 block format constraints, the last match has to start 12 bytes before the end and the last 5 bytes are literals */
+#define LZ4_MIN_MATCH       4
+#define LZ4_LAST_LITERALS   5
+#define LZ4_MF_LIMIT        12
+#define LZ4_MAX_OFFSET      65535
+
+static uint32_t read_u32(const uint8_t *p)
+{
+    uint32_t value = 0;
+
+    memcpy(&value, p, sizeof(value));
+
+    return value;
+}
+
+static uint32_t hash_position(const uint8_t *p)
+{
+    return (read_u32(p) * 2654435761u) >> (32 - BYTEBEAM_LZ4_HASH_LOG);
+}
+
+/* Writes the extra length bytes of a length that did not fit in its 4 bits of the token */
+static uint8_t *write_length(uint8_t *op, int len)
+{
+    while (len >= 255) {
+        *op++ = 255;
+        len = len - 255;
+    }
+
+    *op++ = (uint8_t)len;
+
+    return op;
+}
+
+/* Writes a sequence i.e. the literals followed by a match, a zero match length writes the literals only */
+static uint8_t *write_sequence(uint8_t *op, uint8_t *op_end, const uint8_t *literals, int literal_len, int offset, int match_len)
+{
+    int match_code = (match_len > 0) ? match_len - LZ4_MIN_MATCH : 0;
+
+    // worst case of the token, the length bytes, the literals and the offset
+    if (op + 1 + (literal_len / 255) + 1 + literal_len + 2 + (match_code / 255) + 1 > op_end) {
+        return NULL;
+    }
+
+    uint8_t *token = op++;
+
+    *token = (uint8_t)(((literal_len < 15) ? literal_len : 15) << 4);
+
+    if (literal_len >= 15) {
+        op = write_length(op, literal_len - 15);
+    }
+
+    memcpy(op, literals, literal_len);
+    op = op + literal_len;
+
+    if (match_len == 0) {
+        return op;
+    }
+
+    *op++ = (uint8_t)(offset & 0xFF);
+    *op++ = (uint8_t)(offset >> 8);
+
+    *token = *token | (uint8_t)((match_code < 15) ? match_code : 15);
+
+    if (match_code >= 15) {
+        op = write_length(op, match_code - 15);
+    }
+
+    return op;
+}
+
+int bytebeam_lz4_compress(const uint8_t *src, int src_len, uint8_t *dst, int dst_size, uint16_t *hash_table)
+{
+    int ip = 0;
+    int anchor = 0;
+    uint8_t *op = dst;
+    uint8_t *op_end = dst + dst_size;
+
+    if (src_len < 0 || src_len > BYTEBEAM_LZ4_MAX_INPUT_SIZE) {
+        return -1;
+    }
+
+    memset(hash_table, 0x00, BYTEBEAM_LZ4_HASH_TABLE_SIZE * sizeof(uint16_t));
+
+    if (src_len > LZ4_MF_LIMIT) {
+        int match_limit = src_len - LZ4_LAST_LITERALS;
+        int search_limit = src_len - LZ4_MF_LIMIT;
+
+        // position 0 is put in the table implicitly, as the table starts zeroed
+        ip = 1;
+
+        while (ip < search_limit) {
+            uint32_t hash = hash_position(src + ip);
+            int ref = hash_table[hash];
+
+            hash_table[hash] = (uint16_t)ip;
+
+            // the table may point anywhere, so the bytes are always compared
+            if (ip - ref > LZ4_MAX_OFFSET || read_u32(src + ref) != read_u32(src + ip)) {
+                // skip faster over the data that does not compress
+                ip = ip + 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            // a match often starts a few bytes before the hashed position
+            while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                ip--;
+                ref--;
+            }
+
+            int match_len = LZ4_MIN_MATCH;
+
+            while (ip + match_len < match_limit && src[ip + match_len] == src[ref + match_len]) {
+                match_len++;
+            }
+
+            op = write_sequence(op, op_end, src + anchor, ip - anchor, ip - ref, match_len);
+
+            if (op == NULL) {
+                return -1;
+            }
+
+            ip = ip + match_len;
+            anchor = ip;
+
+            // hashing a position inside the match finds the repetitions of its tail too
+            if (ip < search_limit) {
+                hash_table[hash_position(src + ip - 2)] = (uint16_t)(ip - 2);
+            }
+        }
+    }
+
+    op = write_sequence(op, op_end, src + anchor, src_len - anchor, 0, 0);
+
+    if (op == NULL) {
+        return -1;
+    }
+
+    return (int)(op - dst);
+}
@@ -0,0 +1,400 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bytebeam_hal.h"
+#include "bytebeam_internal.h"
+#include "bytebeam_json.h"
+#include "bytebeam_log.h"
+#include "bytebeam_stream.h"
+#include "bytebeam_delivery.h"
+#include "bytebeam_metrics.h"
+
+/* Maximum length of a histogram column name i.e. the histogram name followed by its suffix */
+#define METRICS_KEY_STR_LEN 48
+
+/* The metrics are plain 32 bit words updated with relaxed atomics, so recording one is a couple of instructions on
+ * any task without a lock. 32 bits keep the atomics lock free on the 32 bit targets.
+ */
+typedef struct bytebeam_metrics {
+    uint32_t counters[BYTEBEAM_METRIC_COUNTER_COUNT];
+    int32_t gauges[BYTEBEAM_METRIC_GAUGE_COUNT];
+    bytebeam_metric_histogram_value_t histograms[BYTEBEAM_METRIC_HISTOGRAM_COUNT];
+} bytebeam_metrics_t;
+
+static const char *counter_names[BYTEBEAM_METRIC_COUNTER_COUNT] = {
+    [BYTEBEAM_METRIC_STREAM_PUBLISHES]        = "stream_publishes",
+    [BYTEBEAM_METRIC_STREAM_PUBLISH_FAILURES] = "stream_publish_failures",
+    [BYTEBEAM_METRIC_STREAM_PUBLISH_BYTES]    = "stream_publish_bytes",
+    [BYTEBEAM_METRIC_STREAM_RATE_LIMITED]     = "stream_rate_limited",
+    [BYTEBEAM_METRIC_STREAM_COMPRESSED]       = "stream_compressed",
+    [BYTEBEAM_METRIC_MQTT_CONNECTS]           = "mqtt_connects",
+    [BYTEBEAM_METRIC_MQTT_DISCONNECTS]        = "mqtt_disconnects",
+    [BYTEBEAM_METRIC_ACTIONS_RECEIVED]        = "actions_received",
+    [BYTEBEAM_METRIC_ACTIONS_REJECTED]        = "actions_rejected",
+};
+
+static const char *gauge_names[BYTEBEAM_METRIC_GAUGE_COUNT] = {
+    [BYTEBEAM_METRIC_OUTBOX_BYTES]       = "outbox_bytes",
+    [BYTEBEAM_METRIC_PUBLISHES_INFLIGHT] = "publishes_inflight",
+    [BYTEBEAM_METRIC_ACTION_QUEUE_DEPTH] = "action_queue_depth",
+};
+
+static const char *histogram_names[BYTEBEAM_METRIC_HISTOGRAM_COUNT] = {
+    [BYTEBEAM_METRIC_PUBLISH_US]         = "publish_us",
+    [BYTEBEAM_METRIC_COMPRESS_US]        = "compress_us",
+    [BYTEBEAM_METRIC_LOG_FLUSH_US]       = "log_flush_us",
+    [BYTEBEAM_METRIC_ACTION_DISPATCH_MS] = "action_dispatch_ms",
+    [BYTEBEAM_METRIC_ACTION_RUN_MS]      = "action_run_ms",
+};
+
+// bytebeam metrics module variables
+static bytebeam_metrics_t bytebeam_metrics = { 0 };
+static uint64_t bytebeam_metrics_sequence = 0;
+
+/* The periodic publisher state is guarded by the client lock, which is created by the first interval set and never
+ * deleted. The pinned client is the one the log flusher task is publishing the metrics of without the lock held, a
+ * client is not cleared before the flusher lets go of it.
+ */
+static bytebeam_hal_mutex_t bytebeam_metrics_client_lock = NULL;
+static bytebeam_client_t *bytebeam_metrics_client = NULL;
+static bytebeam_client_t *bytebeam_metrics_pinned_client = NULL;
+static int bytebeam_metrics_interval_ms = 0;
+static long long bytebeam_metrics_last_publish_ms = 0;
+
+static const char *TAG = "BYTEBEAM_METRICS";
+
+static bytebeam_hal_mutex_t get_metrics_client_lock(void)
+{
+    bytebeam_hal_mutex_t expected = NULL;
+    bytebeam_hal_mutex_t lock = __atomic_load_n(&bytebeam_metrics_client_lock, __ATOMIC_ACQUIRE);
+
+    if (lock != NULL) {
+        return lock;
+    }
+
+    lock = bytebeam_hal_mutex_create();
+
+    if (lock == NULL) {
+        return NULL;
+    }
+
+    // two tasks may set the interval at the same time, the lock of the one coming second is thrown away
+    if (!__atomic_compare_exchange_n(&bytebeam_metrics_client_lock, &expected, lock, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        bytebeam_hal_mutex_delete(lock);
+        return expected;
+    }
+
+    return lock;
+}
+
+void bytebeam_metrics_count(bytebeam_metric_counter_t counter, uint32_t value)
+{
+    __atomic_fetch_add(&bytebeam_metrics.counters[counter], value, __ATOMIC_RELAXED);
+}
+
+void bytebeam_metrics_gauge(bytebeam_metric_gauge_t gauge, int32_t value)
+{
+    __atomic_store_n(&bytebeam_metrics.gauges[gauge], value, __ATOMIC_RELAXED);
+}
+
+void bytebeam_metrics_observe(bytebeam_metric_histogram_t histogram, long long value)
+{
+    int bucket = 0;
+    uint32_t bound = 1;
+    bytebeam_metric_histogram_value_t *metric = &bytebeam_metrics.histograms[histogram];
+
+    // the clocks may step back a little across the cores, nothing took negative time though
+    uint32_t observed = (value < 0) ? 0 : (value > UINT32_MAX) ? UINT32_MAX : (uint32_t)value;
+
+    while (bucket < BYTEBEAM_METRICS_HISTOGRAM_BUCKETS - 1 && observed > bound) {
+        bound = bound * 4;
+        bucket++;
+    }
+
+    __atomic_fetch_add(&metric->buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&metric->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&metric->sum, observed, __ATOMIC_RELAXED);
+
+    uint32_t max = __atomic_load_n(&metric->max, __ATOMIC_RELAXED);
+
+    while (observed > max) {
+        if (__atomic_compare_exchange_n(&metric->max, &max, observed, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+}
+
+const char *bytebeam_metrics_counter_name(bytebeam_metric_counter_t counter)
+{
+    if (counter < 0 || counter >= BYTEBEAM_METRIC_COUNTER_COUNT) {
+        return NULL;
+    }
+
+    return counter_names[counter];
+}
+
+const char *bytebeam_metrics_gauge_name(bytebeam_metric_gauge_t gauge)
+{
+    if (gauge < 0 || gauge >= BYTEBEAM_METRIC_GAUGE_COUNT) {
+        return NULL;
+    }
+
+    return gauge_names[gauge];
+}
+
+const char *bytebeam_metrics_histogram_name(bytebeam_metric_histogram_t histogram)
+{
+    if (histogram < 0 || histogram >= BYTEBEAM_METRIC_HISTOGRAM_COUNT) {
+        return NULL;
+    }
+
+    return histogram_names[histogram];
+}
+
+/* Copies the metrics out, taking the histograms over to the caller if reset is set */
+static void take_metrics(bytebeam_sdk_metrics_t *metrics, bool reset)
+{
+    int index = 0;
+    int bucket = 0;
+
+    for (index = 0; index < BYTEBEAM_METRIC_COUNTER_COUNT; index++) {
+        metrics->counters[index] = __atomic_load_n(&bytebeam_metrics.counters[index], __ATOMIC_RELAXED);
+    }
+
+    for (index = 0; index < BYTEBEAM_METRIC_GAUGE_COUNT; index++) {
+        metrics->gauges[index] = __atomic_load_n(&bytebeam_metrics.gauges[index], __ATOMIC_RELAXED);
+    }
+
+    for (index = 0; index < BYTEBEAM_METRIC_HISTOGRAM_COUNT; index++) {
+        bytebeam_metric_histogram_value_t *metric = &bytebeam_metrics.histograms[index];
+        bytebeam_metric_histogram_value_t *value = &metrics->histograms[index];
+
+        if (reset) {
+            value->count = __atomic_exchange_n(&metric->count, 0, __ATOMIC_RELAXED);
+            value->sum = __atomic_exchange_n(&metric->sum, 0, __ATOMIC_RELAXED);
+            value->max = __atomic_exchange_n(&metric->max, 0, __ATOMIC_RELAXED);
+        } else {
+            value->count = __atomic_load_n(&metric->count, __ATOMIC_RELAXED);
+            value->sum = __atomic_load_n(&metric->sum, __ATOMIC_RELAXED);
+            value->max = __atomic_load_n(&metric->max, __ATOMIC_RELAXED);
+        }
+
+        for (bucket = 0; bucket < BYTEBEAM_METRICS_HISTOGRAM_BUCKETS; bucket++) {
+            if (reset) {
+                value->buckets[bucket] = __atomic_exchange_n(&metric->buckets[bucket], 0, __ATOMIC_RELAXED);
+            } else {
+                value->buckets[bucket] = __atomic_load_n(&metric->buckets[bucket], __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+bytebeam_err_t bytebeam_get_sdk_metrics(bytebeam_sdk_metrics_t *metrics)
+{
+    if (metrics == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    take_metrics(metrics, false);
+
+    return BB_SUCCESS;
+}
+
+static void write_histogram(bytebeam_json_writer_t *writer, const char *name, const bytebeam_metric_histogram_value_t *value)
+{
+    int bucket = 0;
+    int length = 0;
+    char key[METRICS_KEY_STR_LEN];
+    char buckets[BYTEBEAM_METRICS_HISTOGRAM_BUCKETS * 11];
+
+    snprintf(key, sizeof(key), "%s_count", name);
+    bytebeam_json_add_uint(writer, key, value->count);
+
+    snprintf(key, sizeof(key), "%s_sum", name);
+    bytebeam_json_add_uint(writer, key, value->sum);
+
+    snprintf(key, sizeof(key), "%s_max", name);
+    bytebeam_json_add_uint(writer, key, value->max);
+
+    for (bucket = 0; bucket < BYTEBEAM_METRICS_HISTOGRAM_BUCKETS; bucket++) {
+        length = length + snprintf(buckets + length, sizeof(buckets) - length, (bucket == 0) ? "%u" : ",%u", (unsigned int)value->buckets[bucket]);
+    }
+
+    snprintf(key, sizeof(key), "%s_buckets", name);
+    bytebeam_json_add_string(writer, key, buckets);
+}
+
+bytebeam_err_t bytebeam_publish_sdk_metrics(bytebeam_client_t *bytebeam_client)
+{
+    if (bytebeam_client == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    int index = 0;
+    int ret_val = 0;
+    unsigned long long milliseconds = bytebeam_hal_get_epoch_millis();
+    bytebeam_sdk_metrics_t metrics;
+    bytebeam_log_stats_t log_stats;
+    bytebeam_delivery_stats_t delivery_stats = { 0 };
+    bytebeam_json_writer_t writer;
+
+    if (milliseconds == 0) {
+        BB_LOGE(TAG, "failed to get epoch millis.");
+        return BB_FAILURE;
+    }
+
+    // the gauges owned by the mqtt client are sampled rather than kept up to date on every change
+    if (bytebeam_client->client != NULL) {
+        bytebeam_metrics_gauge(BYTEBEAM_METRIC_OUTBOX_BYTES, bytebeam_hal_mqtt_get_outbox_size(bytebeam_client->client));
+    }
+
+    if (bytebeam_get_delivery_stats(bytebeam_client, &delivery_stats) == BB_SUCCESS) {
+        bytebeam_metrics_gauge(BYTEBEAM_METRIC_PUBLISHES_INFLIGHT, delivery_stats.inflight);
+    }
+
+    char *string_json = malloc(BYTEBEAM_METRICS_PAYLOAD_STR_LEN);
+
+    if (string_json == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for sdk metrics");
+        return BB_FAILURE;
+    }
+
+    take_metrics(&metrics, true);
+    bytebeam_log_get_stats(&log_stats);
+
+    bytebeam_json_writer_init(&writer, string_json, BYTEBEAM_METRICS_PAYLOAD_STR_LEN);
+
+    bytebeam_json_begin_array(&writer, NULL);
+    bytebeam_json_begin_object(&writer, NULL);
+    bytebeam_json_add_uint(&writer, "timestamp", milliseconds);
+    bytebeam_json_add_uint(&writer, "sequence", ++bytebeam_metrics_sequence);
+    bytebeam_json_add_int(&writer, "uptime_ms", bytebeam_hal_get_uptime_ms());
+
+    for (index = 0; index < BYTEBEAM_METRIC_COUNTER_COUNT; index++) {
+        bytebeam_json_add_uint(&writer, counter_names[index], metrics.counters[index]);
+    }
+
+    for (index = 0; index < BYTEBEAM_METRIC_GAUGE_COUNT; index++) {
+        bytebeam_json_add_int(&writer, gauge_names[index], metrics.gauges[index]);
+    }
+
+    for (index = 0; index < BYTEBEAM_METRIC_HISTOGRAM_COUNT; index++) {
+        write_histogram(&writer, histogram_names[index], &metrics.histograms[index]);
+    }
+
+    bytebeam_json_add_uint(&writer, "log_published", log_stats.published_records);
+    bytebeam_json_add_uint(&writer, "log_dropped", log_stats.dropped_records);
+    bytebeam_json_add_uint(&writer, "log_failed", log_stats.failed_records);
+    bytebeam_json_add_uint(&writer, "deliveries_acked", delivery_stats.acked);
+    bytebeam_json_add_uint(&writer, "deliveries_timed_out", delivery_stats.timed_out);
+
+    bytebeam_json_end_object(&writer);
+    bytebeam_json_end_array(&writer);
+
+    if (bytebeam_json_writer_finish(&writer) != BB_SUCCESS) {
+        BB_LOGE(TAG, "SDK metrics size exceeded buffer size");
+
+        free(string_json);
+        return BB_FAILURE;
+    }
+
+    ret_val = bytebeam_publish_to_stream(bytebeam_client, BYTEBEAM_METRICS_STREAM, string_json);
+
+    free(string_json);
+
+    return ret_val;
+}
+
+bytebeam_err_t bytebeam_set_sdk_metrics_interval(bytebeam_client_t *bytebeam_client, int interval_ms)
+{
+    if (bytebeam_client == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (interval_ms < 0) {
+        BB_LOGE(TAG, "Invalid sdk metrics interval %d ms", interval_ms);
+        return BB_FAILURE;
+    }
+
+    bytebeam_hal_mutex_t lock = get_metrics_client_lock();
+
+    if (lock == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for sdk metrics lock");
+        return BB_FAILURE;
+    }
+
+    bytebeam_hal_mutex_lock(lock);
+
+    bytebeam_metrics_client = bytebeam_client;
+    bytebeam_metrics_last_publish_ms = bytebeam_hal_get_uptime_ms();
+
+    __atomic_store_n(&bytebeam_metrics_interval_ms, interval_ms, __ATOMIC_RELEASE);
+
+    bytebeam_hal_mutex_unlock(lock);
+
+    return BB_SUCCESS;
+}
+
+void bytebeam_metrics_poll(void)
+{
+    bytebeam_hal_mutex_t lock = __atomic_load_n(&bytebeam_metrics_client_lock, __ATOMIC_ACQUIRE);
+
+    // the flusher polls every second, so skip the lock unless the periodic publish is on
+    if (lock == NULL || __atomic_load_n(&bytebeam_metrics_interval_ms, __ATOMIC_ACQUIRE) == 0) {
+        return;
+    }
+
+    bytebeam_hal_mutex_lock(lock);
+
+    bytebeam_client_t *bytebeam_client = bytebeam_metrics_client;
+    int interval_ms = __atomic_load_n(&bytebeam_metrics_interval_ms, __ATOMIC_ACQUIRE);
+    long long now = bytebeam_hal_get_uptime_ms();
+
+    if (bytebeam_client == NULL || interval_ms == 0 || now - bytebeam_metrics_last_publish_ms < interval_ms ||
+        bytebeam_client->connection_status != 1) {
+        bytebeam_hal_mutex_unlock(lock);
+        return;
+    }
+
+    // the metrics go out without the lock, bytebeam_metrics_client_clear waits for the pin to go
+    bytebeam_metrics_last_publish_ms = now;
+    bytebeam_metrics_pinned_client = bytebeam_client;
+
+    bytebeam_hal_mutex_unlock(lock);
+
+    if (bytebeam_publish_sdk_metrics(bytebeam_client) != BB_SUCCESS) {
+        BB_LOGE(TAG, "Failed to publish sdk metrics");
+    }
+
+    bytebeam_hal_mutex_lock(lock);
+    bytebeam_metrics_pinned_client = NULL;
+    bytebeam_hal_mutex_unlock(lock);
+}
+
+void bytebeam_metrics_client_clear(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_hal_mutex_t lock = __atomic_load_n(&bytebeam_metrics_client_lock, __ATOMIC_ACQUIRE);
+
+    // the interval was never set, so no client to clear
+    if (lock == NULL) {
+        return;
+    }
+
+    bytebeam_hal_mutex_lock(lock);
+
+    if (bytebeam_metrics_client == bytebeam_client) {
+        __atomic_store_n(&bytebeam_metrics_interval_ms, 0, __ATOMIC_RELEASE);
+        bytebeam_metrics_client = NULL;
+    }
+
+    // the flusher may still be publishing the metrics of this client, maybe from before another client was set
+    while (bytebeam_metrics_pinned_client == bytebeam_client) {
+        bytebeam_hal_mutex_unlock(lock);
+        bytebeam_hal_delay_ms(10);
+        bytebeam_hal_mutex_lock(lock);
+    }
+
+    bytebeam_hal_mutex_unlock(lock);
+}
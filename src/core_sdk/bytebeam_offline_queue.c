@@ -0,0 +1,915 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "bytebeam_hal.h"
+#include "bytebeam_internal.h"
+#include "bytebeam_stream.h"
+#include "bytebeam_offline_queue.h"
+
+/* Every record is stored as this header followed by the stream name and the payload (both without NULL character) */
+#define OFFLINE_RECORD_MAGIC 0xBB01
+
+/* Every segment file name starts with this prefix followed by the device id, so the clients can share a directory */
+#define OFFLINE_SEGMENT_PREFIX_STR_LEN (sizeof("bbq_") + BYTEBEAM_DEVICE_ID_STR_LEN)
+
+/* The segment file name appended to the base path, sized for the largest segment number */
+#define OFFLINE_SEGMENT_PATH_STR_LEN (BYTEBEAM_OFFLINE_QUEUE_PATH_STR_LEN + OFFLINE_SEGMENT_PREFIX_STR_LEN + sizeof("/4294967295.seg"))
+
+/* Marks the drain chunk as being published, the ack may arrive before the msg id is known */
+#define OFFLINE_INFLIGHT_NONE    -1
+#define OFFLINE_INFLIGHT_PENDING -2
+
+/* The number of acks remembered while the drain chunk is being published */
+#define OFFLINE_MAX_EARLY_ACKS 4
+
+typedef struct offline_record_header {
+    uint16_t magic;
+    uint16_t stream_len;
+    uint32_t payload_len;
+} offline_record_header_t;
+
+typedef enum {
+    DRAIN_CHUNK_READY,
+    DRAIN_CHUNK_SKIPPED,
+    DRAIN_CHUNK_SEGMENT_END,
+    DRAIN_CHUNK_WAIT,
+} drain_chunk_result_t;
+
+typedef struct bytebeam_offline_queue {
+    bytebeam_offline_queue_config_t config;
+    char base_path[BYTEBEAM_OFFLINE_QUEUE_PATH_STR_LEN];
+    char segment_prefix[OFFLINE_SEGMENT_PREFIX_STR_LEN];
+    bytebeam_hal_mutex_t lock;
+    FILE *write_file;
+    FILE *read_file;
+    unsigned int oldest_segment;
+    unsigned int newest_segment;
+    int newest_segment_size;
+    int read_offset;
+    int inflight_msg_id;
+    int inflight_offset;
+    int inflight_records;
+    bool is_inflight_dropped;
+    int early_acks[OFFLINE_MAX_EARLY_ACKS];
+    int next_early_ack;
+    char inflight_stream[BYTEBEAM_STREAM_NAME_STR_LEN];
+    char *drain_buffer;
+    int drain_length;
+    bool is_closed;
+    int users;
+    bool is_disabled;
+    bytebeam_offline_queue_stats_t stats;
+    struct bytebeam_offline_queue *next;
+} bytebeam_offline_queue_t;
+
+/* Guards the offline queue pointer of every client along with the users count of the queue, created by the first
+ * enable and never deleted
+ */
+static bytebeam_hal_mutex_t bytebeam_offline_queue_users_lock = NULL;
+
+/* The enabled queues of all the clients, guarded by the users lock. Two queues must never share their segment files. */
+static bytebeam_offline_queue_t *bytebeam_offline_queues = NULL;
+
+static const char *TAG = "BYTEBEAM_OFFLINE_QUEUE";
+
+static bytebeam_hal_mutex_t get_users_lock(void)
+{
+    bytebeam_hal_mutex_t expected = NULL;
+    bytebeam_hal_mutex_t lock = __atomic_load_n(&bytebeam_offline_queue_users_lock, __ATOMIC_ACQUIRE);
+
+    if (lock != NULL) {
+        return lock;
+    }
+
+    lock = bytebeam_hal_mutex_create();
+
+    if (lock == NULL) {
+        return NULL;
+    }
+
+    // two clients may enable their queues at the same time, the lock of the one coming second is thrown away
+    if (!__atomic_compare_exchange_n(&bytebeam_offline_queue_users_lock, &expected, lock, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        bytebeam_hal_mutex_delete(lock);
+        return expected;
+    }
+
+    return lock;
+}
+
+static void close_segment_files(bytebeam_offline_queue_t *queue)
+{
+    if (queue->write_file != NULL) {
+        fclose(queue->write_file);
+        queue->write_file = NULL;
+    }
+
+    if (queue->read_file != NULL) {
+        fclose(queue->read_file);
+        queue->read_file = NULL;
+    }
+}
+
+static void free_queue(bytebeam_offline_queue_t *queue)
+{
+    close_segment_files(queue);
+
+    if (queue->config.mount_spiffs) {
+        bytebeam_hal_spiffs_unmount();
+    }
+
+    bytebeam_hal_mutex_delete(queue->lock);
+    free(queue->drain_buffer);
+    free(queue);
+}
+
+/* The mqtt event handler and the publishing tasks may still be using the queue when it is disabled, so they take a
+ * reference on it and the last one to let go frees it.
+ */
+static bytebeam_offline_queue_t *acquire_queue(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_hal_mutex_t lock = __atomic_load_n(&bytebeam_offline_queue_users_lock, __ATOMIC_ACQUIRE);
+
+    // no queue was ever enabled
+    if (lock == NULL) {
+        return NULL;
+    }
+
+    bytebeam_hal_mutex_lock(lock);
+
+    bytebeam_offline_queue_t *queue = bytebeam_client->offline_queue;
+
+    if (queue != NULL) {
+        queue->users++;
+    }
+
+    bytebeam_hal_mutex_unlock(lock);
+
+    return queue;
+}
+
+static void release_queue(bytebeam_offline_queue_t *queue)
+{
+    bytebeam_hal_mutex_lock(bytebeam_offline_queue_users_lock);
+    queue->users--;
+    bool is_unused = queue->is_disabled && queue->users == 0;
+    bytebeam_hal_mutex_unlock(bytebeam_offline_queue_users_lock);
+
+    if (is_unused) {
+        free_queue(queue);
+    }
+}
+
+static void get_segment_path(bytebeam_offline_queue_t *queue, unsigned int segment, char *path)
+{
+    snprintf(path, OFFLINE_SEGMENT_PATH_STR_LEN, "%s/%s%08u.seg", queue->base_path, queue->segment_prefix, segment);
+}
+
+static int get_segment_size(bytebeam_offline_queue_t *queue, unsigned int segment)
+{
+    struct stat st;
+    char path[OFFLINE_SEGMENT_PATH_STR_LEN];
+
+    get_segment_path(queue, segment, path);
+
+    if (stat(path, &st) != 0) {
+        return 0;
+    }
+
+    return (int)st.st_size;
+}
+
+static unsigned int count_segment_records(bytebeam_offline_queue_t *queue, unsigned int segment, int offset)
+{
+    char path[OFFLINE_SEGMENT_PATH_STR_LEN];
+    offline_record_header_t header;
+    unsigned int records = 0;
+
+    get_segment_path(queue, segment, path);
+
+    FILE *file = fopen(path, "rb");
+
+    if (file == NULL) {
+        return 0;
+    }
+
+    while (fseek(file, offset, SEEK_SET) == 0 && fread(&header, sizeof(header), 1, file) == 1) {
+        if (header.magic != OFFLINE_RECORD_MAGIC) {
+            break;
+        }
+
+        offset = offset + sizeof(header) + header.stream_len + header.payload_len;
+        records++;
+    }
+
+    fclose(file);
+
+    return records;
+}
+
+/* Remove the oldest segment file, the caller must make sure it is not the segment being written */
+static void remove_oldest_segment(bytebeam_offline_queue_t *queue)
+{
+    char path[OFFLINE_SEGMENT_PATH_STR_LEN];
+
+    if (queue->read_file != NULL) {
+        fclose(queue->read_file);
+        queue->read_file = NULL;
+    }
+
+    get_segment_path(queue, queue->oldest_segment, path);
+
+    queue->stats.used_size = queue->stats.used_size - get_segment_size(queue, queue->oldest_segment);
+    remove(path);
+
+    BB_LOGD(TAG, "Removed segment %s", path);
+
+    queue->oldest_segment++;
+    queue->read_offset = 0;
+
+    // the records of the chunk being published are gone, so its ack must not move the read offset. A pending chunk
+    // still belongs to the task publishing it, that task lets go of it once the publish returns.
+    if (queue->inflight_msg_id == OFFLINE_INFLIGHT_PENDING) {
+        queue->is_inflight_dropped = true;
+    } else if (queue->inflight_msg_id != OFFLINE_INFLIGHT_NONE) {
+        queue->inflight_msg_id = OFFLINE_INFLIGHT_NONE;
+    }
+}
+
+/* Remove the only segment once all of its records are drained so the file system space is reclaimed */
+static void reset_newest_segment(bytebeam_offline_queue_t *queue)
+{
+    char path[OFFLINE_SEGMENT_PATH_STR_LEN];
+
+    close_segment_files(queue);
+    get_segment_path(queue, queue->newest_segment, path);
+    remove(path);
+
+    queue->stats.used_size = 0;
+    queue->newest_segment_size = 0;
+    queue->read_offset = 0;
+}
+
+static bool is_queue_empty(bytebeam_offline_queue_t *queue)
+{
+    return (queue->oldest_segment == queue->newest_segment) && (queue->read_offset >= queue->newest_segment_size);
+}
+
+static int discover_segments(bytebeam_offline_queue_t *queue)
+{
+    unsigned int segment = 0;
+    bool found = false;
+    struct dirent *entry = NULL;
+    size_t prefix_len = strlen(queue->segment_prefix);
+
+    DIR *dir = opendir(queue->base_path);
+
+    if (dir == NULL) {
+        BB_LOGE(TAG, "Failed to open %s directory", queue->base_path);
+        return -1;
+    }
+
+    queue->oldest_segment = 0;
+    queue->newest_segment = 0;
+    queue->stats.used_size = 0;
+
+    while ((entry = readdir(dir)) != NULL) {
+        // the segments of the other clients sharing the directory are left alone
+        if (strlen(entry->d_name) != prefix_len + 12 || strncmp(entry->d_name, queue->segment_prefix, prefix_len) != 0 ||
+            sscanf(entry->d_name + prefix_len, "%08u.seg", &segment) != 1) {
+            continue;
+        }
+
+        if (!found || segment < queue->oldest_segment) {
+            queue->oldest_segment = segment;
+        }
+
+        if (!found || segment > queue->newest_segment) {
+            queue->newest_segment = segment;
+        }
+
+        found = true;
+        queue->stats.used_size = queue->stats.used_size + get_segment_size(queue, segment);
+    }
+
+    closedir(dir);
+
+    if (found) {
+        /* Never append to the segments of the previous boot, their tail might be torn by a power loss. So the writes
+         * start at a fresh segment and the old ones are drained first.
+         */
+        queue->newest_segment++;
+        BB_LOGI(TAG, "Found queued records of %d bytes", queue->stats.used_size);
+    } else {
+        queue->oldest_segment = 1;
+        queue->newest_segment = 1;
+    }
+
+    queue->newest_segment_size = 0;
+    queue->read_offset = 0;
+
+    return 0;
+}
+
+static drain_chunk_result_t read_drain_chunk(bytebeam_offline_queue_t *queue)
+{
+    offline_record_header_t header;
+    char record_stream[BYTEBEAM_STREAM_NAME_STR_LEN];
+
+    char *buffer = queue->drain_buffer;
+    int buffer_size = queue->config.drain_size;
+    int offset = queue->read_offset;
+    int length = 1;
+    int records = 0;
+
+    buffer[0] = '[';
+    buffer[1] = '\0';
+
+    while (true) {
+        // the newest segment is still being written, so only the records written so far are valid
+        if (queue->oldest_segment == queue->newest_segment && offset >= queue->newest_segment_size) {
+            break;
+        }
+
+        if (fseek(queue->read_file, offset, SEEK_SET) != 0 || fread(&header, sizeof(header), 1, queue->read_file) != 1) {
+            break;
+        }
+
+        // a corrupt header means the rest of the segment is unusable (most probably a write torn by a power loss)
+        if (header.magic != OFFLINE_RECORD_MAGIC || header.stream_len == 0 || header.stream_len >= sizeof(record_stream)) {
+            BB_LOGE(TAG, "Corrupt record in segment %u at offset %d", queue->oldest_segment, offset);
+            break;
+        }
+
+        if (fread(record_stream, header.stream_len, 1, queue->read_file) != 1) {
+            break;
+        }
+
+        record_stream[header.stream_len] = '\0';
+
+        int record_size = sizeof(header) + header.stream_len + header.payload_len;
+
+        // a drained publish only carries records of one stream
+        if (records > 0 && strcmp(record_stream, queue->inflight_stream) != 0) {
+            break;
+        }
+
+        // read the payload past the separator slot, so that appending it moves the data backwards only
+        char *payload = buffer + length + 2;
+
+        if (length + 2 + (int)header.payload_len + 2 > buffer_size) {
+            if (records > 0) {
+                break;
+            }
+
+            BB_LOGE(TAG, "Dropping %s stream record of %u bytes, exceeded drain buffer size", record_stream, (unsigned int)header.payload_len);
+
+            queue->stats.dropped_records++;
+            queue->read_offset = offset + record_size;
+            return DRAIN_CHUNK_SKIPPED;
+        }
+
+        if (header.payload_len > 0 && fread(payload, header.payload_len, 1, queue->read_file) != 1) {
+            break;
+        }
+
+        payload[header.payload_len] = '\0';
+
+        int new_length = bytebeam_stream_array_append(buffer, buffer_size, length, payload);
+
+        if (new_length == -1) {
+            buffer[length] = '\0';
+
+            if (records > 0) {
+                break;
+            }
+
+            BB_LOGE(TAG, "Dropping malformed %s stream record", record_stream);
+
+            queue->stats.dropped_records++;
+            queue->read_offset = offset + record_size;
+            return DRAIN_CHUNK_SKIPPED;
+        }
+
+        if (records == 0) {
+            strcpy(queue->inflight_stream, record_stream);
+        }
+
+        length = new_length;
+        offset = offset + record_size;
+        records++;
+    }
+
+    if (records == 0) {
+        return (queue->oldest_segment == queue->newest_segment) ? DRAIN_CHUNK_WAIT : DRAIN_CHUNK_SEGMENT_END;
+    }
+
+    buffer[length] = ']';
+    buffer[length + 1] = '\0';
+
+    queue->drain_length = length + 1;
+    queue->inflight_offset = offset;
+    queue->inflight_records = records;
+
+    return DRAIN_CHUNK_READY;
+}
+
+static void clear_early_acks(bytebeam_offline_queue_t *queue)
+{
+    for (int index = 0; index < OFFLINE_MAX_EARLY_ACKS; index++) {
+        queue->early_acks[index] = OFFLINE_INFLIGHT_NONE;
+    }
+
+    queue->next_early_ack = 0;
+}
+
+static bool take_early_ack(bytebeam_offline_queue_t *queue, int msg_id)
+{
+    for (int index = 0; index < OFFLINE_MAX_EARLY_ACKS; index++) {
+        if (queue->early_acks[index] == msg_id) {
+            queue->early_acks[index] = OFFLINE_INFLIGHT_NONE;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void commit_drain_chunk(bytebeam_offline_queue_t *queue)
+{
+    queue->read_offset = queue->inflight_offset;
+    queue->stats.drained_records = queue->stats.drained_records + queue->inflight_records;
+    queue->inflight_msg_id = OFFLINE_INFLIGHT_NONE;
+
+    BB_LOGD(TAG, "Drained %d records of %s stream", queue->inflight_records, queue->inflight_stream);
+}
+
+/* Publish the next chunk of the queue unless one is already waiting for its ack. The lock is never held while
+ * publishing, so this can be called from the mqtt event handler as well as from the publishing tasks.
+ */
+static void drain_next_chunk(bytebeam_client_t *bytebeam_client, bytebeam_offline_queue_t *queue)
+{
+    char path[OFFLINE_SEGMENT_PATH_STR_LEN];
+
+    bytebeam_hal_mutex_lock(queue->lock);
+
+    while (!queue->is_closed && bytebeam_client->connection_status == 1 && queue->inflight_msg_id == OFFLINE_INFLIGHT_NONE) {
+        if (is_queue_empty(queue)) {
+            if (queue->newest_segment_size > 0) {
+                reset_newest_segment(queue);
+            }
+
+            break;
+        }
+
+        if (queue->read_file == NULL) {
+            get_segment_path(queue, queue->oldest_segment, path);
+            queue->read_file = fopen(path, "rb");
+
+            if (queue->read_file == NULL) {
+                if (queue->oldest_segment == queue->newest_segment) {
+                    break;
+                }
+
+                remove_oldest_segment(queue);
+                continue;
+            }
+        }
+
+        drain_chunk_result_t result = read_drain_chunk(queue);
+
+        if (result == DRAIN_CHUNK_SKIPPED) {
+            continue;
+        }
+
+        if (result == DRAIN_CHUNK_SEGMENT_END) {
+            remove_oldest_segment(queue);
+            continue;
+        }
+
+        if (result == DRAIN_CHUNK_WAIT) {
+            break;
+        }
+
+        // only this task moves the chunk out of pending, so the drain buffer stays untouched while it is published
+        queue->inflight_msg_id = OFFLINE_INFLIGHT_PENDING;
+        queue->is_inflight_dropped = false;
+        clear_early_acks(queue);
+
+        bytebeam_hal_mutex_unlock(queue->lock);
+
+        int msg_id = bytebeam_stream_publish_raw(bytebeam_client, queue->inflight_stream, queue->drain_buffer, queue->drain_length);
+
+        bytebeam_hal_mutex_lock(queue->lock);
+
+        // the chunk might have been dropped meanwhile to make space for the new records
+        if (queue->is_inflight_dropped) {
+            queue->is_inflight_dropped = false;
+            queue->inflight_msg_id = OFFLINE_INFLIGHT_NONE;
+            continue;
+        }
+
+        if (msg_id == -1) {
+            BB_LOGE(TAG, "Failed to publish drained %s stream records", queue->inflight_stream);
+
+            queue->inflight_msg_id = OFFLINE_INFLIGHT_NONE;
+            break;
+        }
+
+        if (take_early_ack(queue, msg_id)) {
+            commit_drain_chunk(queue);
+            continue;
+        }
+
+        queue->inflight_msg_id = msg_id;
+    }
+
+    bytebeam_hal_mutex_unlock(queue->lock);
+}
+
+bool bytebeam_offline_queue_is_active(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_offline_queue_t *queue = acquire_queue(bytebeam_client);
+
+    if (queue == NULL) {
+        return false;
+    }
+
+    bytebeam_hal_mutex_lock(queue->lock);
+    bool is_active = (bytebeam_client->connection_status == 0) || !is_queue_empty(queue);
+    bytebeam_hal_mutex_unlock(queue->lock);
+
+    release_queue(queue);
+
+    return is_active;
+}
+
+static bytebeam_err_t store_record(bytebeam_client_t *bytebeam_client, bytebeam_offline_queue_t *queue, char *stream_name, char *payload, int length)
+{
+    char path[OFFLINE_SEGMENT_PATH_STR_LEN];
+
+    offline_record_header_t header = {
+        .magic = OFFLINE_RECORD_MAGIC,
+        .stream_len = (uint16_t)strlen(stream_name),
+        .payload_len = (uint32_t)length
+    };
+
+    int record_size = sizeof(header) + header.stream_len + header.payload_len;
+
+    bytebeam_hal_mutex_lock(queue->lock);
+
+    // the queue got disabled while this record was on its way
+    if (queue->is_closed) {
+        bytebeam_hal_mutex_unlock(queue->lock);
+        return BB_FAILURE;
+    }
+
+    if (header.stream_len >= BYTEBEAM_STREAM_NAME_STR_LEN || record_size > queue->config.segment_size) {
+        BB_LOGE(TAG, "Dropping %s stream record, exceeded segment size", stream_name);
+
+        queue->stats.dropped_records++;
+        bytebeam_hal_mutex_unlock(queue->lock);
+        return BB_FAILURE;
+    }
+
+    // roll over to a new segment if the record does not fit in the current one
+    if (queue->newest_segment_size + record_size > queue->config.segment_size) {
+        if (queue->write_file != NULL) {
+            fclose(queue->write_file);
+            queue->write_file = NULL;
+        }
+
+        queue->newest_segment++;
+        queue->newest_segment_size = 0;
+    }
+
+    while (queue->stats.used_size + record_size > queue->config.max_size) {
+        if (queue->config.drop_policy == BYTEBEAM_OFFLINE_DROP_NEWEST || queue->oldest_segment == queue->newest_segment) {
+            queue->stats.dropped_records++;
+            bytebeam_hal_mutex_unlock(queue->lock);
+            return BB_FAILURE;
+        }
+
+        unsigned int dropped_records = count_segment_records(queue, queue->oldest_segment, queue->read_offset);
+
+        BB_LOGW(TAG, "Offline queue full, dropping %u oldest records", dropped_records);
+
+        queue->stats.dropped_records = queue->stats.dropped_records + dropped_records;
+        remove_oldest_segment(queue);
+    }
+
+    if (queue->write_file == NULL) {
+        get_segment_path(queue, queue->newest_segment, path);
+        queue->write_file = fopen(path, "ab");
+
+        if (queue->write_file == NULL) {
+            BB_LOGE(TAG, "Failed to open segment %s for writing", path);
+
+            queue->stats.dropped_records++;
+            bytebeam_hal_mutex_unlock(queue->lock);
+            return BB_FAILURE;
+        }
+    }
+
+    bool is_written = (fwrite(&header, sizeof(header), 1, queue->write_file) == 1) &&
+                      (fwrite(stream_name, header.stream_len, 1, queue->write_file) == 1) &&
+                      (length == 0 || fwrite(payload, length, 1, queue->write_file) == 1) &&
+                      (fflush(queue->write_file) == 0);
+
+    if (!is_written) {
+        BB_LOGE(TAG, "Failed to write %s stream record", stream_name);
+
+        // start over at a fresh segment, the partial record makes the rest of this one unreadable
+        fclose(queue->write_file);
+        queue->write_file = NULL;
+        queue->stats.used_size = queue->stats.used_size - queue->newest_segment_size + get_segment_size(queue, queue->newest_segment);
+        queue->newest_segment_size = queue->config.segment_size;
+        queue->stats.dropped_records++;
+
+        bytebeam_hal_mutex_unlock(queue->lock);
+        return BB_FAILURE;
+    }
+
+    queue->newest_segment_size = queue->newest_segment_size + record_size;
+    queue->stats.used_size = queue->stats.used_size + record_size;
+    queue->stats.stored_records++;
+
+    bytebeam_hal_mutex_unlock(queue->lock);
+
+    BB_LOGD(TAG, "Stored %s stream record of %d bytes", stream_name, length);
+
+    // the client might be connected with the drain stalled, so give it a kick
+    drain_next_chunk(bytebeam_client, queue);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_offline_queue_store(bytebeam_client_t *bytebeam_client, char *stream_name, char *payload, int length)
+{
+    bytebeam_offline_queue_t *queue = acquire_queue(bytebeam_client);
+
+    if (queue == NULL) {
+        return BB_FAILURE;
+    }
+
+    bytebeam_err_t err_code = store_record(bytebeam_client, queue, stream_name, payload, length);
+
+    release_queue(queue);
+
+    return err_code;
+}
+
+void bytebeam_offline_queue_on_connected(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_offline_queue_t *queue = acquire_queue(bytebeam_client);
+
+    if (queue == NULL) {
+        return;
+    }
+
+    drain_next_chunk(bytebeam_client, queue);
+    release_queue(queue);
+}
+
+void bytebeam_offline_queue_on_disconnected(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_offline_queue_t *queue = acquire_queue(bytebeam_client);
+
+    if (queue == NULL) {
+        return;
+    }
+
+    // the chunk is published again after reconnecting, the records are delivered atleast once
+    bytebeam_hal_mutex_lock(queue->lock);
+
+    if (queue->inflight_msg_id >= 0) {
+        queue->inflight_msg_id = OFFLINE_INFLIGHT_NONE;
+    }
+
+    bytebeam_hal_mutex_unlock(queue->lock);
+    release_queue(queue);
+}
+
+void bytebeam_offline_queue_on_published(bytebeam_client_t *bytebeam_client, int msg_id)
+{
+    bytebeam_offline_queue_t *queue = acquire_queue(bytebeam_client);
+
+    if (queue == NULL) {
+        return;
+    }
+
+    bytebeam_hal_mutex_lock(queue->lock);
+
+    if (queue->inflight_msg_id == msg_id) {
+        commit_drain_chunk(queue);
+    } else if (queue->inflight_msg_id == OFFLINE_INFLIGHT_PENDING) {
+        // the acks of other publishes may arrive before the one of the chunk, keep the latest few
+        queue->early_acks[queue->next_early_ack] = msg_id;
+        queue->next_early_ack = (queue->next_early_ack + 1) % OFFLINE_MAX_EARLY_ACKS;
+    }
+
+    bytebeam_hal_mutex_unlock(queue->lock);
+
+    drain_next_chunk(bytebeam_client, queue);
+    release_queue(queue);
+}
+
+bytebeam_err_t bytebeam_offline_queue_enable(bytebeam_client_t *bytebeam_client, const bytebeam_offline_queue_config_t *config)
+{
+    if (bytebeam_client == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    bytebeam_offline_queue_config_t default_config = BYTEBEAM_OFFLINE_QUEUE_DEFAULT_CONFIG();
+
+    if (config == NULL) {
+        config = &default_config;
+    }
+
+    if (config->base_path == NULL || config->segment_size <= 0 || config->max_size < 2 * config->segment_size || config->drain_size < 16) {
+        BB_LOGE(TAG, "Invalid offline queue config");
+        return BB_FAILURE;
+    }
+
+    bytebeam_hal_mutex_t users_lock = get_users_lock();
+    bytebeam_offline_queue_t *queue = calloc(1, sizeof(bytebeam_offline_queue_t));
+
+    if (users_lock == NULL || queue == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for offline queue");
+
+        free(queue);
+        return BB_FAILURE;
+    }
+
+    queue->config = *config;
+    queue->inflight_msg_id = OFFLINE_INFLIGHT_NONE;
+    clear_early_acks(queue);
+
+    int temp_var = snprintf(queue->base_path, sizeof(queue->base_path), "%s", config->base_path);
+
+    if (temp_var >= (int)sizeof(queue->base_path)) {
+        BB_LOGE(TAG, "Offline queue path size exceeded buffer size");
+
+        free(queue);
+        return BB_FAILURE;
+    }
+
+    queue->config.base_path = queue->base_path;
+
+    // the device config is loaded by the init, the segment files of every device are named apart
+    if (bytebeam_client->device_cfg.device_id[0] == '\0') {
+        BB_LOGE(TAG, "Device id is needed for the offline queue, initialize the client first");
+
+        free(queue);
+        return BB_FAILURE;
+    }
+
+    snprintf(queue->segment_prefix, sizeof(queue->segment_prefix), "bbq%s_", bytebeam_client->device_cfg.device_id);
+
+    queue->drain_buffer = malloc(config->drain_size);
+    queue->lock = bytebeam_hal_mutex_create();
+
+    if (queue->drain_buffer == NULL || queue->lock == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for offline queue");
+
+        if (queue->lock != NULL) {
+            bytebeam_hal_mutex_delete(queue->lock);
+        }
+
+        free(queue->drain_buffer);
+        free(queue);
+        return BB_FAILURE;
+    }
+
+    if (config->mount_spiffs && bytebeam_hal_spiffs_mount() != 0) {
+        BB_LOGE(TAG, "Failed to mount SPIFFS for offline queue");
+
+        bytebeam_hal_mutex_delete(queue->lock);
+        free(queue->drain_buffer);
+        free(queue);
+        return BB_FAILURE;
+    }
+
+    if (discover_segments(queue) != 0) {
+        free_queue(queue);
+        return BB_FAILURE;
+    }
+
+    bytebeam_hal_mutex_lock(users_lock);
+
+    bool is_enabled = (bytebeam_client->offline_queue != NULL);
+    bool is_path_in_use = false;
+
+    for (bytebeam_offline_queue_t *other = bytebeam_offline_queues; other != NULL; other = other->next) {
+        if (strcmp(other->base_path, queue->base_path) == 0 && strcmp(other->segment_prefix, queue->segment_prefix) == 0) {
+            is_path_in_use = true;
+        }
+    }
+
+    if (!is_enabled && !is_path_in_use) {
+        // the enabling task holds a reference until the first drain is done
+        queue->users = 1;
+        queue->next = bytebeam_offline_queues;
+        bytebeam_offline_queues = queue;
+        bytebeam_client->offline_queue = queue;
+    }
+
+    bytebeam_hal_mutex_unlock(users_lock);
+
+    if (is_enabled) {
+        BB_LOGE(TAG, "Offline queue is already enabled");
+
+        free_queue(queue);
+        return BB_FAILURE;
+    }
+
+    if (is_path_in_use) {
+        BB_LOGE(TAG, "Offline queue of device %s at %s is in use by another client", bytebeam_client->device_cfg.device_id, queue->base_path);
+
+        free_queue(queue);
+        return BB_FAILURE;
+    }
+
+    BB_LOGI(TAG, "Offline queue enabled at %s/%s*", queue->base_path, queue->segment_prefix);
+
+    // drain the records of the previous boot if we are already connected
+    drain_next_chunk(bytebeam_client, queue);
+    release_queue(queue);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_offline_queue_disable(bytebeam_client_t *bytebeam_client)
+{
+    if (bytebeam_client == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    bytebeam_hal_mutex_t users_lock = __atomic_load_n(&bytebeam_offline_queue_users_lock, __ATOMIC_ACQUIRE);
+
+    if (users_lock == NULL) {
+        return BB_SUCCESS;
+    }
+
+    bytebeam_hal_mutex_lock(users_lock);
+
+    bytebeam_offline_queue_t *queue = bytebeam_client->offline_queue;
+
+    if (queue != NULL) {
+        // keep it alive until the segment files are closed below
+        queue->users++;
+        queue->is_disabled = true;
+        bytebeam_client->offline_queue = NULL;
+
+        // the segment files are closed below, so another client may take them over from here on
+        for (bytebeam_offline_queue_t **link = &bytebeam_offline_queues; *link != NULL; link = &(*link)->next) {
+            if (*link == queue) {
+                *link = queue->next;
+                break;
+            }
+        }
+    }
+
+    bytebeam_hal_mutex_unlock(users_lock);
+
+    if (queue == NULL) {
+        return BB_SUCCESS;
+    }
+
+    // the tasks still holding the queue finish their current call, but read or write no further records
+    bytebeam_hal_mutex_lock(queue->lock);
+    queue->is_closed = true;
+    close_segment_files(queue);
+    bytebeam_hal_mutex_unlock(queue->lock);
+
+    release_queue(queue);
+
+    BB_LOGI(TAG, "Offline queue disabled");
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_offline_queue_get_stats(bytebeam_client_t *bytebeam_client, bytebeam_offline_queue_stats_t *stats)
+{
+    if (bytebeam_client == NULL || stats == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    bytebeam_offline_queue_t *queue = acquire_queue(bytebeam_client);
+
+    if (queue == NULL) {
+        return BB_FAILURE;
+    }
+
+    bytebeam_hal_mutex_lock(queue->lock);
+    *stats = queue->stats;
+    bytebeam_hal_mutex_unlock(queue->lock);
+
+    release_queue(queue);
+
+    return BB_SUCCESS;
+}
@@ -1,66 +1,55 @@
-#include "cJSON.h"
-#include "nvs.h"
-#include "nvs_flash.h"
+#include <stdlib.h>
 #include "bytebeam_hal.h"
+#include "bytebeam_json.h"
 #include "bytebeam_action.h"
 #include "bytebeam_ota.h"
 
-char *ota_action_id = "";
-char ota_error_str[BYTEBEAM_OTA_ERROR_STR_LEN] = "";
-
 static const char *TAG = "BYTEBEAM_OTA";
 
 static int parse_ota_json(char *payload_string, char *url_string_return)
 {   
-    cJSON *pl_json = NULL;
-    const cJSON *url = NULL;
-    const cJSON *version = NULL;
+    int url = -1;
+    int version = -1;
+    int token_count = 0;
+    bytebeam_json_token_t tokens[BYTEBEAM_OTA_JSON_TOKEN_COUNT];
 
-    pl_json = cJSON_Parse(payload_string);
+    token_count = bytebeam_json_parse(payload_string, strlen(payload_string), tokens, BYTEBEAM_OTA_JSON_TOKEN_COUNT);
 
-    if (pl_json == NULL) {
+    if (token_count < 1 || tokens[0].type != BYTEBEAM_JSON_OBJECT) {
         BB_LOGE(TAG, "ERROR in parsing the OTA JSON\n");
 
         return -1;
     }
 
-    url = cJSON_GetObjectItem(pl_json, "url");
+    url = bytebeam_json_find(payload_string, tokens, token_count, 0, "url");
 
-    if (cJSON_IsString(url) && (url->valuestring != NULL)) {
-        BB_LOGI(TAG, "Checking url \"%s\"\n", url->valuestring);
+    if (url != -1 && tokens[url].type == BYTEBEAM_JSON_STRING) {
+        BB_LOGI(TAG, "Checking url \"%.*s\"\n", tokens[url].end - tokens[url].start, payload_string + tokens[url].start);
     } else {
         BB_LOGE(TAG, "URL parsing failed");
 
-        cJSON_Delete(pl_json);
         return -1;
     }
 
-    version = cJSON_GetObjectItem(pl_json, "version");
+    version = bytebeam_json_find(payload_string, tokens, token_count, 0, "version");
 
-    if (cJSON_IsString(version) && (version->valuestring != NULL)) {
-        BB_LOGI(TAG, "Checking version \"%s\"\n", version->valuestring);
+    if (version != -1 && tokens[version].type == BYTEBEAM_JSON_STRING) {
+        BB_LOGI(TAG, "Checking version \"%.*s\"\n", tokens[version].end - tokens[version].start, payload_string + tokens[version].start);
     } else {
         BB_LOGE(TAG, "FW version parsing failed");
 
-        cJSON_Delete(pl_json);
         return -1;
     }
 
-    int max_len = BYTEBAM_OTA_URL_STR_LEN;
-    int temp_var = snprintf(url_string_return, max_len, "%s", url->valuestring);
-
-    if(temp_var >= max_len)
+    if(bytebeam_json_get_string(payload_string, &tokens[url], url_string_return, BYTEBAM_OTA_URL_STR_LEN) != BB_SUCCESS)
     {
         BB_LOGE(TAG, "FW update URL exceeded buffer size");
 
-        cJSON_Delete(pl_json);
         return -1;
     }
 
     BB_LOGI(TAG, "The constructed URL is: %s", url_string_return);
 
-    cJSON_Delete(pl_json);
-    
     return 0;
 }
 
@@ -70,70 +59,21 @@ static int perform_ota(bytebeam_client_t *bytebeam_client, char *action_id, char
     BB_LOGI(TAG, "Starting OTA.....");
 
     if ((bytebeam_hal_ota(bytebeam_client, ota_url)) != -1) {
-        esp_err_t err;
-        nvs_handle_t nvs_handle;
-        int32_t update_flag = 1;
-        int32_t action_id_val = (int32_t)(atoi(ota_action_id));
-
-        err = nvs_flash_init();
-
-        if(err != ESP_OK)
-        {
-            BB_LOGE(TAG, "NVS flash init failed.");
-            return -1;
-        }
-
-        err = nvs_open("test_storage", NVS_READWRITE, &nvs_handle);
-
-        if (err != ESP_OK) 
-        {
-            BB_LOGE(TAG, "Failed to open NVS Storage");
-            return -1;
-        }
-
-        err = nvs_set_i32(nvs_handle, "update_flag", update_flag);
-
-        if (err != ESP_OK) 
-        {
-            BB_LOGE(TAG, "Failed to set the OTA update flag in NVS");
-            return -1;
-        }
-
-        err = nvs_commit(nvs_handle);
-
-        if (err != ESP_OK) 
-        {
-            BB_LOGE(TAG, "Failed to commit the OTA update flag in NVS");
-            return -1;
-        }
-
-        nvs_set_i32(nvs_handle, "action_id_val", action_id_val);
-
-        if (err != ESP_OK) 
-        {
-            BB_LOGE(TAG, "Failed to set the OTA action id in NVS");
+        // the completed OTA is reported after the restart, from the new firmware
+        if (bytebeam_hal_ota_mark_updated(bytebeam_client, atoi(action_id)) != 0) {
             return -1;
         }
 
-        err = nvs_commit(nvs_handle);
-
-        if (err != ESP_OK) 
-        {
-            BB_LOGE(TAG, "Failed to commit the OTA action id in NVS");
-            return -1;
-        }
-
-        nvs_close(nvs_handle);
         bytebeam_hal_restart();
     } else {
         BB_LOGE(TAG, "Firmware Upgrade Failed");
 
-        if ((bytebeam_publish_action_status(bytebeam_client, action_id, 0, "Failed", ota_error_str)) != 0) {
+        if ((bytebeam_publish_action_status(bytebeam_client, action_id, 0, "Failed", bytebeam_client->ota_error_str)) != 0) {
             BB_LOGE(TAG, "Failed to publish negative response for Firmware upgrade failure");
         }
 
         // clear the OTA error
-        memset(ota_error_str, 0x00, sizeof(ota_error_str));
+        memset(bytebeam_client->ota_error_str, 0x00, sizeof(bytebeam_client->ota_error_str));
 
         return -1;
     }
@@ -155,9 +95,14 @@ bytebeam_err_t handle_ota(bytebeam_client_t *bytebeam_client, char *payload_stri
         return BB_FAILURE;
     }
 
-    ota_action_id = action_id;
+    // the hal reports the download progress against this action
+    bytebeam_client->ota_action_id = action_id;
+
+    int ret_val = perform_ota(bytebeam_client, action_id, constructed_url);
+
+    bytebeam_client->ota_action_id = NULL;
 
-    if ((perform_ota(bytebeam_client, action_id, constructed_url)) == -1) {
+    if (ret_val == -1) {
         return BB_FAILURE;
     }
 
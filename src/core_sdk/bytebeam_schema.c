@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "bytebeam_hal.h"
+#include "bytebeam_schema.h"
+
+/* Value of a field read out of the record struct, the member decides which one is set */
+typedef struct schema_value {
+    long long i;
+    unsigned long long u;
+    double d;
+    float f;
+    bool b;
+    const char *s;
+} schema_value_t;
+
+static const char *TAG = "BYTEBEAM_SCHEMA";
+
+/* Reads the field out of the record, the members are copied out as the record need not be aligned. Returns -1 if a
+ * char array string is not NULL terminated.
+ */
+static int read_field(const bytebeam_schema_field_t *field, const uint8_t *record, schema_value_t *value)
+{
+    const uint8_t *member = record + field->offset;
+
+    switch (field->type) {
+        case BYTEBEAM_SCHEMA_INT8   : { int8_t v;   memcpy(&v, member, sizeof(v)); value->i = v; break; }
+        case BYTEBEAM_SCHEMA_INT16  : { int16_t v;  memcpy(&v, member, sizeof(v)); value->i = v; break; }
+        case BYTEBEAM_SCHEMA_INT32  : { int32_t v;  memcpy(&v, member, sizeof(v)); value->i = v; break; }
+        case BYTEBEAM_SCHEMA_INT64  : { int64_t v;  memcpy(&v, member, sizeof(v)); value->i = v; break; }
+        case BYTEBEAM_SCHEMA_UINT8  : { uint8_t v;  memcpy(&v, member, sizeof(v)); value->u = v; break; }
+        case BYTEBEAM_SCHEMA_UINT16 : { uint16_t v; memcpy(&v, member, sizeof(v)); value->u = v; break; }
+        case BYTEBEAM_SCHEMA_UINT32 : { uint32_t v; memcpy(&v, member, sizeof(v)); value->u = v; break; }
+        case BYTEBEAM_SCHEMA_UINT64 : { uint64_t v; memcpy(&v, member, sizeof(v)); value->u = v; break; }
+        case BYTEBEAM_SCHEMA_FLOAT  : memcpy(&value->f, member, sizeof(value->f)); break;
+        case BYTEBEAM_SCHEMA_DOUBLE : memcpy(&value->d, member, sizeof(value->d)); break;
+        case BYTEBEAM_SCHEMA_BOOL   : memcpy(&value->b, member, sizeof(value->b)); break;
+
+        case BYTEBEAM_SCHEMA_STRING:
+            if (memchr(member, '\0', field->size) == NULL) {
+                BB_LOGE(TAG, "%s field is not NULL terminated", field->name);
+                return -1;
+            }
+
+            value->s = (const char *)member;
+            break;
+
+        case BYTEBEAM_SCHEMA_STRING_PTR:
+            memcpy(&value->s, member, sizeof(value->s));
+            break;
+
+        default:
+            BB_LOGE(TAG, "%s field has unknown type %d", field->name, field->type);
+            return -1;
+    }
+
+    return 0;
+}
+
+/* Writes the float with the fewest digits that read back as the same float, the double formatting of the json writer
+ * would spell out the float rounding error instead e.g. 23.100000381469727 for 23.1f
+ */
+static bytebeam_err_t write_json_float(bytebeam_json_writer_t *writer, const char *key, float value)
+{
+    char number[24];
+    int precision = 0;
+
+    if (isnan(value) || isinf(value)) {
+        return bytebeam_json_add_null(writer, key);
+    }
+
+    for (precision = 6; precision < 9; precision++) {
+        snprintf(number, sizeof(number), "%1.*g", precision, (double)value);
+
+        if (strtof(number, NULL) == value) {
+            break;
+        }
+    }
+
+    // 9 significant digits always survive the round trip
+    if (precision == 9) {
+        snprintf(number, sizeof(number), "%1.9g", (double)value);
+    }
+
+    return bytebeam_json_add_raw(writer, key, number);
+}
+
+static bytebeam_err_t write_json_record(bytebeam_json_writer_t *writer, const bytebeam_schema_t *schema, const uint8_t *record)
+{
+    int index = 0;
+    schema_value_t value;
+
+    bytebeam_json_begin_object(writer, NULL);
+
+    for (index = 0; index < schema->field_count; index++) {
+        const bytebeam_schema_field_t *field = &schema->fields[index];
+
+        if (read_field(field, record, &value) != 0) {
+            return BB_FAILURE;
+        }
+
+        switch (field->type) {
+            case BYTEBEAM_SCHEMA_INT8:
+            case BYTEBEAM_SCHEMA_INT16:
+            case BYTEBEAM_SCHEMA_INT32:
+            case BYTEBEAM_SCHEMA_INT64:
+                bytebeam_json_add_int(writer, field->name, value.i);
+                break;
+
+            case BYTEBEAM_SCHEMA_UINT8:
+            case BYTEBEAM_SCHEMA_UINT16:
+            case BYTEBEAM_SCHEMA_UINT32:
+            case BYTEBEAM_SCHEMA_UINT64:
+                bytebeam_json_add_uint(writer, field->name, value.u);
+                break;
+
+            case BYTEBEAM_SCHEMA_FLOAT  : write_json_float(writer, field->name, value.f);       break;
+            case BYTEBEAM_SCHEMA_DOUBLE : bytebeam_json_add_double(writer, field->name, value.d); break;
+            case BYTEBEAM_SCHEMA_BOOL   : bytebeam_json_add_bool(writer, field->name, value.b);   break;
+
+            default:
+                bytebeam_json_add_string(writer, field->name, value.s);
+                break;
+        }
+    }
+
+    return bytebeam_json_end_object(writer);
+}
+
+static bytebeam_err_t write_cbor_record(bytebeam_cbor_writer_t *writer, const bytebeam_schema_t *schema, const uint8_t *record)
+{
+    int index = 0;
+    schema_value_t value;
+
+    bytebeam_cbor_begin_map(writer, NULL);
+
+    for (index = 0; index < schema->field_count; index++) {
+        const bytebeam_schema_field_t *field = &schema->fields[index];
+
+        if (read_field(field, record, &value) != 0) {
+            return BB_FAILURE;
+        }
+
+        switch (field->type) {
+            case BYTEBEAM_SCHEMA_INT8:
+            case BYTEBEAM_SCHEMA_INT16:
+            case BYTEBEAM_SCHEMA_INT32:
+            case BYTEBEAM_SCHEMA_INT64:
+                bytebeam_cbor_add_int(writer, field->name, value.i);
+                break;
+
+            case BYTEBEAM_SCHEMA_UINT8:
+            case BYTEBEAM_SCHEMA_UINT16:
+            case BYTEBEAM_SCHEMA_UINT32:
+            case BYTEBEAM_SCHEMA_UINT64:
+                bytebeam_cbor_add_uint(writer, field->name, value.u);
+                break;
+
+            case BYTEBEAM_SCHEMA_FLOAT  : bytebeam_cbor_add_float(writer, field->name, value.f);  break;
+            case BYTEBEAM_SCHEMA_DOUBLE : bytebeam_cbor_add_double(writer, field->name, value.d); break;
+            case BYTEBEAM_SCHEMA_BOOL   : bytebeam_cbor_add_bool(writer, field->name, value.b);   break;
+
+            default:
+                bytebeam_cbor_add_string(writer, field->name, value.s);
+                break;
+        }
+    }
+
+    return bytebeam_cbor_end_map(writer);
+}
+
+bytebeam_err_t bytebeam_schema_write_json(bytebeam_json_writer_t *writer, const bytebeam_schema_t *schema, const void *records, int count)
+{
+    if (writer == NULL || schema == NULL || records == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    int index = 0;
+    const uint8_t *record = records;
+
+    for (index = 0; index < count; index++) {
+        if (write_json_record(writer, schema, record) != BB_SUCCESS) {
+            return BB_FAILURE;
+        }
+
+        record = record + schema->record_size;
+    }
+
+    return bytebeam_json_writer_finish(writer);
+}
+
+bytebeam_err_t bytebeam_schema_write_cbor(bytebeam_cbor_writer_t *writer, const bytebeam_schema_t *schema, const void *records, int count)
+{
+    if (writer == NULL || schema == NULL || records == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    int index = 0;
+    const uint8_t *record = records;
+
+    for (index = 0; index < count; index++) {
+        if (write_cbor_record(writer, schema, record) != BB_SUCCESS) {
+            return BB_FAILURE;
+        }
+
+        record = record + schema->record_size;
+    }
+
+    return bytebeam_cbor_writer_finish(writer);
+}
+
+/* Writes the record as the next element of the batch's json array, straight after the records already in the buffer */
+static int append_batch_record(bytebeam_stream_batch_t *batch, const bytebeam_schema_t *schema, const void *record)
+{
+    bytebeam_json_writer_t writer;
+
+    // reserve space for the closing bracket, the writer itself keeps the space for the NULL character
+    bytebeam_json_writer_init(&writer, batch->buffer + batch->length, batch->config.max_size - batch->length - 1);
+
+    // the buffer always starts with the opening bracket, so anything beyond it is an element
+    writer.need_comma = (batch->length > 1);
+
+    if (bytebeam_schema_write_json(&writer, schema, record, 1) != BB_SUCCESS) {
+        // drop whatever part of the record made it into the buffer
+        batch->buffer[batch->length] = '\0';
+        return -1;
+    }
+
+    return batch->length + writer.length;
+}
+
+bytebeam_err_t bytebeam_stream_batch_append_record(bytebeam_stream_batch_t *batch, const bytebeam_schema_t *schema, const void *record)
+{
+    if (batch == NULL || schema == NULL || record == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (batch->buffer == NULL) {
+        BB_LOGE(TAG, "Stream batch is not initialized");
+        return BB_FAILURE;
+    }
+
+    int length = append_batch_record(batch, schema, record);
+
+    // if the record does not fit, flush the pending records and try again with the empty batch
+    if (length == -1 && batch->record_count > 0) {
+        if (bytebeam_stream_batch_flush(batch) != BB_SUCCESS) {
+            return BB_FAILURE;
+        }
+
+        length = append_batch_record(batch, schema, record);
+    }
+
+    if (length == -1) {
+        BB_LOGE(TAG, "Record could not be written into %s stream batch", batch->stream_name);
+        return BB_FAILURE;
+    }
+
+    if (batch->record_count == 0) {
+        batch->first_record_ms = bytebeam_hal_get_uptime_ms();
+    }
+
+    batch->length = length;
+    batch->record_count++;
+
+    if (batch->config.max_records > 0 && batch->record_count >= batch->config.max_records) {
+        return bytebeam_stream_batch_flush(batch);
+    }
+
+    return bytebeam_stream_batch_poll(batch);
+}
@@ -0,0 +1,712 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytebeam_hal.h"
+#include "bytebeam_internal.h"
+#include "bytebeam_json.h"
+#include "bytebeam_stream.h"
+#include "bytebeam_shadow.h"
+
+typedef enum {
+    SHADOW_FIELD_STRING,
+    SHADOW_FIELD_INT,
+    SHADOW_FIELD_DOUBLE,
+    SHADOW_FIELD_BOOL,
+} shadow_field_type_t;
+
+typedef struct bytebeam_shadow_field {
+    char name[BYTEBEAM_SHADOW_FIELD_NAME_LEN];
+    shadow_field_type_t type;
+    union {
+        char s[BYTEBEAM_SHADOW_STRING_LEN];
+        long long i;
+        double d;
+        bool b;
+    } value;
+    bool is_changed;
+    unsigned int change_count;
+    unsigned int sent_change_count;
+} bytebeam_shadow_field_t;
+
+/* Last sent state of the device shadow. The fields keep their values across the heartbeats, a field is marked as
+ * changed when it is set to a different value and goes out with the next heartbeat. The payload buffer is allocated
+ * along with the shadow, so a heartbeat does not allocate anything.
+ *
+ * The lock guards the fields and is never held across a publish, so setting a field does not wait for the network.
+ * The publish lock hands the payload buffer to one heartbeat at a time, and the users count the flusher publishes
+ * still going out for a shadow taken off the heartbeat list.
+ */
+typedef struct bytebeam_shadow {
+    bytebeam_hal_mutex_t lock;
+    bytebeam_hal_mutex_t publish_lock;
+    bytebeam_shadow_config_t config;
+    bytebeam_shadow_field_t fields[BYTEBEAM_SHADOW_MAX_FIELDS];
+    int field_count;
+    uint64_t sequence;
+    int deltas_since_full;
+    bool needs_full;
+    unsigned int full_request_count;
+    long long next_heartbeat_ms;
+    bytebeam_client_t *bytebeam_client;
+    struct bytebeam_shadow *next;
+    bool is_listed;
+    int users;
+    char payload[BYTEBEAM_DEVICE_HEARTBEAT_STR_LEN];
+} bytebeam_shadow_t;
+
+/* The shadows with a heartbeat interval are kept in a list, which the log flusher task walks to pick the due
+ * heartbeats of all the clients. The list lock is created along with the first shadow and kept for the lifetime of
+ * the application, so the flusher can take it at any time. It is never held across a publish.
+ */
+static bytebeam_hal_mutex_t bytebeam_shadow_list_lock = NULL;
+static bytebeam_shadow_t *bytebeam_shadow_list = NULL;
+
+// the heartbeat sequence of the sleep cycle mode carries on across deep sleep, so the heartbeats stay in order
+static BB_RETAINED uint64_t bytebeam_shadow_sequence = 0;
+
+static const char *TAG = "BYTEBEAM_SHADOW";
+
+static const char *get_reset_reason_str(void)
+{
+    switch(bytebeam_hal_get_reset_reason()) {
+        case BB_RST_UNKNOWN   : return "Unknown Reset";
+        case BB_RST_POWERON   : return "Power On Reset";
+        case BB_RST_EXT       : return "External Pin Reset";
+        case BB_RST_SW        : return "Software Reset";
+        case BB_RST_PANIC     : return "Hard Fault Reset";
+        case BB_RST_INT_WDT   : return "Interrupt Watchdog Reset";
+        case BB_RST_TASK_WDT  : return "Task Watchdog Reset";
+        case BB_RST_WDT       : return "Other Watchdog Reset";
+        case BB_RST_DEEPSLEEP : return "Exiting Deep Sleep Reset";
+        case BB_RST_BROWNOUT  : return "Brownout Reset";
+        case BB_RST_SDIO      : return "SDIO Reset";
+
+        default: return "Unknown Reset Id";
+    }
+}
+
+static bytebeam_hal_mutex_t get_shadow_list_lock(void)
+{
+    bytebeam_hal_mutex_t expected = NULL;
+    bytebeam_hal_mutex_t lock = __atomic_load_n(&bytebeam_shadow_list_lock, __ATOMIC_ACQUIRE);
+
+    if (lock != NULL) {
+        return lock;
+    }
+
+    lock = bytebeam_hal_mutex_create();
+
+    if (lock == NULL) {
+        return NULL;
+    }
+
+    // two clients may be initialized at the same time, the lock of the one coming second is thrown away
+    if (!__atomic_compare_exchange_n(&bytebeam_shadow_list_lock, &expected, lock, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        bytebeam_hal_mutex_delete(lock);
+        return expected;
+    }
+
+    return lock;
+}
+
+/* Adds the shadow to the heartbeat list or takes it out of there, the caller holds the list lock */
+static void set_shadow_listed(bytebeam_shadow_t *shadow, bool is_listed)
+{
+    bytebeam_shadow_t **link = &bytebeam_shadow_list;
+
+    if (shadow->is_listed == is_listed) {
+        return;
+    }
+
+    if (is_listed) {
+        shadow->next = bytebeam_shadow_list;
+        bytebeam_shadow_list = shadow;
+    } else {
+        while (*link != shadow) {
+            link = &(*link)->next;
+        }
+
+        *link = shadow->next;
+        shadow->next = NULL;
+    }
+
+    shadow->is_listed = is_listed;
+}
+
+/* Marks the field to go out with the next heartbeat, the caller holds the shadow lock. The change count tells whether
+ * the field changed again while its heartbeat was going out.
+ */
+static void set_field_changed(bytebeam_shadow_field_t *field)
+{
+    field->is_changed = true;
+    field->change_count++;
+}
+
+/* Finds the field, adding it if there is none yet. The caller holds the shadow lock. */
+static bytebeam_shadow_field_t *get_shadow_field(bytebeam_shadow_t *shadow, const char *name, shadow_field_type_t type)
+{
+    int index = 0;
+
+    for (index = 0; index < shadow->field_count; index++) {
+        if (!strcmp(shadow->fields[index].name, name)) {
+            // a field set with another type counts as changed
+            if (shadow->fields[index].type != type) {
+                memset(&shadow->fields[index].value, 0x00, sizeof(shadow->fields[index].value));
+                shadow->fields[index].type = type;
+                set_field_changed(&shadow->fields[index]);
+            }
+
+            return &shadow->fields[index];
+        }
+    }
+
+    if (strlen(name) >= BYTEBEAM_SHADOW_FIELD_NAME_LEN) {
+        BB_LOGE(TAG, "Shadow field name %s exceeded buffer size", name);
+        return NULL;
+    }
+
+    if (shadow->field_count == BYTEBEAM_SHADOW_MAX_FIELDS) {
+        BB_LOGE(TAG, "No room for shadow field %s", name);
+        return NULL;
+    }
+
+    bytebeam_shadow_field_t *field = &shadow->fields[shadow->field_count++];
+
+    memset(field, 0x00, sizeof(bytebeam_shadow_field_t));
+    strcpy(field->name, name);
+    field->type = type;
+    set_field_changed(field);
+
+    return field;
+}
+
+/* Sets the string field, the caller holds the shadow lock. The device info strings are truncated rather than refused,
+ * as the heartbeat always carried them whatever their length.
+ */
+static int set_shadow_string(bytebeam_shadow_t *shadow, const char *name, const char *value, bool truncate)
+{
+    if (!truncate && strlen(value) >= BYTEBEAM_SHADOW_STRING_LEN) {
+        BB_LOGE(TAG, "Shadow field %s value exceeded buffer size", name);
+        return -1;
+    }
+
+    bytebeam_shadow_field_t *field = get_shadow_field(shadow, name, SHADOW_FIELD_STRING);
+
+    if (field == NULL) {
+        return -1;
+    }
+
+    if (strncmp(field->value.s, value, BYTEBEAM_SHADOW_STRING_LEN - 1) != 0) {
+        snprintf(field->value.s, sizeof(field->value.s), "%s", value);
+        set_field_changed(field);
+    }
+
+    return 0;
+}
+
+/* Picks up the changes the application made to the device info since the last heartbeat */
+static void sync_device_info(bytebeam_client_t *bytebeam_client, bytebeam_shadow_t *shadow)
+{
+    bytebeam_device_info_t *device_info = &bytebeam_client->device_info;
+
+    // if status is not provided append the dummy one showing device activity
+    if (device_info->status == NULL) {
+        device_info->status = "Device is Active!";
+    }
+
+    set_shadow_string(shadow, "Status", device_info->status, true);
+
+    if (device_info->software_type != NULL) {
+        set_shadow_string(shadow, "Software_Type", device_info->software_type, true);
+    }
+
+    if (device_info->software_version != NULL) {
+        set_shadow_string(shadow, "Software_Version", device_info->software_version, true);
+    }
+
+    if (device_info->hardware_type != NULL) {
+        set_shadow_string(shadow, "Hardware_Type", device_info->hardware_type, true);
+    }
+
+    if (device_info->hardware_version != NULL) {
+        set_shadow_string(shadow, "Hardware_Version", device_info->hardware_version, true);
+    }
+}
+
+/* Random offset of a heartbeat deadline, either within [-jitter, +jitter] or, for a one sided one, within [0, jitter] */
+static long long get_heartbeat_jitter_ms(const bytebeam_shadow_config_t *config, bool is_one_sided)
+{
+    long long jitter_ms = (long long)config->heartbeat_interval_ms * config->jitter_percent / 100;
+
+    if (jitter_ms == 0) {
+        return 0;
+    }
+
+    if (is_one_sided) {
+        return bytebeam_hal_random() % (jitter_ms + 1);
+    }
+
+    return (long long)(bytebeam_hal_random() % (2 * jitter_ms + 1)) - jitter_ms;
+}
+
+/* Moves the heartbeat deadline one interval on from now, the caller holds the shadow lock */
+static void schedule_heartbeat(bytebeam_shadow_t *shadow, long long now)
+{
+    shadow->next_heartbeat_ms = now + shadow->config.heartbeat_interval_ms + get_heartbeat_jitter_ms(&shadow->config, false);
+}
+
+/* Claims the heartbeat if it is due within the window, so that the flusher and a batch flush never both publish it */
+static bool claim_heartbeat(bytebeam_shadow_t *shadow, long long now, long long window_ms, long long *due_in_ms)
+{
+    bool is_claimed = false;
+
+    bytebeam_hal_mutex_lock(shadow->lock);
+
+    if (shadow->next_heartbeat_ms - now <= window_ms) {
+        schedule_heartbeat(shadow, now);
+        is_claimed = true;
+    }
+
+    *due_in_ms = shadow->next_heartbeat_ms - now;
+
+    bytebeam_hal_mutex_unlock(shadow->lock);
+
+    return is_claimed;
+}
+
+int bytebeam_shadow_start(bytebeam_client_t *bytebeam_client)
+{
+    if (bytebeam_client->shadow != NULL) {
+        return 0;
+    }
+
+    bytebeam_shadow_t *shadow = calloc(1, sizeof(bytebeam_shadow_t));
+
+    if (shadow == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for device shadow");
+        return -1;
+    }
+
+    shadow->lock = bytebeam_hal_mutex_create();
+    shadow->publish_lock = bytebeam_hal_mutex_create();
+
+    if (shadow->lock == NULL || shadow->publish_lock == NULL || get_shadow_list_lock() == NULL) {
+        BB_LOGE(TAG, "Failed to create the device shadow lock");
+
+        if (shadow->lock != NULL) {
+            bytebeam_hal_mutex_delete(shadow->lock);
+        }
+
+        if (shadow->publish_lock != NULL) {
+            bytebeam_hal_mutex_delete(shadow->publish_lock);
+        }
+
+        free(shadow);
+        return -1;
+    }
+
+    bytebeam_shadow_config_t config = BYTEBEAM_SHADOW_DEFAULT_CONFIG();
+
+    shadow->config = config;
+    shadow->bytebeam_client = bytebeam_client;
+    shadow->needs_full = true;
+
+    if (bytebeam_client->sleep_cycle_cfg.is_enabled) {
+        shadow->sequence = bytebeam_shadow_sequence;
+    }
+
+    // the reset reason does not change until the next boot, so it is looked up just once
+    set_shadow_string(shadow, "Reset_Reason", get_reset_reason_str(), true);
+
+    bytebeam_client->shadow = shadow;
+
+    return 0;
+}
+
+void bytebeam_shadow_stop(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_shadow_t *shadow = bytebeam_client->shadow;
+
+    if (shadow == NULL) {
+        return;
+    }
+
+    bytebeam_hal_mutex_lock(bytebeam_shadow_list_lock);
+    set_shadow_listed(shadow, false);
+
+    // the flusher may still be publishing a heartbeat it picked before, which needs the mqtt client of this one
+    while (shadow->users > 0) {
+        bytebeam_hal_mutex_unlock(bytebeam_shadow_list_lock);
+        bytebeam_hal_delay_ms(10);
+        bytebeam_hal_mutex_lock(bytebeam_shadow_list_lock);
+    }
+
+    bytebeam_hal_mutex_unlock(bytebeam_shadow_list_lock);
+}
+
+void bytebeam_shadow_free(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_shadow_t *shadow = bytebeam_client->shadow;
+
+    if (shadow == NULL) {
+        return;
+    }
+
+    bytebeam_shadow_stop(bytebeam_client);
+    bytebeam_hal_mutex_delete(shadow->publish_lock);
+    bytebeam_hal_mutex_delete(shadow->lock);
+    free(shadow);
+
+    bytebeam_client->shadow = NULL;
+}
+
+void bytebeam_shadow_on_connected(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_shadow_t *shadow = bytebeam_client->shadow;
+
+    if (shadow == NULL) {
+        return;
+    }
+
+    // the deltas sent before the disconnect may never have made it, so start over with a full snapshot
+    bytebeam_hal_mutex_lock(shadow->lock);
+    shadow->needs_full = true;
+    shadow->full_request_count++;
+
+    // after a broker restart the whole fleet connects at once, so the first heartbeats are spread over the jitter
+    shadow->next_heartbeat_ms = bytebeam_hal_get_uptime_ms() + get_heartbeat_jitter_ms(&shadow->config, true);
+    bytebeam_hal_mutex_unlock(shadow->lock);
+}
+
+bytebeam_err_t bytebeam_shadow_set_config(bytebeam_client_t *bytebeam_client, const bytebeam_shadow_config_t *config)
+{
+    if (bytebeam_client == NULL || config == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    bytebeam_shadow_t *shadow = bytebeam_client->shadow;
+
+    if (shadow == NULL) {
+        BB_LOGE(TAG, "Bytebeam client is not initialized");
+        return BB_FAILURE;
+    }
+
+    if (config->heartbeat_interval_ms < 0 || config->full_snapshot_every < 0 ||
+        config->jitter_percent < 0 || config->jitter_percent > 50 ||
+        config->coalesce_percent < 0 || config->coalesce_percent > 100) {
+        BB_LOGE(TAG, "Invalid device shadow config");
+        return BB_FAILURE;
+    }
+
+    bytebeam_hal_mutex_lock(shadow->lock);
+    shadow->config = *config;
+    schedule_heartbeat(shadow, bytebeam_hal_get_uptime_ms());
+    bytebeam_hal_mutex_unlock(shadow->lock);
+
+    // only the shadows with a heartbeat interval are walked by the flusher
+    bytebeam_hal_mutex_lock(bytebeam_shadow_list_lock);
+    set_shadow_listed(shadow, config->heartbeat_interval_ms > 0);
+    bytebeam_hal_mutex_unlock(bytebeam_shadow_list_lock);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_shadow_set_string(bytebeam_client_t *bytebeam_client, const char *name, const char *value)
+{
+    if (bytebeam_client == NULL || name == NULL || value == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    bytebeam_shadow_t *shadow = bytebeam_client->shadow;
+
+    if (shadow == NULL) {
+        BB_LOGE(TAG, "Bytebeam client is not initialized");
+        return BB_FAILURE;
+    }
+
+    bytebeam_hal_mutex_lock(shadow->lock);
+    int ret_val = set_shadow_string(shadow, name, value, false);
+    bytebeam_hal_mutex_unlock(shadow->lock);
+
+    return (ret_val == 0) ? BB_SUCCESS : BB_FAILURE;
+}
+
+bytebeam_err_t bytebeam_shadow_set_int(bytebeam_client_t *bytebeam_client, const char *name, long long value)
+{
+    if (bytebeam_client == NULL || name == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    bytebeam_shadow_t *shadow = bytebeam_client->shadow;
+
+    if (shadow == NULL) {
+        BB_LOGE(TAG, "Bytebeam client is not initialized");
+        return BB_FAILURE;
+    }
+
+    bytebeam_hal_mutex_lock(shadow->lock);
+
+    bytebeam_shadow_field_t *field = get_shadow_field(shadow, name, SHADOW_FIELD_INT);
+
+    if (field != NULL && field->value.i != value) {
+        field->value.i = value;
+        set_field_changed(field);
+    }
+
+    bytebeam_hal_mutex_unlock(shadow->lock);
+
+    return (field != NULL) ? BB_SUCCESS : BB_FAILURE;
+}
+
+bytebeam_err_t bytebeam_shadow_set_double(bytebeam_client_t *bytebeam_client, const char *name, double value)
+{
+    if (bytebeam_client == NULL || name == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    bytebeam_shadow_t *shadow = bytebeam_client->shadow;
+
+    if (shadow == NULL) {
+        BB_LOGE(TAG, "Bytebeam client is not initialized");
+        return BB_FAILURE;
+    }
+
+    bytebeam_hal_mutex_lock(shadow->lock);
+
+    bytebeam_shadow_field_t *field = get_shadow_field(shadow, name, SHADOW_FIELD_DOUBLE);
+
+    // compare the bits, so that a NaN does not count as changed every time
+    if (field != NULL && memcmp(&field->value.d, &value, sizeof(value)) != 0) {
+        field->value.d = value;
+        set_field_changed(field);
+    }
+
+    bytebeam_hal_mutex_unlock(shadow->lock);
+
+    return (field != NULL) ? BB_SUCCESS : BB_FAILURE;
+}
+
+bytebeam_err_t bytebeam_shadow_set_bool(bytebeam_client_t *bytebeam_client, const char *name, bool value)
+{
+    if (bytebeam_client == NULL || name == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    bytebeam_shadow_t *shadow = bytebeam_client->shadow;
+
+    if (shadow == NULL) {
+        BB_LOGE(TAG, "Bytebeam client is not initialized");
+        return BB_FAILURE;
+    }
+
+    bytebeam_hal_mutex_lock(shadow->lock);
+
+    bytebeam_shadow_field_t *field = get_shadow_field(shadow, name, SHADOW_FIELD_BOOL);
+
+    if (field != NULL && field->value.b != value) {
+        field->value.b = value;
+        set_field_changed(field);
+    }
+
+    bytebeam_hal_mutex_unlock(shadow->lock);
+
+    return (field != NULL) ? BB_SUCCESS : BB_FAILURE;
+}
+
+static void write_shadow_field(bytebeam_json_writer_t *writer, const bytebeam_shadow_field_t *field)
+{
+    switch (field->type) {
+        case SHADOW_FIELD_STRING : bytebeam_json_add_string(writer, field->name, field->value.s); break;
+        case SHADOW_FIELD_INT    : bytebeam_json_add_int(writer, field->name, field->value.i);    break;
+        case SHADOW_FIELD_DOUBLE : bytebeam_json_add_double(writer, field->name, field->value.d); break;
+        case SHADOW_FIELD_BOOL   : bytebeam_json_add_bool(writer, field->name, field->value.b);   break;
+    }
+}
+
+bytebeam_err_t bytebeam_shadow_publish(bytebeam_client_t *bytebeam_client, bool full)
+{
+    if (bytebeam_client == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    bytebeam_shadow_t *shadow = bytebeam_client->shadow;
+
+    if (shadow == NULL) {
+        BB_LOGE(TAG, "Bytebeam client is not initialized");
+        return BB_FAILURE;
+    }
+
+    int index = 0;
+    int ret_val = 0;
+    unsigned int full_request_count = 0;
+    unsigned long long milliseconds = bytebeam_hal_get_epoch_millis();
+    bytebeam_json_writer_t writer;
+
+    if (milliseconds == 0) {
+        BB_LOGE(TAG, "failed to get epoch millis.");
+        return BB_FAILURE;
+    }
+
+    bytebeam_hal_mutex_lock(shadow->publish_lock);
+    bytebeam_hal_mutex_lock(shadow->lock);
+
+    sync_device_info(bytebeam_client, shadow);
+
+    full = full || shadow->needs_full || shadow->deltas_since_full >= shadow->config.full_snapshot_every;
+    full_request_count = shadow->full_request_count;
+
+    shadow->sequence++;
+
+    if (bytebeam_client->sleep_cycle_cfg.is_enabled) {
+        bytebeam_shadow_sequence = shadow->sequence;
+    }
+
+    bytebeam_json_writer_init(&writer, shadow->payload, sizeof(shadow->payload));
+
+    bytebeam_json_begin_array(&writer, NULL);
+    bytebeam_json_begin_object(&writer, NULL);
+    bytebeam_json_add_uint(&writer, "timestamp", milliseconds);
+    bytebeam_json_add_uint(&writer, "sequence", shadow->sequence);
+    bytebeam_json_add_int(&writer, "Uptime", bytebeam_hal_get_uptime_ms());
+
+    for (index = 0; index < shadow->field_count; index++) {
+        if (full || shadow->fields[index].is_changed) {
+            write_shadow_field(&writer, &shadow->fields[index]);
+            shadow->fields[index].sent_change_count = shadow->fields[index].change_count;
+        }
+    }
+
+    bytebeam_json_end_object(&writer);
+    bytebeam_json_end_array(&writer);
+
+    if (bytebeam_json_writer_finish(&writer) != BB_SUCCESS) {
+        bytebeam_hal_mutex_unlock(shadow->lock);
+        bytebeam_hal_mutex_unlock(shadow->publish_lock);
+
+        BB_LOGE(TAG, "Device heartbeat size exceeded buffer size");
+        return BB_FAILURE;
+    }
+
+    // the payload is complete, so the fields are free to change while the heartbeat goes out
+    bytebeam_hal_mutex_unlock(shadow->lock);
+
+    BB_LOGD(TAG, "\nStatus to send:\n%s\n", shadow->payload);
+
+    // the heartbeat is what tells the device is alive, so neither the rate limit nor the outbox watermarks hold it back
+    ret_val = bytebeam_stream_publish_unlimited(bytebeam_client, BYTEBEAM_SHADOW_STREAM, shadow->payload);
+
+    bytebeam_hal_mutex_lock(shadow->lock);
+
+    // the changes stay marked until they make it out, a failed heartbeat just sends them along with the next one, and
+    // so does a field set again while this one was going out
+    if (ret_val == BB_SUCCESS) {
+        for (index = 0; index < shadow->field_count; index++) {
+            if (shadow->fields[index].change_count == shadow->fields[index].sent_change_count) {
+                shadow->fields[index].is_changed = false;
+            }
+        }
+
+        if (full) {
+            // a reconnect while the heartbeat was going out asks for another full snapshot
+            shadow->needs_full = (shadow->full_request_count != full_request_count);
+            shadow->deltas_since_full = 0;
+        } else {
+            shadow->deltas_since_full++;
+        }
+    }
+
+    bytebeam_hal_mutex_unlock(shadow->lock);
+    bytebeam_hal_mutex_unlock(shadow->publish_lock);
+
+    return ret_val;
+}
+
+int bytebeam_publish_device_heartbeat(bytebeam_client_t *bytebeam_client)
+{
+    return bytebeam_shadow_publish(bytebeam_client, true);
+}
+
+void bytebeam_shadow_on_stream_flush(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_shadow_t *shadow = bytebeam_client->shadow;
+    long long window_ms = 0;
+    long long due_in_ms = 0;
+
+    if (shadow == NULL) {
+        return;
+    }
+
+    bytebeam_hal_mutex_lock(shadow->lock);
+    window_ms = (long long)shadow->config.heartbeat_interval_ms * shadow->config.coalesce_percent / 100;
+    bytebeam_hal_mutex_unlock(shadow->lock);
+
+    // the radio is awake for the batch anyway, so a heartbeat due soon goes out now rather than on its own later
+    if (window_ms == 0 || !claim_heartbeat(shadow, bytebeam_hal_get_uptime_ms(), window_ms, &due_in_ms)) {
+        return;
+    }
+
+    BB_LOGD(TAG, "Device heartbeat coalesced with stream batch flush");
+
+    if (bytebeam_shadow_publish(bytebeam_client, false) != BB_SUCCESS) {
+        BB_LOGE(TAG, "Failed to publish device heartbeat");
+    }
+}
+
+int bytebeam_shadow_poll(void)
+{
+    bytebeam_hal_mutex_t lock = __atomic_load_n(&bytebeam_shadow_list_lock, __ATOMIC_ACQUIRE);
+    bytebeam_shadow_t *shadow = NULL;
+    long long next_due_ms = -1;
+    long long due_in_ms = 0;
+
+    if (lock == NULL) {
+        return -1;
+    }
+
+    bytebeam_hal_mutex_lock(lock);
+
+    shadow = bytebeam_shadow_list;
+
+    while (shadow != NULL) {
+        // a connect schedules the next heartbeat anyway, so there is nothing to wait for while disconnected
+        if (shadow->bytebeam_client->connection_status != 1) {
+            shadow = shadow->next;
+            continue;
+        }
+
+        if (claim_heartbeat(shadow, bytebeam_hal_get_uptime_ms(), 0, &due_in_ms)) {
+            // the heartbeat goes out without the list lock, so a slow broker holds up neither the other clients nor
+            // bytebeam_shadow_stop, which waits for the pin to go before the client can go away
+            shadow->users++;
+            bytebeam_hal_mutex_unlock(lock);
+
+            if (bytebeam_shadow_publish(shadow->bytebeam_client, false) != BB_SUCCESS) {
+                BB_LOGE(TAG, "Failed to publish device heartbeat");
+            }
+
+            bytebeam_hal_mutex_lock(lock);
+            shadow->users--;
+
+            // the list may have changed meanwhile, so walk it again, the claimed heartbeats are not due anymore
+            shadow = bytebeam_shadow_list;
+            next_due_ms = -1;
+            continue;
+        }
+
+        if (next_due_ms == -1 || due_in_ms < next_due_ms) {
+            next_due_ms = due_in_ms;
+        }
+
+        shadow = shadow->next;
+    }
+
+    bytebeam_hal_mutex_unlock(lock);
+
+    return (next_due_ms > INT_MAX) ? INT_MAX : (int)next_due_ms;
+}
@@ -0,0 +1,103 @@
+#include "bytebeam_hal.h"
+#include "bytebeam_internal.h"
+#include "bytebeam_offline_queue.h"
+#include "bytebeam_sleep_cycle.h"
+
+/* The wake up count lives in the memory retained across deep sleep, along with the heartbeat, log and action status
+ * sequences, everything else of the sdk starts over on every wake up. It is counted once per bytebeam_init, so the
+ * cadences below are in wake ups rather than in connects.
+ */
+static BB_RETAINED uint32_t bytebeam_wake_count = 0;
+
+static const char *TAG = "BYTEBEAM_SLEEP_CYCLE";
+
+/* Tells whether this wake up is one of every nth, the first wake up after power on always is. */
+static bool is_cadence_due(int every, int default_every)
+{
+    if (every <= 0) {
+        every = default_every;
+    }
+
+    return bytebeam_wake_count == 0 || ((bytebeam_wake_count - 1) % (uint32_t)every) == 0;
+}
+
+static bool is_flushed(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_offline_queue_stats_t stats;
+
+    if (bytebeam_client->connection_status != 1) {
+        return false;
+    }
+
+    // the buffered logs go to the outbox first, so they have to be out of the log ring before the outbox counts
+    if (!bytebeam_log_flush_ring()) {
+        return false;
+    }
+
+    if (bytebeam_client->offline_queue != NULL &&
+        bytebeam_offline_queue_get_stats(bytebeam_client, &stats) == BB_SUCCESS && stats.used_size > 0) {
+        return false;
+    }
+
+    return bytebeam_hal_mqtt_get_outbox_size(bytebeam_client->client) == 0;
+}
+
+void bytebeam_sleep_cycle_on_init(bytebeam_client_t *bytebeam_client)
+{
+    if (!bytebeam_client->sleep_cycle_cfg.is_enabled) {
+        return;
+    }
+
+    bytebeam_wake_count++;
+
+    BB_LOGI(TAG, "Wake up %u in sleep cycle mode", (unsigned int)bytebeam_wake_count);
+}
+
+bool bytebeam_sleep_cycle_should_subscribe(bytebeam_client_t *bytebeam_client, bool session_present)
+{
+    // without the session the broker forgot the subscription as well
+    if (!bytebeam_client->sleep_cycle_cfg.is_enabled || !session_present) {
+        return true;
+    }
+
+    return is_cadence_due(bytebeam_client->sleep_cycle_cfg.subscribe_every, BYTEBEAM_SLEEP_CYCLE_SUBSCRIBE_EVERY);
+}
+
+bool bytebeam_sleep_cycle_should_publish_heartbeat(bytebeam_client_t *bytebeam_client)
+{
+    if (!bytebeam_client->sleep_cycle_cfg.is_enabled) {
+        return true;
+    }
+
+    return is_cadence_due(bytebeam_client->sleep_cycle_cfg.heartbeat_every, BYTEBEAM_SLEEP_CYCLE_HEARTBEAT_EVERY);
+}
+
+bytebeam_err_t bytebeam_flush(bytebeam_client_t *bytebeam_client, int timeout_ms)
+{
+    if (bytebeam_client == NULL) {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (bytebeam_client->client == NULL) {
+        BB_LOGE(TAG, "Bytebeam client is not initialized");
+        return BB_FAILURE;
+    }
+
+    long long deadline_ms = bytebeam_hal_get_uptime_ms() + timeout_ms;
+
+    while (!is_flushed(bytebeam_client)) {
+        if (bytebeam_hal_get_uptime_ms() >= deadline_ms) {
+            BB_LOGW(TAG, "Publishes still pending after %d ms", timeout_ms);
+            return BB_FAILURE;
+        }
+
+        bytebeam_hal_delay_ms(BYTEBEAM_FLUSH_POLL_INTERVAL_MS);
+    }
+
+    return BB_SUCCESS;
+}
+
+uint32_t bytebeam_get_wake_count(void)
+{
+    return bytebeam_wake_count;
+}
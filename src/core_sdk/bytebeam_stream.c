@@ -1,217 +1,958 @@
-#include "cJSON.h"
+#include <ctype.h>
+#include <stdint.h>
 #include "bytebeam_hal.h"
+#include "bytebeam_internal.h"
+#include "bytebeam_json.h"
+#include "bytebeam_lz4.h"
+#include "bytebeam_columnar.h"
+#include "bytebeam_delivery.h"
 #include "bytebeam_action.h"
 #include "bytebeam_stream.h"
 
+/* Payload formats of a stream, each one published to its own topic suffix */
+typedef enum {
+    STREAM_FORMAT_JSONARRAY,
+    STREAM_FORMAT_CBOR,
+    STREAM_FORMAT_JSONARRAY_LZ4,
+    STREAM_FORMAT_CBOR_LZ4,
+    STREAM_FORMAT_COLUMNAR,
+    STREAM_FORMAT_COUNT,
+} stream_format_t;
+
+static const char *stream_format_suffix[STREAM_FORMAT_COUNT] = {
+    [STREAM_FORMAT_JSONARRAY]     = "jsonarray",
+    [STREAM_FORMAT_CBOR]          = "cbor",
+    [STREAM_FORMAT_JSONARRAY_LZ4] = "jsonarray/lz4",
+    [STREAM_FORMAT_CBOR_LZ4]      = "cbor/lz4",
+    [STREAM_FORMAT_COLUMNAR]      = "columnar",
+};
+
+/* Compressed format of each format, STREAM_FORMAT_COUNT for the ones that are never compressed */
+static const stream_format_t stream_format_lz4[STREAM_FORMAT_COUNT] = {
+    [STREAM_FORMAT_JSONARRAY]     = STREAM_FORMAT_JSONARRAY_LZ4,
+    [STREAM_FORMAT_CBOR]          = STREAM_FORMAT_CBOR_LZ4,
+    [STREAM_FORMAT_JSONARRAY_LZ4] = STREAM_FORMAT_COUNT,
+    [STREAM_FORMAT_CBOR_LZ4]      = STREAM_FORMAT_COUNT,
+    [STREAM_FORMAT_COLUMNAR]      = STREAM_FORMAT_COUNT,
+};
+
+/* Length of the uncompressed payload size put in front of the lz4 block */
+#define STREAM_LZ4_HEADER_LEN 4
+
+/* Compression state of a stream, allocated when the compression is first enabled and kept until the client is destroyed
+ * so that a publish in progress never sees it go away. The lock guards the scratch hash table and output buffer.
+ */
+typedef struct bytebeam_stream_compression {
+    bytebeam_hal_mutex_t lock;
+    int enabled;
+    int min_size;
+    int size;
+    uint8_t *buffer;
+    uint16_t hash_table[BYTEBEAM_LZ4_HASH_TABLE_SIZE];
+} bytebeam_stream_compression_t;
+
+/* Token bucket of a stream, guarded by the lock of the stream topic cache. The tokens are kept in thousandths of a byte
+ * so that the refill of a few milliseconds is not lost to rounding.
+ */
+typedef struct bytebeam_stream_rate_limit {
+    bool enabled;
+    long long rate;
+    long long burst;
+    long long tokens;
+    long long last_refill_ms;
+} bytebeam_stream_rate_limit_t;
+
+/* A topic handed out to a publish is never written again, a rebuilt topic that differs goes into a fresh allocation
+ * and the old one is retired until the cache is freed, as a publish in another task might still be using it.
+ */
+typedef struct bytebeam_stream_topic {
+    uint32_t generation;
+    char *topic;
+} bytebeam_stream_topic_t;
+
+/* Open addressing hash table with linear probing of the opened streams, keyed by the stream name. It holds pointers so
+ * that the stream handles stay valid while the table grows. A topic is built on its first use and once per generation
+ * of the cache after that, bytebeam_init starts a new generation as the device config might have changed.
+ */
+typedef struct bytebeam_stream {
+    bytebeam_client_t *bytebeam_client;
+    uint32_t hash;
+    char name[BYTEBEAM_STREAM_NAME_STR_LEN];
+    bytebeam_stream_topic_t topics[STREAM_FORMAT_COUNT];
+    bytebeam_stream_compression_t *compression;
+    bytebeam_stream_rate_limit_t rate_limit;
+} bytebeam_stream_t;
+
+typedef struct bytebeam_stream_topics {
+    bytebeam_hal_mutex_t lock;
+    uint32_t generation;
+    int capacity;
+    int count;
+    bytebeam_stream_t **streams;
+    bytebeam_stream_topic_t action_status_topic;
+    char **retired_topics;
+    int retired_count;
+    bool has_outbox_watermarks;
+    bool outbox_above_high;
+    bytebeam_outbox_watermark_config_t outbox_watermarks;
+} bytebeam_stream_topics_t;
+
 static const char *TAG = "BYTEBEAM_STREAM";
 
-int bytebeam_publish_device_heartbeat(bytebeam_client_t *bytebeam_client)
+static uint32_t stream_name_hash(const char *name)
 {
-    static uint64_t sequence = 0;
-    unsigned long long milliseconds = 0;
+    uint32_t hash = 2166136261u;
 
-    int ret_val = 0;
-    const char* reboot_reason_str = "";
-    long long uptime = 0;
+    while (*name != '\0') {
+        hash = (hash ^ (uint8_t)*name) * 16777619u;
+        name++;
+    }
 
-    cJSON *device_shadow_json_list = NULL;
-    cJSON *device_shadow_json = NULL;
-    cJSON *sequence_json = NULL;
-    cJSON *timestamp_json = NULL;
-    cJSON *device_status_json = NULL;
-    cJSON *device_reset_reason_json = NULL;
-    cJSON *device_uptime_json = NULL;
-    cJSON *device_software_type_json = NULL;
-    cJSON *device_software_version_json = NULL;
-    cJSON *device_hardware_type_json = NULL;
-    cJSON *device_hardware_version_json = NULL;
+    return hash;
+}
 
-    char *string_json = NULL;
+static int find_stream_slot(bytebeam_stream_topics_t *topics, const char *name, uint32_t hash)
+{
+    int mask = topics->capacity - 1;
+    int index = (int)(hash & mask);
 
-    device_shadow_json_list = cJSON_CreateArray();
+    while (topics->streams[index] != NULL) {
+        if (topics->streams[index]->hash == hash && !strcmp(topics->streams[index]->name, name)) {
+            break;
+        }
 
-    if(device_shadow_json_list == NULL)
-    {
-        BB_LOGE(TAG, "Json Init failed.");
-        return -1;
+        index = (index + 1) & mask;
     }
 
-    device_shadow_json = cJSON_CreateObject();
+    return index;
+}
+
+static int grow_stream_topics(bytebeam_stream_topics_t *topics)
+{
+    int index = 0;
+    int new_capacity = topics->capacity * 2;
+    int mask = new_capacity - 1;
+    bytebeam_stream_t **new_streams = calloc(new_capacity, sizeof(bytebeam_stream_t *));
 
-    if(device_shadow_json == NULL)
-    {
-        BB_LOGE(TAG, "Json add failed.");
-        cJSON_Delete(device_shadow_json_list);
+    if (new_streams == NULL) {
         return -1;
     }
 
-    milliseconds = bytebeam_hal_get_epoch_millis();
+    for (index = 0; index < topics->capacity; index++) {
+        bytebeam_stream_t *stream = topics->streams[index];
 
-    if(milliseconds == 0)
-    {
-        BB_LOGE(TAG, "failed to get epoch millis.");
-        cJSON_Delete(device_shadow_json_list);
-        return -1;
+        if (stream == NULL) {
+            continue;
+        }
+
+        int new_index = (int)(stream->hash & mask);
+
+        while (new_streams[new_index] != NULL) {
+            new_index = (new_index + 1) & mask;
+        }
+
+        new_streams[new_index] = stream;
     }
 
-    timestamp_json = cJSON_CreateNumber(milliseconds);
+    free(topics->streams);
+    topics->streams = new_streams;
+    topics->capacity = new_capacity;
 
-    if(timestamp_json == NULL)
-    {
-        BB_LOGE(TAG, "Json add time stamp failed.");
-        cJSON_Delete(device_shadow_json_list);
+    return 0;
+}
+
+int bytebeam_stream_topics_start(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_stream_topics_t *topics = bytebeam_client->stream_topics;
+
+    // the topics of the already opened streams are rebuilt with the new device config on their next publish
+    if (topics != NULL) {
+        uint32_t generation = topics->generation + 1;
+
+        // skip the generation of the never built topics on wrap around
+        if (generation == 0) {
+            generation = 1;
+        }
+
+        __atomic_store_n(&topics->generation, generation, __ATOMIC_RELEASE);
+        return 0;
+    }
+
+    topics = calloc(1, sizeof(bytebeam_stream_topics_t));
+
+    if (topics == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for stream topic cache");
         return -1;
     }
 
-    cJSON_AddItemToObject(device_shadow_json, "timestamp", timestamp_json);
+    topics->capacity = 1;
+
+    while (topics->capacity < BYTEBEAM_STREAM_TOPIC_CACHE_SIZE) {
+        topics->capacity = topics->capacity * 2;
+    }
 
-    sequence++;
-    sequence_json = cJSON_CreateNumber(sequence);
+    // zero is the generation of a stream whose topic was never built
+    topics->generation = 1;
+    topics->streams = calloc(topics->capacity, sizeof(bytebeam_stream_t *));
+    topics->lock = bytebeam_hal_mutex_create();
 
-    if(sequence_json == NULL)
-    {
-        BB_LOGE(TAG, "Json add sequence id failed.");
-        cJSON_Delete(device_shadow_json_list);
+    if (topics->streams == NULL || topics->lock == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for stream topic cache");
+
+        if (topics->lock != NULL) {
+            bytebeam_hal_mutex_delete(topics->lock);
+        }
+
+        free(topics->streams);
+        free(topics);
         return -1;
     }
 
-    cJSON_AddItemToObject(device_shadow_json, "sequence", sequence_json);
+    bytebeam_client->stream_topics = topics;
+
+    return 0;
+}
+
+void bytebeam_stream_topics_free(bytebeam_client_t *bytebeam_client)
+{
+    int index = 0;
+    bytebeam_stream_topics_t *topics = bytebeam_client->stream_topics;
+
+    if (topics == NULL) {
+        return;
+    }
+
+    for (index = 0; index < topics->capacity; index++) {
+        bytebeam_stream_t *stream = topics->streams[index];
+
+        if (stream == NULL) {
+            continue;
+        }
+
+        for (int format = 0; format < STREAM_FORMAT_COUNT; format++) {
+            free(stream->topics[format].topic);
+        }
+
+        if (stream->compression != NULL) {
+            bytebeam_hal_mutex_delete(stream->compression->lock);
+            free(stream->compression->buffer);
+            free(stream->compression);
+        }
+
+        free(stream);
+    }
+
+    for (index = 0; index < topics->retired_count; index++) {
+        free(topics->retired_topics[index]);
+    }
+
+    free(topics->action_status_topic.topic);
+    free(topics->retired_topics);
+    bytebeam_hal_mutex_delete(topics->lock);
+    free(topics->streams);
+    free(topics);
+
+    bytebeam_client->stream_topics = NULL;
+}
+
+/* Sets the newly built topic for the generation, the caller must hold the lock of the cache */
+static const char *set_topic(bytebeam_stream_topics_t *topics, bytebeam_stream_topic_t *topic, uint32_t generation, const char *new_topic)
+{
+    // most of the time the device config did not change, the topic handed out so far is still good
+    if (topic->topic != NULL && strcmp(topic->topic, new_topic) == 0) {
+        __atomic_store_n(&topic->generation, generation, __ATOMIC_RELEASE);
+        return topic->topic;
+    }
+
+    char *topic_copy = strdup(new_topic);
+
+    if (topic_copy == NULL) {
+        return NULL;
+    }
+
+    if (topic->topic != NULL) {
+        char **retired_topics = realloc(topics->retired_topics, (topics->retired_count + 1) * sizeof(char *));
+
+        if (retired_topics == NULL) {
+            free(topic_copy);
+            return NULL;
+        }
+
+        retired_topics[topics->retired_count] = topic->topic;
+        topics->retired_topics = retired_topics;
+        topics->retired_count++;
+    }
+
+    __atomic_store_n(&topic->topic, topic_copy, __ATOMIC_RELEASE);
+    __atomic_store_n(&topic->generation, generation, __ATOMIC_RELEASE);
+
+    BB_LOGI(TAG, "Topic is %s", topic_copy);
+
+    return topic_copy;
+}
+
+/* Returns the topic of the stream for the format, building it first if the device config changed since it was built */
+static const char *get_stream_topic(bytebeam_stream_t *stream, stream_format_t format)
+{
+    char new_topic[BYTEBEAM_MQTT_TOPIC_STR_LEN];
+    const char *topic_str = NULL;
+    bytebeam_stream_topics_t *topics = stream->bytebeam_client->stream_topics;
+    bytebeam_stream_topic_t *topic = &stream->topics[format];
+    uint32_t generation = __atomic_load_n(&topics->generation, __ATOMIC_ACQUIRE);
+
+    if (__atomic_load_n(&topic->generation, __ATOMIC_ACQUIRE) == generation) {
+        return __atomic_load_n(&topic->topic, __ATOMIC_ACQUIRE);
+    }
 
-    bytebeam_reset_reason_t reboot_reason_id = bytebeam_hal_get_reset_reason();
+    bytebeam_hal_mutex_lock(topics->lock);
 
-    switch(reboot_reason_id) {
-        case BB_RST_UNKNOWN   : reboot_reason_str = "Unknown Reset";            break;
-        case BB_RST_POWERON   : reboot_reason_str = "Power On Reset";           break;
-        case BB_RST_EXT       : reboot_reason_str = "External Pin Reset";       break;
-        case BB_RST_SW        : reboot_reason_str = "Software Reset";           break;
-        case BB_RST_PANIC     : reboot_reason_str = "Hard Fault Reset";         break;
-        case BB_RST_INT_WDT   : reboot_reason_str = "Interrupt Watchdog Reset"; break;
-        case BB_RST_TASK_WDT  : reboot_reason_str = "Task Watchdog Reset";      break;
-        case BB_RST_WDT       : reboot_reason_str = "Other Watchdog Reset";     break;
-        case BB_RST_DEEPSLEEP : reboot_reason_str = "Exiting Deep Sleep Reset"; break;
-        case BB_RST_BROWNOUT  : reboot_reason_str = "Brownout Reset";           break;
-        case BB_RST_SDIO      : reboot_reason_str = "SDIO Reset";               break;
+    if (topic->generation == generation) {
+        topic_str = topic->topic;
+        bytebeam_hal_mutex_unlock(topics->lock);
 
-        default: reboot_reason_str = "Unknown Reset Id";
+        return topic_str;
     }
 
-    device_reset_reason_json = cJSON_CreateString(reboot_reason_str);
+    bytebeam_device_config_t *device_cfg = &stream->bytebeam_client->device_cfg;
+
+    int max_len = BYTEBEAM_MQTT_TOPIC_STR_LEN;
+    int temp_var = snprintf(new_topic, max_len, "/tenants/%s/devices/%s/events/%s/%s",
+            device_cfg->project_id,
+            device_cfg->device_id,
+            stream->name,
+            stream_format_suffix[format]);
 
-    if(device_reset_reason_json == NULL)
+    if(temp_var >= max_len)
     {
-        BB_LOGE(TAG, "Json add device reboot reason failed.");
-        cJSON_Delete(device_shadow_json_list);
-        return -1;
+        BB_LOGE(TAG, "Publish topic size exceeded buffer size");
+
+        bytebeam_hal_mutex_unlock(topics->lock);
+        return NULL;
+    }
+
+    // only the formats in use get a topic, sized to fit
+    topic_str = set_topic(topics, topic, generation, new_topic);
+
+    if (topic_str == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for %s stream topic", stream->name);
     }
 
-    cJSON_AddItemToObject(device_shadow_json, "Reset_Reason", device_reset_reason_json);
+    bytebeam_hal_mutex_unlock(topics->lock);
 
-    uptime = bytebeam_hal_get_uptime_ms();
+    return topic_str;
+}
+
+const char *bytebeam_stream_get_action_status_topic(bytebeam_client_t *bytebeam_client)
+{
+    char new_topic[BYTEBEAM_MQTT_TOPIC_STR_LEN];
+    const char *topic_str = NULL;
+    bytebeam_stream_topics_t *topics = bytebeam_client->stream_topics;
 
-    device_uptime_json = cJSON_CreateNumber(uptime);
+    if (topics == NULL) {
+        BB_LOGE(TAG, "Bytebeam client is not initialized");
+        return NULL;
+    }
 
-    if(device_uptime_json == NULL)
+    bytebeam_stream_topic_t *topic = &topics->action_status_topic;
+    uint32_t generation = __atomic_load_n(&topics->generation, __ATOMIC_ACQUIRE);
+
+    if (__atomic_load_n(&topic->generation, __ATOMIC_ACQUIRE) == generation) {
+        return __atomic_load_n(&topic->topic, __ATOMIC_ACQUIRE);
+    }
+
+    bytebeam_hal_mutex_lock(topics->lock);
+
+    if (topic->generation == generation) {
+        topic_str = topic->topic;
+        bytebeam_hal_mutex_unlock(topics->lock);
+
+        return topic_str;
+    }
+
+    int max_len = BYTEBEAM_MQTT_TOPIC_STR_LEN;
+    int temp_var = snprintf(new_topic, max_len, "/tenants/%s/devices/%s/action/status",
+            bytebeam_client->device_cfg.project_id,
+            bytebeam_client->device_cfg.device_id);
+
+    if(temp_var >= max_len)
     {
-        BB_LOGE(TAG, "Json add device uptime failed.");
-        cJSON_Delete(device_shadow_json_list);
-        return -1;
+        BB_LOGE(TAG, "action status topic size exceeded topic buffer size");
+
+        bytebeam_hal_mutex_unlock(topics->lock);
+        return NULL;
     }
 
-    cJSON_AddItemToObject(device_shadow_json, "Uptime", device_uptime_json);
+    topic_str = set_topic(topics, topic, generation, new_topic);
 
-    // if status is not provided append the dummy one showing device activity
-    if(bytebeam_client->device_info.status == NULL) {
-        bytebeam_client->device_info.status = "Device is Active!";
+    if (topic_str == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for action status topic");
     }
 
-    device_status_json = cJSON_CreateString(bytebeam_client->device_info.status);
+    bytebeam_hal_mutex_unlock(topics->lock);
+
+    return topic_str;
+}
 
-    if(device_status_json == NULL)
+bytebeam_stream_handle_t bytebeam_stream_open(bytebeam_client_t *bytebeam_client, char *stream_name)
+{
+    if (bytebeam_client == NULL || stream_name == NULL)
     {
-        BB_LOGE(TAG, "Json add device status failed.");
-        cJSON_Delete(device_shadow_json_list);
+        return NULL;
+    }
+
+    if (strlen(stream_name) >= BYTEBEAM_STREAM_NAME_STR_LEN) {
+        BB_LOGE(TAG, "Stream name size exceeded buffer size");
+        return NULL;
+    }
+
+    bytebeam_stream_topics_t *topics = bytebeam_client->stream_topics;
+
+    if (topics == NULL) {
+        BB_LOGE(TAG, "Bytebeam client is not initialized");
+        return NULL;
+    }
+
+    uint32_t hash = stream_name_hash(stream_name);
+
+    bytebeam_hal_mutex_lock(topics->lock);
+
+    int index = find_stream_slot(topics, stream_name, hash);
+    bytebeam_stream_t *stream = topics->streams[index];
+
+    if (stream != NULL) {
+        bytebeam_hal_mutex_unlock(topics->lock);
+        return stream;
+    }
+
+    // keep the load factor under 3/4 so that the probe sequences stay short
+    if ((topics->count + 1) * 4 > topics->capacity * 3) {
+        if (grow_stream_topics(topics) != 0) {
+            BB_LOGE(TAG, "Failed to grow the stream topic cache");
+
+            bytebeam_hal_mutex_unlock(topics->lock);
+            return NULL;
+        }
+
+        index = find_stream_slot(topics, stream_name, hash);
+    }
+
+    stream = calloc(1, sizeof(bytebeam_stream_t));
+
+    if (stream == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for %s stream", stream_name);
+
+        bytebeam_hal_mutex_unlock(topics->lock);
+        return NULL;
+    }
+
+    stream->bytebeam_client = bytebeam_client;
+    stream->hash = hash;
+    strcpy(stream->name, stream_name);
+
+    topics->streams[index] = stream;
+    topics->count++;
+
+    bytebeam_hal_mutex_unlock(topics->lock);
+
+    return stream;
+}
+
+/* Publishes the payload and adds it to the in-flight table of the client. A publish without a callback still goes out
+ * if the table is full, it just is not accounted, one with a callback fails instead so that its callback is never lost.
+ */
+static int publish_stream_topic(bytebeam_stream_t *stream, stream_format_t format, char *payload, int length, bytebeam_delivery_cb_t callback, void *callback_arg)
+{
+    int qos = 1;
+    int msg_id = 0;
+    int slot_index = -1;
+    bytebeam_client_t *bytebeam_client = stream->bytebeam_client;
+    const char *topic = get_stream_topic(stream, format);
+
+    if (topic == NULL) {
+        return -1;
+    }
+
+    slot_index = bytebeam_delivery_reserve(bytebeam_client, callback, callback_arg);
+
+    if (slot_index == -1 && callback != NULL) {
+        BB_LOGE(TAG, "Too many publishes waiting for their acknowledgement");
         return -1;
     }
 
-    cJSON_AddItemToObject(device_shadow_json, "Status", device_status_json);
+    long long start_us = bytebeam_hal_get_uptime_us();
+
+    msg_id = bytebeam_hal_mqtt_publish(bytebeam_client->client, (char *)topic, payload, length, qos);
+
+    bytebeam_metrics_observe(BYTEBEAM_METRIC_PUBLISH_US, bytebeam_hal_get_uptime_us() - start_us);
+    bytebeam_delivery_commit(bytebeam_client, slot_index, msg_id);
+
+    if (msg_id != -1) {
+        BB_LOGD(TAG, "sent publish successful, msg_id=%d, %d bytes", msg_id, length);
+
+        bytebeam_metrics_count(BYTEBEAM_METRIC_STREAM_PUBLISHES, 1);
+        bytebeam_metrics_count(BYTEBEAM_METRIC_STREAM_PUBLISH_BYTES, length);
+    } else {
+        bytebeam_metrics_count(BYTEBEAM_METRIC_STREAM_PUBLISH_FAILURES, 1);
+    }
+
+    return msg_id;
+}
+
+/* Compresses the payload into the scratch buffer of the stream, the caller holds the compression lock. Returns the
+ * length of the compressed payload or -1 if it could not be compressed or did not get any smaller.
+ */
+static int compress_stream_payload(bytebeam_stream_compression_t *compression, const char *payload, int length)
+{
+    int buffer_size = STREAM_LZ4_HEADER_LEN + BYTEBEAM_LZ4_COMPRESS_BOUND(length);
 
-    // if software type is provided append it else leave
-    if(bytebeam_client->device_info.software_type != NULL) {
-        device_software_type_json = cJSON_CreateString(bytebeam_client->device_info.software_type);
+    // the buffer only grows, so it settles at the size of the biggest payload of the stream
+    if (compression->size < buffer_size) {
+        uint8_t *new_buffer = realloc(compression->buffer, buffer_size);
 
-        if(device_software_type_json == NULL)
-        {
-            BB_LOGE(TAG, "Json add device software type failed.");
-            cJSON_Delete(device_shadow_json_list);
+        if (new_buffer == NULL) {
+            BB_LOGE(TAG, "Failed to allocate the memory for stream compression");
             return -1;
         }
 
-        cJSON_AddItemToObject(device_shadow_json, "Software_Type", device_software_type_json);
+        compression->buffer = new_buffer;
+        compression->size = buffer_size;
     }
 
-    // if software version is provided append it else leave
-    if(bytebeam_client->device_info.software_version != NULL) {
-         device_software_version_json = cJSON_CreateString(bytebeam_client->device_info.software_version);
+    int block_len = bytebeam_lz4_compress((const uint8_t *)payload, length,
+                                          compression->buffer + STREAM_LZ4_HEADER_LEN,
+                                          compression->size - STREAM_LZ4_HEADER_LEN,
+                                          compression->hash_table);
 
-        if(device_software_version_json == NULL)
-        {
-            BB_LOGE(TAG, "Json add device software version failed.");
-            cJSON_Delete(device_shadow_json_list);
-            return -1;
+    if (block_len == -1 || STREAM_LZ4_HEADER_LEN + block_len >= length) {
+        return -1;
+    }
+
+    compression->buffer[0] = (uint8_t)(length & 0xFF);
+    compression->buffer[1] = (uint8_t)((length >> 8) & 0xFF);
+    compression->buffer[2] = (uint8_t)((length >> 16) & 0xFF);
+    compression->buffer[3] = (uint8_t)((length >> 24) & 0xFF);
+
+    return STREAM_LZ4_HEADER_LEN + block_len;
+}
+
+static int publish_stream_raw(bytebeam_stream_t *stream, stream_format_t format, char *payload, int length, bytebeam_delivery_cb_t callback, void *callback_arg)
+{
+    bytebeam_stream_compression_t *compression = __atomic_load_n(&stream->compression, __ATOMIC_ACQUIRE);
+
+    if (compression == NULL || stream_format_lz4[format] == STREAM_FORMAT_COUNT ||
+        !__atomic_load_n(&compression->enabled, __ATOMIC_RELAXED) ||
+        length < __atomic_load_n(&compression->min_size, __ATOMIC_RELAXED) || length > BYTEBEAM_LZ4_MAX_INPUT_SIZE) {
+        return publish_stream_topic(stream, format, payload, length, callback, callback_arg);
+    }
+
+    bytebeam_hal_mutex_lock(compression->lock);
+
+    long long start_us = bytebeam_hal_get_uptime_us();
+    int compressed_len = compress_stream_payload(compression, payload, length);
+
+    bytebeam_metrics_observe(BYTEBEAM_METRIC_COMPRESS_US, bytebeam_hal_get_uptime_us() - start_us);
+
+    if (compressed_len == -1) {
+        bytebeam_hal_mutex_unlock(compression->lock);
+        return publish_stream_topic(stream, format, payload, length, callback, callback_arg);
+    }
+
+    BB_LOGD(TAG, "compressed %s stream payload from %d to %d bytes", stream->name, length, compressed_len);
+
+    bytebeam_metrics_count(BYTEBEAM_METRIC_STREAM_COMPRESSED, 1);
+
+    // the mqtt client copies the payload, so the scratch buffer is free again once the publish returns
+    int msg_id = publish_stream_topic(stream, stream_format_lz4[format], (char *)compression->buffer, compressed_len, callback, callback_arg);
+
+    bytebeam_hal_mutex_unlock(compression->lock);
+
+    return msg_id;
+}
+
+void bytebeam_stream_check_outbox(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_stream_topics_t *topics = bytebeam_client->stream_topics;
+
+    if (topics == NULL) {
+        return;
+    }
+
+    bytebeam_hal_mutex_lock(topics->lock);
+
+    bool has_outbox_watermarks = topics->has_outbox_watermarks;
+    bytebeam_outbox_watermark_config_t config = topics->outbox_watermarks;
+
+    bytebeam_hal_mutex_unlock(topics->lock);
+
+    if (!has_outbox_watermarks) {
+        return;
+    }
+
+    int outbox_size = bytebeam_hal_mqtt_get_outbox_size(bytebeam_client->client);
+    bool above_high = __atomic_load_n(&topics->outbox_above_high, __ATOMIC_ACQUIRE);
+    bool expected = above_high;
+
+    if (!above_high && outbox_size < config.high_watermark) {
+        return;
+    }
+
+    if (above_high && outbox_size > config.low_watermark) {
+        return;
+    }
+
+    // the publishing tasks and the mqtt task race here, only the one that flips the state reports it
+    if (!__atomic_compare_exchange_n(&topics->outbox_above_high, &expected, !above_high, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    if (above_high) {
+        BB_LOGI(TAG, "Outbox drained to %d bytes, accepting the stream publishes", outbox_size);
+    } else {
+        BB_LOGW(TAG, "Outbox grew to %d bytes, refusing the stream publishes", outbox_size);
+    }
+
+    if (config.callback != NULL) {
+        config.callback(bytebeam_client, !above_high, outbox_size, config.callback_arg);
+    }
+}
+
+/* Refills the token bucket of the stream, the caller holds the lock of the stream topic cache */
+static void refill_rate_limit(bytebeam_stream_rate_limit_t *rate_limit)
+{
+    long long now = bytebeam_hal_get_uptime_ms();
+    long long elapsed_ms = now - rate_limit->last_refill_ms;
+
+    rate_limit->last_refill_ms = now;
+
+    if (elapsed_ms <= 0) {
+        return;
+    }
+
+    // a long idle time fills the bucket anyway, so skip the multiplication that could overflow
+    if (elapsed_ms >= rate_limit->burst / rate_limit->rate + 1) {
+        rate_limit->tokens = rate_limit->burst;
+        return;
+    }
+
+    rate_limit->tokens = rate_limit->tokens + elapsed_ms * rate_limit->rate;
+
+    if (rate_limit->tokens > rate_limit->burst) {
+        rate_limit->tokens = rate_limit->burst;
+    }
+}
+
+/* Checks the outbox watermarks and the rate limit of the stream, taking the tokens for the publish if consume is set */
+static bool admit_stream_publish(bytebeam_stream_t *stream, int length, bool consume)
+{
+    bytebeam_stream_topics_t *topics = stream->bytebeam_client->stream_topics;
+    bool is_admitted = true;
+
+    bytebeam_stream_check_outbox(stream->bytebeam_client);
+
+    if (__atomic_load_n(&topics->outbox_above_high, __ATOMIC_ACQUIRE)) {
+        is_admitted = false;
+    }
+
+    bytebeam_hal_mutex_lock(topics->lock);
+
+    if (is_admitted && stream->rate_limit.enabled) {
+        long long cost = (long long)length * 1000;
+
+        refill_rate_limit(&stream->rate_limit);
+
+        if (stream->rate_limit.tokens < cost) {
+            is_admitted = false;
+        } else if (consume) {
+            stream->rate_limit.tokens = stream->rate_limit.tokens - cost;
         }
+    }
 
-        cJSON_AddItemToObject(device_shadow_json, "Software_Version", device_software_version_json);
+    bytebeam_hal_mutex_unlock(topics->lock);
+
+    if (!is_admitted && consume) {
+        bytebeam_metrics_count(BYTEBEAM_METRIC_STREAM_RATE_LIMITED, 1);
     }
 
-    // if hardware type is provided append it else leave
-    if(bytebeam_client->device_info.hardware_type != NULL) {
+    return is_admitted;
+}
 
-        device_hardware_type_json = cJSON_CreateString(bytebeam_client->device_info.hardware_type);
+int bytebeam_stream_publish_raw(bytebeam_client_t *bytebeam_client, char *stream_name, char *payload, int length)
+{
+    bytebeam_stream_t *stream = bytebeam_stream_open(bytebeam_client, stream_name);
 
-        if(device_hardware_type_json == NULL)
-        {
-            BB_LOGE(TAG, "Json add device hardware type failed.");
-            cJSON_Delete(device_shadow_json_list);
-            return -1;
+    if (stream == NULL) {
+        return -1;
+    }
+
+    return publish_stream_raw(stream, STREAM_FORMAT_JSONARRAY, payload, length, NULL, NULL);
+}
+
+static bytebeam_err_t publish_stream_json(bytebeam_stream_t *stream, char *payload, bool is_limited)
+{
+    int msg_id = -1;
+    int length = strlen(payload);
+    bytebeam_client_t *bytebeam_client = stream->bytebeam_client;
+
+    // keep the records in order, anything published while older records are queued has to be queued as well
+    if (!bytebeam_offline_queue_is_active(bytebeam_client)) {
+        // only the live publishes count against the rate limit and the outbox, the queued records cost neither
+        if (is_limited && !admit_stream_publish(stream, length, true)) {
+            BB_LOGD(TAG, "Publish to %s stream rate limited", stream->name);
+            return BB_RATE_LIMITED;
         }
 
-        cJSON_AddItemToObject(device_shadow_json, "Hardware_Type", device_hardware_type_json);
+        msg_id = publish_stream_raw(stream, STREAM_FORMAT_JSONARRAY, payload, length, NULL, NULL);
+
+        if (msg_id != -1) {
+            return BB_SUCCESS;
+        }
     }
 
-    // if hardware version is provided append it else leave
-    if(bytebeam_client->device_info.hardware_version != NULL) {
-        device_hardware_version_json = cJSON_CreateString(bytebeam_client->device_info.hardware_version);
+    if (bytebeam_client->offline_queue != NULL) {
+        return bytebeam_offline_queue_store(bytebeam_client, stream->name, payload, length);
+    }
 
-        if(device_hardware_version_json == NULL)
-        {
-            BB_LOGE(TAG, "Json add device hardware version failed.");
-            cJSON_Delete(device_shadow_json_list);
-            return -1;
+    BB_LOGE(TAG, "Publish to %s stream Failed", stream->name);
+    return BB_FAILURE;
+}
+
+int bytebeam_stream_publish_unlimited(bytebeam_client_t *bytebeam_client, char *stream_name, char *payload)
+{
+    bytebeam_stream_t *stream = bytebeam_stream_open(bytebeam_client, stream_name);
+
+    if (stream == NULL) {
+        BB_LOGE(TAG, "Publish to %s stream Failed", stream_name);
+        return BB_FAILURE;
+    }
+
+    return publish_stream_json(stream, payload, false);
+}
+
+bytebeam_err_t bytebeam_stream_publish(bytebeam_stream_handle_t stream, char *payload)
+{
+    if (stream == NULL || payload == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    return publish_stream_json(stream, payload, true);
+}
+
+bytebeam_err_t bytebeam_stream_publish_with_callback(bytebeam_stream_handle_t stream, char *payload, bytebeam_delivery_cb_t callback, void *callback_arg)
+{
+    if (stream == NULL || payload == NULL || callback == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    int length = strlen(payload);
+
+    if (!admit_stream_publish(stream, length, true)) {
+        BB_LOGD(TAG, "Publish to %s stream rate limited", stream->name);
+        return BB_RATE_LIMITED;
+    }
+
+    // a queued message would outlive its callback, so these are never stored in the offline queue
+    int msg_id = publish_stream_raw(stream, STREAM_FORMAT_JSONARRAY, payload, length, callback, callback_arg);
+
+    if (msg_id == -1) {
+        BB_LOGE(TAG, "Publish to %s stream Failed", stream->name);
+        return BB_FAILURE;
+    }
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_stream_publish_cbor(bytebeam_stream_handle_t stream, const uint8_t *payload, int length)
+{
+    if (stream == NULL || payload == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (!admit_stream_publish(stream, length, true)) {
+        BB_LOGD(TAG, "Publish to %s stream rate limited", stream->name);
+        return BB_RATE_LIMITED;
+    }
+
+    // the offline queue only knows json arrays, so the binary records are never queued or held back by it
+    int msg_id = publish_stream_raw(stream, STREAM_FORMAT_CBOR, (char *)payload, length, NULL, NULL);
+
+    if (msg_id == -1) {
+        BB_LOGE(TAG, "Publish to %s stream Failed", stream->name);
+        return BB_FAILURE;
+    }
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_stream_publish_columnar(bytebeam_stream_handle_t stream, bytebeam_columnar_encoder_t *encoder)
+{
+    if (stream == NULL || encoder == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (encoder->sample_count == 0) {
+        return BB_SUCCESS;
+    }
+
+    int length = bytebeam_columnar_finish(encoder);
+
+    if (!admit_stream_publish(stream, length, true)) {
+        BB_LOGD(TAG, "Publish to %s stream rate limited", stream->name);
+        return BB_RATE_LIMITED;
+    }
+
+    // the samples are already packed as tight as they get, so the columnar batches skip the compression
+    int msg_id = publish_stream_raw(stream, STREAM_FORMAT_COLUMNAR, (char *)encoder->buffer, length, NULL, NULL);
+
+    if (msg_id == -1) {
+        BB_LOGE(TAG, "Publish to %s stream Failed", stream->name);
+        return BB_FAILURE;
+    }
+
+    BB_LOGD(TAG, "Published %s stream columnar batch of %d samples in %d bytes", stream->name, encoder->sample_count, length);
+
+    bytebeam_shadow_on_stream_flush(stream->bytebeam_client);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_stream_set_compression(bytebeam_stream_handle_t stream, const bytebeam_stream_compression_config_t *config)
+{
+    if (stream == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    bytebeam_stream_compression_t *compression = stream->compression;
+
+    if (config == NULL) {
+        if (compression != NULL) {
+            __atomic_store_n(&compression->enabled, 0, __ATOMIC_RELAXED);
+        }
+
+        return BB_SUCCESS;
+    }
+
+    if (config->min_size < 0) {
+        BB_LOGE(TAG, "Invalid stream compression config");
+        return BB_FAILURE;
+    }
+
+    bytebeam_stream_topics_t *topics = stream->bytebeam_client->stream_topics;
+
+    bytebeam_hal_mutex_lock(topics->lock);
+
+    compression = stream->compression;
+
+    if (compression == NULL) {
+        compression = calloc(1, sizeof(bytebeam_stream_compression_t));
+
+        if (compression != NULL) {
+            compression->lock = bytebeam_hal_mutex_create();
+
+            if (compression->lock == NULL) {
+                free(compression);
+                compression = NULL;
+            }
+        }
+
+        if (compression == NULL) {
+            BB_LOGE(TAG, "Failed to allocate the memory for %s stream compression", stream->name);
+
+            bytebeam_hal_mutex_unlock(topics->lock);
+            return BB_FAILURE;
         }
 
-        cJSON_AddItemToObject(device_shadow_json, "Hardware_Version", device_hardware_version_json);
+        __atomic_store_n(&stream->compression, compression, __ATOMIC_RELEASE);
     }
 
-    cJSON_AddItemToArray(device_shadow_json_list, device_shadow_json);
+    __atomic_store_n(&compression->min_size, config->min_size, __ATOMIC_RELAXED);
+    __atomic_store_n(&compression->enabled, 1, __ATOMIC_RELAXED);
 
-    string_json = cJSON_Print(device_shadow_json_list);
+    bytebeam_hal_mutex_unlock(topics->lock);
+
+    return BB_SUCCESS;
+}
 
-    if(string_json == NULL)
+bytebeam_err_t bytebeam_stream_set_rate_limit(bytebeam_stream_handle_t stream, const bytebeam_stream_rate_limit_config_t *config)
+{
+    if (stream == NULL)
     {
-        BB_LOGE(TAG, "Json string print failed.");
-        cJSON_Delete(device_shadow_json_list);
-        return -1;
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (config != NULL && (config->rate_bytes_per_sec <= 0 || config->burst_bytes <= 0)) {
+        BB_LOGE(TAG, "Invalid stream rate limit config");
+        return BB_FAILURE;
     }
 
-    BB_LOGI(TAG, "\nStatus to send:\n%s\n", string_json);
+    bytebeam_stream_topics_t *topics = stream->bytebeam_client->stream_topics;
 
-    // publish the json to device shadow stream
-    ret_val = bytebeam_publish_to_stream(bytebeam_client, "device_shadow", string_json);
+    bytebeam_hal_mutex_lock(topics->lock);
+
+    if (config == NULL) {
+        stream->rate_limit.enabled = false;
+    } else {
+        stream->rate_limit.enabled = true;
+        stream->rate_limit.rate = config->rate_bytes_per_sec;
+        stream->rate_limit.burst = (long long)config->burst_bytes * 1000;
+        stream->rate_limit.tokens = stream->rate_limit.burst;
+        stream->rate_limit.last_refill_ms = bytebeam_hal_get_uptime_ms();
+    }
 
-    cJSON_Delete(device_shadow_json_list);
-    cJSON_free(string_json);
+    bytebeam_hal_mutex_unlock(topics->lock);
 
-    return ret_val;
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_set_outbox_watermarks(bytebeam_client_t *bytebeam_client, const bytebeam_outbox_watermark_config_t *config)
+{
+    if (bytebeam_client == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (config != NULL && (config->high_watermark <= 0 || config->low_watermark < 0 || config->low_watermark >= config->high_watermark)) {
+        BB_LOGE(TAG, "Invalid outbox watermark config");
+        return BB_FAILURE;
+    }
+
+    bytebeam_stream_topics_t *topics = bytebeam_client->stream_topics;
+
+    if (topics == NULL) {
+        BB_LOGE(TAG, "Bytebeam client is not initialized");
+        return BB_FAILURE;
+    }
+
+    bytebeam_hal_mutex_lock(topics->lock);
+
+    topics->has_outbox_watermarks = (config != NULL);
+
+    if (config != NULL) {
+        topics->outbox_watermarks = *config;
+    }
+
+    bytebeam_hal_mutex_unlock(topics->lock);
+
+    // without the watermarks nothing would ever lift the refusal
+    if (config == NULL) {
+        __atomic_store_n(&topics->outbox_above_high, false, __ATOMIC_RELEASE);
+    }
+
+    return BB_SUCCESS;
+}
+
+bool bytebeam_stream_can_publish(bytebeam_stream_handle_t stream, int length)
+{
+    if (stream == NULL)
+    {
+        return false;
+    }
+
+    return admit_stream_publish(stream, length, false);
 }
 
 bytebeam_err_t bytebeam_publish_to_stream(bytebeam_client_t *bytebeam_client, char *stream_name, char *payload)
@@ -222,31 +963,269 @@ bytebeam_err_t bytebeam_publish_to_stream(bytebeam_client_t *bytebeam_client, ch
         return BB_NULL_CHECK_FAILURE;
     }
 
-    int qos = 1;
-    int msg_id = 0;
-    char topic[BYTEBEAM_MQTT_TOPIC_STR_LEN] = {0};
+    bytebeam_stream_t *stream = bytebeam_stream_open(bytebeam_client, stream_name);
 
-    int max_len = BYTEBEAM_MQTT_TOPIC_STR_LEN;
-    int temp_var = snprintf(topic, max_len,  "/tenants/%s/devices/%s/events/%s/jsonarray",
-            bytebeam_client->device_cfg.project_id,
-            bytebeam_client->device_cfg.device_id,
-            stream_name);
+    if (stream == NULL) {
+        BB_LOGE(TAG, "Publish to %s stream Failed", stream_name);
+        return BB_FAILURE;
+    }
 
-    if(temp_var >= max_len)
+    return bytebeam_stream_publish(stream, payload);
+}
+
+/* Strip the surrounding whitespace and array brackets of the record so that its elements can be appended to a json
+ * array as is. Returns the length of the elements (0 for an empty array) or -1 if the record is malformed.
+ */
+static int get_record_elements(const char *record, const char **elements)
+{
+    const char *start = record;
+    const char *end = record + strlen(record);
+
+    while (start < end && isspace((unsigned char)*start)) {
+        start++;
+    }
+
+    while (end > start && isspace((unsigned char)*(end - 1))) {
+        end--;
+    }
+
+    if (start == end) {
+        return -1;
+    }
+
+    if (*start == '[') {
+        if (*(end - 1) != ']') {
+            return -1;
+        }
+
+        start++;
+        end--;
+
+        while (start < end && isspace((unsigned char)*start)) {
+            start++;
+        }
+
+        while (end > start && isspace((unsigned char)*(end - 1))) {
+            end--;
+        }
+    } else if (*start != '{' || *(end - 1) != '}') {
+        return -1;
+    }
+
+    *elements = start;
+
+    return (int)(end - start);
+}
+
+int bytebeam_stream_array_append(char *buffer, int buffer_size, int length, const char *record)
+{
+    const char *elements = NULL;
+    int elements_len = get_record_elements(record, &elements);
+
+    if (elements_len < 0) {
+        return -1;
+    }
+
+    if (elements_len == 0) {
+        return length;
+    }
+
+    // the buffer always starts with the opening bracket, so anything beyond it is an element
+    int separator_len = (length > 1) ? 1 : 0;
+
+    // reserve space for the closing bracket and the NULL character
+    if (length + separator_len + elements_len + 2 > buffer_size) {
+        return -1;
+    }
+
+    if (separator_len) {
+        buffer[length++] = ',';
+    }
+
+    // the record may live in the tail of the same buffer, hence the move
+    memmove(buffer + length, elements, elements_len);
+    length = length + elements_len;
+    buffer[length] = '\0';
+
+    return length;
+}
+
+static void reset_stream_batch(bytebeam_stream_batch_t *batch)
+{
+    batch->buffer[0] = '[';
+    batch->buffer[1] = '\0';
+    batch->length = 1;
+    batch->record_count = 0;
+    batch->first_record_ms = 0;
+}
+
+bytebeam_err_t bytebeam_stream_batch_init(bytebeam_stream_batch_t *batch, bytebeam_client_t *bytebeam_client, char *stream_name, const bytebeam_stream_batch_config_t *config)
+{
+    if (batch == NULL || bytebeam_client == NULL || stream_name == NULL)
     {
-        BB_LOGE(TAG, "Publish topic size exceeded buffer size");
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    bytebeam_stream_batch_config_t default_config = BYTEBEAM_STREAM_BATCH_DEFAULT_CONFIG();
+
+    if (config == NULL) {
+        config = &default_config;
+    }
+
+    // we need atleast the space for the array brackets and the NULL character
+    if (config->max_size < 3 || config->max_records < 0 || config->max_age_ms < 0) {
+        BB_LOGE(TAG, "Invalid stream batch config");
         return BB_FAILURE;
     }
 
-    BB_LOGI(TAG, "Topic is %s", topic);
+    int max_len = BYTEBEAM_STREAM_NAME_STR_LEN;
+    int temp_var = snprintf(batch->stream_name, max_len, "%s", stream_name);
 
-    msg_id = bytebeam_hal_mqtt_publish(bytebeam_client->client, topic, payload, strlen(payload), qos);
-    
-    if (msg_id != -1) {
-        BB_LOGI(TAG, "sent publish successful, msg_id=%d, message:%s", msg_id, payload);
+    if (temp_var >= max_len) {
+        BB_LOGE(TAG, "Stream name size exceeded buffer size");
+        return BB_FAILURE;
+    }
+
+    batch->stream = bytebeam_stream_open(bytebeam_client, stream_name);
+
+    if (batch->stream == NULL) {
+        return BB_FAILURE;
+    }
+
+    batch->buffer = malloc(config->max_size);
+
+    if (batch->buffer == NULL) {
+        BB_LOGE(TAG, "Failed to allocate the memory for stream batch");
+        return BB_FAILURE;
+    }
+
+    batch->bytebeam_client = bytebeam_client;
+    batch->config = *config;
+    reset_stream_batch(batch);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_stream_batch_append(bytebeam_stream_batch_t *batch, char *record)
+{
+    if (batch == NULL || record == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (batch->buffer == NULL) {
+        BB_LOGE(TAG, "Stream batch is not initialized");
+        return BB_FAILURE;
+    }
+
+    const char *elements = NULL;
+
+    if (get_record_elements(record, &elements) == -1) {
+        BB_LOGE(TAG, "Malformed record for %s stream batch", batch->stream_name);
+        return BB_FAILURE;
+    }
+
+    int length = bytebeam_stream_array_append(batch->buffer, batch->config.max_size, batch->length, record);
+
+    // if the record does not fit, flush the pending records and try again with the empty batch
+    if (length == -1 && batch->record_count > 0) {
+        if (bytebeam_stream_batch_flush(batch) != BB_SUCCESS) {
+            return BB_FAILURE;
+        }
+
+        length = bytebeam_stream_array_append(batch->buffer, batch->config.max_size, batch->length, record);
+    }
+
+    if (length == -1) {
+        BB_LOGE(TAG, "Record size exceeded %s stream batch size", batch->stream_name);
+        return BB_FAILURE;
+    }
+
+    if (length == batch->length) {
         return BB_SUCCESS;
-    } else {
-        BB_LOGE(TAG, "Publish to %s stream Failed", stream_name);
+    }
+
+    if (batch->record_count == 0) {
+        batch->first_record_ms = bytebeam_hal_get_uptime_ms();
+    }
+
+    batch->length = length;
+    batch->record_count++;
+
+    if (batch->config.max_records > 0 && batch->record_count >= batch->config.max_records) {
+        return bytebeam_stream_batch_flush(batch);
+    }
+
+    return bytebeam_stream_batch_poll(batch);
+}
+
+bytebeam_err_t bytebeam_stream_batch_poll(bytebeam_stream_batch_t *batch)
+{
+    if (batch == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (batch->record_count == 0 || batch->config.max_age_ms == 0) {
+        return BB_SUCCESS;
+    }
+
+    long long age_ms = bytebeam_hal_get_uptime_ms() - batch->first_record_ms;
+
+    if (age_ms < batch->config.max_age_ms) {
+        return BB_SUCCESS;
+    }
+
+    return bytebeam_stream_batch_flush(batch);
+}
+
+bytebeam_err_t bytebeam_stream_batch_flush(bytebeam_stream_batch_t *batch)
+{
+    if (batch == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (batch->buffer == NULL || batch->record_count == 0) {
+        return BB_SUCCESS;
+    }
+
+    // close the json array, space for it is always reserved while appending the records
+    batch->buffer[batch->length] = ']';
+    batch->buffer[batch->length + 1] = '\0';
+
+    int ret_val = bytebeam_stream_publish(batch->stream, batch->buffer);
+
+    if (ret_val != BB_SUCCESS) {
+        BB_LOGE(TAG, "Failed to flush %s stream batch of %d records", batch->stream_name, batch->record_count);
+
+        // re-open the json array so that the records can be retried later
+        batch->buffer[batch->length] = '\0';
         return BB_FAILURE;
     }
+
+    BB_LOGD(TAG, "Flushed %s stream batch of %d records", batch->stream_name, batch->record_count);
+
+    reset_stream_batch(batch);
+
+    bytebeam_shadow_on_stream_flush(batch->bytebeam_client);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_stream_batch_deinit(bytebeam_stream_batch_t *batch)
+{
+    if (batch == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (batch->record_count > 0) {
+        BB_LOGW(TAG, "Dropping %d records of %s stream batch", batch->record_count, batch->stream_name);
+    }
+
+    free(batch->buffer);
+    memset(batch, 0x00, sizeof(bytebeam_stream_batch_t));
+
+    return BB_SUCCESS;
 }
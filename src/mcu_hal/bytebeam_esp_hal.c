@@ -1,20 +1,59 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
 #include "nvs.h"
 #include "nvs_flash.h"
 #include "esp_timer.h"
-#include "esp_https_ota.h"
+#include "esp_system.h"
+#include "esp_http_client.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_app_format.h"
 #include "esp_idf_version.h"
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include "spi_flash_mmap.h"
+#include "esp_random.h"
+#else
+#include "esp_spi_flash.h"
+#endif
 #include "esp_spiffs.h"
 #include "esp_vfs_fat.h"
-#include "bytebeam_esp_hal.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "bytebeam_hal.h"
+#include "bytebeam_internal.h"
 #include "bytebeam_ota.h"
 #include "bytebeam_action.h"
 #include "bytebeam_client.h"
 
 static int ota_img_data_len = 0;
+static int ota_downloaded_data_len = 0;
+static int ota_progress_stamp = 0;
+static int ota_range_total_len = 0;
+static char ota_etag_str[BYTEBEAM_OTA_ETAG_STR_LEN] = "";
 static int ota_update_completed = 0;
 static char ota_action_id_str[BYTEBEAM_ACTION_ID_STR_LEN] = "";
+static char ota_device_id_str[BYTEBEAM_DEVICE_ID_STR_LEN] = "";
 static bytebeam_client_t *ota_client = NULL;
+static int spiffs_mount_count = 0;
+static int fatfs_mount_count = 0;
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+static esp_partition_mmap_handle_t provisioning_partition_handle;
+#else
+static spi_flash_mmap_handle_t provisioning_partition_handle;
+#endif
+static const void *provisioning_partition_data = NULL;
+static int provisioning_partition_length = 0;
+static int provisioning_partition_map_count = 0;
+
+/* Download progress of the OTA image, saved in NVS so that the download can be resumed */
+typedef struct bytebeam_ota_resume_state {
+    int32_t image_size;
+    int32_t offset;
+    char etag[BYTEBEAM_OTA_ETAG_STR_LEN];
+} bytebeam_ota_resume_state_t;
 
 static const char *TAG = "BYTEBEAM_HAL";
 
@@ -33,20 +72,61 @@ int bytebeam_hal_mqtt_publish(bytebeam_client_handle_t client, char *topic, char
     return esp_mqtt_client_publish(client, (const char *)topic, (const char *)message, length, qos, 1);
 }
 
+int bytebeam_hal_mqtt_get_outbox_size(bytebeam_client_handle_t client)
+{
+    if (client == NULL) {
+        return 0;
+    }
+
+    return esp_mqtt_client_get_outbox_size(client);
+}
+
 int bytebeam_hal_restart(void)
 {
     esp_restart();
     return 0;
 }
 
-esp_err_t _http_event_handler(esp_http_client_event_t *evt)
+static void publish_ota_progress(void)
 {
-    static int loop_var = 0;
-    static int update_progress_offset = 10;
-    static int update_progress_percent = 0;
-    static int downloaded_data_len = 0;
-    static const char* update_progress_status = "Downloading";
+    const int update_progress_offset = 10;
+    const char* update_progress_status = "Downloading";
+
+    // without the image size there is no way to tell the progress
+    if (ota_img_data_len <= 0) {
+        return;
+    }
+
+    int update_progress_percent = (int)(((long long)ota_downloaded_data_len * 100) / ota_img_data_len);
+
+    if (update_progress_percent > 100) {
+        update_progress_percent = 100;
+    }
+
+    // report only on every progress stamp, the data comes in far too often
+    if (update_progress_percent < ota_progress_stamp) {
+        return;
+    }
+
+    BB_LOGD(TAG, "update_progress_percent : %d", update_progress_percent);
+    BB_LOGD(TAG, "ota_action_id : %s", ota_client->ota_action_id);
+
+    // If we are done, change the status to downloaded
+    if(update_progress_percent == 100) {
+        update_progress_status = "Downloaded";
+    }
+
+    // publish the OTA progress status
+    if(bytebeam_publish_action_status(ota_client, ota_client->ota_action_id, update_progress_percent, update_progress_status, "") != 0) {
+        BB_LOGE(TAG, "Failed to publish OTA progress status");
+    }
+
+    // mark the next progress stamp, stay past 100 once done
+    ota_progress_stamp = update_progress_percent - (update_progress_percent % update_progress_offset) + update_progress_offset;
+}
 
+esp_err_t _http_event_handler(esp_http_client_event_t *evt)
+{
     switch (evt->event_id) {
     case HTTP_EVENT_ERROR:
         BB_LOGE(TAG, "HTTP_EVENT_ERROR");
@@ -62,37 +142,18 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 
     case HTTP_EVENT_ON_HEADER:
         BB_LOGI(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+
+        // the response headers are only available here, keep the ones needed for resuming the download
+        if (strcasecmp(evt->header_key, "ETag") == 0) {
+            snprintf(ota_etag_str, sizeof(ota_etag_str), "%s", evt->header_value);
+        } else if (strcasecmp(evt->header_key, "Content-Range") == 0) {
+            const char *total = strchr(evt->header_value, '/');
+            ota_range_total_len = (total != NULL) ? atoi(total + 1) : 0;
+        }
         break;
 
     case HTTP_EVENT_ON_DATA:
         BB_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
-        downloaded_data_len = downloaded_data_len + evt->data_len;
-        update_progress_percent = (((float)downloaded_data_len / (float)ota_img_data_len) * 100.00);
-
-        if (update_progress_percent == loop_var) {
-            BB_LOGD(TAG, "update_progress_percent : %d", update_progress_percent);
-            BB_LOGD(TAG, "ota_action_id : %s", ota_action_id);
-
-            // If we are done, change the status to downloaded
-            if(update_progress_percent == 100) {
-                update_progress_status = "Downloaded";
-            }
-
-            // publish the OTA progress status
-            if(bytebeam_publish_action_status(ota_client, ota_action_id, update_progress_percent, update_progress_status, "") != 0) {
-                BB_LOGE(TAG, "Failed to publish OTA progress status");
-            }
-
-            if (loop_var == 100) {
-                // reset the varibales
-                loop_var = 0;
-                update_progress_percent = 0;
-                downloaded_data_len = 0;
-            } else {
-                // mark the next progress stamp
-                loop_var = loop_var + update_progress_offset;
-            }
-        }
         break;
 
     case HTTP_EVENT_ON_FINISH:
@@ -113,26 +174,343 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
-esp_err_t _test_event_handler(esp_http_client_event_t *evt)
+static void set_ota_error(const char *message, esp_err_t err)
 {
-    switch (evt->event_id) {
-    case HTTP_EVENT_ERROR:
-        BB_LOGE(TAG, "HTTP_EVENT_ERROR");
-        break;
-    case HTTP_EVENT_ON_DATA:
-        ota_img_data_len = ota_img_data_len + evt->data_len;
-        break;
-    default:
-        break;
+    int max_len = BYTEBEAM_OTA_ERROR_STR_LEN;
+    int temp_var = snprintf(ota_client->ota_error_str, max_len, "%s, Error (%d): %s", message, err, esp_err_to_name(err));
+
+    if (temp_var >= max_len) {
+        BB_LOGE(TAG, "OTA error size exceeded buffer size");
     }
 
-    return ESP_OK;
+    BB_LOGE(TAG, "HTTP_UPDATE_FAILED %s", ota_client->ota_error_str);
 }
 
-int bytebeam_hal_ota(bytebeam_client_t *bytebeam_client, char *ota_url)
+/* The resume state lives next to the update_flag and action_id_val keys. It is only valid for the same url and
+ * the same OTA partition, and the offset is always a multiple of the flash sector size.
+ */
+static void load_ota_resume_state(const char *ota_url, const esp_partition_t *partition, bytebeam_ota_resume_state_t *state)
+{
+    nvs_handle_t nvs_handle;
+    char url[BYTEBAM_OTA_URL_STR_LEN] = { 0 };
+    size_t url_len = sizeof(url);
+    size_t etag_len = sizeof(state->etag);
+    uint32_t partition_addr = 0;
+
+    memset(state, 0x00, sizeof(bytebeam_ota_resume_state_t));
+
+    if (nvs_open("test_storage", NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return;
+    }
+
+    bool is_valid = (nvs_get_str(nvs_handle, "ota_url", url, &url_len) == ESP_OK) &&
+                    (nvs_get_u32(nvs_handle, "ota_part_addr", &partition_addr) == ESP_OK) &&
+                    (nvs_get_i32(nvs_handle, "ota_size", &state->image_size) == ESP_OK) &&
+                    (nvs_get_i32(nvs_handle, "ota_offset", &state->offset) == ESP_OK);
+
+    if (nvs_get_str(nvs_handle, "ota_etag", state->etag, &etag_len) != ESP_OK) {
+        state->etag[0] = '\0';
+    }
+
+    nvs_close(nvs_handle);
+
+    if (!is_valid || strcmp(url, ota_url) != 0 || partition_addr != partition->address ||
+        state->offset <= 0 || state->offset > state->image_size || (state->offset % SPI_FLASH_SEC_SIZE) != 0) {
+        memset(state, 0x00, sizeof(bytebeam_ota_resume_state_t));
+        return;
+    }
+
+    BB_LOGI(TAG, "Resuming OTA download at %d of %d bytes", (int)state->offset, (int)state->image_size);
+}
+
+static void save_ota_resume_state(const char *ota_url, const esp_partition_t *partition, const bytebeam_ota_resume_state_t *state)
+{
+    nvs_handle_t nvs_handle;
+
+    if (nvs_open("test_storage", NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        BB_LOGE(TAG, "Failed to open NVS Storage");
+        return;
+    }
+
+    esp_err_t err = nvs_set_str(nvs_handle, "ota_url", ota_url);
+
+    if (err == ESP_OK) {
+        err = nvs_set_u32(nvs_handle, "ota_part_addr", partition->address);
+    }
+
+    if (err == ESP_OK) {
+        err = nvs_set_i32(nvs_handle, "ota_size", state->image_size);
+    }
+
+    if (err == ESP_OK) {
+        err = nvs_set_str(nvs_handle, "ota_etag", state->etag);
+    }
+
+    if (err == ESP_OK) {
+        err = nvs_set_i32(nvs_handle, "ota_offset", state->offset);
+    }
+
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+
+    if (err != ESP_OK) {
+        BB_LOGE(TAG, "Failed to save the OTA resume state in NVS");
+    }
+
+    nvs_close(nvs_handle);
+}
+
+static void clear_ota_resume_state(void)
+{
+    nvs_handle_t nvs_handle;
+
+    if (nvs_open("test_storage", NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        return;
+    }
+
+    // the offset alone decides whether a download can be resumed
+    nvs_erase_key(nvs_handle, "ota_offset");
+    nvs_commit(nvs_handle);
+    nvs_close(nvs_handle);
+}
+
+static bool is_http_redirect(int status_code)
+{
+    return status_code == 301 || status_code == 302 || status_code == 303 || status_code == 307 || status_code == 308;
+}
+
+/* Opens the connection and fetches the response headers, following the redirects to wherever the image is hosted.
+ * Returns the content length of the final response, or -1 with the OTA error set.
+ */
+static int open_ota_connection(esp_http_client_handle_t client, char *buffer, int buffer_len)
+{
+    int content_length = 0;
+
+    for (int redirects = 0; ; redirects++) {
+        ota_etag_str[0] = '\0';
+        ota_range_total_len = 0;
+
+        esp_err_t err = esp_http_client_open(client, 0);
+
+        if (err != ESP_OK) {
+            set_ota_error("Failed to open HTTP connection", err);
+            return -1;
+        }
+
+        content_length = esp_http_client_fetch_headers(client);
+
+        if (!is_http_redirect(esp_http_client_get_status_code(client))) {
+            return content_length;
+        }
+
+        if (redirects == BYTEBEAM_OTA_MAX_REDIRECTS) {
+            set_ota_error("Too many HTTP redirects", ESP_FAIL);
+            return -1;
+        }
+
+        // the range headers stay set, so the redirected request asks for the same part of the image
+        err = esp_http_client_set_redirection(client);
+
+        if (err != ESP_OK) {
+            set_ota_error("Failed to follow HTTP redirect", err);
+            return -1;
+        }
+
+        // the body of the redirect is of no use, read it off before closing
+        while (esp_http_client_read(client, buffer, buffer_len) > 0) {
+        }
+
+        esp_http_client_close(client);
+    }
+}
+
+/* Download the image from the resume offset onwards into the partition. Returns ESP_OK once the whole image is
+ * written, the resume state is kept updated so that any failure can carry on from the last saved sector. An image
+ * sent without its size (chunked) is streamed to the end and started over after any failure.
+ */
+static esp_err_t download_ota_image(esp_http_client_config_t *config, const esp_partition_t *partition, bytebeam_ota_resume_state_t *state, char *sector)
+{
+    char range[32] = { 0 };
+    int last_saved_offset = state->offset;
+    bool is_streamed = false;
+    bool is_last_sector = false;
+    esp_err_t err = ESP_OK;
+
+    esp_http_client_handle_t client = esp_http_client_init(config);
+
+    if (client == NULL) {
+        set_ota_error("HTTP client init failed", ESP_FAIL);
+        return ESP_FAIL;
+    }
+
+    if (state->offset > 0) {
+        snprintf(range, sizeof(range), "bytes=%d-", (int)state->offset);
+        esp_http_client_set_header(client, "Range", range);
+
+        // makes the server send the whole image again if it changed since the download started
+        if (state->etag[0] != '\0') {
+            esp_http_client_set_header(client, "If-Range", state->etag);
+        }
+    }
+
+    int content_length = open_ota_connection(client, sector, SPI_FLASH_SEC_SIZE);
+
+    if (content_length < 0) {
+        esp_http_client_cleanup(client);
+        return ESP_FAIL;
+    }
+
+    int status_code = esp_http_client_get_status_code(client);
+
+    if (state->offset > 0 && status_code == 206 && ota_range_total_len == state->image_size) {
+        BB_LOGI(TAG, "Server accepted the range request, %d bytes left", (int)(state->image_size - state->offset));
+    } else if (status_code == 200 && content_length > 0) {
+        if (state->offset > 0) {
+            BB_LOGW(TAG, "Server sent the whole image, restarting the download");
+        }
+
+        state->offset = 0;
+        state->image_size = content_length;
+        last_saved_offset = 0;
+        snprintf(state->etag, sizeof(state->etag), "%s", ota_etag_str);
+    } else if (status_code == 200 && esp_http_client_is_chunked_response(client)) {
+        BB_LOGW(TAG, "Server sent no image size, the download can not be resumed");
+
+        // nothing to resume from without the size, whatever was saved before is of no use either
+        is_streamed = true;
+        state->offset = 0;
+        state->image_size = 0;
+        state->etag[0] = '\0';
+        last_saved_offset = 0;
+        clear_ota_resume_state();
+    } else {
+        BB_LOGE(TAG, "Unexpected HTTP response, status %d, content length %d", status_code, content_length);
+
+        // most probably the server does not know the range anymore, start over the next time
+        state->offset = 0;
+        clear_ota_resume_state();
+
+        set_ota_error("Unexpected HTTP response", ESP_FAIL);
+        esp_http_client_cleanup(client);
+        return ESP_FAIL;
+    }
+
+    if (state->image_size > (int32_t)partition->size) {
+        state->offset = 0;
+        clear_ota_resume_state();
+
+        set_ota_error("Image does not fit in the OTA partition", ESP_ERR_INVALID_SIZE);
+        esp_http_client_cleanup(client);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    ota_img_data_len = state->image_size;
+    ota_downloaded_data_len = state->offset;
+
+    while (is_streamed || state->offset < state->image_size) {
+        int sector_len = is_streamed ? SPI_FLASH_SEC_SIZE : state->image_size - state->offset;
+
+        if (sector_len > SPI_FLASH_SEC_SIZE) {
+            sector_len = SPI_FLASH_SEC_SIZE;
+        }
+
+        // collect a whole sector first, so that only the complete sectors ever reach the flash
+        int read_len = 0;
+
+        while (read_len < sector_len) {
+            int len = esp_http_client_read(client, sector + read_len, sector_len - read_len);
+
+            if (len <= 0) {
+                break;
+            }
+
+            read_len = read_len + len;
+        }
+
+        // a streamed image ends with a short sector, as long as the last chunk made it
+        if (is_streamed && read_len < sector_len && esp_http_client_is_complete_data_received(client)) {
+            if (read_len == 0) {
+                break;
+            }
+
+            sector_len = read_len;
+            is_last_sector = true;
+        }
+
+        if (read_len < sector_len) {
+            BB_LOGE(TAG, "Connection lost at %d of %d bytes", (int)(state->offset + read_len), (int)state->image_size);
+            set_ota_error("Connection lost", ESP_ERR_HTTP_EAGAIN);
+            err = ESP_ERR_HTTP_EAGAIN;
+            break;
+        }
+
+        if (state->offset + sector_len > (int32_t)partition->size) {
+            set_ota_error("Image does not fit in the OTA partition", ESP_ERR_INVALID_SIZE);
+            err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+
+        if (state->offset == 0 && (uint8_t)sector[0] != ESP_IMAGE_HEADER_MAGIC) {
+            set_ota_error("Invalid image header", ESP_ERR_OTA_VALIDATE_FAILED);
+            err = ESP_ERR_OTA_VALIDATE_FAILED;
+            break;
+        }
+
+        err = esp_partition_erase_range(partition, state->offset, SPI_FLASH_SEC_SIZE);
+
+        if (err == ESP_OK) {
+            err = esp_partition_write(partition, state->offset, sector, sector_len);
+        }
+
+        if (err != ESP_OK) {
+            set_ota_error("Failed to write the OTA partition", err);
+            break;
+        }
+
+        state->offset = state->offset + sector_len;
+        ota_downloaded_data_len = state->offset;
+        publish_ota_progress();
+
+        if (is_last_sector) {
+            break;
+        }
+
+        // only complete sectors are saved, the last partial sector is never a resume point
+        if (!is_streamed && sector_len == SPI_FLASH_SEC_SIZE && state->offset - last_saved_offset >= BYTEBEAM_OTA_RESUME_SAVE_INTERVAL) {
+            save_ota_resume_state(config->url, partition, state);
+            last_saved_offset = state->offset;
+        }
+    }
+
+    // a streamed image has no resume point, the next attempt starts over
+    if (err != ESP_OK && is_streamed) {
+        state->offset = 0;
+    }
+
+    // the size of a streamed image is only known at its end, report it downloaded now
+    if (err == ESP_OK && is_streamed) {
+        state->image_size = state->offset;
+        ota_img_data_len = state->image_size;
+        publish_ota_progress();
+    }
+
+    // save the progress made in this attempt, rounded down to the last complete sector
+    if (err != ESP_OK && !is_streamed && state->offset > last_saved_offset) {
+        state->offset = state->offset - (state->offset % SPI_FLASH_SEC_SIZE);
+        save_ota_resume_state(config->url, partition, state);
+    }
+
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+
+    return err;
+}
+
+/* Runs the OTA of the ota client, the OTA progress and errors are reported through it */
+static int run_ota(char *ota_url)
 {
-    // set the ota client reference to the incoming bytebeam client
-    ota_client = bytebeam_client;
+    bytebeam_ota_resume_state_t state;
 
     esp_http_client_config_t config = {
         .url = ota_url,
@@ -140,65 +518,150 @@ int bytebeam_hal_ota(bytebeam_client_t *bytebeam_client, char *ota_url)
         .client_cert_pem = (char *)ota_client->device_cfg.client_cert_pem,
         .client_key_pem = (char *)ota_client->device_cfg.client_key_pem,
         .event_handler = _http_event_handler,
+        .keep_alive_enable = true,
     };
 
-    esp_http_client_config_t test_config = {
-        .url = ota_url,
-        .cert_pem = (char *)ota_client->device_cfg.ca_cert_pem,
-        .client_cert_pem = (char *)ota_client->device_cfg.client_cert_pem,
-        .client_key_pem = (char *)ota_client->device_cfg.client_key_pem,
-        .event_handler = _test_event_handler,
-    };
-
-#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
-	esp_https_ota_config_t ota_config = {
-        .http_config = &config,
-    };
-#endif
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
 
-    ota_img_data_len = 0;
+    if (partition == NULL) {
+        set_ota_error("No OTA partition found", ESP_ERR_NOT_FOUND);
+        return -1;
+    }
 
-    esp_http_client_handle_t client = esp_http_client_init(&test_config);
-    esp_err_t err = esp_http_client_perform(client);
+    char *sector = malloc(SPI_FLASH_SEC_SIZE);
 
-    if (err == ESP_OK) {
-        BB_LOGI(TAG, "content_length = %d", ota_img_data_len);
-    } else {
+    if (sector == NULL) {
+        set_ota_error("Failed to allocate the memory for OTA", ESP_ERR_NO_MEM);
         return -1;
     }
 
-    esp_http_client_cleanup(client);
     BB_LOGI(TAG, "The URL is:%s", config.url);
 
-#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
-    err = esp_https_ota(&ota_config);
+    // an interrupted download of the same image carries on from where it stopped, even across reboots
+    load_ota_resume_state(ota_url, partition, &state);
 
-    if (err != ESP_OK) {
-        int max_len = BYTEBEAM_OTA_ERROR_STR_LEN;
-        int temp_var = snprintf(ota_error_str, max_len, "Error (%d): %s", err, esp_err_to_name(err));
+    ota_img_data_len = 0;
+    ota_downloaded_data_len = 0;
+    ota_progress_stamp = 0;
+
+    esp_err_t err = ESP_FAIL;
 
-        if (temp_var >= max_len) {
-            BB_LOGE(TAG, "OTA error size exceeded buffer size");
+    for (int attempt = 0; attempt <= BYTEBEAM_OTA_MAX_RETRIES; attempt++) {
+        if (attempt > 0) {
+            BB_LOGW(TAG, "Retrying OTA download (%d/%d)", attempt, BYTEBEAM_OTA_MAX_RETRIES);
+            vTaskDelay(pdMS_TO_TICKS(BYTEBEAM_OTA_RETRY_DELAY_MS));
         }
 
-        BB_LOGI(TAG, "HTTP_UPDATE_FAILED %s", ota_error_str);
+        err = download_ota_image(&config, partition, &state, sector);
+
+        // retrying is only worth it for the network errors, a bad image stays bad
+        if (err == ESP_OK || err == ESP_ERR_OTA_VALIDATE_FAILED || err == ESP_ERR_INVALID_SIZE) {
+            break;
+        }
+    }
+
+    free(sector);
+
+    if (err != ESP_OK) {
         return -1;
     }
-#else
-    err = esp_https_ota(&config);
+
+    // this verifies the image (including its SHA-256 digest) before marking it bootable
+    err = esp_ota_set_boot_partition(partition);
+
+    // either way there is nothing left to resume
+    clear_ota_resume_state();
 
     if (err != ESP_OK) {
-        int max_len = BYTEBEAM_OTA_ERROR_STR_LEN;
-        int temp_var = snprintf(ota_error_str, max_len, "Error (%d): %s", err, esp_err_to_name(err));
+        set_ota_error("Image validation failed", err);
+        return -1;
+    }
 
-        if (temp_var >= max_len) {
-            BB_LOGE(TAG, "OTA error size exceeded buffer size");
-        }
+    return 0;
+}
+
+int bytebeam_hal_ota(bytebeam_client_t *bytebeam_client, char *ota_url)
+{
+    bytebeam_client_t *expected = NULL;
 
-        BB_LOGI(TAG, "HTTP_UPDATE_FAILED %s", ota_error_str);
+    // there is one OTA partition for all the clients, so only one of them can update the firmware at a time
+    if (!__atomic_compare_exchange_n(&ota_client, &expected, bytebeam_client, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        snprintf(bytebeam_client->ota_error_str, BYTEBEAM_OTA_ERROR_STR_LEN, "Another OTA is in progress");
+        BB_LOGE(TAG, "HTTP_UPDATE_FAILED %s", bytebeam_client->ota_error_str);
         return -1;
     }
-#endif
+
+    int ret_val = run_ota(ota_url);
+
+    __atomic_store_n(&ota_client, NULL, __ATOMIC_RELEASE);
+
+    return ret_val;
+}
+
+int bytebeam_hal_ota_mark_updated(bytebeam_client_t *bytebeam_client, int action_id_val)
+{
+    esp_err_t err;
+    nvs_handle_t nvs_handle;
+    int32_t update_flag = 1;
+
+    err = nvs_flash_init();
+
+    if(err != ESP_OK)
+    {
+        BB_LOGE(TAG, "NVS flash init failed.");
+        return -1;
+    }
+
+    err = nvs_open("test_storage", NVS_READWRITE, &nvs_handle);
+
+    if (err != ESP_OK) 
+    {
+        BB_LOGE(TAG, "Failed to open NVS Storage");
+        return -1;
+    }
+
+    err = nvs_set_i32(nvs_handle, "update_flag", update_flag);
+
+    if (err != ESP_OK) 
+    {
+        BB_LOGE(TAG, "Failed to set the OTA update flag in NVS");
+
+        nvs_close(nvs_handle);
+        return -1;
+    }
+
+    err = nvs_set_i32(nvs_handle, "action_id_val", (int32_t)action_id_val);
+
+    if (err != ESP_OK) 
+    {
+        BB_LOGE(TAG, "Failed to set the OTA action id in NVS");
+
+        nvs_close(nvs_handle);
+        return -1;
+    }
+
+    // the device the action came for, so that the new firmware reports the completion through the right client
+    err = nvs_set_str(nvs_handle, "action_device", bytebeam_client->device_cfg.device_id);
+
+    if (err != ESP_OK) 
+    {
+        BB_LOGE(TAG, "Failed to set the OTA device id in NVS");
+
+        nvs_close(nvs_handle);
+        return -1;
+    }
+
+    err = nvs_commit(nvs_handle);
+
+    if (err != ESP_OK) 
+    {
+        BB_LOGE(TAG, "Failed to commit the OTA update flag in NVS");
+
+        nvs_close(nvs_handle);
+        return -1;
+    }
+
+    nvs_close(nvs_handle);
 
     return 0;
 }
@@ -232,20 +695,31 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     switch ((esp_mqtt_event_id_t)event_id) {
     case MQTT_EVENT_CONNECTED:
         BB_LOGI(TAG, "MQTT_EVENT_CONNECTED");
-        msg_id = bytebeam_subscribe_to_actions(bytebeam_client->device_cfg, client);
+        bytebeam_metrics_count(BYTEBEAM_METRIC_MQTT_CONNECTS, 1);
+        // in sleep cycle mode the broker mostly still holds the subscription from the last wake up
+        if (bytebeam_sleep_cycle_should_subscribe(bytebeam_client, event->session_present)) {
+            msg_id = bytebeam_subscribe_to_actions(bytebeam_client->device_cfg, client);
 
-        if (msg_id != -1) {
-            BB_LOGI(TAG, "MQTT SUBSCRIBED!! Msg ID:%d", msg_id);
-        } else {
-            BB_LOGE(TAG, "MQTT SUBSCRIBE FAILED");
+            if (msg_id != -1) {
+                BB_LOGI(TAG, "MQTT SUBSCRIBED!! Msg ID:%d", msg_id);
+            } else {
+                BB_LOGE(TAG, "MQTT SUBSCRIBE FAILED");
+            }
         }
 
         bytebeam_client->connection_status = 1;
+
+        // drain the records queued while we were offline
+        bytebeam_offline_queue_on_connected(bytebeam_client);
+        bytebeam_shadow_on_connected(bytebeam_client);
         break;
 
     case MQTT_EVENT_DISCONNECTED:
         BB_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
+        bytebeam_metrics_count(BYTEBEAM_METRIC_MQTT_DISCONNECTS, 1);
         bytebeam_client->connection_status = 0;
+        bytebeam_offline_queue_on_disconnected(bytebeam_client);
+        bytebeam_stream_check_outbox(bytebeam_client);
         break;
 
     case MQTT_EVENT_SUBSCRIBED:
@@ -258,6 +732,9 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 
     case MQTT_EVENT_PUBLISHED:
         BB_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+        bytebeam_offline_queue_on_published(bytebeam_client, event->msg_id);
+        bytebeam_delivery_on_published(bytebeam_client, event->msg_id);
+        bytebeam_stream_check_outbox(bytebeam_client);
         break;
 
     case MQTT_EVENT_DATA:
@@ -265,7 +742,13 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         BB_LOGI(TAG, "TOPIC=%.*s\r\n", event->topic_len, event->topic);
         BB_LOGI(TAG, "DATA=%.*s\r\n", event->data_len, event->data);
 
-        ret_val = bytebeam_handle_actions(event->data, event->client, bytebeam_client);
+        // the actions are small, a fragmented one is not supported
+        if (event->current_data_offset != 0 || event->data_len != event->total_data_len) {
+            BB_LOGE(TAG, "Ignoring fragmented action of %d bytes", event->total_data_len);
+            break;
+        }
+
+        ret_val = bytebeam_handle_actions(event->data, event->data_len, event->client, bytebeam_client);
 
         if (ret_val != 0) {
             BB_LOGE(TAG, "BYTEBEAM HANDLE ACTIONS FAILED");
@@ -366,6 +849,13 @@ int bytebeam_hal_init(bytebeam_client_t *bytebeam_client)
                 return -1;
             }
 
+            /* Get the device of the OTA action from NVS, an older firmware did not save it */
+            size_t device_id_len = sizeof(ota_device_id_str);
+
+            if (nvs_get_str(temp_nv_handle, "action_device", ota_device_id_str, &device_id_len) != ESP_OK) {
+                ota_device_id_str[0] = '\0';
+            }
+
             int max_len = BYTEBEAM_ACTION_ID_STR_LEN;
             int temp_var = snprintf(ota_action_id_str, max_len, "%d", (int)ota_action_id_val);
 
@@ -403,6 +893,11 @@ int bytebeam_hal_destroy(bytebeam_client_t *bytebeam_client)
     return 0;
 }
 
+static bool is_ota_device(bytebeam_client_t *bytebeam_client)
+{
+    return ota_device_id_str[0] == '\0' || strcmp(ota_device_id_str, bytebeam_client->device_cfg.device_id) == 0;
+}
+
 int bytebeam_hal_start_mqtt(bytebeam_client_t *bytebeam_client)
 {
     esp_err_t err;
@@ -413,7 +908,8 @@ int bytebeam_hal_start_mqtt(bytebeam_client_t *bytebeam_client)
         return -1;
     }
 
-    if (ota_update_completed == 1) {
+    // the OTA completion goes out through the client which received the OTA action
+    if (ota_update_completed == 1 && is_ota_device(bytebeam_client)) {
         ota_update_completed = 0;
 
         if ((bytebeam_publish_action_completed(bytebeam_client, ota_action_id_str)) != 0) {
@@ -421,9 +917,11 @@ int bytebeam_hal_start_mqtt(bytebeam_client_t *bytebeam_client)
         }
     }
 
-    // publish the device heartbeat
-    if (bytebeam_publish_device_heartbeat(bytebeam_client) != 0) {
-        BB_LOGE(TAG, "Failed to publish device heartbeat");
+    // publish the device heartbeat, in sleep cycle mode not on every wake up
+    if (bytebeam_sleep_cycle_should_publish_heartbeat(bytebeam_client)) {
+        if (bytebeam_publish_device_heartbeat(bytebeam_client) != 0) {
+            BB_LOGE(TAG, "Failed to publish device heartbeat");
+        }
     }
 
     return 0;
@@ -446,6 +944,12 @@ int bytebeam_hal_spiffs_mount()
 {  
     esp_err_t err;
 
+    // SPIFFS is shared between the provisioning and the offline queue, so only the first user mounts it
+    if (spiffs_mount_count > 0) {
+        spiffs_mount_count++;
+        return 0;
+    }
+
     esp_vfs_spiffs_conf_t conf = {
         .base_path = "/spiffs",
         .partition_label = NULL,
@@ -474,6 +978,7 @@ int bytebeam_hal_spiffs_mount()
         return -1;
     }
 
+    spiffs_mount_count = 1;
     return 0;
 }
 
@@ -481,12 +986,18 @@ int bytebeam_hal_spiffs_unmount()
 {
     esp_err_t err;
 
+    if (spiffs_mount_count > 1) {
+        spiffs_mount_count--;
+        return 0;
+    }
+
     err = esp_vfs_spiffs_unregister(NULL);
 
     if (err != ESP_OK) {
         return -1;
     }
 
+    spiffs_mount_count = 0;
     return 0;
 }
 
@@ -494,6 +1005,11 @@ int bytebeam_hal_fatfs_mount()
 {
     esp_err_t err;
 
+    if (fatfs_mount_count > 0) {
+        fatfs_mount_count++;
+        return 0;
+    }
+
     const esp_vfs_fat_mount_config_t conf = {
             .max_files = 4,
             .format_if_mount_failed = false,
@@ -521,6 +1037,7 @@ int bytebeam_hal_fatfs_mount()
         return -1;
     }
 
+    fatfs_mount_count = 1;
     return 0;
 }
 
@@ -528,12 +1045,18 @@ int bytebeam_hal_fatfs_unmount()
 {
     esp_err_t err;
 
+    if (fatfs_mount_count > 1) {
+        fatfs_mount_count--;
+        return 0;
+    }
+
     err = esp_vfs_fat_spiflash_unmount_ro("/spiflash", "storage");
 
     if (err != ESP_OK) {
         return -1;
     }
 
+    fatfs_mount_count = 0;
     return 0;
 }
 
@@ -556,4 +1079,239 @@ long long bytebeam_hal_get_uptime_ms()
     long long uptime = esp_timer_get_time();
     uptime = uptime/1000;
     return uptime;
-}
\ No newline at end of file
+}
+
+long long bytebeam_hal_get_uptime_us()
+{
+    return esp_timer_get_time();
+}
+
+uint32_t bytebeam_hal_random(void)
+{
+    return esp_random();
+}
+
+/* The provisioning cache is a single blob next to the OTA keys, NVS spreads it over as many pages as it needs */
+char *bytebeam_hal_provisioning_cache_load(int *length)
+{
+    nvs_handle_t nvs_handle;
+    size_t blob_len = 0;
+    char *blob = NULL;
+
+    // the cache is loaded by bytebeam_init, which may well run before the application got to initialize NVS
+    if (nvs_flash_init() != ESP_OK) {
+        BB_LOGE(TAG, "NVS flash init failed.");
+        return NULL;
+    }
+
+    if (nvs_open("test_storage", NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return NULL;
+    }
+
+    if (nvs_get_blob(nvs_handle, "prov_cache", NULL, &blob_len) == ESP_OK && blob_len > 0) {
+        blob = malloc(blob_len);
+
+        if (blob != NULL && nvs_get_blob(nvs_handle, "prov_cache", blob, &blob_len) != ESP_OK) {
+            free(blob);
+            blob = NULL;
+        }
+    }
+
+    nvs_close(nvs_handle);
+
+    *length = (int)blob_len;
+
+    return blob;
+}
+
+int bytebeam_hal_provisioning_cache_save(const char *data, int length)
+{
+    nvs_handle_t nvs_handle;
+
+    if (nvs_flash_init() != ESP_OK) {
+        BB_LOGE(TAG, "NVS flash init failed.");
+        return -1;
+    }
+
+    if (nvs_open("test_storage", NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        BB_LOGE(TAG, "Failed to open NVS Storage");
+        return -1;
+    }
+
+    esp_err_t err = nvs_set_blob(nvs_handle, "prov_cache", data, length);
+
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK) {
+        BB_LOGE(TAG, "Failed to save the provisioning cache in NVS (%s)", esp_err_to_name(err));
+        return -1;
+    }
+
+    return 0;
+}
+
+int bytebeam_hal_provisioning_cache_erase(void)
+{
+    nvs_handle_t nvs_handle;
+
+    if (nvs_flash_init() != ESP_OK) {
+        BB_LOGE(TAG, "NVS flash init failed.");
+        return -1;
+    }
+
+    if (nvs_open("test_storage", NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        BB_LOGE(TAG, "Failed to open NVS Storage");
+        return -1;
+    }
+
+    esp_err_t err = nvs_erase_key(nvs_handle, "prov_cache");
+
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+
+    nvs_close(nvs_handle);
+
+    // nothing cached is as good as erased
+    return (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND) ? 0 : -1;
+}
+
+#if CONFIG_BYTEBEAM_PROVISION_DEVICE_FROM_PARTITION
+const char *bytebeam_hal_provisioning_partition_map(int *length)
+{
+    // the clients provisioned from the partition all share the one mapping, so only the first user maps it
+    if (provisioning_partition_map_count > 0) {
+        provisioning_partition_map_count++;
+        *length = provisioning_partition_length;
+        return (const char *)provisioning_partition_data;
+    }
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, CONFIG_BYTEBEAM_PROVISIONING_PARTITION_NAME);
+
+    if (partition == NULL) {
+        BB_LOGE(TAG, "Provisioning partition %s not found", CONFIG_BYTEBEAM_PROVISIONING_PARTITION_NAME);
+        return NULL;
+    }
+
+    // the whole partition is mapped, the provisioning image tells how much of it is in use
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    esp_err_t err = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &provisioning_partition_data, &provisioning_partition_handle);
+#else
+    esp_err_t err = esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &provisioning_partition_data, &provisioning_partition_handle);
+#endif
+
+    if (err != ESP_OK) {
+        BB_LOGE(TAG, "Failed to map provisioning partition (%s)", esp_err_to_name(err));
+
+        provisioning_partition_data = NULL;
+        return NULL;
+    }
+
+    provisioning_partition_length = (int)partition->size;
+    provisioning_partition_map_count = 1;
+
+    *length = provisioning_partition_length;
+
+    return (const char *)provisioning_partition_data;
+}
+
+void bytebeam_hal_provisioning_partition_unmap(void)
+{
+    if (provisioning_partition_map_count > 1) {
+        provisioning_partition_map_count--;
+        return;
+    }
+
+    if (provisioning_partition_data == NULL) {
+        return;
+    }
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    esp_partition_munmap(provisioning_partition_handle);
+#else
+    spi_flash_munmap(provisioning_partition_handle);
+#endif
+
+    provisioning_partition_data = NULL;
+    provisioning_partition_map_count = 0;
+}
+#endif
+
+bytebeam_hal_mutex_t bytebeam_hal_mutex_create(void)
+{
+    return (bytebeam_hal_mutex_t)xSemaphoreCreateRecursiveMutex();
+}
+
+void bytebeam_hal_mutex_lock(bytebeam_hal_mutex_t mutex)
+{
+    xSemaphoreTakeRecursive((SemaphoreHandle_t)mutex, portMAX_DELAY);
+}
+
+void bytebeam_hal_mutex_unlock(bytebeam_hal_mutex_t mutex)
+{
+    xSemaphoreGiveRecursive((SemaphoreHandle_t)mutex);
+}
+
+void bytebeam_hal_mutex_delete(bytebeam_hal_mutex_t mutex)
+{
+    vSemaphoreDelete((SemaphoreHandle_t)mutex);
+}
+
+bytebeam_hal_task_t bytebeam_hal_task_create(const char *name, void (*task_func)(void *), void *arg, int stack_size, int priority)
+{
+    TaskHandle_t task = NULL;
+
+    if (xTaskCreate(task_func, name, stack_size, arg, priority, &task) != pdPASS) {
+        return NULL;
+    }
+
+    return (bytebeam_hal_task_t)task;
+}
+
+void bytebeam_hal_task_delete(bytebeam_hal_task_t task)
+{
+    // NULL deletes the calling task
+    vTaskDelete((TaskHandle_t)task);
+}
+
+void bytebeam_hal_task_notify(bytebeam_hal_task_t task)
+{
+    xTaskNotifyGive((TaskHandle_t)task);
+}
+
+bool bytebeam_hal_task_wait_notify(int timeout_ms)
+{
+    return ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms)) != 0;
+}
+
+void bytebeam_hal_delay_ms(int milliseconds)
+{
+    vTaskDelay(pdMS_TO_TICKS(milliseconds));
+}
+
+bytebeam_hal_semaphore_t bytebeam_hal_semaphore_create(int max_count, int initial_count)
+{
+    return (bytebeam_hal_semaphore_t)xSemaphoreCreateCounting(max_count, initial_count);
+}
+
+bool bytebeam_hal_semaphore_take(bytebeam_hal_semaphore_t semaphore, int timeout_ms)
+{
+    // negative timeout waits forever
+    TickType_t ticks = (timeout_ms < 0) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+
+    return xSemaphoreTake((SemaphoreHandle_t)semaphore, ticks) == pdTRUE;
+}
+
+void bytebeam_hal_semaphore_give(bytebeam_hal_semaphore_t semaphore)
+{
+    xSemaphoreGive((SemaphoreHandle_t)semaphore);
+}
+
+void bytebeam_hal_semaphore_delete(bytebeam_hal_semaphore_t semaphore)
+{
+    vSemaphoreDelete((SemaphoreHandle_t)semaphore);
+}
@@ -0,0 +1,965 @@
+/* The linux hal is built by the host cmake build only, other builds of the library pick up the esp hal instead */
+#ifdef CONFIG_SDK_PLATFORM_LINUX
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/random.h>
+#ifdef BYTEBEAM_LINUX_HAL_CURL
+#include <curl/curl.h>
+#endif
+#include "bytebeam_hal.h"
+#include "bytebeam_internal.h"
+#include "bytebeam_ota.h"
+#include "bytebeam_action.h"
+#include "bytebeam_client.h"
+
+/* A task is a detached thread with a notification count, as per the freertos direct to task notifications */
+typedef struct bytebeam_linux_task {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int notify_count;
+    void (*task_func)(void *);
+    void *arg;
+} bytebeam_linux_task_t;
+
+typedef struct bytebeam_linux_semaphore {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int count;
+    int max_count;
+} bytebeam_linux_semaphore_t;
+
+static int ota_update_completed = 0;
+static char ota_action_id_str[BYTEBEAM_ACTION_ID_STR_LEN] = "";
+static char ota_device_id_str[BYTEBEAM_DEVICE_ID_STR_LEN] = "";
+static __thread bytebeam_linux_task_t *current_task = NULL;
+
+static const char *TAG = "BYTEBEAM_HAL";
+
+static void make_abs_timeout(struct timespec *ts, int timeout_ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+
+    ts->tv_sec = ts->tv_sec + timeout_ms / 1000;
+    ts->tv_nsec = ts->tv_nsec + (long)(timeout_ms % 1000) * 1000000;
+
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec = ts->tv_nsec - 1000000000;
+    }
+}
+
+static void init_monotonic_cond(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+int bytebeam_hal_mqtt_subscribe(bytebeam_client_handle_t client, char *topic, int qos)
+{
+    return bytebeam_linux_mqtt_subscribe(client, (const char *)topic, qos);
+}
+
+int bytebeam_hal_mqtt_unsubscribe(bytebeam_client_handle_t client, char *topic)
+{
+    // the subscriptions go away with the session, the host client has no use for unsubscribe
+    BB_LOGE(TAG, "Unsubscribe is not supported on linux, topic : %s", topic);
+    return -1;
+}
+
+int bytebeam_hal_mqtt_publish(bytebeam_client_handle_t client, char *topic, char *message, int length, int qos)
+{
+    return bytebeam_linux_mqtt_publish(client, (const char *)topic, (const char *)message, length, qos);
+}
+
+int bytebeam_hal_mqtt_get_outbox_size(bytebeam_client_handle_t client)
+{
+    if (client == NULL) {
+        return 0;
+    }
+
+    return bytebeam_linux_mqtt_get_outbox_size(client);
+}
+
+int bytebeam_hal_restart(void)
+{
+    // there is no rebooting a host process, the supervisor (if any) is expected to start it again
+    BB_LOGI(TAG, "Restart requested, exiting");
+
+    fflush(stdout);
+    exit(0);
+
+    return 0;
+}
+
+#ifdef BYTEBEAM_LINUX_HAL_CURL
+static bytebeam_client_t *ota_client = NULL;
+
+typedef struct bytebeam_linux_ota_download {
+    bytebeam_client_t *bytebeam_client;
+    CURL *curl;
+    CURLSH *share;
+    FILE *file;
+    bool is_started;
+    long long offset;
+    long long image_size;
+    int progress_stamp;
+} bytebeam_linux_ota_download_t;
+
+static void publish_ota_progress(bytebeam_linux_ota_download_t *download)
+{
+    const int update_progress_offset = 10;
+    char *update_progress_status = "Downloading";
+
+    // without the image size there is no way to tell the progress
+    if (download->image_size <= 0) {
+        return;
+    }
+
+    int update_progress_percent = (int)((download->offset * 100) / download->image_size);
+
+    if (update_progress_percent > 100) {
+        update_progress_percent = 100;
+    }
+
+    if (update_progress_percent < download->progress_stamp) {
+        return;
+    }
+
+    if (update_progress_percent == 100) {
+        update_progress_status = "Downloaded";
+    }
+
+    if (bytebeam_publish_action_status(download->bytebeam_client, download->bytebeam_client->ota_action_id, update_progress_percent, update_progress_status, "") != 0) {
+        BB_LOGE(TAG, "Failed to publish OTA progress status");
+    }
+
+    download->progress_stamp = update_progress_percent - (update_progress_percent % update_progress_offset) + update_progress_offset;
+}
+
+static size_t ota_write_callback(char *data, size_t size, size_t nmemb, void *userdata)
+{
+    bytebeam_linux_ota_download_t *download = userdata;
+    size_t len = size * nmemb;
+
+    // the first data tells whether the server honoured the range, a whole image replaces the partial one
+    if (!download->is_started) {
+        long status_code = 0;
+        curl_off_t content_length = -1;
+
+        curl_easy_getinfo(download->curl, CURLINFO_RESPONSE_CODE, &status_code);
+        curl_easy_getinfo(download->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length);
+
+        if (status_code != 206 && download->offset > 0) {
+            BB_LOGW(TAG, "Server sent the whole image, restarting the download");
+
+            if (ftruncate(fileno(download->file), 0) != 0) {
+                return 0;
+            }
+
+            download->offset = 0;
+        }
+
+        download->image_size = (content_length > 0) ? download->offset + content_length : -1;
+        download->is_started = true;
+    }
+
+    if (fwrite(data, 1, len, download->file) != len) {
+        return 0;
+    }
+
+    download->offset = download->offset + (long long)len;
+    publish_ota_progress(download);
+
+    return len;
+}
+
+static int download_ota_image(bytebeam_linux_ota_download_t *download, const char *ota_url, const char *part_fname)
+{
+    char range[32] = { 0 };
+    long status_code = 0;
+    char *ota_error_str = download->bytebeam_client->ota_error_str;
+
+    CURL *curl = curl_easy_init();
+
+    if (curl == NULL) {
+        snprintf(ota_error_str, BYTEBEAM_OTA_ERROR_STR_LEN, "HTTP client init failed");
+        return -1;
+    }
+
+    // an interrupted download carries on from whatever made it into the partial file
+    download->file = fopen(part_fname, "ab");
+
+    if (download->file == NULL) {
+        snprintf(ota_error_str, BYTEBEAM_OTA_ERROR_STR_LEN, "Failed to open %s", part_fname);
+        curl_easy_cleanup(curl);
+        return -1;
+    }
+
+    fseek(download->file, 0, SEEK_END);
+    download->offset = ftell(download->file);
+    download->curl = curl;
+    download->is_started = false;
+
+    if (download->offset > 0) {
+        snprintf(range, sizeof(range), "%lld-", download->offset);
+        curl_easy_setopt(curl, CURLOPT_RANGE, range);
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, ota_url);
+    curl_easy_setopt(curl, CURLOPT_SHARE, download->share);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_MAXREDIRS, (long)BYTEBEAM_OTA_MAX_REDIRECTS);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, ota_write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, download);
+
+    // the ota server is verified with the same certificates as the broker
+    struct curl_blob ca_blob = { 0 };
+    struct curl_blob cert_blob = { 0 };
+    struct curl_blob key_blob = { 0 };
+    bytebeam_device_config_t *device_cfg = &download->bytebeam_client->device_cfg;
+
+    if (device_cfg->ca_cert_pem != NULL) {
+        ca_blob.data = (void *)device_cfg->ca_cert_pem;
+        ca_blob.len = strlen(device_cfg->ca_cert_pem);
+        curl_easy_setopt(curl, CURLOPT_CAINFO_BLOB, &ca_blob);
+    }
+
+    if (device_cfg->client_cert_pem != NULL && device_cfg->client_key_pem != NULL) {
+        cert_blob.data = (void *)device_cfg->client_cert_pem;
+        cert_blob.len = strlen(device_cfg->client_cert_pem);
+        key_blob.data = (void *)device_cfg->client_key_pem;
+        key_blob.len = strlen(device_cfg->client_key_pem);
+        curl_easy_setopt(curl, CURLOPT_SSLCERT_BLOB, &cert_blob);
+        curl_easy_setopt(curl, CURLOPT_SSLKEY_BLOB, &key_blob);
+    }
+
+    CURLcode res = curl_easy_perform(curl);
+
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status_code);
+
+    fclose(download->file);
+    download->file = NULL;
+    curl_easy_cleanup(curl);
+
+    if (res != CURLE_OK) {
+        BB_LOGE(TAG, "OTA download stopped at %lld bytes : %s", download->offset, curl_easy_strerror(res));
+        snprintf(ota_error_str, BYTEBEAM_OTA_ERROR_STR_LEN, "%s", curl_easy_strerror(res));
+
+        // a refused range most probably means the image changed, start over the next time
+        if (res == CURLE_HTTP_RETURNED_ERROR && status_code == 416) {
+            remove(part_fname);
+        }
+
+        return -1;
+    }
+
+    // the size of an image sent without it (chunked) is only known at its end, report it downloaded now
+    if (download->image_size <= 0) {
+        download->image_size = download->offset;
+        publish_ota_progress(download);
+    }
+
+    return 0;
+}
+#endif
+
+#ifdef BYTEBEAM_LINUX_HAL_CURL
+static int run_ota(bytebeam_client_t *bytebeam_client, char *ota_url)
+{
+    char part_fname[256] = { 0 };
+    bytebeam_linux_ota_download_t download;
+    int ret_val = -1;
+
+    snprintf(part_fname, sizeof(part_fname), "%s.part", BYTEBEAM_LINUX_OTA_IMAGE_FILENAME);
+
+    memset(&download, 0x00, sizeof(download));
+    download.bytebeam_client = bytebeam_client;
+
+    BB_LOGI(TAG, "The URL is:%s", ota_url);
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    // every attempt is a new connection, sharing the tls sessions lets the retries skip the full handshake
+    download.share = curl_share_init();
+
+    if (download.share != NULL) {
+        curl_share_setopt(download.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
+
+    for (int attempt = 0; attempt <= BYTEBEAM_OTA_MAX_RETRIES; attempt++) {
+        if (attempt > 0) {
+            BB_LOGW(TAG, "Retrying OTA download (%d/%d)", attempt, BYTEBEAM_OTA_MAX_RETRIES);
+            bytebeam_hal_delay_ms(BYTEBEAM_OTA_RETRY_DELAY_MS);
+        }
+
+        ret_val = download_ota_image(&download, ota_url, part_fname);
+
+        if (ret_val == 0) {
+            break;
+        }
+    }
+
+    curl_share_cleanup(download.share);
+
+    if (ret_val != 0) {
+        return -1;
+    }
+
+    if (rename(part_fname, BYTEBEAM_LINUX_OTA_IMAGE_FILENAME) != 0) {
+        snprintf(bytebeam_client->ota_error_str, BYTEBEAM_OTA_ERROR_STR_LEN, "Failed to save the OTA image");
+        return -1;
+    }
+
+    BB_LOGI(TAG, "OTA image saved to %s", BYTEBEAM_LINUX_OTA_IMAGE_FILENAME);
+
+    return 0;
+}
+#endif
+
+int bytebeam_hal_ota(bytebeam_client_t *bytebeam_client, char *ota_url)
+{
+#ifdef BYTEBEAM_LINUX_HAL_CURL
+    bytebeam_client_t *expected = NULL;
+
+    // there is one OTA image file for all the clients, so only one of them can download an update at a time
+    if (!__atomic_compare_exchange_n(&ota_client, &expected, bytebeam_client, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        snprintf(bytebeam_client->ota_error_str, BYTEBEAM_OTA_ERROR_STR_LEN, "Another OTA is in progress");
+        return -1;
+    }
+
+    int ret_val = run_ota(bytebeam_client, ota_url);
+
+    __atomic_store_n(&ota_client, NULL, __ATOMIC_RELEASE);
+
+    return ret_val;
+#else
+    (void)ota_url;
+
+    snprintf(bytebeam_client->ota_error_str, BYTEBEAM_OTA_ERROR_STR_LEN, "OTA is not supported by this build");
+    return -1;
+#endif
+}
+
+int bytebeam_hal_ota_mark_updated(bytebeam_client_t *bytebeam_client, int action_id_val)
+{
+    FILE *file = fopen(BYTEBEAM_LINUX_OTA_STATE_FILENAME, "w");
+
+    if (file == NULL) {
+        BB_LOGE(TAG, "Failed to open %s", BYTEBEAM_LINUX_OTA_STATE_FILENAME);
+        return -1;
+    }
+
+    // the device the action came for goes along, so that the next start reports the completion through its client
+    int ret_val = (fprintf(file, "%d\n%s\n", action_id_val, bytebeam_client->device_cfg.device_id) > 0) ? 0 : -1;
+
+    if (fclose(file) != 0) {
+        ret_val = -1;
+    }
+
+    if (ret_val != 0) {
+        BB_LOGE(TAG, "Failed to save the OTA action id");
+    }
+
+    return ret_val;
+}
+
+static void mqtt_event_handler(void *handler_args, bytebeam_linux_mqtt_event_t *event)
+{
+    bytebeam_client_t *bytebeam_client = handler_args;
+    int msg_id, ret_val;
+
+    switch (event->event_id) {
+    case BYTEBEAM_LINUX_MQTT_EVENT_CONNECTED:
+        BB_LOGI(TAG, "MQTT_EVENT_CONNECTED");
+        bytebeam_metrics_count(BYTEBEAM_METRIC_MQTT_CONNECTS, 1);
+        // in sleep cycle mode the broker mostly still holds the subscription from the last wake up
+        if (bytebeam_sleep_cycle_should_subscribe(bytebeam_client, event->session_present)) {
+            msg_id = bytebeam_subscribe_to_actions(bytebeam_client->device_cfg, bytebeam_client->client);
+
+            if (msg_id != -1) {
+                BB_LOGI(TAG, "MQTT SUBSCRIBED!! Msg ID:%d", msg_id);
+            } else {
+                BB_LOGE(TAG, "MQTT SUBSCRIBE FAILED");
+            }
+        }
+
+        bytebeam_client->connection_status = 1;
+
+        // drain the records queued while we were offline
+        bytebeam_offline_queue_on_connected(bytebeam_client);
+        bytebeam_shadow_on_connected(bytebeam_client);
+        break;
+
+    case BYTEBEAM_LINUX_MQTT_EVENT_DISCONNECTED:
+        BB_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
+        bytebeam_metrics_count(BYTEBEAM_METRIC_MQTT_DISCONNECTS, 1);
+        bytebeam_client->connection_status = 0;
+        bytebeam_offline_queue_on_disconnected(bytebeam_client);
+        // the linux mqtt client drops its in-flight publishes on a disconnect, so these are never going to be acknowledged
+        bytebeam_delivery_on_disconnected(bytebeam_client);
+        bytebeam_stream_check_outbox(bytebeam_client);
+        break;
+
+    case BYTEBEAM_LINUX_MQTT_EVENT_SUBSCRIBED:
+        BB_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
+        break;
+
+    case BYTEBEAM_LINUX_MQTT_EVENT_PUBLISHED:
+        BB_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+        bytebeam_offline_queue_on_published(bytebeam_client, event->msg_id);
+        bytebeam_delivery_on_published(bytebeam_client, event->msg_id);
+        bytebeam_stream_check_outbox(bytebeam_client);
+        break;
+
+    case BYTEBEAM_LINUX_MQTT_EVENT_DATA:
+        BB_LOGI(TAG, "MQTT_EVENT_DATA");
+        BB_LOGI(TAG, "TOPIC=%.*s", event->topic_len, event->topic);
+        BB_LOGI(TAG, "DATA=%.*s", event->data_len, event->data);
+
+        ret_val = bytebeam_handle_actions(event->data, event->data_len, bytebeam_client->client, bytebeam_client);
+
+        if (ret_val != 0) {
+            BB_LOGE(TAG, "BYTEBEAM HANDLE ACTIONS FAILED");
+        } else {
+            BB_LOGI(TAG, "BYTEBEAM HANDLE ACTIONS SUCCESS!!");
+        }
+
+        break;
+
+    default:
+        BB_LOGI(TAG, "Other event id:%d", event->event_id);
+        break;
+    }
+}
+
+int bytebeam_hal_init(bytebeam_client_t *bytebeam_client)
+{
+    const char *broker_uri = getenv(BYTEBEAM_LINUX_BROKER_URI_ENV);
+
+    // lets the tests point the device to a local broker, the certificates are ignored for a plain mqtt:// uri
+    if (broker_uri != NULL) {
+        BB_LOGI(TAG, "Using the broker uri from the environment : %s", broker_uri);
+        bytebeam_client->mqtt_cfg.uri = broker_uri;
+    }
+
+    bytebeam_client->client = bytebeam_linux_mqtt_init(&bytebeam_client->mqtt_cfg, mqtt_event_handler, bytebeam_client);
+
+    if (bytebeam_client->client == NULL) {
+        BB_LOGE(TAG, "MQTT Client initialization failed");
+        return -1;
+    }
+
+    // the state file is only there after a successful OTA, it is consumed by this start
+    FILE *file = fopen(BYTEBEAM_LINUX_OTA_STATE_FILENAME, "r");
+
+    if (file == NULL) {
+        BB_LOGI(TAG, "Normal start");
+        return 0;
+    }
+
+    int ota_action_id_val = 0;
+    int ret_val = fscanf(file, "%d\n", &ota_action_id_val);
+
+    // an older state file has no device id, its completion goes out through any client
+    if (ret_val != 1 || fgets(ota_device_id_str, sizeof(ota_device_id_str), file) == NULL) {
+        ota_device_id_str[0] = '\0';
+    }
+
+    ota_device_id_str[strcspn(ota_device_id_str, "\n")] = '\0';
+
+    fclose(file);
+    remove(BYTEBEAM_LINUX_OTA_STATE_FILENAME);
+
+    if (ret_val != 1) {
+        BB_LOGE(TAG, "Failed to retreieve the OTA action id from %s", BYTEBEAM_LINUX_OTA_STATE_FILENAME);
+        return 0;
+    }
+
+    snprintf(ota_action_id_str, sizeof(ota_action_id_str), "%d", ota_action_id_val);
+    ota_update_completed = 1;
+
+    BB_LOGI(TAG, "Start after successful OTA update");
+
+    return 0;
+}
+
+int bytebeam_hal_destroy(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_linux_mqtt_destroy(bytebeam_client->client);
+
+    return 0;
+}
+
+static bool is_ota_device(bytebeam_client_t *bytebeam_client)
+{
+    return ota_device_id_str[0] == '\0' || strcmp(ota_device_id_str, bytebeam_client->device_cfg.device_id) == 0;
+}
+
+int bytebeam_hal_start_mqtt(bytebeam_client_t *bytebeam_client)
+{
+    if (bytebeam_linux_mqtt_start(bytebeam_client->client) != 0) {
+        return -1;
+    }
+
+    // the OTA completion goes out through the client which received the OTA action
+    if (ota_update_completed == 1 && is_ota_device(bytebeam_client)) {
+        ota_update_completed = 0;
+
+        if ((bytebeam_publish_action_completed(bytebeam_client, ota_action_id_str)) != 0) {
+            BB_LOGE(TAG, "Failed to publish OTA complete status");
+        }
+    }
+
+    // publish the device heartbeat, in sleep cycle mode not on every wake up
+    if (bytebeam_sleep_cycle_should_publish_heartbeat(bytebeam_client)) {
+        if (bytebeam_publish_device_heartbeat(bytebeam_client) != 0) {
+            BB_LOGE(TAG, "Failed to publish device heartbeat");
+        }
+    }
+
+    return 0;
+}
+
+int bytebeam_hal_stop_mqtt(bytebeam_client_t *bytebeam_client)
+{
+    return bytebeam_linux_mqtt_stop(bytebeam_client->client);
+}
+
+/* The host has a regular file system, the paths used by the sdk are relative to the working directory */
+int bytebeam_hal_spiffs_mount()
+{
+    return 0;
+}
+
+int bytebeam_hal_spiffs_unmount()
+{
+    return 0;
+}
+
+int bytebeam_hal_fatfs_mount()
+{
+    return 0;
+}
+
+int bytebeam_hal_fatfs_unmount()
+{
+    return 0;
+}
+
+unsigned long long bytebeam_hal_get_epoch_millis()
+{
+    struct timeval te;
+    gettimeofday(&te, NULL); // get current time
+    unsigned long long milliseconds = te.tv_sec * 1000LL + te.tv_usec / 1000;
+    return milliseconds;
+}
+
+bytebeam_reset_reason_t bytebeam_hal_get_reset_reason()
+{
+    // every process start looks like a power on
+    return BB_RST_POWERON;
+}
+
+long long bytebeam_hal_get_uptime_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+long long bytebeam_hal_get_uptime_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint32_t bytebeam_hal_random(void)
+{
+    uint32_t value = 0;
+
+    // the value only spreads the devices out in time, so the clock will do if the kernel has no entropy to spare
+    if (getrandom(&value, sizeof(value), GRND_NONBLOCK) != sizeof(value)) {
+        value = (uint32_t)(bytebeam_hal_get_uptime_us() * 2654435761u) ^ (uint32_t)getpid();
+    }
+
+    return value;
+}
+
+char *bytebeam_hal_provisioning_cache_load(int *length)
+{
+    FILE *file = fopen(BYTEBEAM_LINUX_PROVISIONING_CACHE_FILENAME, "rb");
+
+    if (file == NULL) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *blob = (file_length > 0) ? malloc(file_length) : NULL;
+
+    if (blob != NULL && fread(blob, 1, file_length, file) != (size_t)file_length) {
+        free(blob);
+        blob = NULL;
+    }
+
+    fclose(file);
+
+    *length = (int)file_length;
+
+    return blob;
+}
+
+int bytebeam_hal_provisioning_cache_save(const char *data, int length)
+{
+    char temp_fname[256];
+
+    // write a temporary file and rename it over the cache, so that a crash never leaves half a cache behind
+    snprintf(temp_fname, sizeof(temp_fname), "%s.tmp", BYTEBEAM_LINUX_PROVISIONING_CACHE_FILENAME);
+
+    FILE *file = fopen(temp_fname, "wb");
+
+    if (file == NULL) {
+        BB_LOGE(TAG, "Failed to open %s", temp_fname);
+        return -1;
+    }
+
+    bool is_written = fwrite(data, 1, length, file) == (size_t)length;
+
+    if (fclose(file) != 0 || !is_written || rename(temp_fname, BYTEBEAM_LINUX_PROVISIONING_CACHE_FILENAME) != 0) {
+        BB_LOGE(TAG, "Failed to save the provisioning cache to %s", BYTEBEAM_LINUX_PROVISIONING_CACHE_FILENAME);
+
+        remove(temp_fname);
+        return -1;
+    }
+
+    return 0;
+}
+
+int bytebeam_hal_provisioning_cache_erase(void)
+{
+    if (remove(BYTEBEAM_LINUX_PROVISIONING_CACHE_FILENAME) != 0 && errno != ENOENT) {
+        BB_LOGE(TAG, "Failed to remove %s", BYTEBEAM_LINUX_PROVISIONING_CACHE_FILENAME);
+        return -1;
+    }
+
+    return 0;
+}
+
+#if CONFIG_BYTEBEAM_PROVISION_DEVICE_FROM_PARTITION
+// the provisioning image file stands in for the flash partition, it is mapped read only just the same
+static void *provisioning_image_data = NULL;
+static size_t provisioning_image_length = 0;
+static int provisioning_image_map_count = 0;
+
+const char *bytebeam_hal_provisioning_partition_map(int *length)
+{
+    struct stat image_stat;
+
+    // the clients provisioned from the image all share the one mapping, so only the first user maps it
+    if (provisioning_image_map_count > 0) {
+        provisioning_image_map_count++;
+        *length = (int)provisioning_image_length;
+        return (const char *)provisioning_image_data;
+    }
+
+    int fd = open(BYTEBEAM_LINUX_PROVISIONING_IMAGE_FILENAME, O_RDONLY);
+
+    if (fd < 0) {
+        BB_LOGE(TAG, "Failed to open %s", BYTEBEAM_LINUX_PROVISIONING_IMAGE_FILENAME);
+        return NULL;
+    }
+
+    if (fstat(fd, &image_stat) != 0 || image_stat.st_size <= 0) {
+        BB_LOGE(TAG, "Failed to get the size of %s", BYTEBEAM_LINUX_PROVISIONING_IMAGE_FILENAME);
+
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, image_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping keeps the file open on its own
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        BB_LOGE(TAG, "Failed to map %s (%s)", BYTEBEAM_LINUX_PROVISIONING_IMAGE_FILENAME, strerror(errno));
+        return NULL;
+    }
+
+    provisioning_image_data = data;
+    provisioning_image_length = image_stat.st_size;
+    provisioning_image_map_count = 1;
+
+    *length = (int)image_stat.st_size;
+
+    return (const char *)data;
+}
+
+void bytebeam_hal_provisioning_partition_unmap(void)
+{
+    if (provisioning_image_map_count > 1) {
+        provisioning_image_map_count--;
+        return;
+    }
+
+    if (provisioning_image_data == NULL) {
+        return;
+    }
+
+    munmap(provisioning_image_data, provisioning_image_length);
+
+    provisioning_image_data = NULL;
+    provisioning_image_length = 0;
+    provisioning_image_map_count = 0;
+}
+#endif
+
+unsigned long long bytebeam_linux_log_timestamp(void)
+{
+    return (unsigned long long)bytebeam_hal_get_uptime_ms();
+}
+
+bytebeam_hal_mutex_t bytebeam_hal_mutex_create(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutex_t *mutex = malloc(sizeof(pthread_mutex_t));
+
+    if (mutex == NULL) {
+        return NULL;
+    }
+
+    // the sdk mutexes are recursive, as per the esp hal
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    return (bytebeam_hal_mutex_t)mutex;
+}
+
+void bytebeam_hal_mutex_lock(bytebeam_hal_mutex_t mutex)
+{
+    pthread_mutex_lock((pthread_mutex_t *)mutex);
+}
+
+void bytebeam_hal_mutex_unlock(bytebeam_hal_mutex_t mutex)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)mutex);
+}
+
+void bytebeam_hal_mutex_delete(bytebeam_hal_mutex_t mutex)
+{
+    pthread_mutex_destroy((pthread_mutex_t *)mutex);
+    free(mutex);
+}
+
+static void *task_thread(void *arg)
+{
+    bytebeam_linux_task_t *task = arg;
+
+    current_task = task;
+    task->task_func(task->arg);
+
+    // a task function returning is the same as deleting itself
+    bytebeam_hal_task_delete(NULL);
+
+    return NULL;
+}
+
+bytebeam_hal_task_t bytebeam_hal_task_create(const char *name, void (*task_func)(void *), void *arg, int stack_size, int priority)
+{
+    pthread_attr_t attr;
+    bytebeam_linux_task_t *task = calloc(1, sizeof(bytebeam_linux_task_t));
+
+    // the stack size and priority are freertos notions, the host defaults serve well enough
+    (void)name;
+    (void)stack_size;
+    (void)priority;
+
+    if (task == NULL) {
+        return NULL;
+    }
+
+    task->task_func = task_func;
+    task->arg = arg;
+    pthread_mutex_init(&task->lock, NULL);
+    init_monotonic_cond(&task->cond);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    int ret_val = pthread_create(&task->thread, &attr, task_thread, task);
+
+    pthread_attr_destroy(&attr);
+
+    if (ret_val != 0) {
+        pthread_cond_destroy(&task->cond);
+        pthread_mutex_destroy(&task->lock);
+        free(task);
+        return NULL;
+    }
+
+    return (bytebeam_hal_task_t)task;
+}
+
+void bytebeam_hal_task_delete(bytebeam_hal_task_t task)
+{
+    // only a task deleting itself is supported, a thread can not be killed safely from the outside
+    if (task != NULL && task != current_task) {
+        BB_LOGE(TAG, "Deleting another task is not supported on linux");
+        return;
+    }
+
+    bytebeam_linux_task_t *self = current_task;
+
+    if (self != NULL) {
+        current_task = NULL;
+
+        pthread_cond_destroy(&self->cond);
+        pthread_mutex_destroy(&self->lock);
+        free(self);
+    }
+
+    pthread_exit(NULL);
+}
+
+void bytebeam_hal_task_notify(bytebeam_hal_task_t task)
+{
+    bytebeam_linux_task_t *target = task;
+
+    pthread_mutex_lock(&target->lock);
+    target->notify_count++;
+    pthread_cond_signal(&target->cond);
+    pthread_mutex_unlock(&target->lock);
+}
+
+bool bytebeam_hal_task_wait_notify(int timeout_ms)
+{
+    struct timespec ts;
+    bytebeam_linux_task_t *self = current_task;
+    bool is_notified = false;
+
+    if (self == NULL) {
+        // not a hal task, so nobody can notify it
+        bytebeam_hal_delay_ms(timeout_ms);
+        return false;
+    }
+
+    make_abs_timeout(&ts, timeout_ms);
+
+    pthread_mutex_lock(&self->lock);
+
+    while (self->notify_count == 0) {
+        if (pthread_cond_timedwait(&self->cond, &self->lock, &ts) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    // clears the count on exit, as per ulTaskNotifyTake(pdTRUE, ...)
+    is_notified = (self->notify_count != 0);
+    self->notify_count = 0;
+
+    pthread_mutex_unlock(&self->lock);
+
+    return is_notified;
+}
+
+void bytebeam_hal_delay_ms(int milliseconds)
+{
+    struct timespec ts;
+
+    ts.tv_sec = milliseconds / 1000;
+    ts.tv_nsec = (long)(milliseconds % 1000) * 1000000;
+
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+bytebeam_hal_semaphore_t bytebeam_hal_semaphore_create(int max_count, int initial_count)
+{
+    bytebeam_linux_semaphore_t *semaphore = calloc(1, sizeof(bytebeam_linux_semaphore_t));
+
+    if (semaphore == NULL) {
+        return NULL;
+    }
+
+    semaphore->count = initial_count;
+    semaphore->max_count = max_count;
+    pthread_mutex_init(&semaphore->lock, NULL);
+    init_monotonic_cond(&semaphore->cond);
+
+    return (bytebeam_hal_semaphore_t)semaphore;
+}
+
+bool bytebeam_hal_semaphore_take(bytebeam_hal_semaphore_t semaphore, int timeout_ms)
+{
+    struct timespec ts;
+    bytebeam_linux_semaphore_t *sem = semaphore;
+    bool is_taken = false;
+
+    if (timeout_ms >= 0) {
+        make_abs_timeout(&ts, timeout_ms);
+    }
+
+    pthread_mutex_lock(&sem->lock);
+
+    while (sem->count == 0) {
+        // negative timeout waits forever
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&sem->cond, &sem->lock);
+        } else if (pthread_cond_timedwait(&sem->cond, &sem->lock, &ts) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    if (sem->count > 0) {
+        sem->count--;
+        is_taken = true;
+    }
+
+    pthread_mutex_unlock(&sem->lock);
+
+    return is_taken;
+}
+
+void bytebeam_hal_semaphore_give(bytebeam_hal_semaphore_t semaphore)
+{
+    bytebeam_linux_semaphore_t *sem = semaphore;
+
+    pthread_mutex_lock(&sem->lock);
+
+    // a full counting semaphore ignores the give, as per freertos
+    if (sem->count < sem->max_count) {
+        sem->count++;
+        pthread_cond_signal(&sem->cond);
+    }
+
+    pthread_mutex_unlock(&sem->lock);
+}
+
+void bytebeam_hal_semaphore_delete(bytebeam_hal_semaphore_t semaphore)
+{
+    bytebeam_linux_semaphore_t *sem = semaphore;
+
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->lock);
+    free(sem);
+}
+
+#endif /* CONFIG_SDK_PLATFORM_LINUX */
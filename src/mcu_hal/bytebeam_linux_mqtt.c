@@ -0,0 +1,980 @@
+/* The linux hal is built by the host cmake build only, other builds of the library pick up the esp hal instead */
+#ifdef CONFIG_SDK_PLATFORM_LINUX
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#ifdef BYTEBEAM_LINUX_HAL_TLS
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+#endif
+#include "bytebeam_hal.h"
+#include "bytebeam_linux_mqtt.h"
+
+/* Mqtt 3.1.1 control packet types, already shifted into the upper nibble of the fixed header */
+#define MQTT_CONNECT        0x10
+#define MQTT_CONNACK        0x20
+#define MQTT_PUBLISH        0x30
+#define MQTT_PUBACK         0x40
+#define MQTT_SUBSCRIBE      0x82
+#define MQTT_SUBACK         0x90
+#define MQTT_PINGREQ        0xC0
+#define MQTT_PINGRESP       0xD0
+#define MQTT_DISCONNECT     0xE0
+
+/* The clean session flag of the connect packet and the session present flag of the connack */
+#define MQTT_CONNECT_CLEAN_SESSION    0x02
+#define MQTT_CONNACK_SESSION_PRESENT  0x01
+
+/* The fixed header is at most 5 bytes i.e. the packet type and 4 bytes of remaining length */
+#define MQTT_FIXED_HEADER_MAX_LEN 5
+
+/* An unacknowledged qos 1 publish, counted towards the outbox size until its puback arrives */
+typedef struct bytebeam_linux_mqtt_inflight {
+    uint16_t msg_id;
+    int len;
+} bytebeam_linux_mqtt_inflight_t;
+
+/* All the socket and tls operations happen under io_lock, an ssl object must not be used from two threads at once.
+ * The network thread reads a packet only once the socket is readable, so the publishing tasks wait for it at most
+ * for the time taken by a single packet.
+ */
+struct bytebeam_linux_mqtt_client {
+    bytebeam_linux_mqtt_config_t config;
+    bytebeam_linux_mqtt_event_handler_t handler;
+    void *handler_args;
+    char host[256];
+    char port[8];
+    char client_id[64];
+    bool use_tls;
+    int sock;
+#ifdef BYTEBEAM_LINUX_HAL_TLS
+    SSL_CTX *ssl_ctx;
+    SSL *ssl;
+    SSL_SESSION *ssl_session;
+#endif
+    pthread_mutex_t io_lock;
+    pthread_t thread;
+    unsigned char *rx_buffer;
+    unsigned char *tx_buffer;
+    uint16_t next_msg_id;
+    long long last_sent_ms;
+    long long ping_sent_ms;
+    bool is_ping_outstanding;
+    bool is_session_present;
+    bool is_running;
+    bool is_connected;
+    bytebeam_linux_mqtt_inflight_t inflight[BYTEBEAM_LINUX_MQTT_MAX_INFLIGHT];
+    int inflight_count;
+    int inflight_bytes;
+};
+
+static const char *TAG = "BYTEBEAM_LINUX_MQTT";
+
+static long long monotonic_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int parse_uri(bytebeam_linux_mqtt_client_handle_t client, const char *uri)
+{
+    const char *host = NULL;
+    const char *default_port = NULL;
+
+    if (!strncmp(uri, "mqtts://", 8) || !strncmp(uri, "ssl://", 6)) {
+        client->use_tls = true;
+        default_port = "8883";
+    } else if (!strncmp(uri, "mqtt://", 7) || !strncmp(uri, "tcp://", 6)) {
+        client->use_tls = false;
+        default_port = "1883";
+    } else {
+        BB_LOGE(TAG, "Unsupported broker uri : %s", uri);
+        return -1;
+    }
+
+    host = strstr(uri, "://") + 3;
+
+    int host_len = (int)strcspn(host, ":/");
+
+    if (host_len == 0 || host_len >= (int)sizeof(client->host)) {
+        BB_LOGE(TAG, "Invalid broker host in uri : %s", uri);
+        return -1;
+    }
+
+    memcpy(client->host, host, host_len);
+    client->host[host_len] = '\0';
+
+    if (host[host_len] == ':') {
+        int port_len = (int)strspn(host + host_len + 1, "0123456789");
+
+        if (port_len == 0 || port_len >= (int)sizeof(client->port)) {
+            BB_LOGE(TAG, "Invalid broker port in uri : %s", uri);
+            return -1;
+        }
+
+        memcpy(client->port, host + host_len + 1, port_len);
+        client->port[port_len] = '\0';
+    } else {
+        strcpy(client->port, default_port);
+    }
+
+    return 0;
+}
+
+#ifdef BYTEBEAM_LINUX_HAL_TLS
+/* Keeps the newest session of the connection for resuming it on the next connect. A tls 1.3 server sends its
+ * tickets after the handshake, so this is called from the network thread within the handshake or a read, which is the
+ * only thread touching the session.
+ */
+static int on_new_ssl_session(SSL *ssl, SSL_SESSION *session)
+{
+    bytebeam_linux_mqtt_client_handle_t client = SSL_get_app_data(ssl);
+
+    // a copy, as openssl marks the session of the connection as not resumable when the broker drops it uncleanly
+    SSL_SESSION *session_copy = SSL_SESSION_dup(session);
+
+    if (session_copy == NULL) {
+        return 0;
+    }
+
+    if (client->ssl_session != NULL) {
+        SSL_SESSION_free(client->ssl_session);
+    }
+
+    client->ssl_session = session_copy;
+
+    // the connection keeps its own reference
+    return 0;
+}
+
+static int create_ssl_ctx(bytebeam_linux_mqtt_client_handle_t client)
+{
+    BIO *bio = NULL;
+    X509 *cert = NULL;
+    EVP_PKEY *key = NULL;
+
+    client->ssl_ctx = SSL_CTX_new(TLS_client_method());
+
+    if (client->ssl_ctx == NULL) {
+        return -1;
+    }
+
+    if (client->config.cert_pem != NULL) {
+        X509_STORE *store = SSL_CTX_get_cert_store(client->ssl_ctx);
+
+        bio = BIO_new_mem_buf(client->config.cert_pem, -1);
+
+        // the ca certificate may be a chain of several pem blocks
+        while (bio != NULL && (cert = PEM_read_bio_X509(bio, NULL, NULL, NULL)) != NULL) {
+            X509_STORE_add_cert(store, cert);
+            X509_free(cert);
+        }
+
+        BIO_free(bio);
+        ERR_clear_error();
+
+        SSL_CTX_set_verify(client->ssl_ctx, SSL_VERIFY_PEER, NULL);
+    } else {
+        SSL_CTX_set_default_verify_paths(client->ssl_ctx);
+        SSL_CTX_set_verify(client->ssl_ctx, SSL_VERIFY_PEER, NULL);
+    }
+
+    // a reconnect resumes the last session rather than going through the whole mutual tls handshake again
+    SSL_CTX_set_session_cache_mode(client->ssl_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(client->ssl_ctx, on_new_ssl_session);
+
+    if (client->config.client_cert_pem != NULL && client->config.client_key_pem != NULL) {
+        bio = BIO_new_mem_buf(client->config.client_cert_pem, -1);
+        cert = (bio != NULL) ? PEM_read_bio_X509(bio, NULL, NULL, NULL) : NULL;
+        BIO_free(bio);
+
+        bio = BIO_new_mem_buf(client->config.client_key_pem, -1);
+        key = (bio != NULL) ? PEM_read_bio_PrivateKey(bio, NULL, NULL, NULL) : NULL;
+        BIO_free(bio);
+
+        int ret_val = (cert != NULL && key != NULL &&
+                       SSL_CTX_use_certificate(client->ssl_ctx, cert) == 1 &&
+                       SSL_CTX_use_PrivateKey(client->ssl_ctx, key) == 1) ? 0 : -1;
+
+        X509_free(cert);
+        EVP_PKEY_free(key);
+
+        if (ret_val != 0) {
+            BB_LOGE(TAG, "Failed to load the client certificate and key");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+#endif
+
+static void net_close(bytebeam_linux_mqtt_client_handle_t client)
+{
+#ifdef BYTEBEAM_LINUX_HAL_TLS
+    if (client->ssl != NULL) {
+        SSL_shutdown(client->ssl);
+        SSL_free(client->ssl);
+        client->ssl = NULL;
+    }
+#endif
+
+    if (client->sock >= 0) {
+        close(client->sock);
+        client->sock = -1;
+    }
+}
+
+static int net_connect(bytebeam_linux_mqtt_client_handle_t client)
+{
+    struct addrinfo hints;
+    struct addrinfo *result = NULL;
+    struct addrinfo *addr = NULL;
+
+    memset(&hints, 0x00, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(client->host, client->port, &hints, &result) != 0) {
+        BB_LOGE(TAG, "Failed to resolve %s", client->host);
+        return -1;
+    }
+
+    for (addr = result; addr != NULL; addr = addr->ai_next) {
+        client->sock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+
+        if (client->sock < 0) {
+            continue;
+        }
+
+        if (connect(client->sock, addr->ai_addr, addr->ai_addrlen) == 0) {
+            break;
+        }
+
+        close(client->sock);
+        client->sock = -1;
+    }
+
+    freeaddrinfo(result);
+
+    if (client->sock < 0) {
+        BB_LOGE(TAG, "Failed to connect to %s:%s", client->host, client->port);
+        return -1;
+    }
+
+    int flag = 1;
+    struct timeval timeout = {
+        .tv_sec = BYTEBEAM_LINUX_MQTT_NETWORK_TIMEOUT_MS / 1000,
+        .tv_usec = (BYTEBEAM_LINUX_MQTT_NETWORK_TIMEOUT_MS % 1000) * 1000
+    };
+
+    // a dead broker must not block the network thread or the publishing tasks forever
+    setsockopt(client->sock, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    setsockopt(client->sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client->sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    if (!client->use_tls) {
+        return 0;
+    }
+
+#ifdef BYTEBEAM_LINUX_HAL_TLS
+    client->ssl = SSL_new(client->ssl_ctx);
+
+    if (client->ssl == NULL) {
+        net_close(client);
+        return -1;
+    }
+
+    SSL_set_fd(client->ssl, client->sock);
+    SSL_set_tlsext_host_name(client->ssl, client->host);
+    SSL_set1_host(client->ssl, client->host);
+    SSL_set_app_data(client->ssl, client);
+
+    // the server falls back to a full handshake by itself if it no longer knows the session
+    if (client->ssl_session != NULL) {
+        SSL_set_session(client->ssl, client->ssl_session);
+    }
+
+    if (SSL_connect(client->ssl) != 1) {
+        BB_LOGE(TAG, "TLS handshake with %s failed : %s", client->host, ERR_reason_error_string(ERR_get_error()));
+
+        // do not offer the session again, in case it is what the server choked on
+        SSL_SESSION_free(client->ssl_session);
+        client->ssl_session = NULL;
+
+        net_close(client);
+        return -1;
+    }
+
+    if (SSL_session_reused(client->ssl)) {
+        BB_LOGI(TAG, "TLS session with %s resumed", client->host);
+    }
+
+    return 0;
+#else
+    net_close(client);
+    return -1;
+#endif
+}
+
+static int net_write(bytebeam_linux_mqtt_client_handle_t client, const unsigned char *data, int len)
+{
+    while (len > 0) {
+        int written = 0;
+
+#ifdef BYTEBEAM_LINUX_HAL_TLS
+        if (client->ssl != NULL) {
+            written = SSL_write(client->ssl, data, len);
+        } else
+#endif
+        {
+            written = (int)send(client->sock, data, len, MSG_NOSIGNAL);
+        }
+
+        if (written <= 0) {
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        data = data + written;
+        len = len - written;
+    }
+
+    return 0;
+}
+
+static int net_read(bytebeam_linux_mqtt_client_handle_t client, unsigned char *data, int len)
+{
+    while (len > 0) {
+        int received = 0;
+
+#ifdef BYTEBEAM_LINUX_HAL_TLS
+        if (client->ssl != NULL) {
+            received = SSL_read(client->ssl, data, len);
+        } else
+#endif
+        {
+            received = (int)recv(client->sock, data, len, 0);
+        }
+
+        if (received <= 0) {
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        data = data + received;
+        len = len - received;
+    }
+
+    return 0;
+}
+
+/* Returns 1 if there is data to read, 0 on timeout and -1 if the connection is broken */
+static int net_wait_readable(bytebeam_linux_mqtt_client_handle_t client, int timeout_ms)
+{
+#ifdef BYTEBEAM_LINUX_HAL_TLS
+    // the tls layer may already hold decrypted data which the socket knows nothing about
+    if (client->ssl != NULL && SSL_pending(client->ssl) > 0) {
+        return 1;
+    }
+#endif
+
+    struct pollfd pfd = {
+        .fd = client->sock,
+        .events = POLLIN
+    };
+
+    int ret_val = poll(&pfd, 1, timeout_ms);
+
+    if (ret_val < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    if (ret_val > 0 && (pfd.revents & (POLLERR | POLLNVAL))) {
+        return -1;
+    }
+
+    return (ret_val > 0) ? 1 : 0;
+}
+
+static int encode_remaining_length(unsigned char *out, int len)
+{
+    int count = 0;
+
+    do {
+        unsigned char byte = len % 128;
+
+        len = len / 128;
+        out[count++] = (len > 0) ? (byte | 0x80) : byte;
+    } while (len > 0);
+
+    return count;
+}
+
+static void encode_uint16(unsigned char *out, int value)
+{
+    out[0] = (value >> 8) & 0xFF;
+    out[1] = value & 0xFF;
+}
+
+/* Sends the packet built in the tx buffer just after the room kept for the fixed header, the caller holds io_lock */
+static int send_tx_packet(bytebeam_linux_mqtt_client_handle_t client, unsigned char type, int len)
+{
+    unsigned char header[MQTT_FIXED_HEADER_MAX_LEN];
+    int header_len = 1;
+
+    header[0] = type;
+    header_len = header_len + encode_remaining_length(header + 1, len);
+
+    // move the fixed header right in front of the packet, so it goes out in a single write
+    unsigned char *packet = client->tx_buffer + MQTT_FIXED_HEADER_MAX_LEN - header_len;
+    memcpy(packet, header, header_len);
+
+    if (net_write(client, packet, header_len + len) != 0) {
+        return -1;
+    }
+
+    client->last_sent_ms = monotonic_ms();
+
+    return 0;
+}
+
+static int send_short_packet(bytebeam_linux_mqtt_client_handle_t client, unsigned char type, int msg_id, bool with_msg_id)
+{
+    unsigned char packet[4] = { type, 0x00, 0x00, 0x00 };
+    int len = 2;
+
+    if (with_msg_id) {
+        packet[1] = 0x02;
+        encode_uint16(packet + 2, msg_id);
+        len = 4;
+    }
+
+    pthread_mutex_lock(&client->io_lock);
+
+    int ret_val = net_write(client, packet, len);
+
+    if (ret_val == 0) {
+        client->last_sent_ms = monotonic_ms();
+    }
+
+    pthread_mutex_unlock(&client->io_lock);
+
+    return ret_val;
+}
+
+/* Reads a whole packet into the rx buffer, returns the remaining length or -1 */
+static int read_packet(bytebeam_linux_mqtt_client_handle_t client, unsigned char *type)
+{
+    unsigned char byte = 0;
+    int len = 0;
+    int multiplier = 1;
+    int count = 0;
+
+    pthread_mutex_lock(&client->io_lock);
+
+    if (net_read(client, type, 1) != 0) {
+        pthread_mutex_unlock(&client->io_lock);
+        return -1;
+    }
+
+    do {
+        if (count == 4 || net_read(client, &byte, 1) != 0) {
+            pthread_mutex_unlock(&client->io_lock);
+            return -1;
+        }
+
+        len = len + (byte & 0x7F) * multiplier;
+        multiplier = multiplier * 128;
+        count++;
+    } while (byte & 0x80);
+
+    if (len > BYTEBEAM_LINUX_MQTT_MAX_PACKET_SIZE) {
+        BB_LOGE(TAG, "Received packet of %d bytes exceeds the maximum packet size", len);
+
+        pthread_mutex_unlock(&client->io_lock);
+        return -1;
+    }
+
+    int ret_val = net_read(client, client->rx_buffer, len);
+
+    pthread_mutex_unlock(&client->io_lock);
+
+    return (ret_val == 0) ? len : -1;
+}
+
+static uint16_t next_msg_id(bytebeam_linux_mqtt_client_handle_t client)
+{
+    // zero is not a valid message id
+    client->next_msg_id++;
+
+    if (client->next_msg_id == 0) {
+        client->next_msg_id = 1;
+    }
+
+    return client->next_msg_id;
+}
+
+/* Counts the publish towards the outbox size, the caller holds io_lock */
+static void add_inflight(bytebeam_linux_mqtt_client_handle_t client, uint16_t msg_id, int len)
+{
+    // forget the oldest publish once the table is full, its puback is most likely lost anyway
+    if (client->inflight_count == BYTEBEAM_LINUX_MQTT_MAX_INFLIGHT) {
+        client->inflight_bytes = client->inflight_bytes - client->inflight[0].len;
+        client->inflight_count--;
+        memmove(&client->inflight[0], &client->inflight[1], client->inflight_count * sizeof(bytebeam_linux_mqtt_inflight_t));
+    }
+
+    client->inflight[client->inflight_count].msg_id = msg_id;
+    client->inflight[client->inflight_count].len = len;
+    client->inflight_count++;
+
+    __atomic_store_n(&client->inflight_bytes, client->inflight_bytes + len, __ATOMIC_RELAXED);
+}
+
+/* Removes the acknowledged publish from the outbox, the caller holds io_lock */
+static void remove_inflight(bytebeam_linux_mqtt_client_handle_t client, uint16_t msg_id)
+{
+    int index = 0;
+
+    for (index = 0; index < client->inflight_count; index++) {
+        if (client->inflight[index].msg_id != msg_id) {
+            continue;
+        }
+
+        __atomic_store_n(&client->inflight_bytes, client->inflight_bytes - client->inflight[index].len, __ATOMIC_RELAXED);
+
+        client->inflight_count--;
+        memmove(&client->inflight[index], &client->inflight[index + 1], (client->inflight_count - index) * sizeof(bytebeam_linux_mqtt_inflight_t));
+        break;
+    }
+}
+
+static void emit_event(bytebeam_linux_mqtt_client_handle_t client, bytebeam_linux_mqtt_event_t *event)
+{
+    if (client->handler != NULL) {
+        client->handler(client->handler_args, event);
+    }
+}
+
+static int mqtt_connect(bytebeam_linux_mqtt_client_handle_t client)
+{
+    unsigned char type = 0;
+    unsigned char *packet = client->tx_buffer + MQTT_FIXED_HEADER_MAX_LEN;
+    int client_id_len = (int)strlen(client->client_id);
+    int len = 0;
+
+    if (net_connect(client) != 0) {
+        return -1;
+    }
+
+    // protocol name and level followed by the connect flags, only the clean session flag is ever set
+    memcpy(packet, "\x00\x04MQTT\x04", 7);
+    packet[7] = client->config.disable_clean_session ? 0x00 : MQTT_CONNECT_CLEAN_SESSION;
+    len = 8;
+    encode_uint16(packet + len, client->config.keepalive_sec);
+    len = len + 2;
+    encode_uint16(packet + len, client_id_len);
+    len = len + 2;
+    memcpy(packet + len, client->client_id, client_id_len);
+    len = len + client_id_len;
+
+    pthread_mutex_lock(&client->io_lock);
+    int ret_val = send_tx_packet(client, MQTT_CONNECT, len);
+    pthread_mutex_unlock(&client->io_lock);
+
+    if (ret_val != 0 || net_wait_readable(client, BYTEBEAM_LINUX_MQTT_NETWORK_TIMEOUT_MS) != 1) {
+        BB_LOGE(TAG, "No response to mqtt connect from %s", client->host);
+
+        net_close(client);
+        return -1;
+    }
+
+    len = read_packet(client, &type);
+
+    if (len != 2 || (type & 0xF0) != MQTT_CONNACK || client->rx_buffer[1] != 0) {
+        BB_LOGE(TAG, "Mqtt connect refused by %s, return code %d", client->host, (len == 2) ? client->rx_buffer[1] : -1);
+
+        net_close(client);
+        return -1;
+    }
+
+    client->is_ping_outstanding = false;
+    client->is_session_present = (client->rx_buffer[0] & MQTT_CONNACK_SESSION_PRESENT) != 0;
+
+    return 0;
+}
+
+static int handle_packet(bytebeam_linux_mqtt_client_handle_t client)
+{
+    unsigned char type = 0;
+    bytebeam_linux_mqtt_event_t event;
+    int len = read_packet(client, &type);
+
+    if (len < 0) {
+        return -1;
+    }
+
+    memset(&event, 0x00, sizeof(event));
+
+    switch (type & 0xF0) {
+    case MQTT_PUBLISH: {
+        int qos = (type >> 1) & 0x03;
+        int pos = 0;
+
+        if (len < 2) {
+            return -1;
+        }
+
+        event.topic_len = (client->rx_buffer[0] << 8) | client->rx_buffer[1];
+        event.topic = (const char *)client->rx_buffer + 2;
+        pos = 2 + event.topic_len;
+
+        if (qos > 0) {
+            if (pos + 2 > len) {
+                return -1;
+            }
+
+            event.msg_id = (client->rx_buffer[pos] << 8) | client->rx_buffer[pos + 1];
+            pos = pos + 2;
+        }
+
+        if (pos > len || qos > 1) {
+            BB_LOGE(TAG, "Dropping the connection on an unsupported publish");
+            return -1;
+        }
+
+        if (qos == 1 && send_short_packet(client, MQTT_PUBACK, event.msg_id, true) != 0) {
+            return -1;
+        }
+
+        event.event_id = BYTEBEAM_LINUX_MQTT_EVENT_DATA;
+        event.data = (char *)client->rx_buffer + pos;
+        event.data_len = len - pos;
+        emit_event(client, &event);
+        break;
+    }
+
+    case MQTT_PUBACK:
+    case MQTT_SUBACK:
+        if (len < 2) {
+            return -1;
+        }
+
+        event.event_id = ((type & 0xF0) == MQTT_PUBACK) ? BYTEBEAM_LINUX_MQTT_EVENT_PUBLISHED : BYTEBEAM_LINUX_MQTT_EVENT_SUBSCRIBED;
+        event.msg_id = (client->rx_buffer[0] << 8) | client->rx_buffer[1];
+
+        if (event.event_id == BYTEBEAM_LINUX_MQTT_EVENT_PUBLISHED) {
+            pthread_mutex_lock(&client->io_lock);
+            remove_inflight(client, (uint16_t)event.msg_id);
+            pthread_mutex_unlock(&client->io_lock);
+        }
+
+        emit_event(client, &event);
+        break;
+
+    case MQTT_PINGRESP:
+        client->is_ping_outstanding = false;
+        break;
+
+    default:
+        BB_LOGD(TAG, "Ignoring mqtt packet type 0x%02x", type);
+        break;
+    }
+
+    return 0;
+}
+
+static int check_keepalive(bytebeam_linux_mqtt_client_handle_t client)
+{
+    long long now = monotonic_ms();
+    long long keepalive_ms = (long long)client->config.keepalive_sec * 1000;
+
+    if (client->is_ping_outstanding) {
+        return (now - client->ping_sent_ms < keepalive_ms) ? 0 : -1;
+    }
+
+    // ping a bit before the keep alive runs out, the broker allows one and a half of it
+    if (now - client->last_sent_ms < keepalive_ms) {
+        return 0;
+    }
+
+    if (send_short_packet(client, MQTT_PINGREQ, 0, false) != 0) {
+        return -1;
+    }
+
+    client->ping_sent_ms = now;
+    client->is_ping_outstanding = true;
+
+    return 0;
+}
+
+static bool is_running(bytebeam_linux_mqtt_client_handle_t client)
+{
+    return __atomic_load_n(&client->is_running, __ATOMIC_ACQUIRE);
+}
+
+static void wait_reconnect(bytebeam_linux_mqtt_client_handle_t client)
+{
+    long long start = monotonic_ms();
+
+    while (is_running(client) && monotonic_ms() - start < BYTEBEAM_LINUX_MQTT_RECONNECT_DELAY_MS) {
+        usleep(100 * 1000);
+    }
+}
+
+static void *mqtt_thread(void *arg)
+{
+    bytebeam_linux_mqtt_client_handle_t client = arg;
+    bytebeam_linux_mqtt_event_t event;
+
+    while (is_running(client)) {
+        if (mqtt_connect(client) != 0) {
+            wait_reconnect(client);
+            continue;
+        }
+
+        __atomic_store_n(&client->is_connected, true, __ATOMIC_RELEASE);
+
+        memset(&event, 0x00, sizeof(event));
+        event.event_id = BYTEBEAM_LINUX_MQTT_EVENT_CONNECTED;
+        event.session_present = client->is_session_present;
+        emit_event(client, &event);
+
+        while (is_running(client)) {
+            int readable = net_wait_readable(client, 200);
+
+            if (readable < 0 || (readable > 0 && handle_packet(client) != 0)) {
+                break;
+            }
+
+            if (check_keepalive(client) != 0) {
+                BB_LOGE(TAG, "Mqtt keep alive timed out");
+                break;
+            }
+        }
+
+        __atomic_store_n(&client->is_connected, false, __ATOMIC_RELEASE);
+
+        if (!is_running(client)) {
+            send_short_packet(client, MQTT_DISCONNECT, 0, false);
+        }
+
+        pthread_mutex_lock(&client->io_lock);
+        net_close(client);
+
+        // the unacknowledged publishes are not retransmitted, so they leave the outbox with the connection
+        client->inflight_count = 0;
+        __atomic_store_n(&client->inflight_bytes, 0, __ATOMIC_RELAXED);
+
+        pthread_mutex_unlock(&client->io_lock);
+
+        memset(&event, 0x00, sizeof(event));
+        event.event_id = BYTEBEAM_LINUX_MQTT_EVENT_DISCONNECTED;
+        emit_event(client, &event);
+
+        wait_reconnect(client);
+    }
+
+    return NULL;
+}
+
+bytebeam_linux_mqtt_client_handle_t bytebeam_linux_mqtt_init(const bytebeam_linux_mqtt_config_t *config, bytebeam_linux_mqtt_event_handler_t handler, void *handler_args)
+{
+    if (config == NULL || config->uri == NULL) {
+        return NULL;
+    }
+
+    bytebeam_linux_mqtt_client_handle_t client = calloc(1, sizeof(struct bytebeam_linux_mqtt_client));
+
+    if (client == NULL) {
+        return NULL;
+    }
+
+    client->config = *config;
+    client->handler = handler;
+    client->handler_args = handler_args;
+    client->sock = -1;
+
+    if (client->config.keepalive_sec <= 0) {
+        client->config.keepalive_sec = BYTEBEAM_LINUX_MQTT_KEEPALIVE_SEC;
+    }
+
+    if (config->client_id != NULL) {
+        snprintf(client->client_id, sizeof(client->client_id), "%s", config->client_id);
+    } else {
+        snprintf(client->client_id, sizeof(client->client_id), "bytebeam-linux-%d", (int)getpid());
+    }
+
+    client->rx_buffer = malloc(BYTEBEAM_LINUX_MQTT_MAX_PACKET_SIZE);
+    client->tx_buffer = malloc(MQTT_FIXED_HEADER_MAX_LEN + BYTEBEAM_LINUX_MQTT_MAX_PACKET_SIZE);
+
+    if (client->rx_buffer == NULL || client->tx_buffer == NULL || parse_uri(client, config->uri) != 0) {
+        free(client->rx_buffer);
+        free(client->tx_buffer);
+        free(client);
+        return NULL;
+    }
+
+    if (client->use_tls) {
+#ifdef BYTEBEAM_LINUX_HAL_TLS
+        if (create_ssl_ctx(client) != 0) {
+            BB_LOGE(TAG, "Failed to create the TLS context");
+
+            SSL_CTX_free(client->ssl_ctx);
+            free(client->rx_buffer);
+            free(client->tx_buffer);
+            free(client);
+            return NULL;
+        }
+#else
+        BB_LOGE(TAG, "TLS is not supported by this build, use a mqtt:// broker uri");
+
+        free(client->rx_buffer);
+        free(client->tx_buffer);
+        free(client);
+        return NULL;
+#endif
+    }
+
+    pthread_mutex_init(&client->io_lock, NULL);
+
+    return client;
+}
+
+int bytebeam_linux_mqtt_start(bytebeam_linux_mqtt_client_handle_t client)
+{
+    if (is_running(client)) {
+        return -1;
+    }
+
+    __atomic_store_n(&client->is_running, true, __ATOMIC_RELEASE);
+
+    if (pthread_create(&client->thread, NULL, mqtt_thread, client) != 0) {
+        __atomic_store_n(&client->is_running, false, __ATOMIC_RELEASE);
+        return -1;
+    }
+
+    return 0;
+}
+
+int bytebeam_linux_mqtt_stop(bytebeam_linux_mqtt_client_handle_t client)
+{
+    if (!is_running(client)) {
+        return -1;
+    }
+
+    __atomic_store_n(&client->is_running, false, __ATOMIC_RELEASE);
+    pthread_join(client->thread, NULL);
+
+    return 0;
+}
+
+void bytebeam_linux_mqtt_destroy(bytebeam_linux_mqtt_client_handle_t client)
+{
+    if (client == NULL) {
+        return;
+    }
+
+    bytebeam_linux_mqtt_stop(client);
+
+#ifdef BYTEBEAM_LINUX_HAL_TLS
+    SSL_SESSION_free(client->ssl_session);
+    SSL_CTX_free(client->ssl_ctx);
+#endif
+
+    pthread_mutex_destroy(&client->io_lock);
+    free(client->rx_buffer);
+    free(client->tx_buffer);
+    free(client);
+}
+
+int bytebeam_linux_mqtt_publish(bytebeam_linux_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos)
+{
+    int msg_id = 0;
+    int topic_len = (int)strlen(topic);
+    int packet_len = 2 + topic_len + ((qos > 0) ? 2 : 0) + len;
+
+    if (!__atomic_load_n(&client->is_connected, __ATOMIC_ACQUIRE) || qos > 1 || packet_len > BYTEBEAM_LINUX_MQTT_MAX_PACKET_SIZE) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&client->io_lock);
+
+    unsigned char *packet = client->tx_buffer + MQTT_FIXED_HEADER_MAX_LEN;
+    int pos = 0;
+
+    encode_uint16(packet, topic_len);
+    pos = 2;
+    memcpy(packet + pos, topic, topic_len);
+    pos = pos + topic_len;
+
+    if (qos > 0) {
+        msg_id = next_msg_id(client);
+        encode_uint16(packet + pos, msg_id);
+        pos = pos + 2;
+    }
+
+    memcpy(packet + pos, data, len);
+
+    int ret_val = (client->sock >= 0) ? send_tx_packet(client, MQTT_PUBLISH | (qos << 1), packet_len) : -1;
+
+    if (ret_val == 0 && qos > 0) {
+        add_inflight(client, (uint16_t)msg_id, packet_len);
+    }
+
+    pthread_mutex_unlock(&client->io_lock);
+
+    return (ret_val == 0) ? msg_id : -1;
+}
+
+int bytebeam_linux_mqtt_get_outbox_size(bytebeam_linux_mqtt_client_handle_t client)
+{
+    return __atomic_load_n(&client->inflight_bytes, __ATOMIC_RELAXED);
+}
+
+int bytebeam_linux_mqtt_subscribe(bytebeam_linux_mqtt_client_handle_t client, const char *topic, int qos)
+{
+    int topic_len = (int)strlen(topic);
+    int packet_len = 2 + 2 + topic_len + 1;
+
+    if (!__atomic_load_n(&client->is_connected, __ATOMIC_ACQUIRE) || packet_len > BYTEBEAM_LINUX_MQTT_MAX_PACKET_SIZE) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&client->io_lock);
+
+    unsigned char *packet = client->tx_buffer + MQTT_FIXED_HEADER_MAX_LEN;
+    int msg_id = next_msg_id(client);
+
+    encode_uint16(packet, msg_id);
+    encode_uint16(packet + 2, topic_len);
+    memcpy(packet + 4, topic, topic_len);
+    packet[4 + topic_len] = (unsigned char)qos;
+
+    int ret_val = (client->sock >= 0) ? send_tx_packet(client, MQTT_SUBSCRIBE, packet_len) : -1;
+
+    pthread_mutex_unlock(&client->io_lock);
+
+    return (ret_val == 0) ? msg_id : -1;
+}
+
+#endif /* CONFIG_SDK_PLATFORM_LINUX */
@@ -0,0 +1,201 @@
+/*
+ * Host benchmark of the stream publishes with and without batching. Publishes the same 50 Hz sensor records through
+ * the test broker once as one mqtt publish per record and once through stream batches, and reports the records per
+ * second delivered to the broker, the mqtt publishes and the bytes on the wire. The wire bytes include the mqtt framing
+ * of every packet the client sent, the TLS records a real broker connection adds on top are not included.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "bytebeam_sdk.h"
+#include "test_broker.h"
+#include "bench_common.h"
+
+/* The number of records published in every run */
+#define BENCH_RECORD_COUNT 5000
+
+/* How long the connect and the delivery of a run may take at most */
+#define BENCH_TIMEOUT_MS 30000
+
+/* The stream the records are published to */
+#define BENCH_STREAM "bench_stream"
+
+typedef struct {
+    const char *name;
+    bool is_batched;
+    int max_records;
+} bench_mode_t;
+
+static const bench_mode_t bench_modes[] = {
+    { "single publish", false, 0 },
+    { "batch of 10 records", true, 10 },
+    { "batch (default config)", true, BYTEBEAM_STREAM_BATCH_MAX_RECORDS },
+};
+
+static int received_records = 0;
+static pthread_mutex_t received_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void on_publish(const char *topic, const uint8_t *payload, int length, void *arg)
+{
+    (void)arg;
+
+    if (strstr(topic, "/events/" BENCH_STREAM "/") == NULL) {
+        return;
+    }
+
+    int records = 0;
+
+    // every record carries one sequence, the payload is not null terminated
+    for (int index = 0; index + 10 <= length; index++) {
+        if (payload[index] == '"' && memcmp(payload + index, "\"sequence\"", 10) == 0) {
+            records++;
+        }
+    }
+
+    pthread_mutex_lock(&received_lock);
+    received_records += records;
+    pthread_mutex_unlock(&received_lock);
+}
+
+static int get_received_records(void)
+{
+    pthread_mutex_lock(&received_lock);
+    int records = received_records;
+    pthread_mutex_unlock(&received_lock);
+
+    return records;
+}
+
+static void format_record(char *record, int len, int sequence)
+{
+    // a 50 Hz imu sample
+    snprintf(record, len, "{\"timestamp\":%llu,\"sequence\":%d,\"accel_x\":%.3f,\"accel_y\":%.3f,\"accel_z\":%.3f,\"temperature\":%.2f}",
+             1700000000000ULL + (unsigned long long)sequence * 20, sequence, 0.012 * (sequence % 50), -0.981 + 0.001 * (sequence % 7),
+             9.807 - 0.002 * (sequence % 11), 24.5 + 0.01 * (sequence % 30));
+}
+
+static bool publish_records(bytebeam_client_t *bytebeam_client, bytebeam_stream_handle_t stream, const bench_mode_t *mode)
+{
+    char record[256];
+    char payload[260];
+    bytebeam_stream_batch_t batch;
+    bytebeam_stream_batch_config_t batch_config = BYTEBEAM_STREAM_BATCH_DEFAULT_CONFIG();
+
+    if (!mode->is_batched) {
+        for (int sequence = 1; sequence <= BENCH_RECORD_COUNT; sequence++) {
+            format_record(record, sizeof(record), sequence);
+            snprintf(payload, sizeof(payload), "[%s]", record);
+
+            if (bytebeam_stream_publish(stream, payload) != BB_SUCCESS) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    batch_config.max_records = mode->max_records;
+
+    if (bytebeam_stream_batch_init(&batch, bytebeam_client, BENCH_STREAM, &batch_config) != BB_SUCCESS) {
+        return false;
+    }
+
+    bool is_published = true;
+
+    for (int sequence = 1; sequence <= BENCH_RECORD_COUNT && is_published; sequence++) {
+        format_record(record, sizeof(record), sequence);
+        is_published = (bytebeam_stream_batch_append(&batch, record) == BB_SUCCESS);
+    }
+
+    if (is_published) {
+        is_published = (bytebeam_stream_batch_flush(&batch) == BB_SUCCESS);
+    }
+
+    bytebeam_stream_batch_deinit(&batch);
+
+    return is_published;
+}
+
+static void run_mode(FILE *output, bytebeam_client_t *bytebeam_client, test_broker_t *broker, const bench_mode_t *mode)
+{
+    bytebeam_stream_handle_t stream = bytebeam_stream_open(bytebeam_client, BENCH_STREAM);
+
+    int records_before = get_received_records();
+    int publishes_before = test_broker_get_publish_count(broker);
+    long long rx_bytes_before = test_broker_get_rx_bytes(broker);
+    long long start_ns = bench_now_ns();
+
+    if (stream == NULL || !publish_records(bytebeam_client, stream, mode)) {
+        fprintf(output, "%-24s publish failed\n", mode->name);
+        return;
+    }
+
+    // the run ends once the broker got every record
+    while (get_received_records() - records_before < BENCH_RECORD_COUNT && bench_now_ns() - start_ns < BENCH_TIMEOUT_MS * 1000000LL) {
+        usleep(100);
+    }
+
+    long long elapsed_ns = bench_now_ns() - start_ns;
+    int records = get_received_records() - records_before;
+    int publishes = test_broker_get_publish_count(broker) - publishes_before;
+    long long rx_bytes = test_broker_get_rx_bytes(broker) - rx_bytes_before;
+
+    if (records < BENCH_RECORD_COUNT) {
+        fprintf(output, "%-24s timed out with %d of %d records delivered\n", mode->name, records, BENCH_RECORD_COUNT);
+        return;
+    }
+
+    fprintf(output, "%-24s %12.0f %12d %12lld %14.1f\n", mode->name, records * 1e9 / elapsed_ns, publishes, rx_bytes,
+            (double)rx_bytes / records);
+}
+
+int main(void)
+{
+    FILE *output = bench_open_output();
+    bytebeam_client_t bytebeam_client;
+    test_broker_t *broker = test_broker_start(on_publish, NULL);
+
+    if (broker == NULL) {
+        fprintf(output, "failed to start the test broker\n");
+        return 1;
+    }
+
+    memset(&bytebeam_client, 0x00, sizeof(bytebeam_client_t));
+
+    bytebeam_client.use_device_config_data = true;
+    test_broker_get_uri(broker, bytebeam_client.device_cfg.broker_uri, BYTEBEAM_BROKER_URL_STR_LEN);
+    strcpy(bytebeam_client.device_cfg.device_id, "1");
+    strcpy(bytebeam_client.device_cfg.project_id, "bench");
+
+    if (bytebeam_init(&bytebeam_client) != BB_SUCCESS || bytebeam_start(&bytebeam_client) != BB_SUCCESS) {
+        fprintf(output, "failed to start the client\n");
+        return 1;
+    }
+
+    for (int waited_ms = 0; waited_ms < BENCH_TIMEOUT_MS && bytebeam_client.connection_status != 1; waited_ms += 10) {
+        usleep(10 * 1000);
+    }
+
+    if (bytebeam_client.connection_status != 1) {
+        fprintf(output, "client failed to connect\n");
+        return 1;
+    }
+
+    // let the heartbeat published on connect go out before the first run, there are no periodic ones by default
+    usleep(200 * 1000);
+
+    fprintf(output, "%d records of %s, mqtt over loopback\n\n", BENCH_RECORD_COUNT, BENCH_STREAM);
+    fprintf(output, "%-24s %12s %12s %12s %14s\n", "mode", "records/s", "publishes", "wire bytes", "bytes/record");
+
+    for (int index = 0; index < (int)(sizeof(bench_modes) / sizeof(bench_modes[0])); index++) {
+        run_mode(output, &bytebeam_client, broker, &bench_modes[index]);
+    }
+
+    bytebeam_stop(&bytebeam_client);
+    bytebeam_destroy(&bytebeam_client);
+
+    test_broker_stop(broker);
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+/*
+ * Host benchmark of the cbor encoding against the json one. Encodes the same batches of sensor records (timestamp,
+ * sequence and three readings) with the json writer and with the cbor writer and reports the payload bytes and the CPU
+ * time per record. The readings keep three decimals, so they take a full double in cbor unless written as float32.
+ */
+
+#include <string.h>
+#include "bytebeam_sdk.h"
+#include "bench_common.h"
+
+/* The number of records in every batch, i.e. in every payload */
+#define BENCH_BATCH_RECORDS 100
+
+/* The number of batches encoded by every encoder */
+#define BENCH_BATCH_COUNT 2000
+
+/* The size of the payload buffer, large enough for a batch in any encoding */
+#define BENCH_PAYLOAD_SIZE (16 * 1024)
+
+typedef struct {
+    unsigned long long timestamp;
+    unsigned int sequence;
+    double accel_x;
+    double accel_y;
+    double accel_z;
+} bench_record_t;
+
+typedef int (*bench_encode_fn_t)(const bench_record_t *records, int count, uint8_t *payload, int size);
+
+typedef struct {
+    const char *name;
+    bench_encode_fn_t encode;
+} bench_encoder_t;
+
+static bench_record_t records[BENCH_BATCH_RECORDS];
+
+/* Keeps the encoded lengths alive, so the compiler can not drop the encoding */
+static volatile long long bench_sink = 0;
+
+static int encode_json(const bench_record_t *records, int count, uint8_t *payload, int size)
+{
+    bytebeam_json_writer_t writer;
+
+    bytebeam_json_writer_init(&writer, (char *)payload, size);
+    bytebeam_json_begin_array(&writer, NULL);
+
+    for (int index = 0; index < count; index++) {
+        bytebeam_json_begin_object(&writer, NULL);
+        bytebeam_json_add_uint(&writer, "timestamp", records[index].timestamp);
+        bytebeam_json_add_uint(&writer, "sequence", records[index].sequence);
+        bytebeam_json_add_double(&writer, "accel_x", records[index].accel_x);
+        bytebeam_json_add_double(&writer, "accel_y", records[index].accel_y);
+        bytebeam_json_add_double(&writer, "accel_z", records[index].accel_z);
+        bytebeam_json_end_object(&writer);
+    }
+
+    bytebeam_json_end_array(&writer);
+
+    return (bytebeam_json_writer_finish(&writer) == BB_SUCCESS) ? writer.length : -1;
+}
+
+static int encode_cbor(const bench_record_t *records, int count, uint8_t *payload, int size, bool is_float)
+{
+    bytebeam_cbor_writer_t writer;
+
+    bytebeam_cbor_writer_init(&writer, payload, size);
+    bytebeam_cbor_begin_array(&writer, NULL);
+
+    for (int index = 0; index < count; index++) {
+        bytebeam_cbor_begin_map(&writer, NULL);
+        bytebeam_cbor_add_uint(&writer, "timestamp", records[index].timestamp);
+        bytebeam_cbor_add_uint(&writer, "sequence", records[index].sequence);
+
+        if (is_float) {
+            bytebeam_cbor_add_float(&writer, "accel_x", (float)records[index].accel_x);
+            bytebeam_cbor_add_float(&writer, "accel_y", (float)records[index].accel_y);
+            bytebeam_cbor_add_float(&writer, "accel_z", (float)records[index].accel_z);
+        } else {
+            bytebeam_cbor_add_double(&writer, "accel_x", records[index].accel_x);
+            bytebeam_cbor_add_double(&writer, "accel_y", records[index].accel_y);
+            bytebeam_cbor_add_double(&writer, "accel_z", records[index].accel_z);
+        }
+
+        bytebeam_cbor_end_map(&writer);
+    }
+
+    bytebeam_cbor_end_array(&writer);
+
+    return (bytebeam_cbor_writer_finish(&writer) == BB_SUCCESS) ? writer.length : -1;
+}
+
+static int encode_cbor_double(const bench_record_t *records, int count, uint8_t *payload, int size)
+{
+    return encode_cbor(records, count, payload, size, false);
+}
+
+static int encode_cbor_float(const bench_record_t *records, int count, uint8_t *payload, int size)
+{
+    return encode_cbor(records, count, payload, size, true);
+}
+
+static const bench_encoder_t bench_encoders[] = {
+    { "json writer", encode_json },
+    { "cbor writer (double)", encode_cbor_double },
+    { "cbor writer (float32)", encode_cbor_float },
+};
+
+static void run_encoder(FILE *output, const bench_encoder_t *encoder, uint8_t *payload)
+{
+    int length = encoder->encode(records, BENCH_BATCH_RECORDS, payload, BENCH_PAYLOAD_SIZE);
+
+    if (length < 0) {
+        fprintf(output, "%-24s failed\n", encoder->name);
+        return;
+    }
+
+    long long start_ns = bench_thread_cpu_ns();
+
+    for (int batch = 0; batch < BENCH_BATCH_COUNT; batch++) {
+        bench_sink += encoder->encode(records, BENCH_BATCH_RECORDS, payload, BENCH_PAYLOAD_SIZE);
+    }
+
+    long long cpu_ns = bench_thread_cpu_ns() - start_ns;
+
+    fprintf(output, "%-24s %14.1f %14.1f\n", encoder->name, (double)length / BENCH_BATCH_RECORDS,
+            (double)cpu_ns / ((long long)BENCH_BATCH_COUNT * BENCH_BATCH_RECORDS));
+}
+
+int main(void)
+{
+    FILE *output = bench_open_output();
+    uint8_t *payload = malloc(BENCH_PAYLOAD_SIZE);
+
+    if (payload == NULL) {
+        fprintf(output, "failed to allocate the payload buffer\n");
+        return 1;
+    }
+
+    // a 50 Hz accelerometer
+    for (int index = 0; index < BENCH_BATCH_RECORDS; index++) {
+        records[index].timestamp = 1700000000000ULL + (unsigned long long)index * 20;
+        records[index].sequence = index + 1;
+        records[index].accel_x = 0.012 * (index % 50);
+        records[index].accel_y = -0.981 + 0.001 * (index % 7);
+        records[index].accel_z = 9.807 - 0.002 * (index % 11);
+    }
+
+    fprintf(output, "%d batches of %d records\n\n", BENCH_BATCH_COUNT, BENCH_BATCH_RECORDS);
+    fprintf(output, "%-24s %14s %14s\n", "encoder", "bytes/record", "cpu ns/record");
+
+    for (int index = 0; index < (int)(sizeof(bench_encoders) / sizeof(bench_encoders[0])); index++) {
+        run_encoder(output, &bench_encoders[index], payload);
+    }
+
+    free(payload);
+
+    return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Helpers shared by the host benchmarks. The benchmarks are not run by ctest, run them by hand from the build
+ * directory on an otherwise idle machine, the numbers are only comparable between runs on the same machine.
+ */
+
+/* Monotonic time in nanoseconds */
+static inline long long bench_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/* CPU time spent by the calling thread in nanoseconds */
+static inline long long bench_thread_cpu_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/* The sdk logs to stdout as well, so they are sent to /dev/null and the results go to a copy of stdout instead */
+static inline FILE *bench_open_output(void)
+{
+    FILE *output = fdopen(dup(STDOUT_FILENO), "w");
+
+    if (output == NULL || freopen("/dev/null", "w", stdout) == NULL) {
+        fprintf(stderr, "failed to set up the benchmark output\n");
+        exit(1);
+    }
+
+    setvbuf(output, NULL, _IOLBF, 0);
+
+    return output;
+}
+
+#endif /* BENCH_COMMON_H */
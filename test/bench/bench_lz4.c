@@ -0,0 +1,247 @@
+/*
+ * Host benchmark of the lz4 compression of the stream payloads. Compresses json array batches of cloud log records
+ * and of sensor records, and random bytes for reference, at a few batch sizes and reports the compression ratio and
+ * the CPU cost. Every compressed block is decoded again and checked against its input.
+ */
+
+#include <string.h>
+#include "bytebeam_sdk.h"
+#include "bytebeam_lz4.h"
+#include "bench_common.h"
+
+/* The number of payload bytes compressed for every corpus and size */
+#define BENCH_TOTAL_BYTES (64 * 1024 * 1024)
+
+/* The largest payload compressed */
+#define BENCH_MAX_PAYLOAD_SIZE (16 * 1024)
+
+typedef int (*bench_record_fn_t)(char *record, int len, int sequence);
+
+typedef struct {
+    const char *name;
+    bench_record_fn_t format;
+    bool is_json;
+} bench_corpus_t;
+
+static const int bench_payload_sizes[] = { 1024, 4096, BENCH_MAX_PAYLOAD_SIZE };
+
+static const char *log_tags[] = { "WIFI", "MQTT", "SENSOR", "OTA", "APP" };
+
+/* Keeps the compressed lengths alive, so the compiler can not drop the compression */
+static volatile long long bench_sink = 0;
+
+static int format_log_record(char *record, int len, int sequence)
+{
+    unsigned long long timestamp = 1700000000000ULL + (unsigned long long)sequence * 37;
+    const char *tag = log_tags[rand() % 5];
+
+    // a few message templates with changing numbers, the way the device logs look
+    switch (rand() % 4) {
+        case 0 :
+            return snprintf(record, len, "{\"timestamp\":%llu,\"sequence\":%d,\"level\":\"Info\",\"tag\":\"%s\",\"message\":\"rssi %d dBm, channel %d\"}",
+                            timestamp, sequence, tag, -40 - rand() % 50, 1 + rand() % 11);
+        case 1 :
+            return snprintf(record, len, "{\"timestamp\":%llu,\"sequence\":%d,\"level\":\"Debug\",\"tag\":\"%s\",\"message\":\"published %d bytes, msg_id=%d\"}",
+                            timestamp, sequence, tag, 100 + rand() % 900, rand() % 65535);
+        case 2 :
+            return snprintf(record, len, "{\"timestamp\":%llu,\"sequence\":%d,\"level\":\"Warn\",\"tag\":\"%s\",\"message\":\"sensor %d read took %d ms, retrying\"}",
+                            timestamp, sequence, tag, rand() % 4, 10 + rand() % 200);
+        default :
+            return snprintf(record, len, "{\"timestamp\":%llu,\"sequence\":%d,\"level\":\"Info\",\"tag\":\"%s\",\"message\":\"free heap %d bytes, min %d bytes\"}",
+                            timestamp, sequence, tag, 100000 + rand() % 50000, 80000 + rand() % 20000);
+    }
+}
+
+static int format_telemetry_record(char *record, int len, int sequence)
+{
+    // a 50 Hz imu sample with some noise on the readings
+    return snprintf(record, len, "{\"timestamp\":%llu,\"sequence\":%d,\"accel_x\":%.3f,\"accel_y\":%.3f,\"accel_z\":%.3f,\"temperature\":%.2f}",
+                    1700000000000ULL + (unsigned long long)sequence * 20, sequence, (rand() % 1000 - 500) * 0.001,
+                    -0.981 + (rand() % 100) * 0.001, 9.807 - (rand() % 100) * 0.001, 24.5 + (rand() % 100) * 0.01);
+}
+
+/* Fills the whole payload, random bytes are no json records */
+static int format_random_payload(char *payload, int len, int sequence)
+{
+    (void)sequence;
+
+    for (int index = 0; index < len; index++) {
+        payload[index] = (char)rand();
+    }
+
+    return len;
+}
+
+static const bench_corpus_t bench_corpora[] = {
+    { "logs", format_log_record, true },
+    { "telemetry", format_telemetry_record, true },
+    { "random", format_random_payload, false },
+};
+
+/* Fills the payload with a json array of as many records as fit in the given size */
+static int build_payload(const bench_corpus_t *corpus, char *payload, int size)
+{
+    char record[256];
+    int length = 1;
+    int sequence = 1;
+
+    if (!corpus->is_json) {
+        return corpus->format(payload, size, 0);
+    }
+
+    payload[0] = '[';
+
+    while (true) {
+        int record_len = corpus->format(record, sizeof(record), sequence);
+
+        // the record, its separator and the closing bracket must fit
+        if (length + record_len + 2 > size) {
+            break;
+        }
+
+        if (sequence > 1) {
+            payload[length++] = ',';
+        }
+
+        memcpy(payload + length, record, record_len);
+        length = length + record_len;
+        sequence++;
+    }
+
+    payload[length++] = ']';
+
+    return length;
+}
+
+/* Reference decoder of the lz4 block format, for checking the compressed blocks */
+static int lz4_decompress(const uint8_t *src, int src_len, uint8_t *dst, int dst_size)
+{
+    const uint8_t *end = src + src_len;
+    int length = 0;
+
+    while (src < end) {
+        int token = *src++;
+        int literals = token >> 4;
+        int byte = 0;
+
+        if (literals == 15) {
+            do {
+                if (src >= end) {
+                    return -1;
+                }
+
+                byte = *src++;
+                literals = literals + byte;
+            } while (byte == 255);
+        }
+
+        if (literals > end - src || literals > dst_size - length) {
+            return -1;
+        }
+
+        memcpy(dst + length, src, literals);
+        src = src + literals;
+        length = length + literals;
+
+        // the last sequence has literals only
+        if (src == end) {
+            break;
+        }
+
+        if (end - src < 2) {
+            return -1;
+        }
+
+        int offset = src[0] | (src[1] << 8);
+        int match = (token & 15) + 4;
+
+        src = src + 2;
+
+        if (offset == 0 || offset > length) {
+            return -1;
+        }
+
+        if ((token & 15) == 15) {
+            do {
+                if (src >= end) {
+                    return -1;
+                }
+
+                byte = *src++;
+                match = match + byte;
+            } while (byte == 255);
+        }
+
+        if (match > dst_size - length) {
+            return -1;
+        }
+
+        // the match may overlap the bytes it copies
+        for (int index = 0; index < match; index++) {
+            dst[length] = dst[length - offset];
+            length++;
+        }
+    }
+
+    return length;
+}
+
+static void run_corpus(FILE *output, const bench_corpus_t *corpus, int size, uint8_t *payload, uint8_t *compressed, uint8_t *decompressed)
+{
+    uint16_t hash_table[BYTEBEAM_LZ4_HASH_TABLE_SIZE];
+    int compressed_size = BYTEBEAM_LZ4_COMPRESS_BOUND(BENCH_MAX_PAYLOAD_SIZE);
+    int length = build_payload(corpus, (char *)payload, size);
+    int compressed_len = bytebeam_lz4_compress(payload, length, compressed, compressed_size, hash_table);
+
+    if (compressed_len < 0 || lz4_decompress(compressed, compressed_len, decompressed, length) != length ||
+        memcmp(payload, decompressed, length) != 0) {
+        fprintf(output, "%-10s %8d round trip failed\n", corpus->name, length);
+        return;
+    }
+
+    int iterations = BENCH_TOTAL_BYTES / length;
+    long long start_ns = bench_thread_cpu_ns();
+
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        bench_sink += bytebeam_lz4_compress(payload, length, compressed, compressed_size, hash_table);
+    }
+
+    long long cpu_ns = bench_thread_cpu_ns() - start_ns;
+
+    // the stream publishes a payload as is whenever it does not shrink
+    bool is_published_raw = compressed_len + 4 >= length;
+
+    fprintf(output, "%-10s %8d %12d %8.2f %10.0f %10.1f%s\n", corpus->name, length, compressed_len,
+            (double)length / compressed_len, (double)length * iterations * 1000.0 / cpu_ns, (double)cpu_ns / iterations / 1000.0,
+            is_published_raw ? "   (published raw)" : "");
+}
+
+int main(void)
+{
+    FILE *output = bench_open_output();
+    uint8_t *payload = malloc(BENCH_MAX_PAYLOAD_SIZE);
+    uint8_t *compressed = malloc(BYTEBEAM_LZ4_COMPRESS_BOUND(BENCH_MAX_PAYLOAD_SIZE));
+    uint8_t *decompressed = malloc(BENCH_MAX_PAYLOAD_SIZE);
+
+    if (payload == NULL || compressed == NULL || decompressed == NULL) {
+        fprintf(output, "failed to allocate the buffers\n");
+        return 1;
+    }
+
+    fprintf(output, "%d MB of every payload compressed\n\n", BENCH_TOTAL_BYTES / (1024 * 1024));
+    fprintf(output, "%-10s %8s %12s %8s %10s %10s\n", "corpus", "bytes", "compressed", "ratio", "MB/s", "cpu us");
+
+    for (int corpus = 0; corpus < (int)(sizeof(bench_corpora) / sizeof(bench_corpora[0])); corpus++) {
+        for (int size = 0; size < (int)(sizeof(bench_payload_sizes) / sizeof(bench_payload_sizes[0])); size++) {
+            // the same records every run
+            srand(1);
+            run_corpus(output, &bench_corpora[corpus], bench_payload_sizes[size], payload, compressed, decompressed);
+        }
+    }
+
+    free(payload);
+    free(compressed);
+    free(decompressed);
+
+    return 0;
+}
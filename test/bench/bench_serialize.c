@@ -0,0 +1,260 @@
+/*
+ * Host benchmark of the device heartbeat, action status and cloud log payloads. Reports the CPU time and the heap
+ * allocations per message, once for building the payload alone with the json writer and once for the whole publish
+ * call through a client connected to the test broker. The allocations are the ones the sdk makes itself, counted by
+ * wrapping malloc, calloc and realloc at link time, and only the ones made by the publishing task.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include "bytebeam_sdk.h"
+#include "bytebeam_hal.h"
+#include "bytebeam_internal.h"
+#include "test_broker.h"
+#include "bench_common.h"
+
+/* The number of messages measured for every payload */
+#define BENCH_MESSAGE_COUNT 20000
+
+/* The number of messages sent before measuring, for warming up the caches and the connection */
+#define BENCH_WARMUP_COUNT 200
+
+/* The number of log records handed to the log flusher at once, small enough to never fill its ring */
+#define BENCH_LOG_BURST 8
+
+/* How long the connect may take at most */
+#define BENCH_TIMEOUT_MS 10000
+
+typedef bool (*bench_message_fn_t)(bytebeam_client_t *bytebeam_client, int sequence);
+
+typedef struct {
+    const char *name;
+    bench_message_fn_t send;
+} bench_message_t;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static __thread long long allocations = 0;
+
+static const char *TAG = "BENCH";
+
+void *__wrap_malloc(size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __real_realloc(ptr, size);
+}
+
+static bool write_heartbeat(bytebeam_client_t *bytebeam_client, int sequence)
+{
+    char payload[512];
+    bytebeam_json_writer_t writer;
+
+    (void)bytebeam_client;
+
+    bytebeam_json_writer_init(&writer, payload, sizeof(payload));
+
+    bytebeam_json_begin_array(&writer, NULL);
+    bytebeam_json_begin_object(&writer, NULL);
+    bytebeam_json_add_uint(&writer, "timestamp", 1700000000000ULL + sequence);
+    bytebeam_json_add_uint(&writer, "sequence", sequence);
+    bytebeam_json_add_int(&writer, "Uptime", 1000LL * sequence);
+    bytebeam_json_add_string(&writer, "Status", "Device is Active!");
+    bytebeam_json_add_string(&writer, "Software_Type", "bench-app");
+    bytebeam_json_add_string(&writer, "Software_Version", "1.0.0");
+    bytebeam_json_add_string(&writer, "Hardware_Type", "ESP32 DevKit V1");
+    bytebeam_json_add_string(&writer, "Hardware_Version", "rev1");
+    bytebeam_json_add_double(&writer, "Battery", 3.7);
+    bytebeam_json_end_object(&writer);
+    bytebeam_json_end_array(&writer);
+
+    return bytebeam_json_writer_finish(&writer) == BB_SUCCESS;
+}
+
+static bool write_action_status(bytebeam_client_t *bytebeam_client, int sequence)
+{
+    char payload[512];
+    bytebeam_json_writer_t writer;
+
+    (void)bytebeam_client;
+
+    bytebeam_json_writer_init(&writer, payload, sizeof(payload));
+
+    bytebeam_json_begin_array(&writer, NULL);
+    bytebeam_json_begin_object(&writer, NULL);
+    bytebeam_json_add_uint(&writer, "timestamp", 1700000000000ULL + sequence);
+    bytebeam_json_add_uint(&writer, "sequence", sequence);
+    bytebeam_json_add_string(&writer, "state", "Progress");
+    bytebeam_json_begin_array(&writer, "errors");
+    bytebeam_json_add_string(&writer, NULL, "");
+    bytebeam_json_end_array(&writer);
+    bytebeam_json_add_string(&writer, "id", "12345");
+    bytebeam_json_add_int(&writer, "progress", sequence % 100);
+    bytebeam_json_end_object(&writer);
+    bytebeam_json_end_array(&writer);
+
+    return bytebeam_json_writer_finish(&writer) == BB_SUCCESS;
+}
+
+static bool add_log_message(bytebeam_json_writer_t *writer, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    bytebeam_err_t ret_val = bytebeam_json_add_vformat_truncated(writer, "message", 2, fmt, args);
+    va_end(args);
+
+    return ret_val == BB_SUCCESS;
+}
+
+static bool write_log(bytebeam_client_t *bytebeam_client, int sequence)
+{
+    char payload[BYTEBEAM_LOG_PAYLOAD_STR_LEN];
+    bytebeam_json_writer_t writer;
+
+    (void)bytebeam_client;
+
+    bytebeam_json_writer_init(&writer, payload, sizeof(payload));
+
+    bytebeam_json_begin_array(&writer, NULL);
+    bytebeam_json_begin_object(&writer, NULL);
+    bytebeam_json_add_uint(&writer, "timestamp", 1700000000000ULL + sequence);
+    bytebeam_json_add_uint(&writer, "sequence", sequence);
+    bytebeam_json_add_string(&writer, "level", "Info");
+    bytebeam_json_add_string(&writer, "tag", TAG);
+    add_log_message(&writer, "sensor %d read %.2f degC in %d ms", sequence % 4, 24.5 + (sequence % 30) * 0.1, sequence % 17);
+    bytebeam_json_end_object(&writer);
+    bytebeam_json_end_array(&writer);
+
+    return bytebeam_json_writer_finish(&writer) == BB_SUCCESS;
+}
+
+static bool publish_heartbeat(bytebeam_client_t *bytebeam_client, int sequence)
+{
+    (void)sequence;
+
+    return bytebeam_publish_device_heartbeat(bytebeam_client) == BB_SUCCESS;
+}
+
+static bool publish_action_status(bytebeam_client_t *bytebeam_client, int sequence)
+{
+    return bytebeam_publish_action_status(bytebeam_client, "12345", sequence % 100, "Progress", "") == BB_SUCCESS;
+}
+
+static bool publish_log(bytebeam_client_t *bytebeam_client, int sequence)
+{
+    // the flusher publishes the records in the background, the caller only pays for handing them over
+    if (sequence % BENCH_LOG_BURST == 0) {
+        usleep(1000);
+    }
+
+    return bytebeam_client_log_publish(bytebeam_client, "Info", TAG, "sensor %d read %.2f degC in %d ms", sequence % 4,
+                                       24.5 + (sequence % 30) * 0.1, sequence % 17) == BB_SUCCESS;
+}
+
+static const bench_message_t bench_messages[] = {
+    { "heartbeat payload", write_heartbeat },
+    { "action status payload", write_action_status },
+    { "log payload", write_log },
+    { "heartbeat publish", publish_heartbeat },
+    { "action status publish", publish_action_status },
+    { "log publish", publish_log },
+};
+
+static void run_message(FILE *output, bytebeam_client_t *bytebeam_client, const bench_message_t *message)
+{
+    for (int sequence = 0; sequence < BENCH_WARMUP_COUNT; sequence++) {
+        if (!message->send(bytebeam_client, sequence)) {
+            fprintf(output, "%-24s failed\n", message->name);
+            return;
+        }
+    }
+
+    long long allocations_before = allocations;
+    long long start_ns = bench_thread_cpu_ns();
+
+    for (int sequence = 0; sequence < BENCH_MESSAGE_COUNT; sequence++) {
+        if (!message->send(bytebeam_client, sequence)) {
+            fprintf(output, "%-24s failed\n", message->name);
+            return;
+        }
+    }
+
+    long long cpu_ns = bench_thread_cpu_ns() - start_ns;
+
+    fprintf(output, "%-24s %12.0f %16.2f\n", message->name, (double)cpu_ns / BENCH_MESSAGE_COUNT,
+            (double)(allocations - allocations_before) / BENCH_MESSAGE_COUNT);
+}
+
+int main(void)
+{
+    FILE *output = bench_open_output();
+    bytebeam_client_t bytebeam_client;
+    test_broker_t *broker = test_broker_start(NULL, NULL);
+
+    if (broker == NULL) {
+        fprintf(output, "failed to start the test broker\n");
+        return 1;
+    }
+
+    memset(&bytebeam_client, 0x00, sizeof(bytebeam_client_t));
+
+    bytebeam_client.use_device_config_data = true;
+    test_broker_get_uri(broker, bytebeam_client.device_cfg.broker_uri, BYTEBEAM_BROKER_URL_STR_LEN);
+    strcpy(bytebeam_client.device_cfg.device_id, "1");
+    strcpy(bytebeam_client.device_cfg.project_id, "bench");
+
+    if (bytebeam_init(&bytebeam_client) != BB_SUCCESS || bytebeam_start(&bytebeam_client) != BB_SUCCESS) {
+        fprintf(output, "failed to start the client\n");
+        return 1;
+    }
+
+    for (int waited_ms = 0; waited_ms < BENCH_TIMEOUT_MS && bytebeam_client.connection_status != 1; waited_ms += 10) {
+        usleep(10 * 1000);
+    }
+
+    if (bytebeam_client.connection_status != 1) {
+        fprintf(output, "client failed to connect\n");
+        return 1;
+    }
+
+    // the same fields as the heartbeat payload written by hand
+    bytebeam_shadow_set_string(&bytebeam_client, "Status", "Device is Active!");
+    bytebeam_shadow_set_string(&bytebeam_client, "Software_Type", "bench-app");
+    bytebeam_shadow_set_string(&bytebeam_client, "Software_Version", "1.0.0");
+    bytebeam_shadow_set_string(&bytebeam_client, "Hardware_Type", "ESP32 DevKit V1");
+    bytebeam_shadow_set_string(&bytebeam_client, "Hardware_Version", "rev1");
+    bytebeam_shadow_set_double(&bytebeam_client, "Battery", 3.7);
+
+    fprintf(output, "%d messages each, the publishes go to mqtt over loopback\n\n", BENCH_MESSAGE_COUNT);
+    fprintf(output, "%-24s %12s %16s\n", "message", "cpu ns/msg", "allocations/msg");
+
+    for (int index = 0; index < (int)(sizeof(bench_messages) / sizeof(bench_messages[0])); index++) {
+        run_message(output, &bytebeam_client, &bench_messages[index]);
+    }
+
+    bytebeam_log_stats_t log_stats;
+
+    if (bytebeam_log_get_stats(&log_stats) == BB_SUCCESS) {
+        fprintf(output, "\nlog records dropped by the full ring: %u\n", log_stats.dropped_records);
+    }
+
+    bytebeam_stop(&bytebeam_client);
+    bytebeam_destroy(&bytebeam_client);
+
+    test_broker_stop(broker);
+
+    return 0;
+}
@@ -0,0 +1,377 @@
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "test_broker.h"
+
+/* The number of client connections served at the same time */
+#define TEST_BROKER_MAX_CONNECTIONS 8
+
+/* The receive buffer of every connection, large enough for the biggest packet of the linux mqtt client */
+#define TEST_BROKER_BUFFER_SIZE (72 * 1024)
+
+typedef struct test_broker_connection {
+    int fd;
+    uint8_t *buffer;
+    int length;
+} test_broker_connection_t;
+
+struct test_broker {
+    int listen_fd;
+    int port;
+    int wake_fds[2];
+    pthread_t thread;
+    pthread_mutex_t lock;
+    bool is_stopping;
+    bool is_dropping;
+    int publish_count;
+    long long rx_bytes;
+    test_broker_publish_cb_t callback;
+    void *arg;
+    test_broker_connection_t connections[TEST_BROKER_MAX_CONNECTIONS];
+};
+
+static void close_connection(test_broker_connection_t *connection)
+{
+    close(connection->fd);
+    free(connection->buffer);
+
+    connection->fd = -1;
+    connection->buffer = NULL;
+    connection->length = 0;
+}
+
+static int send_all(int fd, const uint8_t *data, int len)
+{
+    while (len > 0) {
+        ssize_t sent = send(fd, data, len, MSG_NOSIGNAL);
+
+        if (sent <= 0) {
+            return -1;
+        }
+
+        data = data + sent;
+        len = len - (int)sent;
+    }
+
+    return 0;
+}
+
+/* Returns the packet length, 0 if the packet is not complete yet and -1 for a malformed length */
+static int get_packet_length(const uint8_t *data, int len, int *header_len)
+{
+    int multiplier = 1;
+    int remaining = 0;
+
+    for (int i = 1; i < 5; i++) {
+        if (i >= len) {
+            return 0;
+        }
+
+        remaining = remaining + (data[i] & 0x7F) * multiplier;
+        multiplier = multiplier * 128;
+
+        if ((data[i] & 0x80) == 0) {
+            *header_len = i + 1;
+            return (*header_len + remaining <= len) ? *header_len + remaining : 0;
+        }
+    }
+
+    return -1;
+}
+
+static int handle_packet(test_broker_t *broker, test_broker_connection_t *connection, const uint8_t *packet, int header_len, int len)
+{
+    const uint8_t *body = packet + header_len;
+    int body_len = len - header_len;
+
+    switch (packet[0] >> 4) {
+    case 1: {
+        const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+        return send_all(connection->fd, connack, sizeof(connack));
+    }
+
+    case 3: {
+        int qos = (packet[0] >> 1) & 0x03;
+        int topic_len = (body[0] << 8) | body[1];
+        int offset = 2 + topic_len;
+        char topic[256] = "";
+
+        if (topic_len >= (int)sizeof(topic) || offset > body_len) {
+            return -1;
+        }
+
+        memcpy(topic, body + 2, topic_len);
+
+        if (qos > 0) {
+            const uint8_t puback[] = { 0x40, 0x02, body[offset], body[offset + 1] };
+            offset = offset + 2;
+
+            if (send_all(connection->fd, puback, sizeof(puback)) != 0) {
+                return -1;
+            }
+        }
+
+        pthread_mutex_lock(&broker->lock);
+        broker->publish_count++;
+        pthread_mutex_unlock(&broker->lock);
+
+        if (broker->callback != NULL) {
+            broker->callback(topic, body + offset, body_len - offset, broker->arg);
+        }
+
+        return 0;
+    }
+
+    case 8: {
+        const uint8_t suback[] = { 0x90, 0x03, body[0], body[1], 0x00 };
+        return send_all(connection->fd, suback, sizeof(suback));
+    }
+
+    case 12: {
+        const uint8_t pingresp[] = { 0xD0, 0x00 };
+        return send_all(connection->fd, pingresp, sizeof(pingresp));
+    }
+
+    case 14:
+        return -1;
+
+    default:
+        return 0;
+    }
+}
+
+static int serve_connection(test_broker_t *broker, test_broker_connection_t *connection)
+{
+    ssize_t received = recv(connection->fd, connection->buffer + connection->length, TEST_BROKER_BUFFER_SIZE - connection->length, 0);
+
+    if (received <= 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&broker->lock);
+    broker->rx_bytes = broker->rx_bytes + received;
+    pthread_mutex_unlock(&broker->lock);
+
+    connection->length = connection->length + (int)received;
+
+    while (connection->length > 0) {
+        int header_len = 0;
+        int len = get_packet_length(connection->buffer, connection->length, &header_len);
+
+        if (len < 0 || (len == 0 && connection->length == TEST_BROKER_BUFFER_SIZE)) {
+            return -1;
+        }
+
+        if (len == 0) {
+            break;
+        }
+
+        if (handle_packet(broker, connection, connection->buffer, header_len, len) != 0) {
+            return -1;
+        }
+
+        memmove(connection->buffer, connection->buffer + len, connection->length - len);
+        connection->length = connection->length - len;
+    }
+
+    return 0;
+}
+
+static void accept_connection(test_broker_t *broker)
+{
+    int fd = accept(broker->listen_fd, NULL, NULL);
+
+    if (fd < 0) {
+        return;
+    }
+
+    for (int i = 0; i < TEST_BROKER_MAX_CONNECTIONS; i++) {
+        if (broker->connections[i].fd == -1) {
+            broker->connections[i].fd = fd;
+            broker->connections[i].buffer = malloc(TEST_BROKER_BUFFER_SIZE);
+            broker->connections[i].length = 0;
+
+            if (broker->connections[i].buffer == NULL) {
+                close_connection(&broker->connections[i]);
+            }
+
+            return;
+        }
+    }
+
+    close(fd);
+}
+
+static void *broker_thread(void *arg)
+{
+    test_broker_t *broker = arg;
+    struct pollfd fds[TEST_BROKER_MAX_CONNECTIONS + 2];
+
+    while (true) {
+        pthread_mutex_lock(&broker->lock);
+        bool is_stopping = broker->is_stopping;
+        bool is_dropping = broker->is_dropping;
+        broker->is_dropping = false;
+        pthread_mutex_unlock(&broker->lock);
+
+        if (is_stopping || is_dropping) {
+            for (int i = 0; i < TEST_BROKER_MAX_CONNECTIONS; i++) {
+                if (broker->connections[i].fd != -1) {
+                    close_connection(&broker->connections[i]);
+                }
+            }
+        }
+
+        if (is_stopping) {
+            break;
+        }
+
+        fds[0].fd = broker->listen_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = broker->wake_fds[0];
+        fds[1].events = POLLIN;
+
+        for (int i = 0; i < TEST_BROKER_MAX_CONNECTIONS; i++) {
+            fds[i + 2].fd = broker->connections[i].fd;
+            fds[i + 2].events = POLLIN;
+            fds[i + 2].revents = 0;
+        }
+
+        if (poll(fds, TEST_BROKER_MAX_CONNECTIONS + 2, -1) < 0) {
+            continue;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char wake;
+            ssize_t ret_val = read(broker->wake_fds[0], &wake, 1);
+            (void)ret_val;
+        }
+
+        for (int i = 0; i < TEST_BROKER_MAX_CONNECTIONS; i++) {
+            if (fds[i + 2].fd != -1 && fds[i + 2].revents != 0 && serve_connection(broker, &broker->connections[i]) != 0) {
+                close_connection(&broker->connections[i]);
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            accept_connection(broker);
+        }
+    }
+
+    return NULL;
+}
+
+static void wake_broker(test_broker_t *broker)
+{
+    char wake = 1;
+    ssize_t ret_val = write(broker->wake_fds[1], &wake, 1);
+    (void)ret_val;
+}
+
+test_broker_t *test_broker_start(test_broker_publish_cb_t callback, void *arg)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int enable = 1;
+
+    test_broker_t *broker = calloc(1, sizeof(test_broker_t));
+
+    if (broker == NULL) {
+        return NULL;
+    }
+
+    broker->callback = callback;
+    broker->arg = arg;
+
+    for (int i = 0; i < TEST_BROKER_MAX_CONNECTIONS; i++) {
+        broker->connections[i].fd = -1;
+    }
+
+    memset(&addr, 0x00, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    broker->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (broker->listen_fd < 0 ||
+        setsockopt(broker->listen_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) != 0 ||
+        bind(broker->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(broker->listen_fd, TEST_BROKER_MAX_CONNECTIONS) != 0 ||
+        getsockname(broker->listen_fd, (struct sockaddr *)&addr, &addr_len) != 0 ||
+        pipe(broker->wake_fds) != 0) {
+        if (broker->listen_fd >= 0) {
+            close(broker->listen_fd);
+        }
+
+        free(broker);
+        return NULL;
+    }
+
+    broker->port = ntohs(addr.sin_port);
+    pthread_mutex_init(&broker->lock, NULL);
+
+    if (pthread_create(&broker->thread, NULL, broker_thread, broker) != 0) {
+        close(broker->listen_fd);
+        close(broker->wake_fds[0]);
+        close(broker->wake_fds[1]);
+        pthread_mutex_destroy(&broker->lock);
+        free(broker);
+        return NULL;
+    }
+
+    return broker;
+}
+
+void test_broker_get_uri(test_broker_t *broker, char *uri, int len)
+{
+    snprintf(uri, len, "mqtt://127.0.0.1:%d", broker->port);
+}
+
+int test_broker_get_publish_count(test_broker_t *broker)
+{
+    pthread_mutex_lock(&broker->lock);
+    int publish_count = broker->publish_count;
+    pthread_mutex_unlock(&broker->lock);
+
+    return publish_count;
+}
+
+long long test_broker_get_rx_bytes(test_broker_t *broker)
+{
+    pthread_mutex_lock(&broker->lock);
+    long long rx_bytes = broker->rx_bytes;
+    pthread_mutex_unlock(&broker->lock);
+
+    return rx_bytes;
+}
+
+void test_broker_drop_connections(test_broker_t *broker)
+{
+    pthread_mutex_lock(&broker->lock);
+    broker->is_dropping = true;
+    pthread_mutex_unlock(&broker->lock);
+
+    wake_broker(broker);
+}
+
+void test_broker_stop(test_broker_t *broker)
+{
+    pthread_mutex_lock(&broker->lock);
+    broker->is_stopping = true;
+    pthread_mutex_unlock(&broker->lock);
+
+    wake_broker(broker);
+    pthread_join(broker->thread, NULL);
+
+    close(broker->listen_fd);
+    close(broker->wake_fds[0]);
+    close(broker->wake_fds[1]);
+    pthread_mutex_destroy(&broker->lock);
+    free(broker);
+}
@@ -0,0 +1,67 @@
+#ifndef TEST_BROKER_H
+#define TEST_BROKER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * A minimal mqtt 3.1.1 broker for the host tests and benchmarks. It accepts the connections of the sdk on a
+ * loopback port, acknowledges every connect, subscribe and qos 1 publish and hands the publishes to a callback.
+ * Nothing is ever routed back to the clients.
+ */
+
+/* Called from the broker thread for every publish received */
+typedef void (*test_broker_publish_cb_t)(const char *topic, const uint8_t *payload, int length, void *arg);
+
+typedef struct test_broker test_broker_t;
+
+/**
+ * @brief Start the broker on an ephemeral loopback port
+ *
+ * @param[in] callback  publish callback, NULL if the publishes are only counted
+ * @param[in] arg       argument for the callback
+ *
+ * @return
+ *      broker handle, NULL if the broker failed to start
+ */
+test_broker_t *test_broker_start(test_broker_publish_cb_t callback, void *arg);
+
+/**
+ * @brief Fill in the broker uri, i.e. mqtt://127.0.0.1:<port>
+ *
+ * @param[in]  broker  broker handle
+ * @param[out] uri     uri buffer
+ * @param[in]  len     uri buffer length
+ */
+void test_broker_get_uri(test_broker_t *broker, char *uri, int len);
+
+/**
+ * @brief Get the number of publishes received so far
+ *
+ * @param[in] broker  broker handle
+ */
+int test_broker_get_publish_count(test_broker_t *broker);
+
+/**
+ * @brief Get the number of bytes received so far, the mqtt framing of every packet included
+ *
+ * @param[in] broker  broker handle
+ */
+long long test_broker_get_rx_bytes(test_broker_t *broker);
+
+/**
+ * @brief Close every client connection, the clients see a connection loss
+ *
+ * @param[in] broker  broker handle
+ */
+void test_broker_drop_connections(test_broker_t *broker);
+
+/**
+ * @brief Stop the broker and free it
+ *
+ * @param[in] broker  broker handle
+ */
+void test_broker_stop(test_broker_t *broker);
+
+#endif /* TEST_BROKER_H */
@@ -0,0 +1,86 @@
+/*
+ * Host test of the json writer cutting the formatted strings short, as done for the log messages too long for the
+ * log payload.
+ */
+
+#include <string.h>
+#include "bytebeam_sdk.h"
+#include "test_check.h"
+
+static bytebeam_err_t add_message(bytebeam_json_writer_t *writer, int reserve, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    bytebeam_err_t ret_val = bytebeam_json_add_vformat_truncated(writer, "message", reserve, fmt, args);
+    va_end(args);
+
+    return ret_val;
+}
+
+static void write_log(char *buffer, int size, const char *message)
+{
+    bytebeam_json_writer_t writer;
+
+    bytebeam_json_writer_init(&writer, buffer, size);
+    bytebeam_json_begin_array(&writer, NULL);
+    bytebeam_json_begin_object(&writer, NULL);
+    bytebeam_json_add_string(&writer, "level", "Info");
+    TEST_CHECK(add_message(&writer, 2, "%s", message) == BB_SUCCESS);
+    bytebeam_json_end_object(&writer);
+    bytebeam_json_end_array(&writer);
+    TEST_CHECK(bytebeam_json_writer_finish(&writer) == BB_SUCCESS);
+}
+
+static bool ends_with(const char *json, const char *suffix)
+{
+    int len = strlen(json);
+    int suffix_len = strlen(suffix);
+
+    return len >= suffix_len && strcmp(json + len - suffix_len, suffix) == 0;
+}
+
+int main(void)
+{
+    char buffer[64];
+    char message[256];
+
+    // a message that fits is left alone
+    write_log(buffer, sizeof(buffer), "hello");
+    TEST_CHECK(strcmp(buffer, "[{\"level\":\"Info\",\"message\":\"hello\"}]") == 0);
+
+    // a long one is cut short with the marker and the json stays closed
+    memset(message, 'a', sizeof(message) - 1);
+    message[sizeof(message) - 1] = '\0';
+
+    write_log(buffer, sizeof(buffer), message);
+    TEST_CHECK(ends_with(buffer, "a" BYTEBEAM_JSON_TRUNCATION_MARKER "\"}]"));
+    TEST_CHECK((int)strlen(buffer) == (int)sizeof(buffer) - 1);
+
+    // the escape sequences count against the space, a sequence is never split
+    memset(message, '"', sizeof(message) - 1);
+
+    write_log(buffer, sizeof(buffer), message);
+    TEST_CHECK(ends_with(buffer, "\\\"" BYTEBEAM_JSON_TRUNCATION_MARKER "\"}]"));
+
+    // nor is a multi byte utf-8 character
+    message[0] = '\0';
+
+    for (int i = 0; i < 40; i++) {
+        strcat(message, "\xc3\xa9");
+    }
+
+    write_log(buffer, sizeof(buffer), message);
+    TEST_CHECK(ends_with(buffer, "\xc3\xa9" BYTEBEAM_JSON_TRUNCATION_MARKER "\"}]"));
+
+    // the plain format still refuses what does not fit
+    bytebeam_json_writer_t writer;
+
+    bytebeam_json_writer_init(&writer, buffer, sizeof(buffer));
+    bytebeam_json_begin_object(&writer, NULL);
+    TEST_CHECK(add_message(&writer, 0, "%s", "fits") == BB_SUCCESS);
+    TEST_CHECK(add_message(&writer, sizeof(buffer), "%s", "no room") == BB_FAILURE);
+
+    printf("json test passed\n");
+
+    return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ * Host test of the cloud logging of a gateway running two clients. Covers every client publishing its logs on its own
+ * log stream under its own device id, the buffered logs of a client going out before it is destroyed and the other
+ * client logging on meanwhile without the log flusher being restarted, a flush waiting for the buffered logs and a
+ * burst overrunning the log ring.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "bytebeam_sdk.h"
+#include "bytebeam_hal.h"
+#include "test_broker.h"
+#include "test_check.h"
+
+/* The number of log records every client publishes */
+#define TEST_LOG_COUNT 100
+
+/* How long the connect and the log flush may take at most */
+#define TEST_TIMEOUT_MS 10000
+
+static const char *TAG = "TEST_LOG";
+
+typedef struct {
+    const char *topic;
+    const char *message;
+    int count;
+    int misrouted;
+} log_counter_t;
+
+static log_counter_t gateway_logs = { "/devices/1/events/logs/jsonarray", "\"message\":\"gateway log" };
+static log_counter_t node_logs = { "/devices/2/events/node_logs/jsonarray", "\"message\":\"node log" };
+static pthread_mutex_t received_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int count_occurrences(const char *text, const char *pattern)
+{
+    int count = 0;
+
+    for (const char *match = strstr(text, pattern); match != NULL; match = strstr(match + 1, pattern)) {
+        count++;
+    }
+
+    return count;
+}
+
+static void count_logs(log_counter_t *counter, log_counter_t *other, const char *topic, const char *payload)
+{
+    if (strstr(topic, counter->topic) == NULL) {
+        return;
+    }
+
+    counter->count += count_occurrences(payload, counter->message);
+    counter->misrouted += count_occurrences(payload, other->message);
+}
+
+static void on_publish(const char *topic, const uint8_t *payload, int length, void *arg)
+{
+    (void)arg;
+
+    char *text = malloc(length + 1);
+
+    TEST_CHECK(text != NULL);
+
+    memcpy(text, payload, length);
+    text[length] = '\0';
+
+    pthread_mutex_lock(&received_lock);
+    count_logs(&gateway_logs, &node_logs, topic, text);
+    count_logs(&node_logs, &gateway_logs, topic, text);
+    pthread_mutex_unlock(&received_lock);
+
+    free(text);
+}
+
+static int get_count(log_counter_t *counter)
+{
+    pthread_mutex_lock(&received_lock);
+    int count = counter->count;
+    pthread_mutex_unlock(&received_lock);
+
+    return count;
+}
+
+static void wait_count(log_counter_t *counter, int count)
+{
+    for (int waited_ms = 0; waited_ms < TEST_TIMEOUT_MS && get_count(counter) < count; waited_ms += 10) {
+        usleep(10 * 1000);
+    }
+
+    TEST_CHECK(get_count(counter) == count);
+}
+
+static void start_client(bytebeam_client_t *bytebeam_client, test_broker_t *broker, const char *device_id)
+{
+    memset(bytebeam_client, 0x00, sizeof(bytebeam_client_t));
+
+    bytebeam_client->use_device_config_data = true;
+    test_broker_get_uri(broker, bytebeam_client->device_cfg.broker_uri, BYTEBEAM_BROKER_URL_STR_LEN);
+    strcpy(bytebeam_client->device_cfg.device_id, device_id);
+    strcpy(bytebeam_client->device_cfg.project_id, "test");
+
+    TEST_CHECK(bytebeam_init(bytebeam_client) == BB_SUCCESS);
+    TEST_CHECK(bytebeam_start(bytebeam_client) == BB_SUCCESS);
+
+    for (int waited_ms = 0; waited_ms < TEST_TIMEOUT_MS && bytebeam_client->connection_status != 1; waited_ms += 10) {
+        usleep(10 * 1000);
+    }
+
+    TEST_CHECK(bytebeam_client->connection_status == 1);
+}
+
+static void test_gateway_logs(test_broker_t *broker)
+{
+    bytebeam_client_t gateway;
+    bytebeam_client_t node;
+
+    start_client(&gateway, broker, "1");
+    start_client(&node, broker, "2");
+
+    // the log apis go through the first client, the node logs through its own handle with its own settings
+    TEST_CHECK(bytebeam_client_log_stream_set(&node, "node_logs") == BB_SUCCESS);
+    TEST_CHECK(bytebeam_client_log_level_set(&node, BYTEBEAM_LOG_LEVEL_DEBUG) == BB_SUCCESS);
+    TEST_CHECK(bytebeam_log_level_get() == BYTEBEAM_LOG_LEVEL_INFO);
+    TEST_CHECK(!strcmp(bytebeam_log_stream_get(), BYTEBEAM_LOG_DEFAULT_STREAM));
+
+    for (int index = 0; index < TEST_LOG_COUNT; index++) {
+        BYTEBEAM_LOGI(TAG, "gateway log %d", index);
+        BYTEBEAM_CLIENT_LOGD(&node, TAG, "node log %d", index);
+
+        // the gateway is at the info level, so its debug logs never go out
+        BYTEBEAM_LOGD(TAG, "gateway log debug %d", index);
+
+        // leave the flusher the time to keep up, a full ring drops the records
+        if (index % 8 == 0) {
+            usleep(5 * 1000);
+        }
+    }
+
+    wait_count(&gateway_logs, TEST_LOG_COUNT);
+
+    // the node logs buffered when it is destroyed still go out, destroying a client stops it as well
+    BYTEBEAM_CLIENT_LOGI(&node, TAG, "node log last");
+
+    bytebeam_destroy(&node);
+
+    wait_count(&node_logs, TEST_LOG_COUNT + 1);
+
+    // the gateway logs on without the node
+    for (int index = 0; index < TEST_LOG_COUNT; index++) {
+        BYTEBEAM_LOGI(TAG, "gateway log %d", index);
+
+        if (index % 8 == 0) {
+            usleep(5 * 1000);
+        }
+    }
+
+    // a flush returns only once the buffered logs are through the ring and acknowledged by the broker
+    TEST_CHECK(bytebeam_flush(&gateway, TEST_TIMEOUT_MS) == BB_SUCCESS);
+    TEST_CHECK(get_count(&gateway_logs) == 2 * TEST_LOG_COUNT);
+
+    // a burst overruns the ring, the dropped records are only counted and reported as rate limited
+    bytebeam_log_stats_t stats_before;
+    bytebeam_log_stats_t stats_after;
+    unsigned int rate_limited = 0;
+
+    TEST_CHECK(bytebeam_log_get_stats(&stats_before) == BB_SUCCESS);
+
+    for (int index = 0; index < 4 * BYTEBEAM_LOG_RING_SIZE; index++) {
+        bytebeam_err_t err_code = bytebeam_log_publish("Info", TAG, "gateway burst %d", index);
+
+        TEST_CHECK(err_code == BB_SUCCESS || err_code == BB_RATE_LIMITED);
+
+        if (err_code == BB_RATE_LIMITED) {
+            rate_limited++;
+        }
+    }
+
+    TEST_CHECK(bytebeam_log_get_stats(&stats_after) == BB_SUCCESS);
+    TEST_CHECK(stats_after.dropped_records - stats_before.dropped_records == rate_limited);
+
+    pthread_mutex_lock(&received_lock);
+    TEST_CHECK(gateway_logs.misrouted == 0);
+    TEST_CHECK(node_logs.misrouted == 0);
+    pthread_mutex_unlock(&received_lock);
+
+    bytebeam_stop(&gateway);
+    bytebeam_destroy(&gateway);
+
+    // without a log client the log apis fall back to the defaults
+    TEST_CHECK(bytebeam_log_publish("Info", TAG, "no client") == BB_FAILURE);
+    TEST_CHECK(bytebeam_log_level_get() == BYTEBEAM_LOG_LEVEL_INFO);
+}
+
+int main(void)
+{
+    test_broker_t *broker = test_broker_start(on_publish, NULL);
+
+    TEST_CHECK(broker != NULL);
+
+    test_gateway_logs(broker);
+
+    test_broker_stop(broker);
+
+    printf("log test passed\n");
+
+    return 0;
+}
@@ -0,0 +1,398 @@
+/*
+ * Host test of the offline queue, the segment files live in a temporary directory and the drain goes to the test
+ * broker. Covers the records surviving a disable and enable (a reboot), the drop policies, the drain after connecting
+ * disabling the queue while other tasks are publishing to it and the oldest records being dropped while they are
+ * drained.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "bytebeam_sdk.h"
+#include "test_broker.h"
+#include "test_check.h"
+
+/* The number of records queued before the client connects */
+#define TEST_RECORD_COUNT 200
+
+/* How long the drain may take at most */
+#define TEST_DRAIN_TIMEOUT_MS 10000
+
+static char base_path[BYTEBEAM_OFFLINE_QUEUE_PATH_STR_LEN];
+static int received_records = 0;
+static int received_out_of_order = 0;
+static int last_received_seq = 0;
+static int evict_records = 0;
+static int evict_torn_payloads = 0;
+static pthread_mutex_t received_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int count_matches(const char *record, const char *pattern)
+{
+    int matches = 0;
+
+    for (const char *match = strstr(record, pattern); match != NULL; match = strstr(match + 1, pattern)) {
+        matches++;
+    }
+
+    return matches;
+}
+
+static void on_publish(const char *topic, const uint8_t *payload, int length, void *arg)
+{
+    (void)arg;
+
+    bool is_evict_stream = (strstr(topic, "/events/evict_stream/") != NULL);
+
+    if (strstr(topic, "/events/test_stream/") == NULL && !is_evict_stream) {
+        return;
+    }
+
+    char *record = malloc(length + 1);
+
+    TEST_CHECK(record != NULL);
+
+    memcpy(record, payload, length);
+    record[length] = '\0';
+
+    pthread_mutex_lock(&received_lock);
+
+    if (is_evict_stream) {
+        int records = count_matches(record, "{\"timestamp\":");
+
+        // a drain buffer written over while it is published shows up as a broken array or broken records
+        if (length < 2 || record[0] != '[' || record[length - 1] != ']' || records != count_matches(record, "\"seq\":") ||
+            records != count_matches(record, "}")) {
+            evict_torn_payloads++;
+        }
+
+        evict_records = evict_records + records;
+
+        pthread_mutex_unlock(&received_lock);
+        free(record);
+        return;
+    }
+
+    for (char *seq = strstr(record, "\"seq\":"); seq != NULL; seq = strstr(seq + 1, "\"seq\":")) {
+        int seq_val = atoi(seq + strlen("\"seq\":"));
+
+        // the queue delivers atleast once, a repeated chunk starts over at an older record
+        if (seq_val != last_received_seq + 1 && seq_val > last_received_seq) {
+            received_out_of_order++;
+        }
+
+        if (seq_val == last_received_seq + 1) {
+            received_records++;
+        }
+
+        if (seq_val > last_received_seq) {
+            last_received_seq = seq_val;
+        }
+    }
+
+    pthread_mutex_unlock(&received_lock);
+
+    free(record);
+}
+
+static void remove_segments(void)
+{
+    char command[128];
+
+    snprintf(command, sizeof(command), "rm -f %s/bbq*.seg", base_path);
+    TEST_CHECK(system(command) == 0);
+}
+
+static void init_client(bytebeam_client_t *bytebeam_client, test_broker_t *broker)
+{
+    memset(bytebeam_client, 0x00, sizeof(bytebeam_client_t));
+
+    bytebeam_client->use_device_config_data = true;
+    test_broker_get_uri(broker, bytebeam_client->device_cfg.broker_uri, BYTEBEAM_BROKER_URL_STR_LEN);
+    strcpy(bytebeam_client->device_cfg.device_id, "1");
+    strcpy(bytebeam_client->device_cfg.project_id, "test");
+
+    TEST_CHECK(bytebeam_init(bytebeam_client) == BB_SUCCESS);
+}
+
+static bytebeam_offline_queue_config_t get_queue_config(void)
+{
+    bytebeam_offline_queue_config_t config = BYTEBEAM_OFFLINE_QUEUE_DEFAULT_CONFIG();
+
+    config.base_path = base_path;
+    config.mount_spiffs = false;
+    config.segment_size = 1024;
+    config.max_size = 64 * 1024;
+    config.drain_size = 512;
+
+    return config;
+}
+
+static void publish_stream_records(bytebeam_client_t *bytebeam_client, char *stream_name, int first_seq, int count, int *stored)
+{
+    char payload[128];
+    bytebeam_stream_handle_t stream = bytebeam_stream_open(bytebeam_client, stream_name);
+
+    TEST_CHECK(stream != NULL);
+
+    for (int seq = first_seq; seq < first_seq + count; seq++) {
+        snprintf(payload, sizeof(payload), "[{\"timestamp\":%d,\"sequence\":%d,\"seq\":%d}]", 1000 + seq, seq, seq);
+
+        if (bytebeam_stream_publish(stream, payload) == BB_SUCCESS && stored != NULL) {
+            (*stored)++;
+        }
+    }
+}
+
+static void publish_records(bytebeam_client_t *bytebeam_client, int first_seq, int count, int *stored)
+{
+    publish_stream_records(bytebeam_client, "test_stream", first_seq, count, stored);
+}
+
+static void test_persistence(test_broker_t *broker)
+{
+    bytebeam_client_t bytebeam_client;
+    bytebeam_offline_queue_stats_t stats;
+    bytebeam_offline_queue_config_t config = get_queue_config();
+
+    remove_segments();
+    init_client(&bytebeam_client, broker);
+
+    TEST_CHECK(bytebeam_offline_queue_enable(&bytebeam_client, &config) == BB_SUCCESS);
+    TEST_CHECK(bytebeam_offline_queue_enable(&bytebeam_client, &config) == BB_FAILURE);
+
+    // a second client can share the directory, but never the segment files of the same device
+    bytebeam_client_t other_client;
+
+    init_client(&other_client, broker);
+    TEST_CHECK(bytebeam_offline_queue_enable(&other_client, &config) == BB_FAILURE);
+
+    strcpy(other_client.device_cfg.device_id, "2");
+    TEST_CHECK(bytebeam_offline_queue_enable(&other_client, &config) == BB_SUCCESS);
+    publish_records(&other_client, 1, 10, NULL);
+    TEST_CHECK(bytebeam_offline_queue_get_stats(&other_client, &stats) == BB_SUCCESS);
+    TEST_CHECK(stats.stored_records == 10);
+    TEST_CHECK(bytebeam_offline_queue_disable(&other_client) == BB_SUCCESS);
+    bytebeam_destroy(&other_client);
+
+    // the client is not started yet, so every record goes to the queue
+    publish_records(&bytebeam_client, 1, TEST_RECORD_COUNT, NULL);
+
+    TEST_CHECK(bytebeam_offline_queue_get_stats(&bytebeam_client, &stats) == BB_SUCCESS);
+    TEST_CHECK(stats.stored_records == TEST_RECORD_COUNT);
+    TEST_CHECK(stats.dropped_records == 0);
+    TEST_CHECK(stats.used_size > config.segment_size);
+
+    int used_size = stats.used_size;
+
+    // a disable and enable is what a reboot looks like to the queue
+    TEST_CHECK(bytebeam_offline_queue_disable(&bytebeam_client) == BB_SUCCESS);
+    TEST_CHECK(bytebeam_offline_queue_get_stats(&bytebeam_client, &stats) == BB_FAILURE);
+    TEST_CHECK(bytebeam_offline_queue_enable(&bytebeam_client, &config) == BB_SUCCESS);
+    TEST_CHECK(bytebeam_offline_queue_get_stats(&bytebeam_client, &stats) == BB_SUCCESS);
+
+    // the records of the other device stay out of this queue
+    TEST_CHECK(stats.used_size == used_size);
+
+    TEST_CHECK(bytebeam_start(&bytebeam_client) == BB_SUCCESS);
+
+    for (int waited_ms = 0; waited_ms < TEST_DRAIN_TIMEOUT_MS; waited_ms += 10) {
+        TEST_CHECK(bytebeam_offline_queue_get_stats(&bytebeam_client, &stats) == BB_SUCCESS);
+
+        if (stats.used_size == 0) {
+            break;
+        }
+
+        usleep(10 * 1000);
+    }
+
+    // the heartbeat published on connect queues up behind the old records as well
+    TEST_CHECK(stats.used_size == 0);
+    TEST_CHECK(stats.drained_records >= TEST_RECORD_COUNT);
+
+    pthread_mutex_lock(&received_lock);
+    TEST_CHECK(received_records == TEST_RECORD_COUNT);
+    TEST_CHECK(received_out_of_order == 0);
+    pthread_mutex_unlock(&received_lock);
+
+    bytebeam_stop(&bytebeam_client);
+    bytebeam_destroy(&bytebeam_client);
+}
+
+static void test_drop_policy(test_broker_t *broker, bytebeam_offline_drop_policy_t drop_policy)
+{
+    bytebeam_client_t bytebeam_client;
+    bytebeam_offline_queue_stats_t stats;
+    bytebeam_offline_queue_config_t config = get_queue_config();
+    int stored = 0;
+
+    config.max_size = 2 * config.segment_size;
+    config.drop_policy = drop_policy;
+
+    remove_segments();
+    init_client(&bytebeam_client, broker);
+
+    TEST_CHECK(bytebeam_offline_queue_enable(&bytebeam_client, &config) == BB_SUCCESS);
+
+    publish_records(&bytebeam_client, 1, TEST_RECORD_COUNT, &stored);
+
+    TEST_CHECK(bytebeam_offline_queue_get_stats(&bytebeam_client, &stats) == BB_SUCCESS);
+    TEST_CHECK(stats.used_size <= config.max_size);
+    TEST_CHECK(stats.dropped_records > 0);
+
+    if (drop_policy == BYTEBEAM_OFFLINE_DROP_NEWEST) {
+        // the refused records are reported to the publisher
+        TEST_CHECK(stored + (int)stats.dropped_records == TEST_RECORD_COUNT);
+    } else {
+        // the new records always make it in, the old ones give way
+        TEST_CHECK(stored == TEST_RECORD_COUNT);
+        TEST_CHECK(stats.stored_records == TEST_RECORD_COUNT);
+    }
+
+    TEST_CHECK(bytebeam_offline_queue_disable(&bytebeam_client) == BB_SUCCESS);
+    bytebeam_destroy(&bytebeam_client);
+}
+
+typedef struct {
+    bytebeam_client_t *bytebeam_client;
+    volatile bool is_running;
+} publisher_arg_t;
+
+static void *publisher_thread(void *arg)
+{
+    publisher_arg_t *publisher = arg;
+    int seq = 1;
+
+    while (publisher->is_running) {
+        publish_records(publisher->bytebeam_client, seq, 10, NULL);
+        seq = seq + 10;
+        usleep(100);
+    }
+
+    return NULL;
+}
+
+static void test_disable_while_publishing(test_broker_t *broker)
+{
+    bytebeam_client_t bytebeam_client;
+    bytebeam_offline_queue_config_t config = get_queue_config();
+    pthread_t threads[4];
+    publisher_arg_t publisher = { .bytebeam_client = &bytebeam_client, .is_running = true };
+
+    remove_segments();
+    init_client(&bytebeam_client, broker);
+
+    for (int i = 0; i < 4; i++) {
+        TEST_CHECK(pthread_create(&threads[i], NULL, publisher_thread, &publisher) == 0);
+    }
+
+    // every round frees the queue the publishers may be halfway through
+    for (int round = 0; round < 100; round++) {
+        TEST_CHECK(bytebeam_offline_queue_enable(&bytebeam_client, &config) == BB_SUCCESS);
+        usleep(1000);
+        TEST_CHECK(bytebeam_offline_queue_disable(&bytebeam_client) == BB_SUCCESS);
+    }
+
+    publisher.is_running = false;
+
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    bytebeam_destroy(&bytebeam_client);
+}
+
+static void *evict_publisher_thread(void *arg)
+{
+    publisher_arg_t *publisher = arg;
+    int seq = 1;
+
+    while (publisher->is_running) {
+        publish_stream_records(publisher->bytebeam_client, "evict_stream", seq, 10, NULL);
+        seq = seq + 10;
+    }
+
+    return NULL;
+}
+
+static void test_evict_while_draining(test_broker_t *broker)
+{
+    bytebeam_client_t bytebeam_client;
+    bytebeam_offline_queue_stats_t stats;
+    bytebeam_offline_queue_config_t config = get_queue_config();
+    pthread_t threads[4];
+    publisher_arg_t publisher = { .bytebeam_client = &bytebeam_client, .is_running = true };
+
+    // two segments only, so nearly every roll over drops the segment the drain is reading
+    config.max_size = 2 * config.segment_size;
+    config.drop_policy = BYTEBEAM_OFFLINE_DROP_OLDEST;
+
+    remove_segments();
+    init_client(&bytebeam_client, broker);
+
+    TEST_CHECK(bytebeam_offline_queue_enable(&bytebeam_client, &config) == BB_SUCCESS);
+
+    // queue up a backlog first, the publishers below keep adding to it while the drain runs
+    publish_stream_records(&bytebeam_client, "evict_stream", 1, TEST_RECORD_COUNT, NULL);
+
+    TEST_CHECK(bytebeam_start(&bytebeam_client) == BB_SUCCESS);
+
+    for (int i = 0; i < 4; i++) {
+        TEST_CHECK(pthread_create(&threads[i], NULL, evict_publisher_thread, &publisher) == 0);
+    }
+
+    usleep(500 * 1000);
+    publisher.is_running = false;
+
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (int waited_ms = 0; waited_ms < TEST_DRAIN_TIMEOUT_MS; waited_ms += 10) {
+        TEST_CHECK(bytebeam_offline_queue_get_stats(&bytebeam_client, &stats) == BB_SUCCESS);
+
+        if (stats.used_size == 0) {
+            break;
+        }
+
+        usleep(10 * 1000);
+    }
+
+    // every stored record got drained or dropped exactly once, a chunk dropped while published is not drained too
+    TEST_CHECK(stats.used_size == 0);
+    TEST_CHECK(stats.dropped_records > 0);
+    TEST_CHECK(stats.stored_records == stats.drained_records + stats.dropped_records);
+
+    pthread_mutex_lock(&received_lock);
+    TEST_CHECK(evict_records > 0);
+    TEST_CHECK(evict_torn_payloads == 0);
+    pthread_mutex_unlock(&received_lock);
+
+    bytebeam_stop(&bytebeam_client);
+    TEST_CHECK(bytebeam_offline_queue_disable(&bytebeam_client) == BB_SUCCESS);
+    bytebeam_destroy(&bytebeam_client);
+}
+
+int main(void)
+{
+    snprintf(base_path, sizeof(base_path), "/tmp/bytebeam_offline_queue_XXXXXX");
+    TEST_CHECK(mkdtemp(base_path) != NULL);
+
+    test_broker_t *broker = test_broker_start(on_publish, NULL);
+
+    TEST_CHECK(broker != NULL);
+
+    test_drop_policy(broker, BYTEBEAM_OFFLINE_DROP_NEWEST);
+    test_drop_policy(broker, BYTEBEAM_OFFLINE_DROP_OLDEST);
+    test_disable_while_publishing(broker);
+    test_persistence(broker);
+    test_evict_while_draining(broker);
+
+    test_broker_stop(broker);
+
+    remove_segments();
+    rmdir(base_path);
+
+    printf("offline queue test passed\n");
+
+    return 0;
+}
@@ -0,0 +1,387 @@
+/*
+ * Host test of the linux OTA download against a local http server. Covers following a redirect, resuming with a range
+ * request after the server cut the connection and restarting a chunked download sent without its size.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "bytebeam_sdk.h"
+#include "bytebeam_hal.h"
+#include "test_broker.h"
+#include "test_check.h"
+
+/* The size of the OTA image served, not a multiple of the chunk size so that the last chunk is a short one */
+#define TEST_IMAGE_SIZE (100 * 1024 + 123)
+
+/* The chunk size of the chunked download */
+#define TEST_CHUNK_SIZE 4096
+
+/* How long the connect and the status publish may take at most */
+#define TEST_TIMEOUT_MS 10000
+
+typedef struct {
+    int listen_fd;
+    int port;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    bool is_cutting;
+    int redirects;
+    int full_requests;
+    int range_requests;
+    int chunked_requests;
+} test_http_server_t;
+
+static uint8_t image[TEST_IMAGE_SIZE];
+static int downloaded_statuses = 0;
+static pthread_mutex_t received_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void on_publish(const char *topic, const uint8_t *payload, int length, void *arg)
+{
+    (void)arg;
+
+    if (strstr(topic, "/action/status") == NULL) {
+        return;
+    }
+
+    char *text = malloc(length + 1);
+
+    TEST_CHECK(text != NULL);
+
+    memcpy(text, payload, length);
+    text[length] = '\0';
+
+    pthread_mutex_lock(&received_lock);
+
+    if (strstr(text, "\"Downloaded\"") != NULL) {
+        downloaded_statuses++;
+    }
+
+    pthread_mutex_unlock(&received_lock);
+
+    free(text);
+}
+
+static int get_downloaded_statuses(void)
+{
+    pthread_mutex_lock(&received_lock);
+    int count = downloaded_statuses;
+    pthread_mutex_unlock(&received_lock);
+
+    return count;
+}
+
+static void wait_downloaded_statuses(int count)
+{
+    for (int waited_ms = 0; waited_ms < TEST_TIMEOUT_MS && get_downloaded_statuses() < count; waited_ms += 10) {
+        usleep(10 * 1000);
+    }
+
+    TEST_CHECK(get_downloaded_statuses() == count);
+}
+
+static int send_all(int fd, const void *data, int len)
+{
+    const uint8_t *bytes = data;
+
+    while (len > 0) {
+        ssize_t sent = send(fd, bytes, len, MSG_NOSIGNAL);
+
+        if (sent <= 0) {
+            return -1;
+        }
+
+        bytes = bytes + sent;
+        len = len - (int)sent;
+    }
+
+    return 0;
+}
+
+static int send_text(int fd, const char *text)
+{
+    return send_all(fd, text, strlen(text));
+}
+
+/* Reads the request upto the end of its headers, the OTA requests have no body */
+static int read_request(int fd, char *request, int len)
+{
+    int received = 0;
+
+    while (received < len - 1) {
+        ssize_t ret_val = recv(fd, request + received, len - 1 - received, 0);
+
+        if (ret_val <= 0) {
+            return -1;
+        }
+
+        received = received + (int)ret_val;
+        request[received] = '\0';
+
+        if (strstr(request, "\r\n\r\n") != NULL) {
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/* Takes the cut of the next full response, only the first one of every download is cut */
+static bool take_cut(test_http_server_t *server)
+{
+    pthread_mutex_lock(&server->lock);
+    bool is_cut = server->is_cutting;
+    server->is_cutting = false;
+    pthread_mutex_unlock(&server->lock);
+
+    return is_cut;
+}
+
+static void count_request(test_http_server_t *server, int *counter)
+{
+    pthread_mutex_lock(&server->lock);
+    (*counter)++;
+    pthread_mutex_unlock(&server->lock);
+}
+
+static void serve_image(test_http_server_t *server, int fd, const char *request)
+{
+    char headers[256];
+    const char *range = strstr(request, "Range: bytes=");
+
+    if (range != NULL) {
+        int offset = atoi(range + strlen("Range: bytes="));
+
+        count_request(server, &server->range_requests);
+
+        snprintf(headers, sizeof(headers), "HTTP/1.1 206 Partial Content\r\nContent-Length: %d\r\nContent-Range: bytes %d-%d/%d\r\n"
+                 "Connection: close\r\n\r\n", TEST_IMAGE_SIZE - offset, offset, TEST_IMAGE_SIZE - 1, TEST_IMAGE_SIZE);
+        send_text(fd, headers);
+        send_all(fd, image + offset, TEST_IMAGE_SIZE - offset);
+        return;
+    }
+
+    count_request(server, &server->full_requests);
+
+    snprintf(headers, sizeof(headers), "HTTP/1.1 200 OK\r\nContent-Length: %d\r\nConnection: close\r\n\r\n", TEST_IMAGE_SIZE);
+    send_text(fd, headers);
+
+    // the connection drops halfway through the image
+    send_all(fd, image, take_cut(server) ? TEST_IMAGE_SIZE / 2 : TEST_IMAGE_SIZE);
+}
+
+static void serve_chunked_image(test_http_server_t *server, int fd)
+{
+    char chunk_header[16];
+    bool is_cut = take_cut(server);
+
+    count_request(server, &server->chunked_requests);
+
+    // the range is never honoured, every request gets the whole image again
+    send_text(fd, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n");
+
+    for (int offset = 0; offset < TEST_IMAGE_SIZE; offset += TEST_CHUNK_SIZE) {
+        int len = (TEST_IMAGE_SIZE - offset < TEST_CHUNK_SIZE) ? TEST_IMAGE_SIZE - offset : TEST_CHUNK_SIZE;
+
+        if (is_cut && offset >= TEST_IMAGE_SIZE / 2) {
+            return;
+        }
+
+        snprintf(chunk_header, sizeof(chunk_header), "%x\r\n", len);
+
+        if (send_text(fd, chunk_header) != 0 || send_all(fd, image + offset, len) != 0 || send_text(fd, "\r\n") != 0) {
+            return;
+        }
+    }
+
+    send_text(fd, "0\r\n\r\n");
+}
+
+static void *http_server_thread(void *arg)
+{
+    test_http_server_t *server = arg;
+    char request[2048];
+    char response[256];
+
+    while (true) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+
+        if (fd < 0) {
+            break;
+        }
+
+        if (read_request(fd, request, sizeof(request)) == 0) {
+            if (!strncmp(request, "GET /redirect/", strlen("GET /redirect/"))) {
+                count_request(server, &server->redirects);
+
+                // the image is hosted elsewhere, like a presigned url of a storage bucket
+                int path_len = strcspn(request + strlen("GET /redirect/"), " ");
+
+                snprintf(response, sizeof(response), "HTTP/1.1 302 Found\r\nLocation: http://127.0.0.1:%d/%.*s\r\n"
+                         "Content-Length: 5\r\nConnection: close\r\n\r\nmoved", server->port, path_len, request + strlen("GET /redirect/"));
+                send_text(fd, response);
+            } else if (!strncmp(request, "GET /image ", strlen("GET /image "))) {
+                serve_image(server, fd, request);
+            } else if (!strncmp(request, "GET /chunked ", strlen("GET /chunked "))) {
+                serve_chunked_image(server, fd);
+            } else {
+                send_text(fd, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            }
+        }
+
+        close(fd);
+    }
+
+    return NULL;
+}
+
+static void start_http_server(test_http_server_t *server)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+
+    memset(server, 0x00, sizeof(test_http_server_t));
+    pthread_mutex_init(&server->lock, NULL);
+
+    memset(&addr, 0x00, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    TEST_CHECK(server->listen_fd >= 0);
+    TEST_CHECK(bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    TEST_CHECK(listen(server->listen_fd, 4) == 0);
+    TEST_CHECK(getsockname(server->listen_fd, (struct sockaddr *)&addr, &addr_len) == 0);
+
+    server->port = ntohs(addr.sin_port);
+
+    TEST_CHECK(pthread_create(&server->thread, NULL, http_server_thread, server) == 0);
+}
+
+static void stop_http_server(test_http_server_t *server)
+{
+    // wakes up the blocked accept
+    shutdown(server->listen_fd, SHUT_RDWR);
+    pthread_join(server->thread, NULL);
+    close(server->listen_fd);
+    pthread_mutex_destroy(&server->lock);
+}
+
+static void check_downloaded_image(void)
+{
+    uint8_t *downloaded = malloc(TEST_IMAGE_SIZE + 1);
+    FILE *file = fopen(BYTEBEAM_LINUX_OTA_IMAGE_FILENAME, "rb");
+
+    TEST_CHECK(downloaded != NULL);
+    TEST_CHECK(file != NULL);
+    TEST_CHECK(fread(downloaded, 1, TEST_IMAGE_SIZE + 1, file) == TEST_IMAGE_SIZE);
+    TEST_CHECK(memcmp(downloaded, image, TEST_IMAGE_SIZE) == 0);
+
+    fclose(file);
+    free(downloaded);
+
+    TEST_CHECK(remove(BYTEBEAM_LINUX_OTA_IMAGE_FILENAME) == 0);
+}
+
+static void run_ota(bytebeam_client_t *bytebeam_client, test_http_server_t *server, const char *path)
+{
+    char ota_url[128];
+
+    snprintf(ota_url, sizeof(ota_url), "http://127.0.0.1:%d/%s", server->port, path);
+
+    pthread_mutex_lock(&server->lock);
+    server->is_cutting = true;
+    pthread_mutex_unlock(&server->lock);
+
+    TEST_CHECK(bytebeam_hal_ota(bytebeam_client, ota_url) == 0);
+
+    check_downloaded_image();
+}
+
+static void test_ota(test_broker_t *broker)
+{
+    bytebeam_client_t bytebeam_client;
+    test_http_server_t server;
+    char ota_action_id[] = "1";
+
+    memset(&bytebeam_client, 0x00, sizeof(bytebeam_client_t));
+
+    bytebeam_client.use_device_config_data = true;
+    test_broker_get_uri(broker, bytebeam_client.device_cfg.broker_uri, BYTEBEAM_BROKER_URL_STR_LEN);
+    strcpy(bytebeam_client.device_cfg.device_id, "1");
+    strcpy(bytebeam_client.device_cfg.project_id, "test");
+
+    TEST_CHECK(bytebeam_init(&bytebeam_client) == BB_SUCCESS);
+    TEST_CHECK(bytebeam_start(&bytebeam_client) == BB_SUCCESS);
+
+    for (int waited_ms = 0; waited_ms < TEST_TIMEOUT_MS && bytebeam_client.connection_status != 1; waited_ms += 10) {
+        usleep(10 * 1000);
+    }
+
+    TEST_CHECK(bytebeam_client.connection_status == 1);
+
+    // the OTA progress goes out as the action status of the OTA action
+    bytebeam_client.ota_action_id = ota_action_id;
+
+    start_http_server(&server);
+
+    // the cut download carries on with a range request, both times through the redirect
+    run_ota(&bytebeam_client, &server, "redirect/image");
+
+    TEST_CHECK(server.redirects == 2);
+    TEST_CHECK(server.full_requests == 1);
+    TEST_CHECK(server.range_requests == 1);
+
+    // the completed download is reported once the whole image is in
+    wait_downloaded_statuses(1);
+
+    // without the size the cut download starts over
+    run_ota(&bytebeam_client, &server, "chunked");
+
+    TEST_CHECK(server.chunked_requests == 2);
+
+    // the size is known once the whole image is in, so it is still reported downloaded
+    wait_downloaded_statuses(2);
+
+    stop_http_server(&server);
+
+    bytebeam_client.ota_action_id = NULL;
+
+    bytebeam_stop(&bytebeam_client);
+    bytebeam_destroy(&bytebeam_client);
+}
+
+int main(void)
+{
+    char work_dir[] = "/tmp/bytebeam_ota_XXXXXX";
+
+    // the image file is written into the working directory
+    TEST_CHECK(mkdtemp(work_dir) != NULL);
+    TEST_CHECK(chdir(work_dir) == 0);
+
+    srand(1);
+
+    for (int index = 0; index < TEST_IMAGE_SIZE; index++) {
+        image[index] = (uint8_t)rand();
+    }
+
+    test_broker_t *broker = test_broker_start(on_publish, NULL);
+
+    TEST_CHECK(broker != NULL);
+
+    test_ota(broker);
+
+    test_broker_stop(broker);
+
+    TEST_CHECK(chdir("/") == 0);
+    TEST_CHECK(rmdir(work_dir) == 0);
+
+    printf("ota test passed\n");
+
+    return 0;
+}